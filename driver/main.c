@@ -126,7 +126,6 @@ TRACEPOINT_PROBE(sched_switch_probe, struct task_struct *prev, struct task_struc
 TRACEPOINT_PROBE(signal_deliver_probe, int sig, struct siginfo *info, struct k_sigaction *ka);
 #endif
 
-DECLARE_BITMAP(g_events_mask, PPM_EVENT_MAX);
 static struct ppm_device *g_ppm_devs;
 static struct class *g_ppm_class;
 static unsigned int g_ppm_numdevs;
@@ -357,7 +356,7 @@ static int ppm_open(struct inode *inode, struct file *filp)
 	consumer->do_dynamic_snaplen = false;
 	consumer->need_to_insert_drop_e = 0;
 	consumer->need_to_insert_drop_x = 0;
-	bitmap_fill(g_events_mask, PPM_EVENT_MAX); /* Enable all syscall to be passed to userspace */
+	bitmap_fill(consumer->events_mask, PPM_EVENT_MAX); /* Enable all syscall to be passed to userspace */
 	ring->info->head = 0;
 	ring->info->tail = 0;
 	ring->nevents = 0;
@@ -624,11 +623,11 @@ static long ppm_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 	{
 		vpr_info("PPM_IOCTL_MASK_ZERO_EVENTS, consumer %p\n", consumer_id);
 
-		bitmap_zero(g_events_mask, PPM_EVENT_MAX);
+		bitmap_zero(consumer->events_mask, PPM_EVENT_MAX);
 
 		/* Used for dropping events so they must stay on */
-		set_bit(PPME_DROP_E, g_events_mask);
-		set_bit(PPME_DROP_X, g_events_mask);
+		set_bit(PPME_DROP_E, consumer->events_mask);
+		set_bit(PPME_DROP_X, consumer->events_mask);
 
 		ret = 0;
 		goto cleanup_ioctl;
@@ -639,12 +638,12 @@ static long ppm_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 
 		vpr_info("PPM_IOCTL_MASK_SET_EVENT (%u), consumer %p\n", syscall_to_set, consumer_id);
 
-		if (syscall_to_set > PPM_EVENT_MAX) {
+		if (syscall_to_set >= PPM_EVENT_MAX) {
 			pr_err("invalid syscall %u\n", syscall_to_set);
 			return -EINVAL;
 		}
 
-		set_bit(syscall_to_set, g_events_mask);
+		set_bit(syscall_to_set, consumer->events_mask);
 
 		ret = 0;
 		goto cleanup_ioctl;
@@ -655,12 +654,12 @@ static long ppm_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 
 		vpr_info("PPM_IOCTL_MASK_UNSET_EVENT (%u), consumer %p\n", syscall_to_unset, consumer_id);
 
-		if (syscall_to_unset > NR_syscalls) {
+		if (syscall_to_unset >= PPM_EVENT_MAX) {
 			pr_err("invalid syscall %u\n", syscall_to_unset);
 			return -EINVAL;
 		}
 
-		clear_bit(syscall_to_unset, g_events_mask);
+		clear_bit(syscall_to_unset, consumer->events_mask);
 
 		ret = 0;
 		goto cleanup_ioctl;
@@ -1096,7 +1095,7 @@ static int record_event_consumer(struct ppm_consumer_t *consumer,
 	int32_t cbres = PPM_SUCCESS;
 	int cpu;
 
-	if (!test_bit(event_type, g_events_mask))
+	if (!test_bit(event_type, consumer->events_mask))
 		return res;
 
 	if (event_type != PPME_DROP_E && event_type != PPME_DROP_X) {
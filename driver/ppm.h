@@ -90,6 +90,7 @@ struct ppm_consumer_t {
 	int dropping_mode;
 	volatile int need_to_insert_drop_e;
 	volatile int need_to_insert_drop_x;
+	DECLARE_BITMAP(events_mask, PPM_EVENT_MAX); /* Event types this consumer receives */
 	struct list_head node;
 };
 
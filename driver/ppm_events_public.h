@@ -1015,6 +1015,10 @@ enum ppm_cmp_operator {
 	CO_CONTAINS = 7,
 	CO_IN = 8,
 	CO_EXISTS = 9,
+	CO_DESCENDANTOF = 10,
+	CO_CONTAINS_ANY = 11,
+	CO_STARTSWITH_ANY = 12,
+	CO_IN_CIDR = 13,
 };
 
 /*
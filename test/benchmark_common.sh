@@ -0,0 +1,59 @@
+#!/bin/bash
+#
+# Helpers shared by the sysdig_*_benchmark.sh scripts. Source this file after
+# setting:
+#  - SYSDIG: the sysdig path
+#  - TRACE: the trace file
+#  - RUNS: the number of runs per configuration. The best run is reported.
+#
+
+# Print the best wall clock time in nanoseconds of $RUNS runs of sysdig on
+# $TRACE. The first argument is the file that gets the output, the rest are
+# passed to sysdig. The output of the last run is left in the file.
+run_best_ns()
+{
+	local out=$1
+	local best=0
+	shift
+
+	for j in $(seq $RUNS)
+	do
+		local start=$(date +%s%N)
+		$SYSDIG -r $TRACE "$@" > $out
+		local end=$(date +%s%N)
+		local cur=$((end - start))
+
+		if [ $best -eq 0 ] || [ $cur -lt $best ]
+		then
+			best=$cur
+		fi
+	done
+
+	echo $best
+}
+
+# Like run_best_ns, in milliseconds
+run_best()
+{
+	local ns=$(run_best_ns "$@")
+	echo $((ns / 1000000))
+}
+
+# Tables that compare every configuration with the first one. The first row
+# printed becomes the baseline.
+BASELINE=""
+
+print_delta_header()
+{
+	printf "%10s %10s  %s\n" "ms" "delta ms" "$1"
+}
+
+print_delta_row()
+{
+	if [ -z "$BASELINE" ]
+	then
+		BASELINE=$1
+	fi
+
+	printf "%10s %10s  %s\n" $1 $(($1 - BASELINE)) "$2"
+}
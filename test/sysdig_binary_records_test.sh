@@ -0,0 +1,202 @@
+#!/bin/bash
+#
+# This script validates the binary records written by sysdig --binary. It
+# builds a small reader with sinsp_binary_record_reader, from
+# userspace/libsinsp/binaryrecords.cpp, which decodes the stream and prints
+# every record the way sysdig prints the same -p format as text. For a set of
+# formats, the script then checks that:
+#  - the header lists the fields of the format, in order
+#  - every record decodes, and the stream ends after the last one
+#  - the decoded records are identical to the text output
+#
+# The formats only use fields that are rendered as decimal numbers, IPv4
+# addresses, booleans or plain strings, which the reader knows how to print.
+#
+# Arguments:
+#  - sysdig path
+#  - trace file
+#  - number of events (optional, default 100000)
+#
+# The compiler is $CXX, or c++.
+#
+# Examples:
+#  ./sysdig_binary_records_test.sh ../build/userspace/sysdig/sysdig trace.scap
+#
+set -eu
+
+SYSDIG=$1
+TRACE=$2
+NEVTS=${3:-100000}
+CXX=${CXX:-c++}
+
+SRCDIR=$(dirname $(readlink -f $0))/../userspace/libsinsp
+
+FORMATS=(
+	"*%evt.num %evt.rawtime %evt.cpu %proc.name %thread.tid %evt.type %evt.dir"
+	"*%evt.num %fd.num %fd.name %evt.rawres %evt.latency %evt.is_io"
+	"*%evt.num %proc.pid %proc.ppid %user.uid %user.name %proc.exe"
+	"*%evt.num %fd.sip %fd.sport %fd.cip %fd.cport %fd.type"
+	"*%evt.num %evt.arg.fd %evt.arg.res %evt.count"
+)
+
+WORKDIR=$(mktemp -d)
+trap "rm -rf $WORKDIR" EXIT
+
+cat > $WORKDIR/binary_records_reader.cpp <<'EOF'
+#include <stdio.h>
+#include <inttypes.h>
+#include <arpa/inet.h>
+
+#include "binaryrecords.h"
+
+using namespace std;
+
+//
+// Print a value the way sysdig renders it as text
+//
+static bool print_value(sinsp_binary_record_reader* reader, uint32_t field)
+{
+	const sinsp_binary_record_reader::field_info& fi = reader->get_fields()[field];
+
+	if(!reader->has_value(field))
+	{
+		fputs("<NA>", stdout);
+		return true;
+	}
+
+	switch(fi.m_type)
+	{
+	case PT_CHARBUF:
+		{
+			uint32_t len;
+			const char* data = reader->get_data(field, &len);
+			fwrite(data, 1, len, stdout);
+			return true;
+		}
+	case PT_BOOL:
+		fputs(reader->get_uint(field)? "true" : "false", stdout);
+		return true;
+	case PT_IPV4ADDR:
+		{
+			struct in_addr addr;
+			addr.s_addr = (uint32_t)reader->get_uint(field);
+			fputs(inet_ntoa(addr), stdout);
+			return true;
+		}
+	case PT_INT8:
+	case PT_INT16:
+	case PT_INT32:
+	case PT_INT64:
+	case PT_ERRNO:
+	case PT_FD:
+	case PT_PID:
+		if(fi.m_print_format != PF_DEC && fi.m_print_format != PF_NA)
+		{
+			break;
+		}
+
+		printf("%" PRId64, reader->get_int(field));
+		return true;
+	case PT_UINT8:
+	case PT_UINT16:
+	case PT_UINT32:
+	case PT_UINT64:
+	case PT_PORT:
+	case PT_RELTIME:
+	case PT_ABSTIME:
+		if(fi.m_print_format != PF_DEC && fi.m_print_format != PF_NA)
+		{
+			break;
+		}
+
+		printf("%" PRIu64, reader->get_uint(field));
+		return true;
+	default:
+		break;
+	}
+
+	fprintf(stderr, "field %s: type %u with print format %u is not supported\n",
+		fi.m_name.c_str(), fi.m_type, fi.m_print_format);
+	return false;
+}
+
+int main()
+{
+	sinsp_binary_record_reader reader;
+	int32_t res;
+
+	if(!reader.read_header(stdin))
+	{
+		fprintf(stderr, "%s\n", reader.get_error().c_str());
+		return 1;
+	}
+
+	const vector<sinsp_binary_record_reader::field_info>& fields = reader.get_fields();
+
+	//
+	// The first line lists the fields in the header
+	//
+	for(uint32_t j = 0; j < fields.size(); j++)
+	{
+		printf("%s%s", (j == 0)? "" : " ", fields[j].m_name.c_str());
+	}
+	printf("\n");
+
+	while((res = reader.read_record(stdin)) == 1)
+	{
+		for(uint32_t j = 0; j < fields.size(); j++)
+		{
+			if(j != 0)
+			{
+				fputc(' ', stdout);
+			}
+
+			if(!print_value(&reader, j))
+			{
+				return 1;
+			}
+		}
+
+		fputc('\n', stdout);
+	}
+
+	if(res < 0)
+	{
+		fprintf(stderr, "%s\n", reader.get_error().c_str());
+		return 1;
+	}
+
+	return 0;
+}
+EOF
+
+$CXX -std=c++0x -O2 -I$SRCDIR -o $WORKDIR/binary_records_reader \
+	$WORKDIR/binary_records_reader.cpp $SRCDIR/binaryrecords.cpp
+
+FAILED=0
+
+printf "%10s %10s  %s\n" "records" "result" "format"
+
+for f in "${FORMATS[@]}"
+do
+	# The header line expected from the reader: the field names of the
+	# format
+	echo "$f" | sed -e 's/^\*//' -e 's/%//g' > $WORKDIR/expected
+	$SYSDIG -r $TRACE -n $NEVTS -p "$f" >> $WORKDIR/expected
+
+	RES="OK"
+	if ! $SYSDIG -r $TRACE -n $NEVTS --binary -p "$f" | $WORKDIR/binary_records_reader > $WORKDIR/decoded
+	then
+		RES="ERROR"
+		FAILED=1
+	elif ! cmp -s $WORKDIR/expected $WORKDIR/decoded
+	then
+		RES="DIFFERENT"
+		FAILED=1
+		diff $WORKDIR/expected $WORKDIR/decoded | head -6 | sed 's/^/           /'
+	fi
+
+	printf "%10s %10s  %s\n" $(($(wc -l < $WORKDIR/decoded) - 1)) $RES "$f"
+done
+
+exit $FAILED
@@ -0,0 +1,51 @@
+#!/bin/bash
+#
+# This script measures the cost of the chisels by running sysdig on a trace
+# file with a set of representative chisels, and comparing the run time with
+# the one of a run without chisels. The top* chisels group the events in a
+# table and print it once at the end of the capture, so the difference is
+# dominated by the per event work of the chisel.
+#
+# The chisels are looked up like sysdig does, so run the script from a
+# directory that contains the chisels/ directory, or install them first.
+#
+# Arguments:
+#  - sysdig path
+#  - trace file
+#  - number of runs per chisel (optional, default 5). The best run is reported.
+#
+# Examples:
+#  cd userspace/sysdig && ../../test/sysdig_chisel_benchmark.sh ../../build/userspace/sysdig/sysdig trace.scap
+#
+set -eu
+
+SYSDIG=$1
+TRACE=$2
+RUNS=${3:-5}
+
+CHISELS=(
+	""
+	"topfiles_bytes"
+	"topfiles_time"
+	"topprocs_file"
+	"topprocs_net"
+	"topscalls"
+	"topscalls_time"
+	"topconns"
+	"fdbytes_by proc.pid"
+	"fdtime_by fd.name"
+)
+
+source $(dirname $(readlink -f $0))/benchmark_common.sh
+
+print_delta_header "chisel"
+
+for c in "${CHISELS[@]}"
+do
+	if [ -z "$c" ]
+	then
+		print_delta_row $(run_best /dev/null -q) "<none>"
+	else
+		print_delta_row $(run_best /dev/null -q -c $c) "$c"
+	fi
+done
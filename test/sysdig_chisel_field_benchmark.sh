@@ -0,0 +1,134 @@
+#!/bin/bash
+#
+# This script measures the cost of the event accessors that the chisels call
+# for every event: evt.field() with a set of representative fields, and
+# evt.get_num(), evt.get_ts() and evt.get_type().
+#
+# It generates a chisel that calls the accessor a fixed number of times in
+# on_event(), and runs it on a trace file. The time of a run with no calls is
+# subtracted, so the result is the overhead of a single call.
+#
+# Arguments:
+#  - sysdig path
+#  - trace file
+#  - number of calls per event (optional, default 10)
+#  - number of runs per accessor (optional, default 5). The best run is
+#    reported.
+#
+# Examples:
+#  ./sysdig_chisel_field_benchmark.sh ../build/userspace/sysdig/sysdig trace.scap
+#
+set -eu
+
+SYSDIG=$1
+TRACE=$2
+CALLS=${3:-10}
+RUNS=${4:-5}
+
+ACCESSORS=(
+	"evt.type"
+	"evt.num"
+	"evt.rawarg.res"
+	"evt.latency"
+	"proc.pid"
+	"proc.name"
+	"fd.name"
+	"evt.buffer"
+	"get_num"
+	"get_ts"
+	"get_type"
+)
+
+CHISELDIR=$(mktemp -d)
+trap "rm -rf $CHISELDIR" EXIT
+
+cat > $CHISELDIR/field_benchmark.lua <<'EOC'
+description = "Calls an event accessor a number of times for every event"
+short_description = "evt.field() benchmark"
+category = "Misc"
+hidden = true
+
+args =
+{
+	{
+		name = "accessor",
+		description = "the field to extract, or get_num, get_ts or get_type",
+		argtype = "string"
+	},
+	{
+		name = "calls",
+		description = "the number of calls per event",
+		argtype = "int"
+	},
+}
+
+accessor = ""
+calls = 0
+nevts = 0
+
+function on_set_arg(name, val)
+	if name == "accessor" then
+		accessor = val
+	elseif name == "calls" then
+		calls = tonumber(val)
+	end
+
+	return true
+end
+
+function on_init()
+	if accessor == "get_num" or accessor == "get_ts" or accessor == "get_type" then
+		getter = evt[accessor]
+	else
+		fld = chisel.request_field(accessor)
+	end
+
+	return true
+end
+
+function on_event()
+	nevts = nevts + 1
+
+	if getter ~= nil then
+		for j = 1, calls do
+			getter()
+		end
+	else
+		for j = 1, calls do
+			evt.field(fld)
+		end
+	end
+
+	return true
+end
+
+function on_capture_end()
+	print(nevts)
+	return true
+end
+EOC
+
+export SYSDIG_CHISEL_DIR=$CHISELDIR/
+
+source $(dirname $(readlink -f $0))/benchmark_common.sh
+
+# Print the best time in nanoseconds of the benchmark chisel with the given
+# accessor and number of calls, leaving the output of the last run in
+# $CHISELDIR/out
+run_chisel()
+{
+	run_best_ns $CHISELDIR/out -c field_benchmark "$1 $2"
+}
+
+BASELINE=$(run_chisel evt.num 0)
+NEVTS=$(cat $CHISELDIR/out)
+
+echo "$NEVTS events, $CALLS calls per event"
+printf "%10s %12s  %s\n" "ms" "ns per call" "accessor"
+printf "%10s %12s  %s\n" $((BASELINE / 1000000)) "-" "<no calls>"
+
+for a in "${ACCESSORS[@]}"
+do
+	T=$(run_chisel $a $CALLS)
+	printf "%10s %12s  %s\n" $((T / 1000000)) $(( (T - BASELINE) / (NEVTS * CALLS) )) "$a"
+done
@@ -0,0 +1,97 @@
+#!/bin/bash
+#
+# This script measures the cost of filtering by running sysdig on a trace file
+# with a set of representative filters, and comparing the run time with the
+# one of an unfiltered run. Events are not printed, so the difference is
+# dominated by the filter evaluation.
+#
+# Arguments:
+#  - sysdig path
+#  - trace file
+#  - number of runs per filter (optional, default 5). The best run is reported.
+#
+# Examples:
+#  ./sysdig_filter_benchmark.sh ../build/userspace/sysdig/sysdig trace.scap
+#  ./sysdig_filter_benchmark.sh ../build/userspace/sysdig/sysdig trace.scap 10
+#
+set -eu
+
+SYSDIG=$1
+TRACE=$2
+RUNS=${3:-5}
+
+FILTERS=(
+	""
+	"evt.type=open"
+	"evt.type!=switch"
+	"proc.name=bash"
+	"fd.name contains /etc"
+	"evt.type=open and fd.name contains /etc"
+	"evt.type=read or evt.type=write or evt.type=sendto or evt.type=recvfrom"
+	"evt.type in ('open', 'openat', 'creat', 'close')"
+	"not (fd.name contains /proc or fd.name contains /dev)"
+	"(evt.type=connect or evt.type=accept) and fd.typechar=4 and not proc.name in ('sshd', 'nginx')"
+	"proc.aname=bash"
+	"evt.dir=< and evt.rawres<0"
+	"fd.port=80 or fd.port=443"
+	"__CONTAINS_OR__"
+	"__CONTAINS_ANY__"
+	"__STARTSWITH_ANY__"
+	"fd.sip in_cidr (10.0.0.0/8, 172.16.0.0/12, 192.168.0.0/16, 127.0.0.0/8, fc00::/7)"
+	"__IN_CIDR_5000__"
+)
+
+# A large pattern list, to compare the multi-pattern operators with the
+# equivalent 'or' chain
+PATTERNS=(/etc/shadow /etc/sudoers /root/.ssh /root/.bash_history /proc/kcore
+	/dev/mem /dev/kmem /boot /lib/modules /usr/bin/sudo /var/log/auth.log
+	/var/run/docker.sock /etc/ld.so.preload /etc/crontab /var/spool/cron
+	/etc/passwd /etc/group /etc/hosts /etc/resolv.conf /etc/pam.d)
+
+CONTAINS_OR=""
+PATTERN_LIST=""
+for p in "${PATTERNS[@]}"
+do
+	if [ -n "$CONTAINS_OR" ]
+	then
+		CONTAINS_OR="$CONTAINS_OR or "
+		PATTERN_LIST="$PATTERN_LIST, "
+	fi
+	CONTAINS_OR="${CONTAINS_OR}fd.name contains $p"
+	PATTERN_LIST="$PATTERN_LIST$p"
+done
+
+# 5000 networks, to check that 'in_cidr' doesn't slow down with the size of
+# the list
+NETWORK_LIST=""
+for a in $(seq 0 19)
+do
+	for b in $(seq 0 249)
+	do
+		NETWORK_LIST="$NETWORK_LIST${NETWORK_LIST:+, }10.$a.$b.0/24"
+	done
+done
+
+for j in "${!FILTERS[@]}"
+do
+	case "${FILTERS[$j]}" in
+		__CONTAINS_OR__) FILTERS[$j]="$CONTAINS_OR";;
+		__CONTAINS_ANY__) FILTERS[$j]="fd.name contains_any ($PATTERN_LIST)";;
+		__STARTSWITH_ANY__) FILTERS[$j]="fd.name startswith_any ($PATTERN_LIST)";;
+		__IN_CIDR_5000__) FILTERS[$j]="fd.sip in_cidr ($NETWORK_LIST)";;
+	esac
+done
+
+source $(dirname $(readlink -f $0))/benchmark_common.sh
+
+print_delta_header "filter"
+
+for f in "${FILTERS[@]}"
+do
+	if [ -z "$f" ]
+	then
+		print_delta_row $(run_best /dev/null -q) "<none>"
+	else
+		print_delta_row $(run_best /dev/null -q "$f") "$f"
+	fi
+done
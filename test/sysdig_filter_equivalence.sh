@@ -0,0 +1,131 @@
+#!/bin/bash
+#
+# This script checks that the compiled filters accept the same events as the
+# expression tree they are built from. For every filter of a representative
+# set, it runs sysdig on the trace files and prints the number of the accepted
+# events, first with the compiled programs and the event type dispatch, and
+# then with SYSDIG_FILTER_EVALUATOR=tree, which makes the filter walk the
+# expression tree. The two outputs must be identical.
+#
+# The set covers every comparison operator, the field types, the checks with
+# custom comparison logic, the boolean operators with nesting, and filters
+# that the event type dispatch can decide alone. The traces are long enough
+# for the filters to reorder their checks, so the reordered programs are
+# checked too.
+#
+# Arguments:
+#  - sysdig path
+#  - one or more trace files
+#
+# Examples:
+#  ./sysdig_filter_equivalence.sh ../build/userspace/sysdig/sysdig trace.scap
+#  ./sysdig_filter_equivalence.sh ../build/userspace/sysdig/sysdig traces/*.scap
+#
+# Note:
+#  the outputs of the filters that differ are kept in a directory that is
+#  printed at the end, for analysis.
+#
+set -eu
+
+SYSDIG=$1
+shift
+TRACES=("$@")
+
+FILTERS=(
+	"evt.type=open"
+	"evt.type!=switch"
+	"evt.type in (open, openat, read, write)"
+	"not evt.type in (switch, read, write)"
+	"evt.type=open or evt.type=close"
+	"evt.type=open and evt.dir=<"
+	"evt.type=open and not evt.type=open"
+	"evt.type=open or not evt.type=open"
+	"evt.type=read and evt.cpu=1"
+	"evt.num<1000 and evt.type=close"
+	"evt.cpu=0 or evt.type=open"
+	"evt.dir=< and evt.rawres<0"
+	"evt.rawres>=0 and evt.rawres<=4096"
+	"evt.rawres>100 and evt.rawres!=4096"
+	"evt.latency>10000"
+	"evt.is_io=true"
+	"evt.is_io_read=true and not evt.is_io_write=true"
+	"proc.name=bash"
+	"proc.name!=sysdig and proc.pid>1000"
+	"proc.name in (bash, sshd, nginx, java)"
+	"proc.aname=bash"
+	"proc.apid=1"
+	"proc.apid[1]=1"
+	"thread.tid descendantof 1"
+	"thread.tid!=1000"
+	"user.name=root"
+	"fd.name contains /etc"
+	"fd.name exists and not fd.name exists"
+	"fd.name contains_any (/etc, /proc, /dev, /var/log)"
+	"fd.name startswith_any (/etc, /proc, /dev, /var/log)"
+	"fd.name in (/dev/null, /etc/passwd, /etc/hosts)"
+	"fd.typechar=4 or fd.typechar=6"
+	"fd.type=ipv4 and fd.l4proto=tcp"
+	"fd.num>2 and fd.num<100"
+	"fd.ip=127.0.0.1"
+	"fd.sip=127.0.0.1 or fd.cip=127.0.0.1"
+	"fd.sip in_cidr (10.0.0.0/8, 172.16.0.0/12, 192.168.0.0/16, 127.0.0.0/8, fc00::/7)"
+	"fd.port=80 or fd.port=443"
+	"fd.sport>1024"
+	"evt.arg.fd=3"
+	"evt.arg.res=0"
+	"evt.buffer contains GET"
+	"(evt.type=connect or evt.type=accept) and fd.typechar=4 and not proc.name in (sshd, nginx)"
+	"not (fd.name contains /proc or fd.name contains /dev) and (evt.type=open or evt.type=openat)"
+	"((proc.name=bash or proc.name=sh) and (evt.type=execve or evt.type=clone)) or fd.name contains /tmp"
+	"evt.type=write and (fd.num=1 or fd.num=2) and evt.rawres>0 and not proc.name=sysdig"
+)
+
+WORKDIR=$(mktemp -d)
+FAILED=0
+
+printf "%10s %10s  %s\n" "events" "result" "filter"
+
+for t in "${TRACES[@]}"
+do
+	echo "$t"
+	n=0
+
+	for f in "${FILTERS[@]}"
+	do
+		n=$((n + 1))
+
+		#
+		# A filter that this sysdig build can't compile is reported as an
+		# error
+		#
+		if ! $SYSDIG -r $t -p "%evt.num" "$f" > $WORKDIR/compiled.$n 2> $WORKDIR/err
+		then
+			printf "%10s %10s  %s\n" "-" "ERROR" "$f"
+			sed 's/^/           /' $WORKDIR/err
+			FAILED=1
+			continue
+		fi
+
+		SYSDIG_FILTER_EVALUATOR=tree $SYSDIG -r $t -p "%evt.num" "$f" > $WORKDIR/tree.$n
+
+		if cmp -s $WORKDIR/compiled.$n $WORKDIR/tree.$n
+		then
+			printf "%10s %10s  %s\n" $(wc -l < $WORKDIR/compiled.$n) "OK" "$f"
+			rm $WORKDIR/compiled.$n $WORKDIR/tree.$n
+		else
+			printf "%10s %10s  %s\n" $(wc -l < $WORKDIR/compiled.$n) "DIFFERENT" "$f"
+			FAILED=1
+		fi
+	done
+done
+
+rm -f $WORKDIR/err
+
+if [ $FAILED -eq 0 ]
+then
+	rm -rf $WORKDIR
+else
+	echo "The outputs are in $WORKDIR"
+fi
+
+exit $FAILED
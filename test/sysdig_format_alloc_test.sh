@@ -0,0 +1,154 @@
+#!/bin/bash
+#
+# This script checks that formatting the output doesn't allocate memory for
+# every event. It counts the malloc, calloc and realloc calls of sysdig with a
+# preloaded library, and runs every output format on the first N and on the
+# first 2N events of a trace file. The same is done with -q, which parses the
+# events without formatting them. The allocations of the formatting in the
+# second N events are then:
+#
+#   (format 2N - format N) - (quiet 2N - quiet N)
+#
+# This must not grow with the number of events. A few allocations are still
+# expected when a buffer grows to fit a longer value, or when the timestamp
+# enters a new second and the timezone is looked up, so the check fails when
+# the count is above a small fixed budget.
+#
+# Arguments:
+#  - sysdig path
+#  - trace file
+#  - number of events N (optional, default 200000). The trace file must have
+#    at least 2N events.
+#  - allocation budget (optional, default 64)
+#
+# The compiler is $CC, or cc.
+#
+# Examples:
+#  ./sysdig_format_alloc_test.sh ../build/userspace/sysdig/sysdig trace.scap
+#  ./sysdig_format_alloc_test.sh ../build/userspace/sysdig/sysdig trace.scap 500000 16
+#
+set -eu
+
+SYSDIG=$1
+TRACE=$2
+NEVTS=${3:-200000}
+BUDGET=${4:-64}
+CC=${CC:-cc}
+
+# Every entry is a set of command line flags. __DEFAULT__ is the default
+# output format.
+FORMATS=(
+	"-p %evt.num"
+	"-p %evt.num %evt.time %evt.cpu %proc.name (%thread.tid) %evt.dir %evt.type %evt.args"
+	"-p %evt.num %evt.datetime %evt.rawtime %evt.reltime %evt.latency"
+	"-p %evt.num %20proc.name %10thread.tid %40fd.name"
+	"-p %evt.num %fd.sip %fd.sport %fd.cip %fd.cport %evt.buffer"
+	"__DEFAULT__"
+	"-j"
+)
+
+WORKDIR=$(mktemp -d)
+trap "rm -rf $WORKDIR" EXIT
+
+cat > $WORKDIR/alloccount.c <<'EOF'
+#include <stdio.h>
+#include <stdlib.h>
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t nmemb, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+
+static unsigned long long g_nallocs = 0;
+
+void* malloc(size_t size)
+{
+	__atomic_add_fetch(&g_nallocs, 1, __ATOMIC_RELAXED);
+	return __libc_malloc(size);
+}
+
+void* calloc(size_t nmemb, size_t size)
+{
+	__atomic_add_fetch(&g_nallocs, 1, __ATOMIC_RELAXED);
+	return __libc_calloc(nmemb, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+	__atomic_add_fetch(&g_nallocs, 1, __ATOMIC_RELAXED);
+	return __libc_realloc(ptr, size);
+}
+
+//
+// The count is written when the process exits
+//
+static void __attribute__((destructor)) write_count()
+{
+	const char* fname = getenv("ALLOC_COUNT_FILE");
+	FILE* f;
+
+	if(fname == NULL || (f = fopen(fname, "w")) == NULL)
+	{
+		return;
+	}
+
+	fprintf(f, "%llu\n", g_nallocs);
+	fclose(f);
+}
+EOF
+
+$CC -O2 -shared -fPIC -o $WORKDIR/alloccount.so $WORKDIR/alloccount.c
+
+# Print the number of allocations of sysdig on the first $1 events. The other
+# arguments are passed to sysdig.
+count_allocs()
+{
+	local nevts=$1
+	shift
+
+	ALLOC_COUNT_FILE=$WORKDIR/count LD_PRELOAD=$WORKDIR/alloccount.so \
+		$SYSDIG -r $TRACE -n $nevts "$@" > /dev/null
+	cat $WORKDIR/count
+}
+
+# Print the allocations between the events N and 2N
+count_second_half()
+{
+	local first=$(count_allocs $NEVTS "$@")
+	local both=$(count_allocs $((NEVTS * 2)) "$@")
+
+	echo $((both - first))
+}
+
+QUIET=$(count_second_half -q)
+FAILED=0
+
+echo "Allocations of the formatting in $NEVTS events, budget $BUDGET"
+printf "%10s  %s\n" "allocs" "format"
+
+for f in "${FORMATS[@]}"
+do
+	if [ "$f" = "__DEFAULT__" ]
+	then
+		N=$(($(count_second_half) - QUIET))
+	else
+		read -r FLAG FMT <<< "$f"
+
+		if [ -z "$FMT" ]
+		then
+			N=$(($(count_second_half $FLAG) - QUIET))
+		else
+			N=$(($(count_second_half $FLAG "$FMT") - QUIET))
+		fi
+	fi
+
+	RES=""
+	if [ $N -gt $BUDGET ]
+	then
+		RES="  FAILED"
+		FAILED=1
+	fi
+
+	printf "%10s  %s%s\n" $N "$f" "$RES"
+done
+
+exit $FAILED
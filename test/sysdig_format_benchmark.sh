@@ -0,0 +1,57 @@
+#!/bin/bash
+#
+# This script measures the cost of formatting the output by running sysdig
+# on a trace file with a set of representative output formats, and comparing
+# the run time with the one of a run that only prints the event number. The
+# output goes to /dev/null, so the difference is dominated by the rendering
+# of the fields.
+#
+# Arguments:
+#  - sysdig path
+#  - trace file
+#  - number of runs per format (optional, default 5). The best run is reported.
+#
+# Examples:
+#  ./sysdig_format_benchmark.sh ../build/userspace/sysdig/sysdig trace.scap
+#  ./sysdig_format_benchmark.sh ../build/userspace/sysdig/sysdig trace.scap 10
+#
+set -eu
+
+SYSDIG=$1
+TRACE=$2
+RUNS=${3:-5}
+
+# Every entry is a set of command line flags. __DEFAULT__ is the default
+# output format.
+FORMATS=(
+	"-p %evt.num"
+	"-p %evt.num %evt.time"
+	"-p %evt.num %evt.time.s"
+	"-p %evt.num %evt.datetime"
+	"-p %evt.num %evt.rawtime %evt.reltime %evt.latency"
+	"-p %evt.num %proc.name %thread.tid %fd.name"
+	"-p %evt.num %20proc.name %10thread.tid %40fd.name"
+	"-p %evt.num %evt.args"
+	"__DEFAULT__"
+	"-j"
+)
+
+source $(dirname $(readlink -f $0))/benchmark_common.sh
+
+print_delta_header "format"
+
+for f in "${FORMATS[@]}"
+do
+	if [ "$f" == "__DEFAULT__" ]
+	then
+		T=$(run_best /dev/null)
+		f="<default>"
+	elif [ "${f:0:3}" == "-p " ]
+	then
+		T=$(run_best /dev/null -p "${f:3}")
+	else
+		T=$(run_best /dev/null $f)
+	fi
+
+	print_delta_row $T "$f"
+done
@@ -0,0 +1,228 @@
+#!/bin/bash
+#
+# This script measures what sinsp_intern_pool saves when a program has many
+# threads. It builds a small program against internpool.h that creates a
+# number of threads of the same process, every one with the arguments and the
+# environment of the parent, and compares:
+#  - vector parse: every thread parses its own vector<string>, like set_args()
+#    did before the pool
+#  - vector copy: every thread copies the vector of its parent, like clone()
+#    did before the pool
+#  - intern: every thread interns the raw buffer, like set_args() does now
+#  - handle copy: every thread copies the handle of its parent, like clone()
+#    does now
+# For every mode, it reports the time per thread and the heap bytes that stay
+# allocated per thread, for the arguments and the environment together.
+#
+# The environment is the one of the script, and the arguments are synthetic.
+#
+# Arguments:
+#  - number of threads (optional, default 100000)
+#  - number of runs per mode (optional, default 5). The best run is reported.
+#
+# The compiler is $CXX, or c++.
+#
+# Examples:
+#  ./sysdig_internpool_benchmark.sh
+#  ./sysdig_internpool_benchmark.sh 1000000 3
+#
+set -eu
+
+NTHREADS=${1:-100000}
+RUNS=${2:-5}
+CXX=${CXX:-c++}
+
+SRCDIR=$(dirname $(readlink -f $0))/../userspace/libsinsp
+
+WORKDIR=$(mktemp -d)
+trap "rm -rf $WORKDIR" EXIT
+
+cat > $WORKDIR/internpool_benchmark.cpp <<'EOF'
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "internpool.h"
+
+extern char** environ;
+
+//
+// Every allocation is prefixed with its size, so that the live heap bytes can
+// be tracked
+//
+static int64_t g_live_bytes = 0;
+
+void* operator new(size_t size)
+{
+	size_t* res = (size_t*)malloc(size + 16);
+	if(res == NULL)
+	{
+		throw std::bad_alloc();
+	}
+
+	res[0] = size;
+	g_live_bytes += size;
+	return res + 2;
+}
+
+void operator delete(void* p) noexcept
+{
+	if(p != NULL)
+	{
+		size_t* base = (size_t*)p - 2;
+		g_live_bytes -= base[0];
+		free(base);
+	}
+}
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void parse_strvec(const char* buf, size_t len, vector<string>* res)
+{
+	size_t offset = 0;
+
+	while(offset < len)
+	{
+		res->push_back(string(buf + offset));
+		offset += res->back().size() + 1;
+	}
+}
+
+static void append_str(string* buf, const char* str)
+{
+	buf->append(str, strlen(str) + 1);
+}
+
+struct thread_state
+{
+	vector<string> m_args;
+	vector<string> m_env;
+	sinsp_intern_pool<vector<string>>::handle m_pooled_args;
+	sinsp_intern_pool<vector<string>>::handle m_pooled_env;
+};
+
+enum mode
+{
+	VECTOR_PARSE,
+	VECTOR_COPY,
+	INTERN,
+	HANDLE_COPY,
+};
+
+static const char* mode_names[] = {"vector parse", "vector copy", "intern", "handle copy"};
+
+//
+// Creates nthreads threads, and returns the time it took. live_bytes gets the
+// heap bytes held by the threads.
+//
+static uint64_t run(mode m, const string& args, const string& env, uint32_t nthreads, int64_t* live_bytes)
+{
+	sinsp_intern_pool<vector<string>> pool;
+	thread_state parent;
+
+	parse_strvec(args.data(), args.size(), &parent.m_args);
+	parse_strvec(env.data(), env.size(), &parent.m_env);
+	parent.m_pooled_args = pool.intern(args.data(), args.size(), parse_strvec);
+	parent.m_pooled_env = pool.intern(env.data(), env.size(), parse_strvec);
+
+	vector<thread_state>* threads = new vector<thread_state>(nthreads);
+	int64_t start_bytes = g_live_bytes;
+	uint64_t start = now_ns();
+
+	for(uint32_t j = 0; j < nthreads; j++)
+	{
+		thread_state& t = (*threads)[j];
+
+		switch(m)
+		{
+		case VECTOR_PARSE:
+			parse_strvec(args.data(), args.size(), &t.m_args);
+			parse_strvec(env.data(), env.size(), &t.m_env);
+			break;
+		case VECTOR_COPY:
+			t.m_args = parent.m_args;
+			t.m_env = parent.m_env;
+			break;
+		case INTERN:
+			t.m_pooled_args = pool.intern(args.data(), args.size(), parse_strvec);
+			t.m_pooled_env = pool.intern(env.data(), env.size(), parse_strvec);
+			break;
+		case HANDLE_COPY:
+			t.m_pooled_args = parent.m_pooled_args;
+			t.m_pooled_env = parent.m_pooled_env;
+			break;
+		}
+	}
+
+	uint64_t res = now_ns() - start;
+	*live_bytes = g_live_bytes - start_bytes;
+
+	delete threads;
+	return res;
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t nthreads = atoi(argv[1]);
+	uint32_t nruns = atoi(argv[2]);
+	string args;
+	string env;
+
+	append_str(&args, "/usr/lib/jvm/java-8-openjdk-amd64/bin/java");
+	append_str(&args, "-Xms512m");
+	append_str(&args, "-Xmx2g");
+	append_str(&args, "-XX:+UseG1GC");
+	append_str(&args, "-Djava.io.tmpdir=/var/tmp/app");
+	append_str(&args, "-Dlog4j.configuration=file:/etc/app/log4j.properties");
+	append_str(&args, "-cp");
+	append_str(&args, "/opt/app/lib/app.jar:/opt/app/lib/commons.jar:/opt/app/lib/netty.jar");
+	append_str(&args, "com.example.app.Server");
+	append_str(&args, "--config=/etc/app/server.conf");
+
+	for(char** e = environ; *e != NULL; e++)
+	{
+		append_str(&env, *e);
+	}
+
+	printf("%u threads, %zu argument bytes, %zu environment bytes\n", nthreads, args.size(), env.size());
+	printf("%14s %14s %14s\n", "mode", "ns/thread", "bytes/thread");
+
+	for(uint32_t m = VECTOR_PARSE; m <= HANDLE_COPY; m++)
+	{
+		uint64_t best = 0;
+		int64_t live_bytes = 0;
+
+		for(uint32_t j = 0; j < nruns; j++)
+		{
+			uint64_t cur = run((mode)m, args, env, nthreads, &live_bytes);
+
+			if(best == 0 || cur < best)
+			{
+				best = cur;
+			}
+		}
+
+		printf("%14s %14.1f %14.1f\n",
+			mode_names[m],
+			(double)best / nthreads,
+			(double)live_bytes / nthreads);
+	}
+
+	return 0;
+}
+EOF
+
+$CXX -std=c++0x -O2 -I$SRCDIR -o $WORKDIR/internpool_benchmark $WORKDIR/internpool_benchmark.cpp
+$WORKDIR/internpool_benchmark $NTHREADS $RUNS
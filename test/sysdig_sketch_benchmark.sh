@@ -0,0 +1,104 @@
+#!/bin/bash
+#
+# This script compares the bounded memory aggregations with the exact ones,
+# on a trace file with a high cardinality key.
+#
+# The top keys are computed by table_generator, first tracking every key and
+# then with a set of max_groups values. For every size, the script reports the
+# run time, how many of the exact top keys are found, and the largest error of
+# the reported values, relative to the exact ones.
+#
+# The number of distinct values of the key is then estimated by the
+# count_distinct chisel with a set of precisions, and compared with the exact
+# count.
+#
+# The chisels are looked up like sysdig does, so run the script from a
+# directory that contains the chisels/ directory, or install them first.
+#
+# Arguments:
+#  - sysdig path
+#  - trace file
+#  - key field (optional, default fd.name)
+#  - value field (optional, default evt.rawarg.res)
+#  - number of top keys to compare (optional, default 10)
+#  - number of runs per configuration (optional, default 3). The best run is
+#    reported.
+#
+# Examples:
+#  cd userspace/sysdig && ../../test/sysdig_sketch_benchmark.sh ../../build/userspace/sysdig/sysdig trace.scap
+#  cd userspace/sysdig && ../../test/sysdig_sketch_benchmark.sh ../../build/userspace/sysdig/sysdig trace.scap fd.sip evt.count 20
+#
+set -eu
+
+SYSDIG=$1
+TRACE=$2
+KEY=${3:-fd.name}
+VALUE=${4:-evt.rawarg.res}
+TOP=${5:-10}
+RUNS=${6:-3}
+
+SIZES=(64 256 1024 4096 16384)
+PRECISIONS=(8 10 12 14 16)
+
+WORKDIR=$(mktemp -d)
+trap "rm -rf $WORKDIR" EXIT
+
+source $(dirname $(readlink -f $0))/benchmark_common.sh
+
+# The rows of a table_generator output, as 'key value' lines. The ~ that
+# marks the estimated values is removed.
+table_rows()
+{
+	awk 'found { v = $1; sub(/^~/, "", v); $1 = ""; print substr($0, 2) "\t" v } /^-----/ { found = 1 }' $1
+}
+
+top_keys()
+{
+	$SYSDIG -r $TRACE -c table_generator "$KEY Key $VALUE Value '$KEY exists' $1 none $2" > $WORKDIR/out
+}
+
+echo "Top $TOP $KEY by $VALUE"
+printf "%10s %10s %10s %12s\n" "groups" "ms" "found" "max error"
+
+T=$(run_best $WORKDIR/out -c table_generator "$KEY Key $VALUE Value '$KEY exists' $TOP none 0")
+table_rows $WORKDIR/out > $WORKDIR/exact_top
+top_keys 0 0
+table_rows $WORKDIR/out > $WORKDIR/exact_all
+NKEYS=$(wc -l < $WORKDIR/exact_all)
+printf "%10s %10s %10s %12s\n" "all" $T $(wc -l < $WORKDIR/exact_top) "0%"
+
+for s in "${SIZES[@]}"
+do
+	T=$(run_best $WORKDIR/out -c table_generator "$KEY Key $VALUE Value '$KEY exists' $TOP none $s")
+	table_rows $WORKDIR/out > $WORKDIR/approx_top
+
+	FOUND=$(awk -F'\t' 'NR == FNR { top[$1] = 1; next } ($1 in top) { n++ } END { print n + 0 }' \
+		$WORKDIR/exact_top $WORKDIR/approx_top)
+	ERR=$(awk -F'\t' 'NR == FNR { exact[$1] = $2; next }
+		{ e = ($1 in exact) ? ($2 - exact[$1]) / exact[$1] : 1; if(e < 0) e = -e; if(e > max) max = e }
+		END { printf "%.2f%%", max * 100 }' \
+		$WORKDIR/exact_all $WORKDIR/approx_top)
+
+	printf "%10s %10s %10s %12s\n" $s $T "$FOUND" "$ERR"
+done
+
+echo
+echo "Distinct values of $KEY"
+printf "%10s %10s %10s %12s %12s\n" "precision" "ms" "memory" "estimate" "error"
+
+START=$(date +%s%N)
+EXACT=$($SYSDIG -r $TRACE -p "%$KEY" "$KEY exists" | sort -u | wc -l)
+END=$(date +%s%N)
+printf "%10s %10s %10s %12s %12s\n" "exact" $(( (END - START) / 1000000 )) "-" $EXACT "0%"
+
+for p in "${PRECISIONS[@]}"
+do
+	T=$(run_best $WORKDIR/out -c count_distinct "$KEY $p")
+	EST=$(awk '{ print $1 }' $WORKDIR/out)
+	ERR=$(awk -v e=$EST -v x=$EXACT 'BEGIN { d = (e - x) / x; if(d < 0) d = -d; printf "%.2f%%", d * 100 }')
+
+	printf "%10s %10s %10s %12s %12s\n" $p $T "$((1 << p))B" $EST "$ERR"
+done
+
+echo
+echo "$NKEYS distinct keys in the exact table"
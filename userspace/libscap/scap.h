@@ -835,6 +835,12 @@ uint32_t scap_event_get_sentinel_begin(scap_evt* e);
 // The returned pointer must be freed via scap_proc_free by the caller.
 struct scap_threadinfo* scap_proc_get(scap_t* handle, int64_t tid, bool scan_sockets);
 
+// Like scap_proc_get, but the error goes to the given buffer, which must be
+// SCAP_LASTERR_SIZE bytes long, and the handle is only read. It can be called
+// from a thread other than the one reading the events, as long as the handle
+// stays open. Note that the proc callback, if set, runs on the calling thread.
+struct scap_threadinfo* scap_proc_get_r(scap_t* handle, int64_t tid, bool scan_sockets, char* error);
+
 // Check if the given thread exists in ;proc
 bool scap_is_thread_alive(scap_t* handle, int64_t pid, int64_t tid, const char* comm);
 
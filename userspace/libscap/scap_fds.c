@@ -519,7 +519,7 @@ void scap_fd_remove(scap_t *handle, scap_threadinfo *tinfo, int64_t fd)
 // Add the file descriptor info pointed by fdi to the fd table for process tinfo.
 // Note: silently skips if fdi->type is SCAP_FD_UNKNOWN.
 //
-int32_t scap_add_fd_to_proc_table(scap_t *handle, scap_threadinfo *tinfo, scap_fdinfo *fdi)
+int32_t scap_add_fd_to_proc_table(scap_t *handle, scap_threadinfo *tinfo, scap_fdinfo *fdi, char *error)
 {
 	int32_t uth_status = SCAP_SUCCESS;
 	scap_fdinfo *tfdi;
@@ -550,7 +550,7 @@ int32_t scap_add_fd_to_proc_table(scap_t *handle, scap_threadinfo *tinfo, scap_f
 		HASH_ADD_INT64(tinfo->fdlist, fd, fdi);
 		if(uth_status != SCAP_SUCCESS)
 		{
-			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "process table allocation error (2)");
+			snprintf(error, SCAP_LASTERR_SIZE, "process table allocation error (2)");
 			return SCAP_FAILURE;
 		}
 	}
@@ -590,7 +590,7 @@ int32_t scap_fd_handle_pipe(scap_t *handle, char *fname, scap_threadinfo *tinfo,
 	strncpy(fdi->info.fname, link_name, SCAP_MAX_PATH_SIZE);
 
 	fdi->ino = ino;
-	return scap_add_fd_to_proc_table(handle, tinfo, fdi);
+	return scap_add_fd_to_proc_table(handle, tinfo, fdi, error);
 }
 
 int32_t scap_fd_handle_regular_file(scap_t *handle, char *fname, scap_threadinfo *tinfo, scap_fdinfo *fdi, char *error)
@@ -641,7 +641,7 @@ int32_t scap_fd_handle_regular_file(scap_t *handle, char *fname, scap_threadinfo
 		strncpy(fdi->info.fname, link_name, SCAP_MAX_PATH_SIZE);
 	}
 
-	return scap_add_fd_to_proc_table(handle, tinfo, fdi);
+	return scap_add_fd_to_proc_table(handle, tinfo, fdi, error);
 }
 
 int32_t scap_fd_handle_socket(scap_t *handle, char *fname, scap_threadinfo *tinfo, scap_fdinfo *fdi, char* procdir, uint64_t net_ns, struct scap_ns_socket_list **sockets_by_ns, char *error)
@@ -669,11 +669,11 @@ int32_t scap_fd_handle_socket(scap_t *handle, char *fname, scap_threadinfo *tinf
 			HASH_ADD_INT64(*sockets_by_ns, net_ns, sockets);
 			if(uth_status != SCAP_SUCCESS)
 			{
-				snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "socket list allocation error");
+				snprintf(error, SCAP_LASTERR_SIZE, "socket list allocation error");
 				return SCAP_FAILURE;				
 			}
 
-			if(scap_fd_read_sockets(handle, procdir, sockets) == SCAP_FAILURE)
+			if(scap_fd_read_sockets(handle, procdir, sockets, error) == SCAP_FAILURE)
 			{
 				sockets->sockets = NULL;
 				return SCAP_FAILURE;
@@ -696,7 +696,7 @@ int32_t scap_fd_handle_socket(scap_t *handle, char *fname, scap_threadinfo *tinf
 	{
 		// it's a kind of socket, but we don't support it right now
 		fdi->type = SCAP_FD_UNSUPPORTED;
-		return scap_add_fd_to_proc_table(handle, tinfo, fdi);
+		return scap_add_fd_to_proc_table(handle, tinfo, fdi, error);
 	}
 
 	//
@@ -708,7 +708,7 @@ int32_t scap_fd_handle_socket(scap_t *handle, char *fname, scap_threadinfo *tinf
 		memcpy(&(fdi->info), &(tfdi->info), sizeof(fdi->info));
 		fdi->ino = ino;
 		fdi->type = tfdi->type;
-		return scap_add_fd_to_proc_table(handle, tinfo, fdi);
+		return scap_add_fd_to_proc_table(handle, tinfo, fdi, error);
 	}
 	else
 	{
@@ -716,7 +716,7 @@ int32_t scap_fd_handle_socket(scap_t *handle, char *fname, scap_threadinfo *tinf
 	}
 }
 
-int32_t scap_fd_read_unix_sockets_from_proc_fs(scap_t *handle, const char* filename, scap_fdinfo **sockets)
+int32_t scap_fd_read_unix_sockets_from_proc_fs(scap_t *handle, const char* filename, scap_fdinfo **sockets, char *error)
 {
 	FILE *f;
 	char line[1024];
@@ -828,7 +828,7 @@ int32_t scap_fd_read_unix_sockets_from_proc_fs(scap_t *handle, const char* filen
 		HASH_ADD_INT64((*sockets), ino, fdinfo);
 		if(uth_status != SCAP_SUCCESS)
 		{
-			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "unix socket allocatiallocation error");
+			snprintf(error, SCAP_LASTERR_SIZE, "unix socket allocatiallocation error");
 			return SCAP_FAILURE;
 		}
 	}
@@ -836,7 +836,7 @@ int32_t scap_fd_read_unix_sockets_from_proc_fs(scap_t *handle, const char* filen
 	return uth_status;
 }
 
-int32_t scap_fd_read_ipv4_sockets_from_proc_fs(scap_t *handle, const char *dir, int l4proto, scap_fdinfo **sockets)
+int32_t scap_fd_read_ipv4_sockets_from_proc_fs(scap_t *handle, const char *dir, int l4proto, scap_fdinfo **sockets, char *error)
 {
 	FILE *f;
 	int32_t uth_status = SCAP_SUCCESS;
@@ -851,7 +851,7 @@ int32_t scap_fd_read_ipv4_sockets_from_proc_fs(scap_t *handle, const char *dir,
 	scan_buf = (char*)malloc(SOCKET_SCAN_BUFFER_SIZE);
 	if(scan_buf == NULL)
 	{
-		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "scan_buf allocation error");
+		snprintf(error, SCAP_LASTERR_SIZE, "scan_buf allocation error");
 		return SCAP_FAILURE;		
 	}
 
@@ -1013,7 +1013,7 @@ int32_t scap_fd_is_ipv6_server_socket(uint32_t ip6_addr[4])
 	return 0 == ip6_addr[0] && 0 == ip6_addr[1] && 0 == ip6_addr[2] && 0 == ip6_addr[3];
 }
 
-int32_t scap_fd_read_ipv6_sockets_from_proc_fs(scap_t *handle, char *dir, int l4proto, scap_fdinfo **sockets)
+int32_t scap_fd_read_ipv6_sockets_from_proc_fs(scap_t *handle, char *dir, int l4proto, scap_fdinfo **sockets, char *error)
 {
 	FILE *f;
 	int32_t uth_status = SCAP_SUCCESS;
@@ -1028,7 +1028,7 @@ int32_t scap_fd_read_ipv6_sockets_from_proc_fs(scap_t *handle, char *dir, int l4
 	scan_buf = (char*)malloc(SOCKET_SCAN_BUFFER_SIZE);
 	if(scan_buf == NULL)
 	{
-		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "scan_buf allocation error");
+		snprintf(error, SCAP_LASTERR_SIZE, "scan_buf allocation error");
 		return SCAP_FAILURE;		
 	}
 
@@ -1228,7 +1228,7 @@ int32_t scap_fd_read_ipv6_sockets_from_proc_fs(scap_t *handle, char *dir, int l4
 	return uth_status;
 }
 
-int32_t scap_fd_read_sockets(scap_t *handle, char* procdir, struct scap_ns_socket_list *sockets)
+int32_t scap_fd_read_sockets(scap_t *handle, char* procdir, struct scap_ns_socket_list *sockets, char *error)
 {
 	char filename[SCAP_MAX_PATH_SIZE];
 	char netroot[SCAP_MAX_PATH_SIZE];
@@ -1249,28 +1249,28 @@ int32_t scap_fd_read_sockets(scap_t *handle, char* procdir, struct scap_ns_socke
 	}
 
 	snprintf(filename, sizeof(filename), "%stcp", netroot);
-	if(scap_fd_read_ipv4_sockets_from_proc_fs(handle, filename, SCAP_L4_TCP, &sockets->sockets) == SCAP_FAILURE)
+	if(scap_fd_read_ipv4_sockets_from_proc_fs(handle, filename, SCAP_L4_TCP, &sockets->sockets, error) == SCAP_FAILURE)
 	{
 		scap_fd_free_table(handle, &sockets->sockets);
 		return SCAP_FAILURE;		
 	}
 
 	snprintf(filename, sizeof(filename), "%sudp", netroot);
-	if(scap_fd_read_ipv4_sockets_from_proc_fs(handle, filename, SCAP_L4_UDP, &sockets->sockets) == SCAP_FAILURE)
+	if(scap_fd_read_ipv4_sockets_from_proc_fs(handle, filename, SCAP_L4_UDP, &sockets->sockets, error) == SCAP_FAILURE)
 	{
 		scap_fd_free_table(handle, &sockets->sockets);
 		return SCAP_FAILURE;		
 	}
 
 	snprintf(filename, sizeof(filename), "%sraw", netroot);
-	if(scap_fd_read_ipv4_sockets_from_proc_fs(handle, filename, SCAP_L4_RAW, &sockets->sockets) == SCAP_FAILURE)
+	if(scap_fd_read_ipv4_sockets_from_proc_fs(handle, filename, SCAP_L4_RAW, &sockets->sockets, error) == SCAP_FAILURE)
 	{
 		scap_fd_free_table(handle, &sockets->sockets);
 		return SCAP_FAILURE;		
 	}
 
 	snprintf(filename, sizeof(filename), "%sunix", netroot);
-	if(scap_fd_read_unix_sockets_from_proc_fs(handle, filename, &sockets->sockets) == SCAP_FAILURE)
+	if(scap_fd_read_unix_sockets_from_proc_fs(handle, filename, &sockets->sockets, error) == SCAP_FAILURE)
 	{
 		scap_fd_free_table(handle, &sockets->sockets);
 		return SCAP_FAILURE;
@@ -1280,21 +1280,21 @@ int32_t scap_fd_read_sockets(scap_t *handle, char* procdir, struct scap_ns_socke
     /* We assume if there is /proc/net/tcp6 that ipv6 is avaiable */
     if(access(filename, R_OK) == 0)
     {
-		if(scap_fd_read_ipv6_sockets_from_proc_fs(handle, filename, SCAP_L4_TCP, &sockets->sockets) == SCAP_FAILURE)
+		if(scap_fd_read_ipv6_sockets_from_proc_fs(handle, filename, SCAP_L4_TCP, &sockets->sockets, error) == SCAP_FAILURE)
 		{
 			scap_fd_free_table(handle, &sockets->sockets);
 			return SCAP_FAILURE;		
 		}
 
 		snprintf(filename, sizeof(filename), "%sudp6", netroot);
-		if(scap_fd_read_ipv6_sockets_from_proc_fs(handle, filename, SCAP_L4_TCP, &sockets->sockets) == SCAP_FAILURE)
+		if(scap_fd_read_ipv6_sockets_from_proc_fs(handle, filename, SCAP_L4_TCP, &sockets->sockets, error) == SCAP_FAILURE)
 		{
 			scap_fd_free_table(handle, &sockets->sockets);
 			return SCAP_FAILURE;		
 		}
 
 		snprintf(filename, sizeof(filename), "%sraw6", netroot);
-		if(scap_fd_read_ipv6_sockets_from_proc_fs(handle, filename, SCAP_L4_TCP, &sockets->sockets) == SCAP_FAILURE)
+		if(scap_fd_read_ipv6_sockets_from_proc_fs(handle, filename, SCAP_L4_TCP, &sockets->sockets, error) == SCAP_FAILURE)
 		{
 			scap_fd_free_table(handle, &sockets->sockets);
 			return SCAP_FAILURE;		
@@ -1304,13 +1304,13 @@ int32_t scap_fd_read_sockets(scap_t *handle, char* procdir, struct scap_ns_socke
 	return SCAP_SUCCESS;
 }
 
-int32_t scap_fd_allocate_fdinfo(scap_t *handle, scap_fdinfo **fdi, int64_t fd, scap_fd_type type)
+int32_t scap_fd_allocate_fdinfo(scap_t *handle, scap_fdinfo **fdi, int64_t fd, scap_fd_type type, char *error)
 {
 	ASSERT(NULL == *fdi);
 	*fdi = (scap_fdinfo *)malloc(sizeof(scap_fdinfo));
 	if(*fdi == NULL)
 	{
-		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "fd table allocation error (2)");
+		snprintf(error, SCAP_LASTERR_SIZE, "fd table allocation error (2)");
 		return SCAP_FAILURE;
 	}
 	(*fdi)->type = type;
@@ -1411,7 +1411,7 @@ int32_t scap_fd_scan_fd_dir(scap_t *handle, char *procdir, scap_threadinfo *tinf
 		switch(sb.st_mode & S_IFMT)
 		{
 		case S_IFIFO:
-			res = scap_fd_allocate_fdinfo(handle, &fdi, fd, SCAP_FD_FIFO);
+			res = scap_fd_allocate_fdinfo(handle, &fdi, fd, SCAP_FD_FIFO, error);
 			if(SCAP_FAILURE == res)
 			{
 				break;
@@ -1422,7 +1422,7 @@ int32_t scap_fd_scan_fd_dir(scap_t *handle, char *procdir, scap_threadinfo *tinf
 		case S_IFBLK:
 		case S_IFCHR:
 		case S_IFLNK:
-			res = scap_fd_allocate_fdinfo(handle, &fdi, fd, SCAP_FD_FILE);
+			res = scap_fd_allocate_fdinfo(handle, &fdi, fd, SCAP_FD_FILE, error);
 			if(SCAP_FAILURE == res)
 			{
 				break;
@@ -1431,7 +1431,7 @@ int32_t scap_fd_scan_fd_dir(scap_t *handle, char *procdir, scap_threadinfo *tinf
 			res = scap_fd_handle_regular_file(handle, f_name, tinfo, fdi, error);
 			break;
 		case S_IFDIR:
-			res = scap_fd_allocate_fdinfo(handle, &fdi, fd, SCAP_FD_DIRECTORY);
+			res = scap_fd_allocate_fdinfo(handle, &fdi, fd, SCAP_FD_DIRECTORY, error);
 			if(SCAP_FAILURE == res)
 			{
 				break;
@@ -1440,7 +1440,7 @@ int32_t scap_fd_scan_fd_dir(scap_t *handle, char *procdir, scap_threadinfo *tinf
 			res = scap_fd_handle_regular_file(handle, f_name, tinfo, fdi, error);
 			break;
 		case S_IFSOCK:
-			res = scap_fd_allocate_fdinfo(handle, &fdi, fd, SCAP_FD_UNKNOWN);
+			res = scap_fd_allocate_fdinfo(handle, &fdi, fd, SCAP_FD_UNKNOWN, error);
 			if(SCAP_FAILURE == res)
 			{
 				break;
@@ -1456,7 +1456,7 @@ int32_t scap_fd_scan_fd_dir(scap_t *handle, char *procdir, scap_threadinfo *tinf
 			} 
 			break;
 		default:
-			res = scap_fd_allocate_fdinfo(handle, &fdi, fd, SCAP_FD_UNSUPPORTED);
+			res = scap_fd_allocate_fdinfo(handle, &fdi, fd, SCAP_FD_UNSUPPORTED, error);
 			if(SCAP_FAILURE == res)
 			{
 				break;
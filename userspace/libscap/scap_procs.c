@@ -859,6 +859,11 @@ void scap_proc_free_table(scap_t* handle)
 }
 
 struct scap_threadinfo* scap_proc_get(scap_t* handle, int64_t tid, bool scan_sockets)
+{
+	return scap_proc_get_r(handle, tid, scan_sockets, handle->m_lasterr);
+}
+
+struct scap_threadinfo* scap_proc_get_r(scap_t* handle, int64_t tid, bool scan_sockets, char* error)
 {
 #if !defined(HAS_CAPTURE)
 	return NULL;
@@ -875,7 +880,7 @@ struct scap_threadinfo* scap_proc_get(scap_t* handle, int64_t tid, bool scan_soc
 	struct scap_threadinfo* tinfo = NULL;
 	char filename[SCAP_MAX_PATH_SIZE];
 	snprintf(filename, sizeof(filename), "%s/proc", scap_get_host_root());
-	if(scap_proc_scan_proc_dir(handle, filename, -1, tid, &tinfo, handle->m_lasterr, scan_sockets) != SCAP_SUCCESS)
+	if(scap_proc_scan_proc_dir(handle, filename, -1, tid, &tinfo, error, scan_sockets) != SCAP_SUCCESS)
 	{
 		return NULL;
 	}
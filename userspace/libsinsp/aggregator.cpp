@@ -0,0 +1,540 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "filter.h"
+#include "filterchecks.h"
+#include "aggregator.h"
+
+extern sinsp_filter_check_list g_filterlist;
+
+//
+// Size of the values of the fixed size types, 0 for the strings and -1 for
+// the types that can't be used as keys
+//
+static int32_t key_value_size(uint32_t type)
+{
+	switch(type)
+	{
+	case PT_INT8:
+	case PT_UINT8:
+	case PT_FLAGS8:
+	case PT_L4PROTO:
+	case PT_SOCKFAMILY:
+	case PT_SIGTYPE:
+		return 1;
+	case PT_INT16:
+	case PT_UINT16:
+	case PT_FLAGS16:
+	case PT_PORT:
+	case PT_SYSCALLID:
+		return 2;
+	case PT_INT32:
+	case PT_UINT32:
+	case PT_FLAGS32:
+	case PT_UID:
+	case PT_GID:
+	case PT_BOOL:
+	case PT_IPV4ADDR:
+		return 4;
+	case PT_INT64:
+	case PT_UINT64:
+	case PT_ERRNO:
+	case PT_FD:
+	case PT_PID:
+	case PT_RELTIME:
+	case PT_ABSTIME:
+		return 8;
+	case PT_CHARBUF:
+	case PT_FSPATH:
+	case PT_BYTEBUF:
+		return 0;
+	default:
+		return -1;
+	}
+}
+
+//
+// Sorts the groups by decreasing value
+//
+struct group_comparer
+{
+	bool operator() (const sinsp_aggregator::group& first, const sinsp_aggregator::group& second) const
+	{
+		return first.m_value > second.m_value;
+	}
+};
+
+static sinsp_filter_check* new_check(sinsp* inspector, const string& name)
+{
+	sinsp_filter_check* chk = g_filterlist.new_filter_check_from_fldname(name,
+		inspector,
+		false);
+
+	if(chk == NULL)
+	{
+		throw sinsp_exception("nonexistent field " + name);
+	}
+
+	if(chk->parse_field_name(name.c_str()) != (int32_t)name.size())
+	{
+		delete chk;
+		throw sinsp_exception("invalid field " + name);
+	}
+
+	return chk;
+}
+
+static void new_checks(sinsp* inspector, const vector<string>& names, OUT vector<sinsp_filter_check*>* checks)
+{
+	try
+	{
+		for(uint32_t j = 0; j < names.size(); j++)
+		{
+			checks->push_back(new_check(inspector, names[j]));
+		}
+	}
+	catch(...)
+	{
+		for(uint32_t j = 0; j < checks->size(); j++)
+		{
+			delete (*checks)[j];
+		}
+
+		checks->clear();
+		throw;
+	}
+}
+
+//
+// Build the key of an event: the concatenation of the values of the checks,
+// each one preceded by its type, which can change from event to event for
+// fields like evt.rawarg, and by its length if it's a string. False if a
+// check has no value for the event.
+//
+static bool extract_key(const vector<sinsp_filter_check*>& checks, sinsp_evt* evt, OUT string* key)
+{
+	uint32_t len;
+
+	key->clear();
+
+	for(uint32_t j = 0; j < checks.size(); j++)
+	{
+		sinsp_filter_check* chk = checks[j];
+		uint8_t* rawval = chk->extract(evt, &len);
+
+		if(rawval == NULL)
+		{
+			return false;
+		}
+
+		uint32_t type = chk->get_field_info()->m_type;
+		int32_t size = key_value_size(type);
+
+		if(size < 0)
+		{
+			return false;
+		}
+
+		key->push_back((char)type);
+
+		if(size == 0)
+		{
+			//
+			// Like the chisels, stop strings at the first NUL
+			//
+			if(type == PT_BYTEBUF)
+			{
+				len = (uint32_t)strnlen((char*)rawval, len);
+			}
+			else
+			{
+				len = (uint32_t)strlen((char*)rawval);
+			}
+
+			key->append((char*)&len, sizeof(len));
+			key->append((char*)rawval, len);
+		}
+		else
+		{
+			key->append((char*)rawval, size);
+		}
+	}
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_aggregator implementation
+///////////////////////////////////////////////////////////////////////////////
+double sinsp_aggregator::row::get_value(op o) const
+{
+	switch(o)
+	{
+	case OP_COUNT:
+		return (double)m_count;
+	case OP_MIN:
+		return m_min;
+	case OP_MAX:
+		return m_max;
+	case OP_AVG:
+		return m_sum / m_count;
+	default:
+		return m_sum;
+	}
+}
+
+sinsp_aggregator::sinsp_aggregator(sinsp* inspector, const vector<string>& keys, const string& value, op o, uint32_t max_groups)
+{
+	m_inspector = inspector;
+	m_value = NULL;
+	m_op = o;
+	m_topk = NULL;
+
+	if(max_groups != 0 && o != OP_SUM && o != OP_COUNT)
+	{
+		throw sinsp_exception("only sum and count support a max number of groups");
+	}
+
+	if(value == "" && o != OP_COUNT)
+	{
+		throw sinsp_exception("the aggregation needs a value field");
+	}
+
+	new_checks(inspector, keys, &m_keys);
+
+	try
+	{
+		//
+		// The type of the PT_DYN fields, like some evt.rawarg arguments,
+		// is only known when the value is extracted. The events for which
+		// it can't be a key are skipped.
+		//
+		for(uint32_t j = 0; j < m_keys.size(); j++)
+		{
+			uint32_t type = m_keys[j]->get_field_info()->m_type;
+
+			if(type != PT_DYN && key_value_size(type) < 0)
+			{
+				throw sinsp_exception("field " + keys[j] + " can't be used as a key");
+			}
+		}
+
+		if(value != "")
+		{
+			m_value = new_check(inspector, value);
+		}
+
+		if(max_groups != 0)
+		{
+			m_topk = new sinsp_space_saving(max_groups);
+		}
+	}
+	catch(...)
+	{
+		for(uint32_t j = 0; j < m_keys.size(); j++)
+		{
+			delete m_keys[j];
+		}
+
+		if(m_value != NULL)
+		{
+			delete m_value;
+		}
+
+		throw;
+	}
+}
+
+sinsp_aggregator::~sinsp_aggregator()
+{
+	for(uint32_t j = 0; j < m_keys.size(); j++)
+	{
+		delete m_keys[j];
+	}
+
+	if(m_value != NULL)
+	{
+		delete m_value;
+	}
+
+	if(m_topk != NULL)
+	{
+		delete m_topk;
+	}
+}
+
+bool sinsp_aggregator::parse_op(const string& name, OUT op* o)
+{
+	if(name == "sum")
+	{
+		*o = OP_SUM;
+	}
+	else if(name == "count")
+	{
+		*o = OP_COUNT;
+	}
+	else if(name == "min")
+	{
+		*o = OP_MIN;
+	}
+	else if(name == "max")
+	{
+		*o = OP_MAX;
+	}
+	else if(name == "avg")
+	{
+		*o = OP_AVG;
+	}
+	else
+	{
+		return false;
+	}
+
+	return true;
+}
+
+bool sinsp_aggregator::rawval_to_double(const uint8_t* rawval, uint32_t type, OUT double* res)
+{
+	switch(type)
+	{
+	case PT_INT8:
+		*res = *(int8_t*)rawval;
+		return true;
+	case PT_INT16:
+		*res = *(int16_t*)rawval;
+		return true;
+	case PT_INT32:
+		*res = *(int32_t*)rawval;
+		return true;
+	case PT_INT64:
+	case PT_ERRNO:
+	case PT_FD:
+	case PT_PID:
+		*res = (double)*(int64_t*)rawval;
+		return true;
+	case PT_UINT8:
+	case PT_FLAGS8:
+	case PT_L4PROTO:
+	case PT_SOCKFAMILY:
+	case PT_SIGTYPE:
+		*res = *(uint8_t*)rawval;
+		return true;
+	case PT_UINT16:
+	case PT_FLAGS16:
+	case PT_PORT:
+	case PT_SYSCALLID:
+		*res = *(uint16_t*)rawval;
+		return true;
+	case PT_UINT32:
+	case PT_FLAGS32:
+	case PT_UID:
+	case PT_GID:
+		*res = *(uint32_t*)rawval;
+		return true;
+	case PT_UINT64:
+	case PT_RELTIME:
+	case PT_ABSTIME:
+		*res = (double)*(uint64_t*)rawval;
+		return true;
+	default:
+		return false;
+	}
+}
+
+void sinsp_aggregator::add(sinsp_evt* evt)
+{
+	uint32_t len;
+	double val = 0;
+
+	if(!extract_key(m_keys, evt, &m_keybuf))
+	{
+		return;
+	}
+
+	if(m_value != NULL)
+	{
+		uint8_t* rawval = m_value->extract(evt, &len);
+
+		if(rawval == NULL)
+		{
+			return;
+		}
+
+		if(!rawval_to_double(rawval, m_value->get_field_info()->m_type, &val))
+		{
+			if(m_op != OP_COUNT)
+			{
+				return;
+			}
+		}
+	}
+
+	if(m_topk != NULL)
+	{
+		m_topk->add(m_keybuf, (m_op == OP_COUNT)? 1 : val);
+		return;
+	}
+
+	unordered_map<string, row>::iterator it = m_table.find(m_keybuf);
+
+	if(it == m_table.end())
+	{
+		row& r = m_table[m_keybuf];
+		r.m_sum = val;
+		r.m_min = val;
+		r.m_max = val;
+		r.m_count = 1;
+	}
+	else
+	{
+		row& r = it->second;
+		r.m_sum += val;
+		r.m_count++;
+
+		if(val < r.m_min)
+		{
+			r.m_min = val;
+		}
+
+		if(val > r.m_max)
+		{
+			r.m_max = val;
+		}
+	}
+}
+
+void sinsp_aggregator::get_top(uint32_t n, OUT vector<group>* res)
+{
+	group g;
+
+	res->clear();
+
+	if(m_topk != NULL)
+	{
+		vector<const sinsp_space_saving::counter*> top;
+		m_topk->get_top(n, &top);
+
+		res->reserve(top.size());
+
+		for(uint32_t j = 0; j < top.size(); j++)
+		{
+			g.m_key = &top[j]->m_key;
+			g.m_value = top[j]->m_count;
+			g.m_error = top[j]->m_error;
+			res->push_back(g);
+		}
+
+		return;
+	}
+
+	res->reserve(m_table.size());
+	g.m_error = 0;
+
+	for(unordered_map<string, row>::iterator it = m_table.begin(); it != m_table.end(); ++it)
+	{
+		g.m_key = &it->first;
+		g.m_value = it->second.get_value(m_op);
+		res->push_back(g);
+	}
+
+	group_comparer cmp;
+
+	if(n != 0 && n < res->size())
+	{
+		partial_sort(res->begin(), res->begin() + n, res->end(), cmp);
+		res->resize(n);
+	}
+	else
+	{
+		sort(res->begin(), res->end(), cmp);
+	}
+}
+
+void sinsp_aggregator::clear()
+{
+	if(m_topk != NULL)
+	{
+		m_topk->clear();
+	}
+	else
+	{
+		m_table.clear();
+	}
+}
+
+uint32_t sinsp_aggregator::size()
+{
+	if(m_topk != NULL)
+	{
+		return m_topk->size();
+	}
+
+	return (uint32_t)m_table.size();
+}
+
+const char* sinsp_aggregator::get_key_value(const string& key, uint32_t* pos, OUT uint32_t* type, OUT uint32_t* len)
+{
+	const char* p = key.data() + *pos;
+
+	*type = (uint8_t)*p;
+	p++;
+
+	int32_t size = key_value_size(*type);
+
+	if(size == 0)
+	{
+		memcpy(len, p, sizeof(uint32_t));
+		p += sizeof(uint32_t);
+	}
+	else
+	{
+		*len = size;
+	}
+
+	*pos = (uint32_t)(p - key.data()) + *len;
+	return p;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_distinct_counter implementation
+///////////////////////////////////////////////////////////////////////////////
+sinsp_distinct_counter::sinsp_distinct_counter(sinsp* inspector, const vector<string>& fields, uint32_t precision)
+	: m_hll(precision)
+{
+	new_checks(inspector, fields, &m_fields);
+}
+
+sinsp_distinct_counter::~sinsp_distinct_counter()
+{
+	for(uint32_t j = 0; j < m_fields.size(); j++)
+	{
+		delete m_fields[j];
+	}
+}
+
+void sinsp_distinct_counter::add(sinsp_evt* evt)
+{
+	if(extract_key(m_fields, evt, &m_keybuf))
+	{
+		m_hll.add(m_keybuf.data(), (uint32_t)m_keybuf.size());
+	}
+}
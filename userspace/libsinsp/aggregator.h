@@ -0,0 +1,267 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+class sinsp_filter_check;
+
+/** @defgroup aggregator Aggregating events
+ *  @{
+ */
+
+/*!
+  \brief Groups the events by the values of a set of filter fields, and
+   aggregates a value field for every group.
+
+  The keys are kept in their binary form, as the filter checks extract them,
+  so adding an event doesn't render any field to a string. An event is
+  skipped if any of the keys, or the value, has no value for it.
+
+  By default the aggregator keeps every group, so its memory grows with the
+  number of different keys. With max_groups, sums and counts are instead
+  tracked with a sinsp_space_saving table of that size: the memory stays
+  fixed, and the values become estimates, exact as long as there are no more
+  than max_groups groups. See sinsp_space_saving for the error bounds.
+
+  Usage:
+
+  \code
+  vector<string> keys;
+  keys.push_back("proc.name");
+  keys.push_back("fd.name");
+
+  sinsp_aggregator agg(inspector, keys, "evt.rawarg.res", sinsp_aggregator::OP_SUM);
+
+  // For every event
+  agg.add(evt);
+
+  // Every interval
+  vector<sinsp_aggregator::group> top;
+  agg.get_top(10, &top);
+  \endcode
+*/
+class SINSP_PUBLIC sinsp_aggregator
+{
+public:
+	enum op
+	{
+		OP_SUM = 0, ///< Sum of the values.
+		OP_COUNT = 1, ///< Number of events. The value field is optional.
+		OP_MIN = 2, ///< Smallest value.
+		OP_MAX = 3, ///< Largest value.
+		OP_AVG = 4, ///< Average of the values.
+	};
+
+	/*!
+	  \brief The aggregated state of a group of events.
+	*/
+	class row
+	{
+	public:
+		/*!
+		  \brief The aggregated value, according to the op of the aggregator.
+		*/
+		double get_value(op o) const;
+
+		double m_sum;
+		double m_min;
+		double m_max;
+		uint64_t m_count;
+	};
+
+	/*!
+	  \brief A group, as returned by get_top().
+	*/
+	struct group
+	{
+		const string* m_key; ///< The key of the group. It can be decoded with get_key_value().
+		double m_value; ///< The aggregated value.
+		double m_error; ///< Max amount by which m_value can exceed the real value. 0 when exact.
+	};
+
+	/*!
+	  \brief Constructs the aggregator.
+
+	  \param inspector The inspector that the events come from.
+	  \param keys The names of the filter fields used for grouping.
+	  \param value The name of the filter field to aggregate. Can be empty
+	   for OP_COUNT.
+	  \param o How the values are aggregated.
+	  \param max_groups If not 0, the max number of groups that are tracked.
+	   Only OP_SUM and OP_COUNT support it, and the values that are not
+	   positive are then ignored.
+
+	  \note Throws a sinsp_exception if a field doesn't exist, or if a key
+	   field has a type that can't be used for grouping, like a socket
+	   address.
+	*/
+	sinsp_aggregator(sinsp* inspector, const vector<string>& keys, const string& value, op o, uint32_t max_groups = 0);
+	~sinsp_aggregator();
+
+	/*!
+	  \brief Parse the name of an op: sum, count, min, max or avg.
+
+	  \return false if the name is not valid.
+	*/
+	static bool parse_op(const string& name, OUT op* o);
+
+	/*!
+	  \brief Add an event to its group.
+	*/
+	void add(sinsp_evt* evt);
+
+	/*!
+	  \brief Get the groups with the largest values, sorted by value.
+
+	  \param n The number of groups to return, or 0 to return all of them.
+	  \param res Filled with the groups, whose keys stay valid until the
+	   next call to add() or clear().
+	*/
+	void get_top(uint32_t n, OUT vector<group>* res);
+
+	/*!
+	  \brief Get the value of one of the keys of a group.
+
+	  \param key The key of the group, as returned by get_top().
+	  \param pos The offset in key of the value. It starts at 0, and is
+	   moved to the next value.
+	  \param type Set to the ppm_param_type of the value.
+	  \param len Set to the length of the value.
+
+	  \return A pointer to the value. Strings are not NUL terminated.
+	*/
+	static const char* get_key_value(const string& key, uint32_t* pos, OUT uint32_t* type, OUT uint32_t* len);
+
+	/*!
+	  \brief Delete all the groups.
+	*/
+	void clear();
+
+	/*!
+	  \brief Get the number of groups.
+	*/
+	uint32_t size();
+
+	uint32_t get_num_keys()
+	{
+		return (uint32_t)m_keys.size();
+	}
+
+	op get_op()
+	{
+		return m_op;
+	}
+
+	/*!
+	  \brief Get the bound on the error of the values, 0 if they are exact.
+	*/
+	double get_max_error()
+	{
+		return (m_topk != NULL)? m_topk->get_max_error() : 0;
+	}
+
+	/*!
+	  \brief Convert a value extracted by a filter check to a number.
+
+	  \return false if the type is not numeric.
+	*/
+	static bool rawval_to_double(const uint8_t* rawval, uint32_t type, OUT double* res);
+
+private:
+	sinsp* m_inspector;
+	vector<sinsp_filter_check*> m_keys;
+	sinsp_filter_check* m_value;
+	op m_op;
+	unordered_map<string, row> m_table;
+	//
+	// Used instead of m_table when the number of groups is bounded
+	//
+	sinsp_space_saving* m_topk;
+	//
+	// Reused to build the key of every event
+	//
+	string m_keybuf;
+};
+
+/*!
+  \brief Estimates the number of different values that a set of filter
+   fields takes, with a sinsp_hyperloglog sketch.
+
+  The memory is fixed: 2^precision bytes. An event is skipped if any of the
+  fields has no value for it.
+
+  Usage:
+
+  \code
+  vector<string> fields;
+  fields.push_back("fd.sip");
+
+  sinsp_distinct_counter cnt(inspector, fields);
+
+  // For every event
+  cnt.add(evt);
+
+  // Every interval
+  double ndistinct = cnt.estimate();
+  \endcode
+*/
+class SINSP_PUBLIC sinsp_distinct_counter
+{
+public:
+	/*!
+	  \note Throws a sinsp_exception if a field doesn't exist, or if the
+	   precision is out of range.
+	*/
+	sinsp_distinct_counter(sinsp* inspector, const vector<string>& fields, uint32_t precision = HLL_DEFAULT_PRECISION);
+	~sinsp_distinct_counter();
+
+	void add(sinsp_evt* evt);
+
+	/*!
+	  \brief Get the estimated number of different values.
+	*/
+	double estimate()
+	{
+		return m_hll.estimate();
+	}
+
+	void clear()
+	{
+		m_hll.clear();
+	}
+
+	/*!
+	  \brief Get the relative standard error of the estimate.
+	*/
+	double get_std_error()
+	{
+		return m_hll.get_std_error();
+	}
+
+	uint64_t get_memory_size()
+	{
+		return m_hll.get_memory_size();
+	}
+
+private:
+	vector<sinsp_filter_check*> m_fields;
+	sinsp_hyperloglog m_hll;
+	string m_keybuf;
+};
+
+/*@}*/
@@ -0,0 +1,334 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <errno.h>
+#include <string.h>
+
+#include "binaryrecords.h"
+
+using namespace std;
+
+const uint32_t sinsp_binary_record_reader::NO_VALUE;
+
+sinsp_binary_record_reader::sinsp_binary_record_reader()
+{
+	m_data = NULL;
+}
+
+bool sinsp_binary_record_reader::read_fully(FILE* fp, char* buf, uint32_t len, bool* eof)
+{
+	size_t res = fread(buf, 1, len, fp);
+
+	*eof = (res == 0 && feof(fp));
+
+	if(res != len)
+	{
+		if(ferror(fp))
+		{
+			m_error = string("error reading the records: ") + strerror(errno);
+		}
+		else
+		{
+			m_error = "truncated binary record stream";
+		}
+
+		return false;
+	}
+
+	return true;
+}
+
+bool sinsp_binary_record_reader::read_header(FILE* fp)
+{
+	uint32_t needed = SINSP_BINARY_RECORD_HEADER_SIZE;
+	bool eof;
+
+	m_buf.resize(needed);
+
+	if(!read_fully(fp, &m_buf[0], needed, &eof))
+	{
+		return false;
+	}
+
+	if(parse_header(&m_buf[0], needed, &needed))
+	{
+		return true;
+	}
+
+	if(needed == 0)
+	{
+		return false;
+	}
+
+	//
+	// Read the field descriptions
+	//
+	m_buf.resize(needed);
+
+	if(!read_fully(fp, &m_buf[SINSP_BINARY_RECORD_HEADER_SIZE], needed - SINSP_BINARY_RECORD_HEADER_SIZE, &eof))
+	{
+		return false;
+	}
+
+	return parse_header(&m_buf[0], needed, &needed);
+}
+
+bool sinsp_binary_record_reader::parse_header(const char* buf, uint32_t len, uint32_t* needed)
+{
+	uint32_t byte_order;
+	uint16_t version;
+	uint16_t nfields;
+	uint32_t hdrlen;
+
+	*needed = 0;
+	m_fields.clear();
+	m_sizes.clear();
+
+	if(len < SINSP_BINARY_RECORD_HEADER_SIZE)
+	{
+		*needed = SINSP_BINARY_RECORD_HEADER_SIZE;
+		m_error = "truncated binary record header";
+		return false;
+	}
+
+	memcpy(&byte_order, buf + 4, sizeof(byte_order));
+	memcpy(&version, buf + 8, sizeof(version));
+	memcpy(&nfields, buf + 10, sizeof(nfields));
+	memcpy(&hdrlen, buf + 12, sizeof(hdrlen));
+
+	if(memcmp(buf, SINSP_BINARY_RECORD_MAGIC, 4) != 0)
+	{
+		m_error = "not a binary record stream";
+		return false;
+	}
+
+	if(byte_order != SINSP_BINARY_RECORD_BYTE_ORDER)
+	{
+		m_error = "the binary record stream was written with a different byte order";
+		return false;
+	}
+
+	if(version != SINSP_BINARY_RECORD_VERSION)
+	{
+		m_error = "unsupported binary record version";
+		return false;
+	}
+
+	if(hdrlen < SINSP_BINARY_RECORD_HEADER_SIZE)
+	{
+		m_error = "invalid binary record header";
+		return false;
+	}
+
+	if(len < hdrlen)
+	{
+		*needed = hdrlen;
+		m_error = "truncated binary record header";
+		return false;
+	}
+
+	uint32_t pos = SINSP_BINARY_RECORD_HEADER_SIZE;
+
+	for(uint32_t j = 0; j < nfields; j++)
+	{
+		field_info fi;
+		uint16_t namelen;
+
+		if(pos + 4 > hdrlen)
+		{
+			m_error = "invalid binary record header";
+			return false;
+		}
+
+		fi.m_type = (uint8_t)buf[pos];
+		fi.m_print_format = (uint8_t)buf[pos + 1];
+		memcpy(&namelen, buf + pos + 2, sizeof(namelen));
+		pos += 4;
+
+		if(pos + namelen > hdrlen || binary_record_value_size(fi.m_type) < 0)
+		{
+			m_error = "invalid binary record header";
+			return false;
+		}
+
+		fi.m_name.assign(buf + pos, namelen);
+		pos += namelen;
+
+		m_fields.push_back(fi);
+		m_sizes.push_back(binary_record_value_size(fi.m_type));
+	}
+
+	m_value_offs.assign(nfields, 0);
+	m_value_lens.assign(nfields, NO_VALUE);
+	m_data = NULL;
+	return true;
+}
+
+int32_t sinsp_binary_record_reader::read_record(FILE* fp)
+{
+	uint32_t len;
+	bool eof;
+
+	if(!read_fully(fp, (char*)&len, sizeof(len), &eof))
+	{
+		return eof? 0 : -1;
+	}
+
+	if(m_buf.size() < (size_t)len + 1)
+	{
+		m_buf.resize((size_t)len + 1);
+	}
+
+	if(!read_fully(fp, &m_buf[0], len, &eof))
+	{
+		return -1;
+	}
+
+	return parse_record(&m_buf[0], len)? 1 : -1;
+}
+
+bool sinsp_binary_record_reader::parse_record(const char* buf, uint32_t len)
+{
+	uint32_t nfields = (uint32_t)m_fields.size();
+	uint32_t pos = (nfields + 7) / 8;
+
+	if(pos > len)
+	{
+		m_error = "truncated binary record";
+		return false;
+	}
+
+	for(uint32_t j = 0; j < nfields; j++)
+	{
+		if((buf[j / 8] & (1 << (j % 8))) == 0)
+		{
+			m_value_lens[j] = NO_VALUE;
+			continue;
+		}
+
+		uint32_t vlen = m_sizes[j];
+
+		if(vlen == 0)
+		{
+			if(pos + sizeof(uint32_t) > len)
+			{
+				m_error = "truncated binary record";
+				return false;
+			}
+
+			memcpy(&vlen, buf + pos, sizeof(uint32_t));
+			pos += sizeof(uint32_t);
+		}
+
+		if(vlen > len - pos)
+		{
+			m_error = "truncated binary record";
+			return false;
+		}
+
+		m_value_offs[j] = pos;
+		m_value_lens[j] = vlen;
+		pos += vlen;
+	}
+
+	m_data = buf;
+	return true;
+}
+
+int32_t sinsp_binary_record_reader::find_field(const string& name)
+{
+	for(uint32_t j = 0; j < m_fields.size(); j++)
+	{
+		if(m_fields[j].m_name == name)
+		{
+			return (int32_t)j;
+		}
+	}
+
+	return -1;
+}
+
+int64_t sinsp_binary_record_reader::get_int(uint32_t field)
+{
+	const char* val = m_data + m_value_offs[field];
+
+	switch(m_sizes[field])
+	{
+	case 1:
+		{
+			int8_t v;
+			memcpy(&v, val, sizeof(v));
+			return v;
+		}
+	case 2:
+		{
+			int16_t v;
+			memcpy(&v, val, sizeof(v));
+			return v;
+		}
+	case 4:
+		{
+			int32_t v;
+			memcpy(&v, val, sizeof(v));
+			return (m_fields[field].m_type == PT_BOOL)? (v != 0) : v;
+		}
+	case 8:
+		{
+			int64_t v;
+			memcpy(&v, val, sizeof(v));
+			return v;
+		}
+	default:
+		return 0;
+	}
+}
+
+uint64_t sinsp_binary_record_reader::get_uint(uint32_t field)
+{
+	const char* val = m_data + m_value_offs[field];
+
+	switch(m_sizes[field])
+	{
+	case 1:
+		{
+			uint8_t v;
+			memcpy(&v, val, sizeof(v));
+			return v;
+		}
+	case 2:
+		{
+			uint16_t v;
+			memcpy(&v, val, sizeof(v));
+			return v;
+		}
+	case 4:
+		{
+			uint32_t v;
+			memcpy(&v, val, sizeof(v));
+			return (m_fields[field].m_type == PT_BOOL)? (v != 0) : v;
+		}
+	case 8:
+		{
+			uint64_t v;
+			memcpy(&v, val, sizeof(v));
+			return v;
+		}
+	default:
+		return 0;
+	}
+}
@@ -0,0 +1,226 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "../common/sysdig_types.h"
+#include "../../driver/ppm_events_public.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Binary event records, written by sysdig --binary.
+//
+// The stream starts with a header that describes the fields of the -p
+// format, followed by one record per event. All the integers are in the
+// byte order of the machine that wrote the stream.
+//
+// Header:
+//   char     magic[4]       "SDBR"
+//   uint32_t byte order     SINSP_BINARY_RECORD_BYTE_ORDER
+//   uint16_t version        SINSP_BINARY_RECORD_VERSION
+//   uint16_t nfields
+//   uint32_t header length  Including the fixed part above
+//   then, for each field:
+//     uint8_t  type          A ppm_param_type
+//     uint8_t  print format  A ppm_print_format
+//     uint16_t name length
+//     char     name[]        As written in the format, e.g. evt.arg.fd
+//
+// Record:
+//   uint32_t length          Of the rest of the record
+//   uint8_t  present[]       (nfields + 7) / 8 bytes. Bit j % 8 of byte
+//                            j / 8 is set if field j has a value.
+//   then, for each field that has a value:
+//     the value, which takes binary_record_value_size(type) bytes, or, for
+//     PT_CHARBUF and PT_BYTEBUF, a uint32_t length followed by the bytes.
+//     Strings are not NUL terminated.
+//
+// Fields whose type has no binary encoding are written as their text
+// rendering, and are described as PT_CHARBUF in the header.
+//
+// This file and binaryrecords.cpp only depend on the C++ standard library
+// and on the sysdig type definitions, so they can be copied into programs
+// that consume the records without linking libsinsp.
+///////////////////////////////////////////////////////////////////////////////
+#define SINSP_BINARY_RECORD_MAGIC "SDBR"
+#define SINSP_BINARY_RECORD_BYTE_ORDER 0x1a2b3c4d
+#define SINSP_BINARY_RECORD_VERSION 1
+#define SINSP_BINARY_RECORD_HEADER_SIZE 16
+
+//
+// Size of the values of a type in the records: the size of the value for
+// the fixed size types, 0 for PT_CHARBUF and PT_BYTEBUF, which are length
+// prefixed, and -1 for the types that can't appear in a record.
+//
+inline int32_t binary_record_value_size(uint32_t type)
+{
+	switch(type)
+	{
+	case PT_INT8:
+	case PT_UINT8:
+	case PT_L4PROTO:
+		return 1;
+	case PT_INT16:
+	case PT_UINT16:
+	case PT_PORT:
+		return 2;
+	case PT_INT32:
+	case PT_UINT32:
+	case PT_BOOL:
+	case PT_IPV4ADDR:
+		return 4;
+	case PT_INT64:
+	case PT_UINT64:
+	case PT_ERRNO:
+	case PT_FD:
+	case PT_PID:
+	case PT_RELTIME:
+	case PT_ABSTIME:
+		return 8;
+	case PT_CHARBUF:
+	case PT_BYTEBUF:
+		return 0;
+	default:
+		return -1;
+	}
+}
+
+//
+// Reader of a binary record stream. Usage:
+//
+//  sinsp_binary_record_reader reader;
+//
+//  if(!reader.read_header(stdin))
+//  {
+//    fprintf(stderr, "%s\n", reader.get_error().c_str());
+//  }
+//
+//  int32_t pid = reader.find_field("proc.pid");
+//
+//  while(reader.read_record(stdin) == 1)
+//  {
+//    if(reader.has_value(pid))
+//    {
+//      printf("%" PRId64 "\n", reader.get_int(pid));
+//    }
+//  }
+//
+// Programs that do their own I/O can pass the header and the records to
+// parse_header() and parse_record() instead.
+//
+class sinsp_binary_record_reader
+{
+public:
+	struct field_info
+	{
+		std::string m_name;
+		uint8_t m_type;
+		uint8_t m_print_format;
+	};
+
+	sinsp_binary_record_reader();
+
+	//
+	// Read and parse the header at the start of the stream. Returns false
+	// on errors, see get_error().
+	//
+	bool read_header(FILE* fp);
+
+	//
+	// Read the next record. Returns 1 if a record has been read, 0 at the
+	// end of the stream, and -1 on errors.
+	//
+	int32_t read_record(FILE* fp);
+
+	//
+	// Parse a header that is already in memory. If len is not enough to
+	// contain it, returns false and sets *needed to the size of the full
+	// header, or of its fixed part, so that the caller can read more data
+	// and call it again. *needed is 0 for other errors.
+	//
+	bool parse_header(const char* buf, uint32_t len, uint32_t* needed);
+
+	//
+	// Parse a record that is already in memory, without its length
+	// prefix. The values point into buf, which must stay valid until the
+	// next record is parsed.
+	//
+	bool parse_record(const char* buf, uint32_t len);
+
+	const std::vector<field_info>& get_fields()
+	{
+		return m_fields;
+	}
+
+	//
+	// Return the index of the first field with the given name, or -1
+	//
+	int32_t find_field(const std::string& name);
+
+	//
+	// Accessors for the values of the last parsed record
+	//
+	bool has_value(uint32_t field)
+	{
+		return m_value_lens[field] != NO_VALUE;
+	}
+
+	//
+	// Value of an integer field, converted to 64 bits. get_int()
+	// sign-extends it. IPv4 addresses are in network byte order, booleans
+	// are 0 or 1.
+	//
+	int64_t get_int(uint32_t field);
+	uint64_t get_uint(uint32_t field);
+
+	//
+	// Value of a PT_CHARBUF or PT_BYTEBUF field. The data is not NUL
+	// terminated.
+	//
+	const char* get_data(uint32_t field, uint32_t* len)
+	{
+		*len = m_value_lens[field];
+		return m_data + m_value_offs[field];
+	}
+
+	const std::string& get_error()
+	{
+		return m_error;
+	}
+
+private:
+	static const uint32_t NO_VALUE = 0xffffffff;
+
+	bool read_fully(FILE* fp, char* buf, uint32_t len, bool* eof);
+
+	std::vector<field_info> m_fields;
+	std::vector<int32_t> m_sizes;
+	//
+	// Offset of the value of every field in the record data, and its
+	// length, or NO_VALUE
+	//
+	std::vector<uint32_t> m_value_offs;
+	std::vector<uint32_t> m_value_lens;
+	const char* m_data;
+	std::vector<char> m_buf;
+	std::string m_error;
+};
@@ -123,6 +123,12 @@ const static struct luaL_reg ll_chisel [] =
 	{"set_interval_ns", &lua_cbacks::set_interval_ns},
 	{"set_interval_s", &lua_cbacks::set_interval_s},
 	{"exec", &lua_cbacks::exec},
+	{"aggregator", &lua_cbacks::aggregator},
+	{"aggregator_top", &lua_cbacks::aggregator_top},
+	{"aggregator_clear", &lua_cbacks::aggregator_clear},
+	{"distinct_counter", &lua_cbacks::distinct_counter},
+	{"distinct_count", &lua_cbacks::distinct_count},
+	{"distinct_clear", &lua_cbacks::distinct_clear},
 	{NULL,NULL}
 };
 
@@ -143,6 +149,7 @@ const static struct luaL_reg ll_evt [] =
 chiselinfo::chiselinfo(sinsp* inspector)
 {
 	m_filter = NULL;
+	m_filter_id = -1;
 	m_formatter = NULL;
 	m_dumper = NULL;
 	m_inspector = inspector;
@@ -156,6 +163,11 @@ chiselinfo::chiselinfo(sinsp* inspector)
 
 chiselinfo::~chiselinfo()
 {
+	if(m_filter_id != -1)
+	{
+		m_inspector->get_chisel_filters()->remove(m_filter_id);
+	}
+
 	if(m_filter)
 	{
 		delete m_filter;
@@ -180,6 +192,12 @@ void chiselinfo::init(string filterstr, string formatterstr)
 
 void chiselinfo::set_filter(string filterstr)
 {
+	if(m_filter_id != -1)
+	{
+		m_inspector->get_chisel_filters()->remove(m_filter_id);
+		m_filter_id = -1;
+	}
+
 	if(m_filter)
 	{
 		delete m_filter;
@@ -189,6 +207,7 @@ void chiselinfo::set_filter(string filterstr)
 	if(filterstr != "")
 	{
 		m_filter = new sinsp_filter(m_inspector, filterstr);
+		m_filter_id = m_inspector->get_chisel_filters()->add(m_filter);
 	}
 }
 
@@ -225,6 +244,8 @@ sinsp_chisel::sinsp_chisel(sinsp* inspector, string filename)
 	m_inspector = inspector;
 	m_ls = NULL;
 	m_lua_has_handle_evt = false;
+	m_lua_on_event_ref = LUA_NOREF;
+	m_lua_evt = NULL;
 	m_lua_is_first_evt = true;
 	m_lua_cinfo = NULL;
 	m_lua_last_interval_sample_time = 0;
@@ -247,11 +268,27 @@ void sinsp_chisel::free_lua_chisel()
 		m_ls = NULL;
 	}
 
+	m_lua_has_handle_evt = false;
+	m_lua_on_event_ref = LUA_NOREF;
+
 	for(uint32_t j = 0; j < m_allocated_fltchecks.size(); j++)
 	{
 		delete m_allocated_fltchecks[j];
 	}
 	m_allocated_fltchecks.clear();
+	m_requested_fields.clear();
+
+	for(uint32_t j = 0; j < m_aggregators.size(); j++)
+	{
+		delete m_aggregators[j];
+	}
+	m_aggregators.clear();
+
+	for(uint32_t j = 0; j < m_distinct_counters.size(); j++)
+	{
+		delete m_distinct_counters[j];
+	}
+	m_distinct_counters.clear();
 
 	if(m_lua_cinfo != NULL)
 	{
@@ -359,7 +396,8 @@ bool sinsp_chisel::init_lua_chisel(chisel_desc &cd, string const &fpath)
 	//
 	luaL_openlib(ls, "sysdig", ll_sysdig, 0);
 	luaL_openlib(ls, "chisel", ll_chisel, 0);
-	luaL_openlib(ls, "evt", ll_evt, 0);
+	lua_pushlightuserdata(ls, NULL);
+	luaL_openlib(ls, "evt", ll_evt, 1);
 
 	//
 	// Add our chisel paths to package.path
@@ -600,7 +638,13 @@ void sinsp_chisel::load(string cmdstr)
 	//
 	luaL_openlib(m_ls, "sysdig", ll_sysdig, 0);
 	luaL_openlib(m_ls, "chisel", ll_chisel, 0);
-	luaL_openlib(m_ls, "evt", ll_evt, 0);
+
+	//
+	// The evt functions are called several times per event, so they get the
+	// chisel as an upvalue instead of looking up the sichisel global
+	//
+	lua_pushlightuserdata(m_ls, this);
+	luaL_openlib(m_ls, "evt", ll_evt, 1);
 
 	//
 	// Add our chisel paths to package.path
@@ -658,6 +702,15 @@ void sinsp_chisel::load(string cmdstr)
 	if(lua_isfunction(m_ls, -1))
 	{
 		m_lua_has_handle_evt = true;
+
+		//
+		// Keep it in the registry, so that calling it for every event
+		// doesn't need a global lookup
+		//
+		m_lua_on_event_ref = luaL_ref(m_ls, LUA_REGISTRYINDEX);
+	}
+	else
+	{
 		lua_pop(m_ls, 1);
 	}
 #endif
@@ -892,6 +945,7 @@ void sinsp_chisel::on_init()
 
 void sinsp_chisel::first_event_inits(sinsp_evt* evt)
 {
+	m_lua_evt = evt;
 	lua_pushlightuserdata(m_ls, evt);
 	lua_setglobal(m_ls, "sievt");
 
@@ -926,22 +980,48 @@ bool sinsp_chisel::run(sinsp_evt* evt)
 	do_timeout(evt);
 
 	//
-	// If there is a filter, run it
+	// If there is a filter, run it. The filters of the chisels are evaluated
+	// together by the first chisel that receives the event, sharing the
+	// checks they have in common.
 	//
 	if(m_lua_cinfo->m_filter != NULL)
 	{
-		if(!m_lua_cinfo->m_filter->run(evt))
+		bool match;
+
+		if(m_lua_cinfo->m_filter_id != -1)
+		{
+			match = m_inspector->get_chisel_filters()->run(evt, m_lua_cinfo->m_filter_id);
+		}
+		else
+		{
+			match = m_lua_cinfo->m_filter->run(evt);
+		}
+
+		if(!match)
 		{
 			return false;
 		}
 	}
 
+	//
+	// Feed the native aggregators and counters of the script
+	//
+	for(uint32_t j = 0; j < m_aggregators.size(); j++)
+	{
+		m_aggregators[j]->add(evt);
+	}
+
+	for(uint32_t j = 0; j < m_distinct_counters.size(); j++)
+	{
+		m_distinct_counters[j]->add(evt);
+	}
+
 	//
 	// If the script has the on_event callback, call it
 	//
 	if(m_lua_has_handle_evt)
 	{
-		lua_getglobal(m_ls, "on_event");
+		lua_rawgeti(m_ls, LUA_REGISTRYINDEX, m_lua_on_event_ref);
 			
 		if(lua_pcall(m_ls, 0, 1, 0) != 0) 
 		{
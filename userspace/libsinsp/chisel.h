@@ -22,6 +22,8 @@ along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
 
 class sinsp_filter_check;
 class sinsp_evt_formatter;
+class sinsp_aggregator;
+class sinsp_distinct_counter;
 
 typedef struct lua_State lua_State;
 
@@ -86,6 +88,11 @@ public:
 	void set_callback_interval(uint64_t interval);
 	~chiselinfo();
 	sinsp_filter* m_filter;
+	//
+	// The bit of the filter in the chisel filter set of the inspector, or -1
+	// if the set is full and the filter runs on its own
+	//
+	int32_t m_filter_id;
 	sinsp_evt_formatter* m_formatter;
 	sinsp_dumper* m_dumper;
 	uint64_t m_callback_interval;
@@ -133,11 +140,24 @@ private:
 	lua_State* m_ls;
 	chisel_desc m_lua_script_info;
 	bool m_lua_has_handle_evt;
+	//
+	// Registry reference to on_event()
+	//
+	int m_lua_on_event_ref;
+	//
+	// The event being processed, for the evt accessors
+	//
+	sinsp_evt* m_lua_evt;
 	bool m_lua_is_first_evt;
 	uint64_t m_lua_last_interval_sample_time;
 	uint64_t m_lua_last_interval_ts;
 	vector<sinsp_filter_check*> m_allocated_fltchecks;
-	char m_lua_fld_storage[1024];
+	//
+	// The checks returned by request_field(), by field name
+	//
+	unordered_map<string, sinsp_filter_check*> m_requested_fields;
+	vector<sinsp_aggregator*> m_aggregators;
+	vector<sinsp_distinct_counter*> m_distinct_counters;
 	chiselinfo* m_lua_cinfo;
 	string m_new_chisel_to_exec;
 
@@ -52,6 +52,11 @@ extern sinsp_filter_check_list g_filterlist;
 extern sinsp_evttables g_infotables;
 void lua_stackdump(lua_State *L);
 
+//
+// Longest part of an unterminated binary buffer that evt.field() returns
+//
+#define LUA_MAX_BYTEBUF_LEN 1023
+
 ///////////////////////////////////////////////////////////////////////////////
 // Lua callbacks
 ///////////////////////////////////////////////////////////////////////////////
@@ -62,37 +67,44 @@ uint32_t lua_cbacks::rawval_to_lua_stack(lua_State *ls, uint8_t* rawval, const f
 	ASSERT(rawval != NULL);
 	ASSERT(finfo != NULL);
 
+	//
+	// Lua numbers are doubles, so the 64 bit values are exact up to 2^53
+	//
 	switch(finfo->m_type)
 	{
 		case PT_INT8:
-			lua_pushnumber(ls, *(int8_t*)rawval);
+			lua_pushinteger(ls, *(int8_t*)rawval);
 			return 1;
 		case PT_INT16:
-			lua_pushnumber(ls, *(int16_t*)rawval);
+			lua_pushinteger(ls, *(int16_t*)rawval);
 			return 1;
 		case PT_INT32:
-			lua_pushnumber(ls, *(int32_t*)rawval);
+			lua_pushinteger(ls, *(int32_t*)rawval);
 			return 1;
 		case PT_INT64:
 		case PT_ERRNO:
 		case PT_PID:
+		case PT_FD:
 			lua_pushnumber(ls, (double)*(int64_t*)rawval);
 			return 1;
 		case PT_L4PROTO: // This can be resolved in the future
 		case PT_FLAGS8:
 		case PT_UINT8:
-			lua_pushnumber(ls, *(uint8_t*)rawval);
+		case PT_SIGTYPE:
+		case PT_SOCKFAMILY:
+			lua_pushinteger(ls, *(uint8_t*)rawval);
 			return 1;
 		case PT_PORT: // This can be resolved in the future
 		case PT_FLAGS16:
 		case PT_UINT16:
-			lua_pushnumber(ls, *(uint16_t*)rawval);
+		case PT_SYSCALLID:
+			lua_pushinteger(ls, *(uint16_t*)rawval);
 			return 1;
 		case PT_FLAGS32:
 		case PT_UINT32:
 		case PT_UID:
 		case PT_GID:
-			lua_pushnumber(ls, *(uint32_t*)rawval);
+			lua_pushinteger(ls, *(uint32_t*)rawval);
 			return 1;
 		case PT_UINT64:
 		case PT_RELTIME:
@@ -100,52 +112,40 @@ uint32_t lua_cbacks::rawval_to_lua_stack(lua_State *ls, uint8_t* rawval, const f
 			lua_pushnumber(ls, (double)*(uint64_t*)rawval);
 			return 1;
 		case PT_CHARBUF:
+		case PT_FSPATH:
 			lua_pushstring(ls, (char*)rawval);
 			return 1;
 		case PT_BYTEBUF:
-			if(rawval[len] == 0)
-			{
-				lua_pushstring(ls, (char*)rawval);
-				return 1;
-			}
-			else
 			{
-				lua_getglobal(ls, "sichisel");
-				sinsp_chisel* ch = (sinsp_chisel*)lua_touserdata(ls, -1);
-				lua_pop(ls, 1);
-
-				uint32_t max_len = len < sizeof(ch->m_lua_fld_storage) ?
-					len : sizeof(ch->m_lua_fld_storage) - 1;
-
-				memcpy(ch->m_lua_fld_storage, rawval, max_len);
-				ch->m_lua_fld_storage[max_len] = 0;
-				lua_pushstring(ls, (char*)ch->m_lua_fld_storage);
+				//
+				// Like a C string, the buffer ends at the first NUL. If it's
+				// not terminated, at most LUA_MAX_BYTEBUF_LEN bytes are returned.
+				//
+				uint32_t max_len = (rawval[len] == 0 || len < LUA_MAX_BYTEBUF_LEN)?
+					len : LUA_MAX_BYTEBUF_LEN;
+
+				lua_pushlstring(ls, (char*)rawval, strnlen((char*)rawval, max_len));
 				return 1;
 			}
 		case PT_SOCKADDR:
 			ASSERT(false);
 			return 0;
-		case PT_SOCKFAMILY:
-			ASSERT(false);
-			return 0;
 		case PT_BOOL:
 			lua_pushboolean(ls, (*(uint32_t*)rawval != 0));
 			return 1;
 		case PT_IPV4ADDR:
 			{
-				lua_getglobal(ls, "sichisel");
-				sinsp_chisel* ch = (sinsp_chisel*)lua_touserdata(ls, -1);
-				lua_pop(ls, 1);
+				char addr[16];
 
-				snprintf(ch->m_lua_fld_storage,
-							sizeof(ch->m_lua_fld_storage),
+				snprintf(addr,
+							sizeof(addr),
 							"%" PRIu8 ".%" PRIu8 ".%" PRIu8 ".%" PRIu8,
 							rawval[0],
 							rawval[1],
 							rawval[2],
 							rawval[3]);
 
-				lua_pushstring(ls, ch->m_lua_fld_storage);
+				lua_pushstring(ls, addr);
 				return 1;
 			}
 		default:
@@ -156,35 +156,34 @@ uint32_t lua_cbacks::rawval_to_lua_stack(lua_State *ls, uint8_t* rawval, const f
 	}
 }
 
-int lua_cbacks::get_num(lua_State *ls) 
+//
+// The evt functions get their chisel as an upvalue, see sinsp_chisel::load()
+//
+inline sinsp_evt* lua_cbacks::get_evt(lua_State *ls, const char* fname)
 {
-	lua_getglobal(ls, "sievt");
-	sinsp_evt* evt = (sinsp_evt*)lua_touserdata(ls, -1);
-	lua_pop(ls, 1);
+	sinsp_chisel* ch = (sinsp_chisel*)lua_touserdata(ls, lua_upvalueindex(1));
 
-	if(evt == NULL)
+	if(ch == NULL || ch->m_lua_evt == NULL)
 	{
-		string err = "invalid call to evt.get_num()";
+		string err = string("invalid call to ") + fname;
 		fprintf(stderr, "%s\n", err.c_str());
 		throw sinsp_exception("chisel error");
 	}
 
+	return ch->m_lua_evt;
+}
+
+int lua_cbacks::get_num(lua_State *ls) 
+{
+	sinsp_evt* evt = get_evt(ls, "evt.get_num()");
+
 	lua_pushnumber(ls, (double)evt->get_num());
 	return 1;
 }
 
 int lua_cbacks::get_ts(lua_State *ls) 
 {
-	lua_getglobal(ls, "sievt");
-	sinsp_evt* evt = (sinsp_evt*)lua_touserdata(ls, -1);
-	lua_pop(ls, 1);
-
-	if(evt == NULL)
-	{
-		string err = "invalid call to evt.get_ts()";
-		fprintf(stderr, "%s\n", err.c_str());
-		throw sinsp_exception("chisel error");
-	}
+	sinsp_evt* evt = get_evt(ls, "evt.get_ts()");
 
 	uint64_t ts = evt->get_ts();
 
@@ -195,16 +194,7 @@ int lua_cbacks::get_ts(lua_State *ls)
 
 int lua_cbacks::get_type(lua_State *ls) 
 {
-	lua_getglobal(ls, "sievt");
-	sinsp_evt* evt = (sinsp_evt*)lua_touserdata(ls, -1);
-	lua_pop(ls, 1);
-
-	if(evt == NULL)
-	{
-		string err = "invalid call to evt.get_type()";
-		fprintf(stderr, "%s\n", err.c_str());
-		throw sinsp_exception("chisel error");
-	}
+	sinsp_evt* evt = get_evt(ls, "evt.get_type()");
 
 	const char* evname;
 	uint16_t etype = evt->get_type();
@@ -229,16 +219,7 @@ int lua_cbacks::get_type(lua_State *ls)
 
 int lua_cbacks::get_cpuid(lua_State *ls) 
 {
-	lua_getglobal(ls, "sievt");
-	sinsp_evt* evt = (sinsp_evt*)lua_touserdata(ls, -1);
-	lua_pop(ls, 1);
-
-	if(evt == NULL)
-	{
-		string err = "invalid call to evt.get_cpuid()";
-		fprintf(stderr, "%s\n", err.c_str());
-		throw sinsp_exception("chisel error");
-	}
+	sinsp_evt* evt = get_evt(ls, "evt.get_cpuid()");
 
 	uint32_t cpuid = evt->get_cpuid();
 
@@ -264,6 +245,18 @@ int lua_cbacks::request_field(lua_State *ls)
 		throw sinsp_exception("chisel error");
 	}
 
+	//
+	// A field that was already requested gets the same check, so that it's
+	// extracted only once per event
+	//
+	unordered_map<string, sinsp_filter_check*>::iterator it = ch->m_requested_fields.find(fld);
+
+	if(it != ch->m_requested_fields.end())
+	{
+		lua_pushlightuserdata(ls, it->second);
+		return 1;
+	}
+
 	sinsp_filter_check* chk = g_filterlist.new_filter_check_from_fldname(fld,
 		inspector, 
 		false);
@@ -280,24 +273,16 @@ int lua_cbacks::request_field(lua_State *ls)
 	lua_pushlightuserdata(ls, chk);
 
 	ch->m_allocated_fltchecks.push_back(chk);
+	ch->m_requested_fields[fld] = chk;
 
 	return 1;
 }
 
 int lua_cbacks::field(lua_State *ls) 
 {
-	lua_getglobal(ls, "sievt");
-	sinsp_evt* evt = (sinsp_evt*)lua_touserdata(ls, -1);
-	lua_pop(ls, 1);
+	sinsp_evt* evt = get_evt(ls, "evt.field()");
 
-	if(evt == NULL)
-	{
-		string err = "invalid call to evt.field()";
-		fprintf(stderr, "%s\n", err.c_str());
-		throw sinsp_exception("chisel error");
-	}
-
-	sinsp_filter_check* chk = (sinsp_filter_check*)lua_topointer(ls, 1);
+	sinsp_filter_check* chk = (sinsp_filter_check*)lua_touserdata(ls, 1);
 	if(chk == NULL)
 	{
 		//
@@ -309,7 +294,7 @@ int lua_cbacks::field(lua_State *ls)
 	}
 
 	uint32_t vlen;
-	uint8_t* rawval = chk->extract(evt, &vlen);
+	uint8_t* rawval = chk->extract_cached(evt, &vlen);
 
 	if(rawval != NULL)
 	{
@@ -690,6 +675,7 @@ int lua_cbacks::get_thread_table(lua_State *ls)
 			{
 				tevt.m_tinfo = &(it->second);
 				tevt.m_fdinfo = &(fdit->second);
+				tevt.clear_extraction_cache();
 				tscapevt.tid = it->first;
 				int64_t tlefd = tevt.m_tinfo->m_lastevent_fd;
 				tevt.m_tinfo->m_lastevent_fd = fdit->first;
@@ -798,7 +784,7 @@ int lua_cbacks::get_thread_table(lua_State *ls)
 		//
 		lua_pushstring(ls, "args");
 
-		vector<string>* args = &(it->second.m_args);
+		const vector<string>* args = &(it->second.get_args());
 		lua_newtable(ls);
 		for(j = 0; j < args->size(); j++)
 		{
@@ -813,7 +799,7 @@ int lua_cbacks::get_thread_table(lua_State *ls)
 		//
 		lua_pushstring(ls, "env");
 
-		vector<string>* env = &(it->second.m_env);
+		const vector<string>* env = &(it->second.get_env());
 		lua_newtable(ls);
 		for(j = 0; j < env->size(); j++)
 		{
@@ -832,6 +818,7 @@ int lua_cbacks::get_thread_table(lua_State *ls)
 		{
 			tevt.m_tinfo = &(it->second);
 			tevt.m_fdinfo = &(fdit->second);
+			tevt.clear_extraction_cache();
 			tscapevt.tid = it->first;
 			int64_t tlefd = tevt.m_tinfo->m_lastevent_fd;
 			tevt.m_tinfo->m_lastevent_fd = fdit->first;
@@ -1203,5 +1190,300 @@ int lua_cbacks::exec(lua_State *ls)
 	return 0;
 }
 
+int lua_cbacks::aggregator(lua_State *ls) 
+{
+	lua_getglobal(ls, "sichisel");
+
+	sinsp_chisel* ch = (sinsp_chisel*)lua_touserdata(ls, -1);
+	lua_pop(ls, 1);
+
+	ASSERT(ch);
+
+	//
+	// The keys can be either a table of field names or a single string with
+	// comma separated names
+	//
+	vector<string> keys;
+
+	if(lua_istable(ls, 1))
+	{
+		for(int32_t j = 1; ; j++)
+		{
+			lua_rawgeti(ls, 1, j);
+			const char* key = lua_tostring(ls, -1);
+			lua_pop(ls, 1);
+
+			if(key == NULL)
+			{
+				break;
+			}
+
+			keys.push_back(key);
+		}
+	}
+	else if(lua_isstring(ls, 1))
+	{
+		keys = sinsp_split(lua_tostring(ls, 1), ',');
+	}
+
+	if(keys.size() == 0)
+	{
+		string err = "chisel.aggregator() needs at least a key field in chisel " + ch->m_filename;
+		fprintf(stderr, "%s\n", err.c_str());
+		throw sinsp_exception("chisel error");
+	}
+
+	const char* value = lua_tostring(ls, 2);
+	const char* opname = lua_tostring(ls, 3);
+	uint32_t max_groups = (uint32_t)lua_tonumber(ls, 4);
+	sinsp_aggregator::op op = sinsp_aggregator::OP_SUM;
+
+	if(opname != NULL && !sinsp_aggregator::parse_op(opname, &op))
+	{
+		string err = "invalid aggregation " + string(opname) + " in chisel " + ch->m_filename;
+		fprintf(stderr, "%s\n", err.c_str());
+		throw sinsp_exception("chisel error");
+	}
+
+	sinsp_aggregator* agg;
+
+	try
+	{
+		agg = new sinsp_aggregator(ch->m_inspector,
+			keys,
+			(value != NULL)? value : "",
+			op,
+			max_groups);
+	}
+	catch(sinsp_exception& e)
+	{
+		string err = "chisel.aggregator() error in chisel " + ch->m_filename + ": " + e.what();
+		fprintf(stderr, "%s\n", err.c_str());
+		throw sinsp_exception("chisel error");
+	}
+
+	ch->m_aggregators.push_back(agg);
+
+	lua_pushlightuserdata(ls, agg);
+	return 1;
+}
+
+int lua_cbacks::aggregator_top(lua_State *ls) 
+{
+	sinsp_aggregator* agg = (sinsp_aggregator*)lua_touserdata(ls, 1);
+
+	if(agg == NULL)
+	{
+		string err = "invalid aggregator passed to chisel.aggregator_top()";
+		fprintf(stderr, "%s\n", err.c_str());
+		throw sinsp_exception("chisel error");
+	}
+
+	uint32_t n = (uint32_t)lua_tonumber(ls, 2);
+	vector<sinsp_aggregator::group> top;
+	agg->get_top(n, &top);
+
+	//
+	// Every row is an array with the values of the keys, followed by the
+	// aggregated value. When the aggregator has max_groups, the values can
+	// be overestimates: the second table has the max error of every row,
+	// and the last return value is the bound on all the errors.
+	//
+	uint32_t nkeys = agg->get_num_keys();
+
+	lua_createtable(ls, (int)top.size(), 0);
+
+	for(uint32_t j = 0; j < top.size(); j++)
+	{
+		const string& key = *top[j].m_key;
+		uint32_t pos = 0;
+
+		lua_createtable(ls, nkeys + 1, 0);
+
+		for(uint32_t k = 0; k < nkeys; k++)
+		{
+			uint32_t type;
+			uint32_t len;
+			const char* val = sinsp_aggregator::get_key_value(key, &pos, &type, &len);
+
+			//
+			// The fixed size values are not aligned in the key
+			//
+			uint64_t buf[2];
+			double num;
+
+			switch(type)
+			{
+			case PT_CHARBUF:
+			case PT_FSPATH:
+			case PT_BYTEBUF:
+				lua_pushlstring(ls, val, len);
+				break;
+			case PT_BOOL:
+				memcpy(buf, val, len);
+				lua_pushboolean(ls, (*(uint32_t*)buf != 0));
+				break;
+			case PT_IPV4ADDR:
+				{
+					char addr[16];
+
+					snprintf(addr,
+						sizeof(addr),
+						"%" PRIu8 ".%" PRIu8 ".%" PRIu8 ".%" PRIu8,
+						(uint8_t)val[0],
+						(uint8_t)val[1],
+						(uint8_t)val[2],
+						(uint8_t)val[3]);
+
+					lua_pushstring(ls, addr);
+				}
+				break;
+			default:
+				memcpy(buf, val, len);
+
+				if(sinsp_aggregator::rawval_to_double((uint8_t*)buf, type, &num))
+				{
+					lua_pushnumber(ls, num);
+				}
+				else
+				{
+					lua_pushnil(ls);
+				}
+				break;
+			}
+
+			lua_rawseti(ls, -2, k + 1);
+		}
+
+		lua_pushnumber(ls, top[j].m_value);
+		lua_rawseti(ls, -2, nkeys + 1);
+
+		lua_rawseti(ls, -2, j + 1);
+	}
+
+	lua_createtable(ls, (int)top.size(), 0);
+
+	for(uint32_t j = 0; j < top.size(); j++)
+	{
+		lua_pushnumber(ls, top[j].m_error);
+		lua_rawseti(ls, -2, j + 1);
+	}
+
+	lua_pushnumber(ls, agg->get_max_error());
+
+	return 3;
+}
+
+int lua_cbacks::aggregator_clear(lua_State *ls) 
+{
+	sinsp_aggregator* agg = (sinsp_aggregator*)lua_touserdata(ls, 1);
+
+	if(agg == NULL)
+	{
+		string err = "invalid aggregator passed to chisel.aggregator_clear()";
+		fprintf(stderr, "%s\n", err.c_str());
+		throw sinsp_exception("chisel error");
+	}
+
+	agg->clear();
+	return 0;
+}
+
+int lua_cbacks::distinct_counter(lua_State *ls) 
+{
+	lua_getglobal(ls, "sichisel");
+
+	sinsp_chisel* ch = (sinsp_chisel*)lua_touserdata(ls, -1);
+	lua_pop(ls, 1);
+
+	ASSERT(ch);
+
+	vector<string> fields;
+
+	if(lua_istable(ls, 1))
+	{
+		for(int32_t j = 1; ; j++)
+		{
+			lua_rawgeti(ls, 1, j);
+			const char* field = lua_tostring(ls, -1);
+			lua_pop(ls, 1);
+
+			if(field == NULL)
+			{
+				break;
+			}
+
+			fields.push_back(field);
+		}
+	}
+	else if(lua_isstring(ls, 1))
+	{
+		fields = sinsp_split(lua_tostring(ls, 1), ',');
+	}
+
+	if(fields.size() == 0)
+	{
+		string err = "chisel.distinct_counter() needs at least a field in chisel " + ch->m_filename;
+		fprintf(stderr, "%s\n", err.c_str());
+		throw sinsp_exception("chisel error");
+	}
+
+	uint32_t precision = HLL_DEFAULT_PRECISION;
+
+	if(lua_isnumber(ls, 2))
+	{
+		precision = (uint32_t)lua_tonumber(ls, 2);
+	}
+
+	sinsp_distinct_counter* cnt;
+
+	try
+	{
+		cnt = new sinsp_distinct_counter(ch->m_inspector, fields, precision);
+	}
+	catch(sinsp_exception& e)
+	{
+		string err = "chisel.distinct_counter() error in chisel " + ch->m_filename + ": " + e.what();
+		fprintf(stderr, "%s\n", err.c_str());
+		throw sinsp_exception("chisel error");
+	}
+
+	ch->m_distinct_counters.push_back(cnt);
+
+	lua_pushlightuserdata(ls, cnt);
+	return 1;
+}
+
+int lua_cbacks::distinct_count(lua_State *ls) 
+{
+	sinsp_distinct_counter* cnt = (sinsp_distinct_counter*)lua_touserdata(ls, 1);
+
+	if(cnt == NULL)
+	{
+		string err = "invalid counter passed to chisel.distinct_count()";
+		fprintf(stderr, "%s\n", err.c_str());
+		throw sinsp_exception("chisel error");
+	}
+
+	lua_pushnumber(ls, cnt->estimate());
+	lua_pushnumber(ls, cnt->get_std_error());
+	return 2;
+}
+
+int lua_cbacks::distinct_clear(lua_State *ls) 
+{
+	sinsp_distinct_counter* cnt = (sinsp_distinct_counter*)lua_touserdata(ls, 1);
+
+	if(cnt == NULL)
+	{
+		string err = "invalid counter passed to chisel.distinct_clear()";
+		fprintf(stderr, "%s\n", err.c_str());
+		throw sinsp_exception("chisel error");
+	}
+
+	cnt->clear();
+	return 0;
+}
+
 #endif // HAS_LUA_CHISELS
 #endif // HAS_CHISELS
@@ -53,6 +53,15 @@ public:
 	static int set_interval_ns(lua_State *ls);
 	static int set_interval_s(lua_State *ls);
 	static int exec(lua_State *ls);
+	static int aggregator(lua_State *ls);
+	static int aggregator_top(lua_State *ls);
+	static int aggregator_clear(lua_State *ls);
+	static int distinct_counter(lua_State *ls);
+	static int distinct_count(lua_State *ls);
+	static int distinct_clear(lua_State *ls);
+
+private:
+	static sinsp_evt* get_evt(lua_State *ls, const char* fname);
 };
 
 #endif // HAS_CHISELS
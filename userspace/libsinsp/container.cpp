@@ -50,21 +50,15 @@ bool sinsp_container_manager::remove_inactive_containers()
 
 		g_logger.format(sinsp_logger::SEV_INFO, "Flushing container table");
 
-		set<string> containers_in_use;
-
-		threadinfo_map_t* threadtable = m_inspector->m_thread_manager->get_threads();
-
-		for(threadinfo_map_iterator_t it = threadtable->begin(); it != threadtable->end(); ++it)
-		{
-			if(!it->second.m_container_id.empty())
-			{
-				containers_in_use.insert(it->second.m_container_id);
-			}
-		}
+		//
+		// The thread manager keeps a count of the threads in every container,
+		// so there's no need to walk the thread table here
+		//
+		sinsp_thread_manager* thread_manager = m_inspector->m_thread_manager;
 
 		for(unordered_map<string, sinsp_container_info>::iterator it = m_containers.begin(); it != m_containers.end();)
 		{
-			if(containers_in_use.find(it->first) == containers_in_use.end())
+			if(!thread_manager->is_container_in_use(it->first))
 			{
 				m_containers.erase(it++);
 			}
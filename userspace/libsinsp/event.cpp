@@ -61,6 +61,7 @@ sinsp_evt::sinsp_evt() :
 {
 	m_params_loaded = false;
 	m_tinfo = NULL;
+	m_n_cached_fields = 0;
 #ifdef _DEBUG
 	m_filtered_out = false;
 #endif
@@ -73,6 +74,7 @@ sinsp_evt::sinsp_evt(sinsp *inspector) :
 	m_inspector = inspector;
 	m_params_loaded = false;
 	m_tinfo = NULL;
+	m_n_cached_fields = 0;
 #ifdef _DEBUG
 	m_filtered_out = false;
 #endif
@@ -660,23 +662,31 @@ char* sinsp_evt::render_fd(int64_t fd, const char** resolved_str, sinsp_evt::par
 			};
 
 			//
-			// Make sure we remove invalid characters from the resolved name
+			// Make sure we remove invalid characters from the resolved name.
+			// The interned name knows if it's clean, in which case we can use it
+			// without copying it.
 			//
-			string sanitized_str = fdinfo->m_name;
+			const string* sanitized_str = &fdinfo->m_name.str();
+			string tstr;
 
-			sanitized_str.erase(remove_if(sanitized_str.begin(), sanitized_str.end(), g_invalidchar()), sanitized_str.end());
+			if(!fdinfo->m_name.is_clean())
+			{
+				tstr = fdinfo->m_name;
+				tstr.erase(remove_if(tstr.begin(), tstr.end(), g_invalidchar()), tstr.end());
+				sanitized_str = &tstr;
+			}
 
 			//
 			// Make sure the string will fit
 			//
-			if(sanitized_str.size() >= m_resolved_paramstr_storage.size())
+			if(sanitized_str->size() >= m_resolved_paramstr_storage.size())
 			{
-				m_resolved_paramstr_storage.resize(sanitized_str.size() + 1);
+				m_resolved_paramstr_storage.resize(sanitized_str->size() + 1);
 			}
 
 			snprintf(&m_resolved_paramstr_storage[0],
 				m_resolved_paramstr_storage.size(),
-				"<%s>%s", typestr, sanitized_str.c_str());
+				"<%s>%s", typestr, sanitized_str->c_str());
 
 /* XXX
 			if(sanitized_str.length() == 0)
@@ -308,6 +308,7 @@ private:
 		m_tinfo = NULL;
 		m_fdinfo = NULL;
 		m_iosize = 0;		
+		m_n_cached_fields = 0;
 	}
 	inline void init(uint8_t* evdata, uint16_t cpuid)
 	{
@@ -319,6 +320,7 @@ private:
 		m_iosize = 0;
 		m_cpuid = cpuid;
 		m_evtnum = 0;		
+		m_n_cached_fields = 0;
 	}
 	inline void load_params()
 	{
@@ -344,6 +346,16 @@ private:
 	int render_fd_json(Json::Value *ret, int64_t fd, const char** resolved_str, sinsp_evt::param_fmt fmt);
 	uint32_t get_dump_flags();
 
+	/*!
+	  \brief Drop the field values that the filter checks cached for this
+	   event. Needed when the state that the fields depend on changes
+	   without the event being reinitialized.
+	*/
+	inline void clear_extraction_cache()
+	{
+		m_n_cached_fields = 0;
+	}
+
 VISIBILITY_PRIVATE
 
 	sinsp* m_inspector;
@@ -367,10 +379,30 @@ VISIBILITY_PRIVATE
 #endif
 	const struct ppm_event_info* m_event_info_table;
 
+	//
+	// Cache of the expensive fields extracted from this event, so that the
+	// filters, the formatter and the chisels don't render the same field
+	// more than once. See sinsp_filter_check::extract_cached().
+	// The entries and their buffers are reused across events, a deque keeps
+	// the buffers in place while the cache grows.
+	//
+	struct extraction_cache_entry
+	{
+		const void* m_field;
+		int32_t m_argid;
+		string m_argname;
+		bool m_is_null;
+		vector<char> m_val;
+	};
+
+	deque<extraction_cache_entry> m_extraction_cache;
+	uint32_t m_n_cached_fields;
+
 	friend class sinsp;
 	friend class sinsp_parser;
 	friend class sinsp_threadinfo;
 	friend class sinsp_analyzer;
+	friend class sinsp_filter_check;
 	friend class sinsp_filter_check_event;
 	friend class sinsp_filter_check_thread;
 	friend class sinsp_dumper;
@@ -379,6 +411,8 @@ VISIBILITY_PRIVATE
 	friend class lua_cbacks;
 	friend class sinsp_proto_detector;
 	friend class sinsp_container_manager;
+	friend class sinsp_fanout_publisher;
+	friend class sinsp_fanout_subscriber;
 };
 
 /*@}*/
@@ -21,6 +21,7 @@ along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
 #include "filter.h"
 #include "filterchecks.h"
 #include "eventformatter.h"
+#include "binaryrecords.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 // rawstring_check implementation
@@ -32,6 +33,16 @@ sinsp_evt_formatter::sinsp_evt_formatter(sinsp* inspector, const string& fmt)
 {
 	m_inspector = inspector;
 	m_first = true;
+	m_out = NULL;
+	m_outsize = 0;
+	m_outlen = 0;
+	m_overflowing = false;
+	m_overflow_evt = NULL;
+	m_overflow_evtnum = 0;
+	m_overflow_ts = 0;
+	m_overflow_res = false;
+	m_overflow_binary = false;
+	m_nfields = 0;
 	set_format(fmt);
 }
 
@@ -76,6 +87,9 @@ void sinsp_evt_formatter::set_format(const string& fmt)
 	const char* cfmt = lfmt.c_str();
 
 	m_tokens.clear();
+	m_tokenlens.clear();
+	m_writers.clear();
+	m_nfields = 0;
 	uint32_t lfmtlen = (uint32_t)lfmt.length();
 
 	for(j = 0; j < lfmtlen; j++)
@@ -86,10 +100,7 @@ void sinsp_evt_formatter::set_format(const string& fmt)
 
 			if(last_nontoken_str_start != j)
 			{
-				rawstring_check* newtkn = new rawstring_check(lfmt.substr(last_nontoken_str_start, j - last_nontoken_str_start));
-				m_tokens.push_back(newtkn);
-				m_tokenlens.push_back(0);
-				m_chks_to_free.push_back(newtkn);
+				add_text(lfmt.substr(last_nontoken_str_start, j - last_nontoken_str_start));
 			}
 
 			if(j == lfmtlen - 1)
@@ -139,11 +150,13 @@ void sinsp_evt_formatter::set_format(const string& fmt)
 
 			m_chks_to_free.push_back(chk);
 
-			j += chk->parse_field_name(cfmt + j + 1);
+			uint32_t namelen = chk->parse_field_name(cfmt + j + 1);
+			string name(cfmt + j + 1, namelen);
+
+			j += namelen;
 			ASSERT(j <= lfmt.length());
 
-			m_tokens.push_back(chk);
-			m_tokenlens.push_back(toklen);
+			add_field(chk, toklen, name);
 
 			last_nontoken_str_start = j + 1;
 		}
@@ -151,9 +164,807 @@ void sinsp_evt_formatter::set_format(const string& fmt)
 
 	if(last_nontoken_str_start != j)
 	{
-		m_tokens.push_back(new rawstring_check(lfmt.substr(last_nontoken_str_start, j - last_nontoken_str_start)));
-		m_tokenlens.push_back(0);
+		add_text(lfmt.substr(last_nontoken_str_start, j - last_nontoken_str_start));
+	}
+
+	compile_json();
+}
+
+void sinsp_evt_formatter::add_text(const string& text)
+{
+	rawstring_check* newtkn = new rawstring_check(text);
+	m_tokens.push_back(newtkn);
+	m_tokenlens.push_back(0);
+	m_chks_to_free.push_back(newtkn);
+
+	token_writer w;
+	w.m_type = WT_TEXT;
+	w.m_json = JK_GENERIC;
+	w.m_size = 0;
+	w.m_width = 0;
+	w.m_chk = newtkn;
+	w.m_text = text;
+	w.m_binary_type = PT_NONE;
+	w.m_binary_size = -1;
+	m_writers.push_back(w);
+}
+
+void sinsp_evt_formatter::add_field(sinsp_filter_check* chk, uint32_t toklen, const string& name)
+{
+	m_tokens.push_back(chk);
+	m_tokenlens.push_back(toklen);
+	m_nfields++;
+
+	token_writer w;
+	w.m_type = WT_GENERIC;
+	w.m_size = 0;
+	w.m_width = toklen;
+	w.m_chk = chk;
+	w.m_field_name = name;
+
+	//
+	// Same output as sinsp_filter_check::rawval_to_string(). The cases that
+	// are not listed, like the hex rendering of the small signed integers,
+	// go through it.
+	//
+	const filtercheck_field_info* fi = chk->get_field_info();
+	ppm_print_format pf = fi->m_print_format;
+
+	switch(fi->m_type)
+	{
+	case PT_CHARBUF:
+		w.m_type = WT_STRING;
+		break;
+	case PT_BYTEBUF:
+		w.m_type = WT_BUFFER;
+		break;
+	case PT_INT8:
+	case PT_INT16:
+	case PT_INT32:
+		if(pf == PF_DEC)
+		{
+			w.m_type = WT_SIGNED;
+			w.m_size = (fi->m_type == PT_INT8)? 1 : (fi->m_type == PT_INT16)? 2 : 4;
+		}
+		break;
+	case PT_INT64:
+	case PT_PID:
+	case PT_ERRNO:
+		if(pf == PF_10_PADDED_DEC)
+		{
+			w.m_type = WT_SIGNED_9;
+		}
+		else if(pf == PF_HEX)
+		{
+			w.m_type = WT_HEX;
+		}
+		else
+		{
+			w.m_type = WT_SIGNED;
+			w.m_size = 8;
+		}
+		break;
+	case PT_L4PROTO:
+	case PT_UINT8:
+	case PT_PORT:
+	case PT_UINT16:
+	case PT_UINT32:
+		//
+		// These are printed in decimal also when their format is hex
+		//
+		if(pf == PF_DEC || pf == PF_HEX)
+		{
+			w.m_type = WT_UNSIGNED;
+			w.m_size = (fi->m_type == PT_L4PROTO || fi->m_type == PT_UINT8)? 1 :
+				(fi->m_type == PT_UINT32)? 4 : 2;
+		}
+		break;
+	case PT_UINT64:
+	case PT_RELTIME:
+	case PT_ABSTIME:
+		if(pf == PF_DEC)
+		{
+			w.m_type = WT_UNSIGNED;
+			w.m_size = 8;
+		}
+		else if(pf == PF_10_PADDED_DEC)
+		{
+			w.m_type = WT_UNSIGNED_9;
+		}
+		else if(pf == PF_HEX)
+		{
+			w.m_type = WT_HEX;
+		}
+		break;
+	case PT_BOOL:
+		w.m_type = WT_BOOL;
+		break;
+	case PT_IPV4ADDR:
+		w.m_type = WT_IPV4;
+		break;
+	default:
+		break;
+	}
+
+	//
+	// Same output as sinsp_filter_check::rawval_to_json(), which renders
+	// the numbers that are not in decimal as strings
+	//
+	if(w.m_type == WT_GENERIC || fi->m_type == PT_ERRNO)
+	{
+		w.m_json = JK_GENERIC;
+	}
+	else if(w.m_type == WT_STRING || w.m_type == WT_BUFFER || w.m_type == WT_IPV4)
+	{
+		w.m_json = JK_STRING;
+	}
+	else if(w.m_type == WT_BOOL || pf == PF_DEC)
+	{
+		w.m_json = JK_BARE;
+	}
+	else
+	{
+		w.m_json = JK_STRING;
+	}
+
+	//
+	// The types that have no binary encoding are written as text
+	//
+	w.m_binary_type = fi->m_type;
+	w.m_binary_size = binary_record_value_size(fi->m_type);
+
+	if(w.m_binary_size < 0)
+	{
+		w.m_binary_type = PT_CHARBUF;
+		w.m_binary_size = 0;
+	}
+
+	m_writers.push_back(w);
+}
+
+void sinsp_evt_formatter::compile_json()
+{
+	map<string, uint32_t> last_tokens;
+	uint32_t j;
+
+	m_json_fields.clear();
+	m_json_shadowed.clear();
+
+	for(j = 0; j < m_writers.size(); j++)
+	{
+		if(m_writers[j].m_type == WT_TEXT)
+		{
+			continue;
+		}
+
+		string name = m_tokens[j]->get_field_info()->m_name;
+		map<string, uint32_t>::iterator it = last_tokens.find(name);
+
+		if(it != last_tokens.end())
+		{
+			m_json_shadowed.push_back(it->second);
+			it->second = j;
+		}
+		else
+		{
+			last_tokens[name] = j;
+		}
+	}
+
+	for(map<string, uint32_t>::iterator it = last_tokens.begin(); it != last_tokens.end(); ++it)
+	{
+		json_field f;
+		string key = m_writer.write(Json::Value(it->first));
+
+		f.m_key = key.substr(0, key.size() - 1) + ":";
+		f.m_token = it->second;
+		m_json_fields.push_back(f);
+	}
+}
+
+//
+// Write the decimal digits of v right before end, and return a pointer to
+// the first one
+//
+static const char g_digit_pairs[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+static inline char* u64_to_dec(uint64_t v, char* end)
+{
+	while(v >= 100)
+	{
+		uint32_t pair = (uint32_t)(v % 100) * 2;
+		v /= 100;
+		*--end = g_digit_pairs[pair + 1];
+		*--end = g_digit_pairs[pair];
+	}
+
+	if(v >= 10)
+	{
+		*--end = g_digit_pairs[v * 2 + 1];
+		*--end = g_digit_pairs[v * 2];
+	}
+	else
+	{
+		*--end = (char)('0' + v);
+	}
+
+	return end;
+}
+
+static inline char* u64_to_hex(uint64_t v, char* end)
+{
+	do
+	{
+		*--end = "0123456789ABCDEF"[v & 0xf];
+		v >>= 4;
+	}
+	while(v != 0);
+
+	return end;
+}
+
+static inline int64_t load_signed(const uint8_t* rawval, uint32_t size)
+{
+	switch(size)
+	{
+	case 1:
+		return *(int8_t*)rawval;
+	case 2:
+		return *(int16_t*)rawval;
+	case 4:
+		return *(int32_t*)rawval;
+	default:
+		return *(int64_t*)rawval;
+	}
+}
+
+static inline uint64_t load_unsigned(const uint8_t* rawval, uint32_t size)
+{
+	switch(size)
+	{
+	case 1:
+		return *(uint8_t*)rawval;
+	case 2:
+		return *(uint16_t*)rawval;
+	case 4:
+		return *(uint32_t*)rawval;
+	default:
+		return *(uint64_t*)rawval;
+	}
+}
+
+//
+// Convert a token to text. Numbers are written right before end, which
+// must have at least 32 bytes of room before it. Returns false if the field
+// has no value for the event.
+//
+bool sinsp_evt_formatter::render_field(const token_writer& w, sinsp_evt* evt, char* end, OUT const char** pstr, OUT uint32_t* plen)
+{
+	const char* str;
+	uint32_t len = 0;
+	uint8_t* rawval;
+
+	if(w.m_type == WT_TEXT)
+	{
+		str = w.m_text.c_str();
+		len = (uint32_t)w.m_text.size();
 	}
+	else if(w.m_type == WT_GENERIC)
+	{
+		str = w.m_chk->tostring(evt);
+
+		if(str == NULL)
+		{
+			return false;
+		}
+
+		len = (uint32_t)strlen(str);
+	}
+	else
+	{
+		rawval = w.m_chk->extract_cached(evt, &len);
+
+		if(rawval == NULL)
+		{
+			return false;
+		}
+
+		switch(w.m_type)
+		{
+		case WT_STRING:
+			str = (const char*)rawval;
+			len = (uint32_t)strlen(str);
+			break;
+		case WT_BUFFER:
+			str = (const char*)rawval;
+			len = (uint32_t)strnlen(str, len);
+			break;
+		case WT_UNSIGNED:
+			str = u64_to_dec(load_unsigned(rawval, w.m_size), end);
+			len = (uint32_t)(end - str);
+			break;
+		case WT_SIGNED:
+			{
+				int64_t v = load_signed(rawval, w.m_size);
+				char* p = u64_to_dec((v < 0)? (0 - (uint64_t)v) : (uint64_t)v, end);
+
+				if(v < 0)
+				{
+					*--p = '-';
+				}
+
+				str = p;
+				len = (uint32_t)(end - str);
+			}
+			break;
+		case WT_UNSIGNED_9:
+		case WT_SIGNED_9:
+			{
+				int64_t v = *(int64_t*)rawval;
+				bool negative = (w.m_type == WT_SIGNED_9 && v < 0);
+				char* p = u64_to_dec(negative? (0 - (uint64_t)v) : (uint64_t)v, end);
+				char* first = end - (negative? 8 : 9);
+
+				while(p > first)
+				{
+					*--p = '0';
+				}
+
+				if(negative)
+				{
+					*--p = '-';
+				}
+
+				str = p;
+				len = (uint32_t)(end - str);
+			}
+			break;
+		case WT_HEX:
+			str = u64_to_hex(*(uint64_t*)rawval, end);
+			len = (uint32_t)(end - str);
+			break;
+		case WT_BOOL:
+			str = (*(uint32_t*)rawval != 0)? "true" : "false";
+			len = (uint32_t)strlen(str);
+			break;
+		case WT_IPV4:
+			{
+				char* p = end;
+
+				for(int32_t k = 3; k >= 0; k--)
+				{
+					p = u64_to_dec(rawval[k], p);
+
+					if(k != 0)
+					{
+						*--p = '.';
+					}
+				}
+
+				str = p;
+				len = (uint32_t)(end - str);
+			}
+			break;
+		default:
+			ASSERT(false);
+			return false;
+		}
+	}
+
+	*pstr = str;
+	*plen = len;
+	return true;
+}
+
+//
+// Render a field of the text output. Returns false if the field has no
+// value for the event.
+//
+bool sinsp_evt_formatter::write_field(const token_writer& w, sinsp_evt* evt)
+{
+	char buf[64];
+	const char* str;
+	uint32_t len;
+
+	if(!render_field(w, evt, buf + sizeof(buf), &str, &len))
+	{
+		return false;
+	}
+
+	if(w.m_width != 0)
+	{
+		append_padded(str, len, w.m_width);
+	}
+	else
+	{
+		append(str, len);
+	}
+
+	return true;
+}
+
+//
+// Append a string with the same escaping as Json::FastWriter
+//
+void sinsp_evt_formatter::append_json_string(const char* str, uint32_t len)
+{
+	uint32_t start = 0;
+	uint32_t j;
+
+	append("\"", 1);
+
+	for(j = 0; j < len; j++)
+	{
+		char c = str[j];
+		const char* esc;
+		char ubuf[7];
+
+		if(c == 0)
+		{
+			break;
+		}
+		else if(c > 0x1f && c != '"' && c != '\\')
+		{
+			continue;
+		}
+
+		switch(c)
+		{
+		case '"':
+			esc = "\\\"";
+			break;
+		case '\\':
+			esc = "\\\\";
+			break;
+		case '\b':
+			esc = "\\b";
+			break;
+		case '\f':
+			esc = "\\f";
+			break;
+		case '\n':
+			esc = "\\n";
+			break;
+		case '\r':
+			esc = "\\r";
+			break;
+		case '\t':
+			esc = "\\t";
+			break;
+		default:
+			if(c < 0)
+			{
+				continue;
+			}
+
+			ubuf[0] = '\\';
+			ubuf[1] = 'u';
+			ubuf[2] = '0';
+			ubuf[3] = '0';
+			ubuf[4] = "0123456789ABCDEF"[(c >> 4) & 0xf];
+			ubuf[5] = "0123456789ABCDEF"[c & 0xf];
+			ubuf[6] = 0;
+			esc = ubuf;
+			break;
+		}
+
+		append(str + start, j - start);
+		append(esc, (uint32_t)strlen(esc));
+		start = j + 1;
+	}
+
+	append(str + start, j - start);
+	append("\"", 1);
+}
+
+void sinsp_evt_formatter::write_json_value(const Json::Value& val)
+{
+	char buf[32];
+	char* end = buf + sizeof(buf);
+	char* p;
+
+	switch(val.type())
+	{
+	case Json::intValue:
+		{
+			Json::Value::LargestInt v = val.asLargestInt();
+			p = u64_to_dec((v < 0)? (0 - (uint64_t)v) : (uint64_t)v, end);
+
+			if(v < 0)
+			{
+				*--p = '-';
+			}
+
+			append(p, (uint32_t)(end - p));
+		}
+		break;
+	case Json::uintValue:
+		p = u64_to_dec(val.asLargestUInt(), end);
+		append(p, (uint32_t)(end - p));
+		break;
+	case Json::booleanValue:
+		if(val.asBool())
+		{
+			append("true", 4);
+		}
+		else
+		{
+			append("false", 5);
+		}
+		break;
+	case Json::stringValue:
+		{
+			const char* str = val.asCString();
+			append_json_string(str, (uint32_t)strlen(str));
+		}
+		break;
+	default:
+		{
+			string json = m_writer.write(val);
+			append(json.c_str(), (uint32_t)json.size() - 1);
+		}
+		break;
+	}
+}
+
+//
+// Write the JSON value of a token. Returns false if the field has no value
+// for the event.
+//
+bool sinsp_evt_formatter::write_json_field(const token_writer& w, sinsp_evt* evt)
+{
+	char buf[64];
+	const char* str;
+	uint32_t len;
+
+	if(w.m_json == JK_GENERIC)
+	{
+		Json::Value val = w.m_chk->tojson(evt);
+
+		if(val == Json::Value::null)
+		{
+			return false;
+		}
+
+		write_json_value(val);
+		return true;
+	}
+
+	//
+	// Some fields, like the timestamps, have a JSON rendering that is
+	// different from their text one
+	//
+	Json::Value val = w.m_chk->extract_as_js(evt, &len);
+
+	if(val != Json::Value::null)
+	{
+		write_json_value(val);
+		return true;
+	}
+
+	if(!render_field(w, evt, buf + sizeof(buf), &str, &len))
+	{
+		return false;
+	}
+
+	if(w.m_json == JK_BARE)
+	{
+		append(str, len);
+	}
+	else
+	{
+		append_json_string(str, len);
+	}
+
+	return true;
+}
+
+bool sinsp_evt_formatter::write_json(sinsp_evt* evt)
+{
+	uint32_t j;
+
+	if(m_require_all_values)
+	{
+		for(j = 0; j < m_json_shadowed.size(); j++)
+		{
+			if(m_tokens[m_json_shadowed[j]]->tojson(evt) == Json::Value::null)
+			{
+				return false;
+			}
+		}
+	}
+
+	if(m_first)
+	{
+		// Give it the opening stanza of a JSON array
+		append("[", 1);
+	}
+	else
+	{
+		// Otherwise say this is another object in an
+		// existing JSON array
+		append(",\n", 2);
+	}
+
+	if(m_json_fields.empty())
+	{
+		append("null", 4);
+	}
+	else
+	{
+		append("{", 1);
+
+		for(j = 0; j < m_json_fields.size(); j++)
+		{
+			if(j != 0)
+			{
+				append(",", 1);
+			}
+
+			append(m_json_fields[j].m_key.c_str(), (uint32_t)m_json_fields[j].m_key.size());
+
+			if(!write_json_field(m_writers[m_json_fields[j].m_token], evt))
+			{
+				if(m_require_all_values)
+				{
+					return false;
+				}
+
+				append("null", 4);
+			}
+		}
+
+		append("}", 1);
+	}
+
+	m_first = false;
+	return true;
+}
+
+//
+// Pointer to a byte that has already been written, wherever it ended up
+//
+char* sinsp_evt_formatter::get_out_ptr(uint32_t pos)
+{
+	return m_overflowing? &m_overflow[pos] : m_out + pos;
+}
+
+//
+// Write the value of a token of a binary record. Returns false if the field
+// has no value for the event.
+//
+bool sinsp_evt_formatter::write_binary_field(const token_writer& w, sinsp_evt* evt)
+{
+	const char* str;
+	uint32_t len = 0;
+
+	if(w.m_binary_size > 0 || w.m_binary_type == PT_BYTEBUF || w.m_type == WT_STRING)
+	{
+		uint8_t* rawval = w.m_chk->extract_cached(evt, &len);
+
+		if(rawval == NULL)
+		{
+			return false;
+		}
+
+		if(w.m_binary_size > 0)
+		{
+			append((const char*)rawval, w.m_binary_size);
+			return true;
+		}
+
+		str = (const char*)rawval;
+
+		if(w.m_type == WT_STRING)
+		{
+			len = (uint32_t)strlen(str);
+		}
+	}
+	else
+	{
+		str = w.m_chk->tostring(evt);
+
+		if(str == NULL)
+		{
+			return false;
+		}
+
+		len = (uint32_t)strlen(str);
+	}
+
+	append((const char*)&len, sizeof(len));
+	append(str, len);
+	return true;
+}
+
+bool sinsp_evt_formatter::write_binary(sinsp_evt* evt)
+{
+	static const char zeros[8] = {0};
+	uint32_t field = 0;
+	uint32_t j;
+
+	//
+	// The length and the bitmap of the fields that have a value are
+	// filled once the values have been written
+	//
+	append(zeros, sizeof(uint32_t));
+
+	for(j = 0; j < (m_nfields + 7) / 8; j++)
+	{
+		append(zeros, 1);
+	}
+
+	for(j = 0; j < m_writers.size(); j++)
+	{
+		if(m_writers[j].m_type == WT_TEXT)
+		{
+			continue;
+		}
+
+		if(write_binary_field(m_writers[j], evt))
+		{
+			*get_out_ptr(sizeof(uint32_t) + field / 8) |= (char)(1 << (field % 8));
+		}
+		else if(m_require_all_values)
+		{
+			return false;
+		}
+
+		field++;
+	}
+
+	uint32_t reclen = m_outlen - sizeof(uint32_t);
+	memcpy(get_out_ptr(0), &reclen, sizeof(reclen));
+	return true;
+}
+
+void sinsp_evt_formatter::get_binary_header(OUT string* res)
+{
+	uint32_t byte_order = SINSP_BINARY_RECORD_BYTE_ORDER;
+	uint16_t version = SINSP_BINARY_RECORD_VERSION;
+	uint16_t nfields = (uint16_t)m_nfields;
+	uint32_t hdrlen;
+
+	if(m_nfields > 0xffff)
+	{
+		throw sinsp_exception("too many fields for the binary output");
+	}
+
+	res->assign(SINSP_BINARY_RECORD_MAGIC, 4);
+	res->append((const char*)&byte_order, sizeof(byte_order));
+	res->append((const char*)&version, sizeof(version));
+	res->append((const char*)&nfields, sizeof(nfields));
+	res->append(sizeof(hdrlen), 0);
+
+	for(uint32_t j = 0; j < m_writers.size(); j++)
+	{
+		const token_writer& w = m_writers[j];
+
+		if(w.m_type == WT_TEXT)
+		{
+			continue;
+		}
+
+		uint16_t namelen = (uint16_t)w.m_field_name.size();
+
+		res->push_back((char)w.m_binary_type);
+		res->push_back((char)m_tokens[j]->get_field_info()->m_print_format);
+		res->append((const char*)&namelen, sizeof(namelen));
+		res->append(w.m_field_name);
+	}
+
+	hdrlen = (uint32_t)res->size();
+	memcpy(&(*res)[12], &hdrlen, sizeof(hdrlen));
 }
 
 bool sinsp_evt_formatter::on_capture_end(OUT string* res)
@@ -174,101 +985,159 @@ bool sinsp_evt_formatter::on_capture_end(OUT string* res)
 
 bool sinsp_evt_formatter::tostring(sinsp_evt* evt, OUT string* res)
 {
-	bool retval = true;
-	const filtercheck_field_info* fi;
+	uint32_t len;
+	char empty;
 
-	uint32_t j = 0;
-	vector<sinsp_filter_check*>::iterator it;
-	res->clear();
+	//
+	// With an empty buffer, the whole result ends up in m_overflow
+	//
+	bool retval = tostring(evt, &empty, 0, &len);
 
-	ASSERT(m_tokenlens.size() == m_tokens.size());
+	if(len == 0)
+	{
+		res->clear();
+	}
+	else
+	{
+		res->swap(m_overflow);
+		m_overflow_evt = NULL;
+	}
+
+	return retval;
+}
 
-	for(j = 0; j < m_tokens.size(); j++)
+void sinsp_evt_formatter::append(const char* str, uint32_t len)
+{
+	if(!m_overflowing)
 	{
-		if(m_inspector->get_buffer_format() == sinsp_evt::PF_JSON
-		   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONEOLS
-		   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONHEX
-		   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONHEXASCII
-		   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONBASE64)
+		if(m_outlen + len <= m_outsize)
 		{
-			Json::Value json_value = m_tokens[j]->tojson(evt);
+			memcpy(m_out + m_outlen, str, len);
+			m_outlen += len;
+			return;
+		}
 
-			if(retval == false)
-			{
-				continue;
-			}
+		m_overflow.assign(m_out, m_outlen);
+		m_overflowing = true;
+	}
 
-			if(json_value == Json::Value::null && m_require_all_values)
-			{
-				retval = false;
-				continue;
-			}
+	m_overflow.append(str, len);
+	m_outlen += len;
+}
 
-			fi = m_tokens[j]->get_field_info();
+//
+// Append exactly width characters, truncating or padding the string with
+// spaces
+//
+void sinsp_evt_formatter::append_padded(const char* str, uint32_t len, uint32_t width)
+{
+	static const char spaces[] = "                                                                ";
 
-			if(fi && fi->m_name) 
-			{
-				m_root[fi->m_name] = m_tokens[j]->tojson(evt);
-			} 
-		} 
-		else 
+	if(len > width)
+	{
+		len = width;
+	}
+
+	append(str, len);
+
+	for(len = width - len; len > 0;)
+	{
+		uint32_t chunk = min(len, (uint32_t)(sizeof(spaces) - 1));
+		append(spaces, chunk);
+		len -= chunk;
+	}
+}
+
+bool sinsp_evt_formatter::tostring(sinsp_evt* evt, OUT char* buf, uint32_t bufsize, OUT uint32_t* len)
+{
+	return render(evt, buf, bufsize, len, false);
+}
+
+bool sinsp_evt_formatter::tobinary(sinsp_evt* evt, OUT char* buf, uint32_t bufsize, OUT uint32_t* len)
+{
+	return render(evt, buf, bufsize, len, true);
+}
+
+bool sinsp_evt_formatter::render(sinsp_evt* evt, char* buf, uint32_t bufsize, OUT uint32_t* len, bool binary)
+{
+	bool retval = true;
+	uint32_t j = 0;
+
+	//
+	// The event didn't fit in the buffer of the previous call
+	//
+	if(m_overflow_evt != NULL)
+	{
+		if(evt == m_overflow_evt && evt->get_num() == m_overflow_evtnum &&
+			evt->get_ts() == m_overflow_ts && binary == m_overflow_binary)
 		{
-			char* str = m_tokens[j]->tostring(evt);
+			*len = (uint32_t)m_overflow.size();
 
-			if(retval == false)
+			if(*len <= bufsize)
 			{
-				continue;
+				memcpy(buf, m_overflow.c_str(), *len);
+				m_overflow_evt = NULL;
 			}
 
-			if(str == NULL) 
+			return m_overflow_res;
+		}
+
+		m_overflow_evt = NULL;
+	}
+
+	m_out = buf;
+	m_outsize = bufsize;
+	m_outlen = 0;
+	m_overflowing = false;
+
+	ASSERT(m_tokenlens.size() == m_tokens.size());
+
+	bool is_json = (m_inspector->get_buffer_format() == sinsp_evt::PF_JSON
+		|| m_inspector->get_buffer_format() == sinsp_evt::PF_JSONEOLS
+		|| m_inspector->get_buffer_format() == sinsp_evt::PF_JSONHEX
+		|| m_inspector->get_buffer_format() == sinsp_evt::PF_JSONHEXASCII
+		|| m_inspector->get_buffer_format() == sinsp_evt::PF_JSONBASE64);
+
+	if(binary)
+	{
+		retval = write_binary(evt);
+	}
+	else if(is_json)
+	{
+		retval = write_json(evt);
+	}
+	else
+	{
+		for(j = 0; j < m_tokens.size(); j++)
+		{
+			if(!write_field(m_writers[j], evt))
 			{
 				if(m_require_all_values)
 				{
 					retval = false;
-					continue;
+					break;
 				}
-				else 
+				else if(m_tokenlens[j] != 0)
 				{
-					str = (char*)"<NA>";
+					append_padded("<NA>", 4, m_tokenlens[j]);
+				}
+				else
+				{
+					append("<NA>", 4);
 				}
-			}
-
-			uint32_t tks = m_tokenlens[j];
-
-			if(tks != 0)
-			{
-				string sstr(str);
-				sstr.resize(tks, ' ');
-				(*res) += sstr;
-			}
-			else
-			{
-				(*res) += str;
 			}
 		}
 	}
 
-	if(m_inspector->get_buffer_format() == sinsp_evt::PF_JSON
-	   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONEOLS
-	   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONHEX
-	   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONHEXASCII
-	   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONBASE64)
-	{
-		if(m_first) 
-		{
-			// Give it the opening stanza of a JSON array
-			(*res) = '[';
-			m_first = false;
-		} 
-		else 
-		{
-			// Otherwise say this is another object in an
-			// existing JSON array
-			(*res) = ",\n";
-		}
+	*len = m_outlen;
 
-		(*res) += m_writer.write( m_root );
-		(*res) = res->substr(0, res->size() - 1);
+	if(m_overflowing)
+	{
+		m_overflow_evt = evt;
+		m_overflow_evtnum = evt->get_num();
+		m_overflow_ts = evt->get_ts();
+		m_overflow_res = retval;
+		m_overflow_binary = binary;
 	}
 
 	return retval;
@@ -290,4 +1159,21 @@ bool sinsp_evt_formatter::tostring(sinsp_evt* evt, OUT string* res)
 	throw sinsp_exception("sinsp_evt_formatter unvavailable because it was not compiled in the library");
 	return false;
 }
+
+bool sinsp_evt_formatter::tostring(sinsp_evt* evt, OUT char* buf, uint32_t bufsize, OUT uint32_t* len)
+{
+	throw sinsp_exception("sinsp_evt_formatter unvavailable because it was not compiled in the library");
+	return false;
+}
+
+void sinsp_evt_formatter::get_binary_header(OUT string* res)
+{
+	throw sinsp_exception("sinsp_evt_formatter unvavailable because it was not compiled in the library");
+}
+
+bool sinsp_evt_formatter::tobinary(sinsp_evt* evt, OUT char* buf, uint32_t bufsize, OUT uint32_t* len)
+{
+	throw sinsp_exception("sinsp_evt_formatter unvavailable because it was not compiled in the library");
+	return false;
+}
 #endif // HAS_FILTERING
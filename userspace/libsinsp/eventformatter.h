@@ -57,6 +57,23 @@ public:
 	*/
 	bool tostring(sinsp_evt* evt, OUT string* res);
 
+	/*!
+	  \brief Renders the event into a caller provided buffer.
+
+	  \param evt Pointer to the event to be converted into string.
+	  \param buf The buffer that will be filled with the result. The result
+	   is not NUL terminated.
+	  \param bufsize The size of buf.
+	  \param len Filled with the length of the result. If it's bigger than
+	   bufsize, the result didn't fit in buf. In that case, calling this
+	   function again for the same event with a big enough buffer returns
+	   the same result, without extracting the fields again.
+
+	  \return true if the string should be shown (based on the initial *),
+	   false otherwise.
+	*/
+	bool tostring(sinsp_evt* evt, OUT char* buf, uint32_t bufsize, OUT uint32_t* len);
+
 	/*!
 	  \brief Fills res with end of capture string rendering of the event.
 	  \param res Pointer to the string that will be filled with the result. 
@@ -66,18 +83,141 @@ public:
 	*/
 	bool on_capture_end(OUT string* res);
 
+	/*!
+	  \brief Fills res with the header of the binary output. The header
+	   describes the fields of the records written by tobinary(), and goes
+	   at the start of the stream. See binaryrecords.h for the layout.
+	*/
+	void get_binary_header(OUT string* res);
+
+	/*!
+	  \brief Renders the event as a binary record, with a typed value for
+	   each field of the format. The text between the fields is ignored.
+	   The buffer works like in tostring().
+
+	  \return true if the record should be written (based on the initial *),
+	   false otherwise.
+	*/
+	bool tobinary(sinsp_evt* evt, OUT char* buf, uint32_t bufsize, OUT uint32_t* len);
+
 private:
+	//
+	// How a token of the format is rendered in text mode. The writer is
+	// chosen when the format is parsed, based on the type and print format
+	// of the field, and writes the value straight into the output buffer.
+	//
+	enum writer_type
+	{
+		WT_TEXT,		// The constant text between the fields
+		WT_STRING,		// NUL terminated string
+		WT_BUFFER,		// Buffer, up to its first NUL
+		WT_UNSIGNED,	// Unsigned decimal integer of m_size bytes
+		WT_SIGNED,		// Signed decimal integer of m_size bytes
+		WT_UNSIGNED_9,	// 64 bit unsigned decimal, zero padded to 9 digits
+		WT_SIGNED_9,	// 64 bit signed decimal, zero padded to 9 digits
+		WT_HEX,			// 64 bit uppercase hexadecimal
+		WT_BOOL,
+		WT_IPV4,
+		WT_GENERIC,		// Anything else, through sinsp_filter_check::tostring()
+	};
+
+	//
+	// How a token is rendered in JSON mode: as a bare number or boolean, as
+	// a quoted string built from its text rendering, or through
+	// sinsp_filter_check::tojson()
+	//
+	enum json_kind
+	{
+		JK_BARE,
+		JK_STRING,
+		JK_GENERIC,
+	};
+
+	struct token_writer
+	{
+		writer_type m_type;
+		json_kind m_json;
+		uint32_t m_size;
+		//
+		// Fixed width of the field, or 0
+		//
+		uint32_t m_width;
+		sinsp_filter_check* m_chk;
+		//
+		// The constant text of a WT_TEXT token
+		//
+		string m_text;
+		//
+		// The name of the field as written in the format, empty for the
+		// constant text
+		//
+		string m_field_name;
+		//
+		// Type of the value in the binary records, and its size, as
+		// returned by binary_record_value_size()
+		//
+		ppm_param_type m_binary_type;
+		int32_t m_binary_size;
+	};
+
 	void set_format(const string& fmt);
+	void add_text(const string& text);
+	void add_field(sinsp_filter_check* chk, uint32_t toklen, const string& name);
+	void compile_json();
+	bool render(sinsp_evt* evt, char* buf, uint32_t bufsize, OUT uint32_t* len, bool binary);
+	bool render_field(const token_writer& w, sinsp_evt* evt, char* end, OUT const char** pstr, OUT uint32_t* plen);
+	bool write_field(const token_writer& w, sinsp_evt* evt);
+	bool write_json(sinsp_evt* evt);
+	bool write_json_field(const token_writer& w, sinsp_evt* evt);
+	void write_json_value(const Json::Value& val);
+	void append_json_string(const char* str, uint32_t len);
+	bool write_binary(sinsp_evt* evt);
+	bool write_binary_field(const token_writer& w, sinsp_evt* evt);
+	char* get_out_ptr(uint32_t pos);
+	void append(const char* str, uint32_t len);
+	void append_padded(const char* str, uint32_t len, uint32_t width);
 	vector<sinsp_filter_check*> m_tokens;
 	vector<uint32_t> m_tokenlens;
 	sinsp* m_inspector;
 	bool m_require_all_values;
 	vector<sinsp_filter_check*> m_chks_to_free;
+	vector<token_writer> m_writers;
+
+	//
+	// The JSON objects are written directly, with the same layout that
+	// Json::FastWriter would produce: one member per field name, sorted by
+	// name, with the value of the last token with that name. The other
+	// tokens with the same name are only checked for a value.
+	//
+	struct json_field
+	{
+		string m_key;
+		uint32_t m_token;
+	};
+
+	vector<json_field> m_json_fields;
+	vector<uint32_t> m_json_shadowed;
+
+	uint32_t m_nfields;
 
 	// Is this the first to_string call?
 	bool m_first;
-	Json::Value m_root;
 	Json::FastWriter m_writer;
+
+	//
+	// Output buffer of the rendering in progress. When the result doesn't
+	// fit in it, it's moved to m_overflow, and kept there for the next call.
+	//
+	char* m_out;
+	uint32_t m_outsize;
+	uint32_t m_outlen;
+	bool m_overflowing;
+	string m_overflow;
+	sinsp_evt* m_overflow_evt;
+	uint64_t m_overflow_evtnum;
+	uint64_t m_overflow_ts;
+	bool m_overflow_res;
+	bool m_overflow_binary;
 };
 
 /*@}*/
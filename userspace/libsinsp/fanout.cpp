@@ -0,0 +1,1642 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+
+#if defined(HAS_CAPTURE)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Shared memory layout
+//
+// The mapping starts with a page aligned header, followed by the data area,
+// whose size is a power of two. Positions in the data area grow forever, and
+// are taken modulo its size.
+//
+// The publisher moves m_reserve_pos forward before writing a frame, and
+// m_commit_pos after it has written it. A subscriber copies a frame out of
+// the ring and then checks that m_reserve_pos didn't get more than a ring
+// ahead of the frame in the meantime, in which case the copy can be garbage
+// and the subscriber has been overrun.
+//
+// Every frame starts with a fanout_frame and is aligned to 8 bytes. Frames
+// don't wrap: when the space left at the end of the data area is too small,
+// the publisher writes a FANOUT_FRAME_WRAP marker there and continues at the
+// beginning.
+///////////////////////////////////////////////////////////////////////////////
+#define FANOUT_MAGIC "SDFANOUT"
+#define FANOUT_VERSION 1
+#define FANOUT_MIN_RING_SIZE (1024 * 1024)
+#define FANOUT_FRAME_WRAP 0xffffffff
+#define FANOUT_ATTACH_RETRIES 1000
+#define FANOUT_ALIGN(x) (((x) + 7) & ~((uint64_t)7))
+
+enum fanout_ring_state
+{
+	FANOUT_STATE_RUNNING = 0,
+	FANOUT_STATE_CLOSED = 1,
+};
+
+enum fanout_slot_state
+{
+	FANOUT_SLOT_FREE = 0,
+	FANOUT_SLOT_CLAIMED = 1,
+	FANOUT_SLOT_ACTIVE = 2,
+};
+
+//
+// One per subscriber. m_read_pos and the counters are written by the
+// subscriber, m_n_overruns and m_slow by the publisher.
+//
+struct alignas(64) fanout_slot
+{
+	std::atomic<uint32_t> m_state;
+	int32_t m_pid;
+	std::atomic<uint64_t> m_read_pos;
+	std::atomic<uint64_t> m_n_evts;
+	std::atomic<uint64_t> m_n_drops;
+	std::atomic<uint64_t> m_n_overruns;
+	std::atomic<uint32_t> m_slow;
+};
+
+struct fanout_ring_header
+{
+	char m_magic[8];
+	uint32_t m_version;
+	uint32_t m_max_subscribers;
+	uint64_t m_header_size;
+	uint64_t m_data_size;
+	int64_t m_publisher_pid;
+	std::atomic<uint32_t> m_state;
+	//
+	// Bumped by the subscribers when they need the thread state to be sent
+	// again, i.e. when they attach or lose events. m_resync_done is the last
+	// value the publisher has seen.
+	//
+	std::atomic<uint32_t> m_resync;
+	std::atomic<uint32_t> m_resync_done;
+	alignas(64) std::atomic<uint64_t> m_reserve_pos;
+	std::atomic<uint64_t> m_commit_pos;
+	fanout_slot m_slots[FANOUT_MAX_SUBSCRIBERS];
+};
+
+struct fanout_frame
+{
+	uint32_t m_len; // Of the payload, or FANOUT_FRAME_WRAP
+	uint16_t m_type; // A fanout_record_type
+	uint16_t m_reserved;
+	uint64_t m_seq; // Sequence number of the event, or of the next event
+};
+
+enum fanout_record_type
+{
+	//
+	// A fanout_thread_record, followed by comm, exe, cwd, container ID, the
+	// arguments, the environment and the cgroups. The last three are lists
+	// of NUL terminated strings, the cgroups are rendered as subsys=cgroup.
+	//
+	FANOUT_RECORD_THREAD = 1,
+	//
+	// A fanout_thread_stats_record
+	//
+	FANOUT_RECORD_THREAD_STATS = 2,
+	//
+	// A fanout_event_record, followed by a fanout_fd_record and the fd name
+	// if FANOUT_EVT_FD is set, and by the scap event
+	//
+	FANOUT_RECORD_EVENT = 3,
+};
+
+struct fanout_thread_record
+{
+	int64_t m_tid;
+	int64_t m_pid;
+	int64_t m_ptid;
+	int64_t m_vtid;
+	int64_t m_vpid;
+	int64_t m_fdlimit;
+	uint64_t m_clone_ts;
+	uint32_t m_uid;
+	uint32_t m_gid;
+	uint32_t m_flags;
+	uint32_t m_comm_len;
+	uint32_t m_exe_len;
+	uint32_t m_cwd_len;
+	uint32_t m_container_id_len;
+	uint32_t m_args_len;
+	uint32_t m_env_len;
+	uint32_t m_cgroups_len;
+};
+
+struct fanout_thread_stats_record
+{
+	int64_t m_tid;
+	uint64_t m_pfmajor;
+	uint64_t m_pfminor;
+	uint32_t m_vmsize_kb;
+	uint32_t m_vmrss_kb;
+	uint32_t m_vmswap_kb;
+	uint32_t m_reserved;
+};
+
+enum fanout_event_flags
+{
+	FANOUT_EVT_THREAD = 1, // The publisher knew the thread of the event
+	FANOUT_EVT_FD = 2, // A fanout_fd_record follows
+	FANOUT_EVT_FDINFO = 4, // The event has an fdinfo, either fd m_fdnum or the attached one
+	FANOUT_EVT_NO_FD = 8, // Fd m_fdnum doesn't exist anymore
+};
+
+struct fanout_event_record
+{
+	uint64_t m_evtnum;
+	uint64_t m_latency;
+	int64_t m_lastevent_fd;
+	int64_t m_fdnum; // Number of the fd of the event in the thread's table, or -1
+	uint32_t m_iosize;
+	int32_t m_errorcode;
+	uint16_t m_cpuid;
+	uint16_t m_flags;
+	uint32_t m_evtlen;
+	//
+	// Value of m_resync_done when the event was published. The events
+	// published before a subscriber's resync request refer to state that
+	// the subscriber may not have.
+	//
+	uint32_t m_resync_gen;
+};
+
+struct fanout_fd_record
+{
+	uint64_t m_ino;
+	uint32_t m_type;
+	uint32_t m_openflags;
+	uint32_t m_flags;
+	uint32_t m_name_len;
+	sinsp_sockinfo m_sockinfo;
+};
+
+static inline uint64_t fanout_hash(uint64_t h, uint64_t v)
+{
+	return h ^ (v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
+}
+
+static uint32_t strvec_len(const vector<string>& strs)
+{
+	uint32_t res = 0;
+
+	for(auto it = strs.begin(); it != strs.end(); ++it)
+	{
+		res += (uint32_t)it->size() + 1;
+	}
+
+	return res;
+}
+
+static char* copy_strvec(char* p, const vector<string>& strs)
+{
+	for(auto it = strs.begin(); it != strs.end(); ++it)
+	{
+		memcpy(p, it->c_str(), it->size() + 1);
+		p += it->size() + 1;
+	}
+
+	return p;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_fanout_ring implementation
+///////////////////////////////////////////////////////////////////////////////
+sinsp_fanout_ring::sinsp_fanout_ring()
+{
+	m_hdr = NULL;
+	m_data = NULL;
+	m_data_size = 0;
+	m_mask = 0;
+	m_map_size = 0;
+	m_owner = false;
+}
+
+sinsp_fanout_ring::~sinsp_fanout_ring()
+{
+	unmap();
+}
+
+string sinsp_fanout_ring::get_shm_name(const string& name)
+{
+	if(name.empty() || name.size() > 200 || name.find('/') != string::npos)
+	{
+		throw sinsp_exception("invalid publisher name '" + name + "'");
+	}
+
+	return "/sysdig-fanout-" + name;
+}
+
+bool sinsp_fanout_ring::is_process_alive(int64_t pid)
+{
+	return kill((pid_t)pid, 0) == 0 || errno != ESRCH;
+}
+
+void sinsp_fanout_ring::create(const string& name, uint64_t data_size)
+{
+	m_shm_name = get_shm_name(name);
+
+	uint64_t header_size = (sizeof(fanout_ring_header) + 4095) & ~((uint64_t)4095);
+	int fd = shm_open(m_shm_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+
+	if(fd < 0 && errno == EEXIST)
+	{
+		//
+		// Either somebody is publishing with this name, or a publisher died
+		// without removing its ring
+		//
+		bool stale = true;
+		int ofd = shm_open(m_shm_name.c_str(), O_RDONLY, 0);
+
+		if(ofd >= 0)
+		{
+			struct stat st;
+
+			if(fstat(ofd, &st) == 0 && (uint64_t)st.st_size >= sizeof(fanout_ring_header))
+			{
+				void* addr = mmap(NULL, sizeof(fanout_ring_header), PROT_READ, MAP_SHARED, ofd, 0);
+
+				if(addr != MAP_FAILED)
+				{
+					fanout_ring_header* hdr = (fanout_ring_header*)addr;
+
+					if(memcmp(hdr->m_magic, FANOUT_MAGIC, sizeof(hdr->m_magic)) == 0 &&
+						hdr->m_state.load() == FANOUT_STATE_RUNNING &&
+						is_process_alive(hdr->m_publisher_pid))
+					{
+						stale = false;
+					}
+
+					munmap(addr, sizeof(fanout_ring_header));
+				}
+			}
+
+			::close(ofd);
+		}
+
+		if(!stale)
+		{
+			throw sinsp_exception("another process is already publishing its events as '" + name + "'");
+		}
+
+		shm_unlink(m_shm_name.c_str());
+		fd = shm_open(m_shm_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+	}
+
+	if(fd < 0)
+	{
+		throw sinsp_exception("can't create the shared memory for '" + name + "': " + strerror(errno));
+	}
+
+	m_map_size = header_size + data_size;
+
+	if(ftruncate(fd, m_map_size) != 0)
+	{
+		string err = strerror(errno);
+		::close(fd);
+		shm_unlink(m_shm_name.c_str());
+		throw sinsp_exception("can't size the shared memory for '" + name + "': " + err);
+	}
+
+	//
+	// Fault the ring in now rather than while publishing
+	//
+	void* addr = mmap(NULL, m_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+	::close(fd);
+
+	if(addr == MAP_FAILED)
+	{
+		string err = strerror(errno);
+		shm_unlink(m_shm_name.c_str());
+		throw sinsp_exception("can't map the shared memory for '" + name + "': " + err);
+	}
+
+	m_owner = true;
+	m_hdr = new(addr) fanout_ring_header;
+	m_data = (char*)addr + header_size;
+	m_data_size = data_size;
+	m_mask = data_size - 1;
+
+	m_hdr->m_version = FANOUT_VERSION;
+	m_hdr->m_max_subscribers = FANOUT_MAX_SUBSCRIBERS;
+	m_hdr->m_header_size = header_size;
+	m_hdr->m_data_size = data_size;
+	m_hdr->m_publisher_pid = getpid();
+	m_hdr->m_state.store(FANOUT_STATE_RUNNING);
+	m_hdr->m_resync.store(0);
+	m_hdr->m_resync_done.store(0);
+	m_hdr->m_reserve_pos.store(0);
+	m_hdr->m_commit_pos.store(0);
+
+	for(uint32_t j = 0; j < FANOUT_MAX_SUBSCRIBERS; j++)
+	{
+		m_hdr->m_slots[j].m_state.store(FANOUT_SLOT_FREE);
+	}
+
+	//
+	// The magic goes last, so the subscribers never see a half initialized
+	// header
+	//
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy(m_hdr->m_magic, FANOUT_MAGIC, sizeof(m_hdr->m_magic));
+}
+
+void sinsp_fanout_ring::attach(const string& name)
+{
+	m_shm_name = get_shm_name(name);
+
+	//
+	// The publisher creates the shared memory before sizing it and filling
+	// the header, so give it some time if it's just starting
+	//
+	for(uint32_t j = 0; ; j++)
+	{
+		int fd = shm_open(m_shm_name.c_str(), O_RDWR, 0);
+
+		if(fd < 0)
+		{
+			if(errno == ENOENT)
+			{
+				throw sinsp_exception("no process is publishing its events as '" + name + "'");
+			}
+
+			throw sinsp_exception("can't open the shared memory for '" + name + "': " + strerror(errno));
+		}
+
+		struct stat st;
+
+		if(fstat(fd, &st) != 0)
+		{
+			string err = strerror(errno);
+			::close(fd);
+			throw sinsp_exception("can't open the shared memory for '" + name + "': " + err);
+		}
+
+		if((uint64_t)st.st_size >= sizeof(fanout_ring_header))
+		{
+			m_map_size = st.st_size;
+			void* addr = mmap(NULL, m_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			::close(fd);
+
+			if(addr == MAP_FAILED)
+			{
+				throw sinsp_exception("can't map the shared memory for '" + name + "': " + strerror(errno));
+			}
+
+			m_hdr = (fanout_ring_header*)addr;
+
+			if(memcmp(m_hdr->m_magic, FANOUT_MAGIC, sizeof(m_hdr->m_magic)) == 0)
+			{
+				break;
+			}
+
+			unmap();
+		}
+		else
+		{
+			::close(fd);
+		}
+
+		if(j >= FANOUT_ATTACH_RETRIES)
+		{
+			throw sinsp_exception("'" + name + "' is not a valid event publisher");
+		}
+
+		usleep(FANOUT_POLL_INTERVAL_US);
+	}
+
+	if(m_hdr->m_version != FANOUT_VERSION ||
+		m_hdr->m_max_subscribers != FANOUT_MAX_SUBSCRIBERS ||
+		m_hdr->m_header_size + m_hdr->m_data_size != m_map_size)
+	{
+		unmap();
+		throw sinsp_exception("'" + name + "' is not a valid event publisher, or it has a different version");
+	}
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+	m_data = (char*)m_hdr + m_hdr->m_header_size;
+	m_data_size = m_hdr->m_data_size;
+	m_mask = m_data_size - 1;
+}
+
+void sinsp_fanout_ring::unmap()
+{
+	if(m_hdr != NULL)
+	{
+		munmap(m_hdr, m_map_size);
+		m_hdr = NULL;
+		m_data = NULL;
+
+		if(m_owner)
+		{
+			shm_unlink(m_shm_name.c_str());
+			m_owner = false;
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_fanout_publisher implementation
+///////////////////////////////////////////////////////////////////////////////
+sinsp_fanout_publisher::sinsp_fanout_publisher(sinsp* inspector, const string& name, uint64_t ring_size, uint32_t wait_subscribers)
+{
+	uint64_t data_size = FANOUT_MIN_RING_SIZE;
+
+	while(data_size < ring_size)
+	{
+		data_size *= 2;
+	}
+
+	m_inspector = inspector;
+	m_wait_subscribers = wait_subscribers;
+	m_waited = (wait_subscribers == 0);
+	m_pos = 0;
+	m_end = 0;
+	m_limit = 0;
+	m_nactive = 0;
+	m_n_published = 0;
+	m_n_since_check = 0;
+	m_resync_gen = 0;
+	m_next_epoch = 0;
+	memset(m_lapped, 0, sizeof(m_lapped));
+
+	fd_cache_entry empty;
+	empty.m_tid = -1;
+	empty.m_fd = -1;
+	empty.m_epoch = 0;
+	empty.m_hash = 0;
+	m_fd_cache.assign(FANOUT_FD_CACHE_SIZE, empty);
+
+	create(name, data_size);
+	m_limit = m_data_size;
+}
+
+sinsp_fanout_publisher::~sinsp_fanout_publisher()
+{
+	if(m_hdr != NULL)
+	{
+		m_hdr->m_state.store(FANOUT_STATE_CLOSED, std::memory_order_release);
+	}
+}
+
+void sinsp_fanout_publisher::publish(sinsp_evt* evt)
+{
+	check_resync();
+
+	if(++m_n_since_check >= FANOUT_CHECK_INTERVAL)
+	{
+		m_n_since_check = 0;
+		scan_subscribers(true);
+	}
+
+	//
+	// Nobody is listening. A new subscriber asks for a resync, so the
+	// thread state will be sent from scratch.
+	//
+	if(m_nactive == 0)
+	{
+		return;
+	}
+
+	//
+	// Threads that go away without a procexit are never erased from the
+	// table, so it's rebuilt from time to time
+	//
+	if(m_published.size() > m_inspector->m_max_thread_table_size)
+	{
+		m_published.clear();
+	}
+
+	fanout_event_record rec;
+	sinsp_threadinfo* tinfo = evt->m_tinfo;
+	thread_state* ts = NULL;
+	sinsp_fdinfo_t* fdinfo = NULL;
+	fd_cache_entry* fdce = NULL;
+	uint64_t fdhash = 0;
+	bool send_fd = false;
+
+	rec.m_evtnum = evt->m_evtnum;
+	rec.m_iosize = evt->m_iosize;
+	rec.m_errorcode = evt->m_errorcode;
+	rec.m_cpuid = evt->m_cpuid;
+	rec.m_flags = 0;
+	rec.m_resync_gen = m_resync_gen;
+	rec.m_evtlen = evt->m_pevt->len;
+	rec.m_fdnum = -1;
+
+	if(tinfo != NULL)
+	{
+		ts = publish_thread(tinfo, 0);
+		rec.m_flags |= FANOUT_EVT_THREAD;
+		rec.m_latency = tinfo->m_latency;
+		rec.m_lastevent_fd = tinfo->m_lastevent_fd;
+	}
+	else
+	{
+		rec.m_latency = 0;
+		rec.m_lastevent_fd = -1;
+	}
+
+	//
+	// The fd fields use the event's fdinfo or, if there's none, the fd in
+	// m_lastevent_fd. The subscriber gets the latter in its fd tables, and
+	// the table below avoids sending it with every event.
+	//
+	if(tinfo != NULL && (evt->get_flags() & (EF_CREATES_FD | EF_USES_FD | EF_DESTROYS_FD)))
+	{
+		int64_t fd = tinfo->m_lastevent_fd;
+		int64_t owner = (tinfo->m_flags & PPM_CL_CLONE_FILES)? tinfo->m_pid : tinfo->m_tid;
+		uint64_t epoch = 0;
+
+		if(fd != -1)
+		{
+			fdinfo = tinfo->get_fd(fd);
+			fdce = &m_fd_cache[fanout_hash(owner, fd) & (FANOUT_FD_CACHE_SIZE - 1)];
+		}
+
+		if(evt->m_fdinfo != NULL)
+		{
+			rec.m_flags |= FANOUT_EVT_FDINFO;
+
+			if(evt->m_fdinfo != fdinfo)
+			{
+				//
+				// Not in the table, so it's sent with the event
+				//
+				fdinfo = evt->m_fdinfo;
+				fd = -1;
+				fdce = NULL;
+			}
+		}
+
+		if(owner == tinfo->m_tid)
+		{
+			epoch = ts->m_epoch;
+		}
+		else
+		{
+			unordered_map<int64_t, thread_state>::iterator it = m_published.find(owner);
+
+			if(it != m_published.end())
+			{
+				epoch = it->second.m_epoch;
+			}
+		}
+
+		if(fdinfo == NULL)
+		{
+			if(fd != -1)
+			{
+				rec.m_flags |= FANOUT_EVT_NO_FD;
+				fdce->m_tid = -1;
+			}
+		}
+		else if(fdce == NULL || epoch == 0)
+		{
+			send_fd = true;
+		}
+		else
+		{
+			uint64_t sockinfo[(sizeof(sinsp_sockinfo) + 7) / 8] = {0};
+			memcpy(sockinfo, &fdinfo->m_sockinfo, sizeof(sinsp_sockinfo));
+
+			fdhash = fanout_hash(fdinfo->m_type, fdinfo->m_openflags);
+			fdhash = fanout_hash(fdhash, fdinfo->m_flags);
+			fdhash = fanout_hash(fdhash, fdinfo->m_ino);
+			fdhash = fanout_hash(fdhash, (uint64_t)fdinfo->m_name.c_str());
+
+			for(uint32_t j = 0; j < sizeof(sockinfo) / 8; j++)
+			{
+				fdhash = fanout_hash(fdhash, sockinfo[j]);
+			}
+
+			send_fd = (fdce->m_tid != owner || fdce->m_fd != fd ||
+				fdce->m_epoch != epoch || fdce->m_hash != fdhash);
+
+			if(send_fd)
+			{
+				fdce->m_tid = owner;
+				fdce->m_fd = fd;
+				fdce->m_epoch = epoch;
+				fdce->m_hash = fdhash;
+			}
+		}
+
+		rec.m_fdnum = fd;
+	}
+
+	uint32_t namelen = 0;
+	uint32_t len = sizeof(rec) + rec.m_evtlen;
+
+	if(send_fd)
+	{
+		rec.m_flags |= FANOUT_EVT_FD;
+		namelen = (uint32_t)fdinfo->m_name.size();
+		len += sizeof(fanout_fd_record) + namelen;
+	}
+
+	char* p = reserve(FANOUT_RECORD_EVENT, len);
+
+	if(p == NULL)
+	{
+		if(fdce != NULL)
+		{
+			fdce->m_tid = -1;
+		}
+
+		return;
+	}
+
+	memcpy(p, &rec, sizeof(rec));
+	p += sizeof(rec);
+
+	if(send_fd)
+	{
+		fanout_fd_record fdrec;
+
+		fdrec.m_ino = fdinfo->m_ino;
+		fdrec.m_type = fdinfo->m_type;
+		fdrec.m_openflags = fdinfo->m_openflags;
+		fdrec.m_flags = fdinfo->m_flags;
+		fdrec.m_name_len = namelen;
+		fdrec.m_sockinfo = fdinfo->m_sockinfo;
+
+		memcpy(p, &fdrec, sizeof(fdrec));
+		p += sizeof(fdrec);
+		memcpy(p, fdinfo->m_name.c_str(), namelen);
+		p += namelen;
+	}
+
+	memcpy(p, evt->m_pevt, rec.m_evtlen);
+	commit();
+
+	m_n_published++;
+
+	//
+	// The tid can come back as a different process
+	//
+	uint16_t etype = evt->get_type();
+
+	if(tinfo != NULL && (etype == PPME_PROCEXIT_E || etype == PPME_PROCEXIT_1_E))
+	{
+		m_published.erase(tinfo->m_tid);
+	}
+}
+
+sinsp_fanout_publisher::thread_state* sinsp_fanout_publisher::publish_thread(sinsp_threadinfo* tinfo, uint32_t depth)
+{
+	std::hash<string> hasher;
+
+	uint64_t hash = fanout_hash(tinfo->m_pid, tinfo->m_ptid);
+	hash = fanout_hash(hash, tinfo->m_vtid);
+	hash = fanout_hash(hash, tinfo->m_vpid);
+	hash = fanout_hash(hash, tinfo->m_uid);
+	hash = fanout_hash(hash, tinfo->m_gid);
+	hash = fanout_hash(hash, tinfo->m_flags);
+	hash = fanout_hash(hash, tinfo->m_fdlimit);
+	hash = fanout_hash(hash, tinfo->m_clone_ts);
+	hash = fanout_hash(hash, hasher(tinfo->m_comm));
+	hash = fanout_hash(hash, hasher(tinfo->m_exe));
+	hash = fanout_hash(hash, hasher(tinfo->m_cwd));
+	hash = fanout_hash(hash, hasher(tinfo->m_container_id));
+	//
+	// The argument, environment and cgroup lists are interned, so the
+	// pointers change when the content does
+	//
+	hash = fanout_hash(hash, (uint64_t)tinfo->m_args.get());
+	hash = fanout_hash(hash, (uint64_t)tinfo->m_env.get());
+	hash = fanout_hash(hash, (uint64_t)tinfo->m_cgroups.get());
+
+	uint64_t stats_hash = fanout_hash(tinfo->m_vmsize_kb, tinfo->m_vmrss_kb);
+	stats_hash = fanout_hash(stats_hash, tinfo->m_vmswap_kb);
+	stats_hash = fanout_hash(stats_hash, tinfo->m_pfmajor);
+	stats_hash = fanout_hash(stats_hash, tinfo->m_pfminor);
+
+	thread_state newts;
+	newts.m_hash = 0;
+	newts.m_stats_hash = 0;
+	newts.m_epoch = 0;
+
+	pair<unordered_map<int64_t, thread_state>::iterator, bool> res =
+		m_published.insert(make_pair(tinfo->m_tid, newts));
+	thread_state* ts = &res.first->second;
+
+	if(!res.second && ts->m_hash == hash && ts->m_epoch != 0)
+	{
+		if(ts->m_stats_hash != stats_hash)
+		{
+			ts->m_stats_hash = stats_hash;
+			write_thread_stats(tinfo);
+		}
+
+		return ts;
+	}
+
+	//
+	// Set the state before following the parents, so loops in the tree
+	// stop here. The element pointers stay valid when the table grows.
+	//
+	ts->m_hash = hash;
+	ts->m_stats_hash = stats_hash;
+	ts->m_epoch = ++m_next_epoch;
+
+	if(depth < MAX_ANCESTOR_CHAIN_LEN)
+	{
+		if(!tinfo->is_main_thread())
+		{
+			sinsp_threadinfo* mtinfo = tinfo->get_main_thread();
+
+			if(mtinfo != NULL && mtinfo != tinfo)
+			{
+				publish_thread(mtinfo, depth + 1);
+			}
+		}
+
+		sinsp_threadinfo* ptinfo = m_inspector->get_thread(tinfo->m_ptid, false, true);
+
+		if(ptinfo != NULL && ptinfo != tinfo)
+		{
+			publish_thread(ptinfo, depth + 1);
+		}
+	}
+
+	write_thread(tinfo);
+	write_thread_stats(tinfo);
+	return ts;
+}
+
+void sinsp_fanout_publisher::write_thread(sinsp_threadinfo* tinfo)
+{
+	fanout_thread_record rec;
+	const vector<string>& args = tinfo->get_args();
+	const vector<string>& env = tinfo->get_env();
+	const vector<pair<string, string>>& cgroups = tinfo->get_cgroups();
+
+	rec.m_tid = tinfo->m_tid;
+	rec.m_pid = tinfo->m_pid;
+	rec.m_ptid = tinfo->m_ptid;
+	rec.m_vtid = tinfo->m_vtid;
+	rec.m_vpid = tinfo->m_vpid;
+	rec.m_fdlimit = tinfo->m_fdlimit;
+	rec.m_clone_ts = tinfo->m_clone_ts;
+	rec.m_uid = tinfo->m_uid;
+	rec.m_gid = tinfo->m_gid;
+	rec.m_flags = tinfo->m_flags;
+	rec.m_comm_len = (uint32_t)tinfo->m_comm.size();
+	rec.m_exe_len = (uint32_t)tinfo->m_exe.size();
+	rec.m_cwd_len = (uint32_t)tinfo->m_cwd.size();
+	rec.m_container_id_len = (uint32_t)tinfo->m_container_id.size();
+	rec.m_args_len = strvec_len(args);
+	rec.m_env_len = strvec_len(env);
+	rec.m_cgroups_len = 0;
+
+	for(auto it = cgroups.begin(); it != cgroups.end(); ++it)
+	{
+		rec.m_cgroups_len += (uint32_t)(it->first.size() + it->second.size()) + 2;
+	}
+
+	uint32_t len = sizeof(rec) + rec.m_comm_len + rec.m_exe_len + rec.m_cwd_len +
+		rec.m_container_id_len + rec.m_args_len + rec.m_env_len + rec.m_cgroups_len;
+
+	char* p = reserve(FANOUT_RECORD_THREAD, len);
+
+	if(p == NULL)
+	{
+		return;
+	}
+
+	memcpy(p, &rec, sizeof(rec));
+	p += sizeof(rec);
+	memcpy(p, tinfo->m_comm.c_str(), rec.m_comm_len);
+	p += rec.m_comm_len;
+	memcpy(p, tinfo->m_exe.c_str(), rec.m_exe_len);
+	p += rec.m_exe_len;
+	memcpy(p, tinfo->m_cwd.c_str(), rec.m_cwd_len);
+	p += rec.m_cwd_len;
+	memcpy(p, tinfo->m_container_id.c_str(), rec.m_container_id_len);
+	p += rec.m_container_id_len;
+	p = copy_strvec(p, args);
+	p = copy_strvec(p, env);
+
+	for(auto it = cgroups.begin(); it != cgroups.end(); ++it)
+	{
+		memcpy(p, it->first.c_str(), it->first.size());
+		p += it->first.size();
+		*p++ = '=';
+		memcpy(p, it->second.c_str(), it->second.size() + 1);
+		p += it->second.size() + 1;
+	}
+
+	commit();
+}
+
+void sinsp_fanout_publisher::write_thread_stats(sinsp_threadinfo* tinfo)
+{
+	fanout_thread_stats_record rec;
+
+	rec.m_tid = tinfo->m_tid;
+	rec.m_pfmajor = tinfo->m_pfmajor;
+	rec.m_pfminor = tinfo->m_pfminor;
+	rec.m_vmsize_kb = tinfo->m_vmsize_kb;
+	rec.m_vmrss_kb = tinfo->m_vmrss_kb;
+	rec.m_vmswap_kb = tinfo->m_vmswap_kb;
+	rec.m_reserved = 0;
+
+	char* p = reserve(FANOUT_RECORD_THREAD_STATS, sizeof(rec));
+
+	if(p != NULL)
+	{
+		memcpy(p, &rec, sizeof(rec));
+		commit();
+	}
+}
+
+char* sinsp_fanout_publisher::reserve(uint16_t type, uint32_t len)
+{
+	uint64_t total = FANOUT_ALIGN(sizeof(fanout_frame) + (uint64_t)len);
+
+	if(total > m_data_size / 2)
+	{
+		ASSERT(false);
+		return NULL;
+	}
+
+	uint64_t start = m_pos;
+	uint64_t off = start & m_mask;
+
+	if(off + total > m_data_size)
+	{
+		start += m_data_size - off;
+	}
+
+	uint64_t end = start + total;
+
+	if(end > m_limit)
+	{
+		make_room(end);
+	}
+
+	//
+	// Announce the overwrite before doing it. The subscribers check
+	// m_reserve_pos after copying a frame.
+	//
+	m_hdr->m_reserve_pos.store(end, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	if(start != m_pos)
+	{
+		uint32_t wrap = FANOUT_FRAME_WRAP;
+		memcpy(m_data + off, &wrap, sizeof(wrap));
+	}
+
+	fanout_frame frame;
+	frame.m_len = len;
+	frame.m_type = type;
+	frame.m_reserved = 0;
+	frame.m_seq = m_n_published;
+
+	char* p = m_data + (start & m_mask);
+	memcpy(p, &frame, sizeof(frame));
+
+	m_end = end;
+	return p + sizeof(frame);
+}
+
+void sinsp_fanout_publisher::commit()
+{
+	m_pos = m_end;
+	m_hdr->m_commit_pos.store(m_pos, std::memory_order_release);
+}
+
+void sinsp_fanout_publisher::make_room(uint64_t end)
+{
+	while(true)
+	{
+		scan_subscribers(m_wait_subscribers != 0);
+
+		if(end <= m_limit)
+		{
+			return;
+		}
+
+		if(m_wait_subscribers != 0)
+		{
+			usleep(FANOUT_POLL_INTERVAL_US);
+			continue;
+		}
+
+		//
+		// Overrun the subscribers that are too far behind. They notice on
+		// their own, and jump to the most recent data.
+		//
+		for(uint32_t j = 0; j < FANOUT_MAX_SUBSCRIBERS; j++)
+		{
+			fanout_slot* slot = &m_hdr->m_slots[j];
+
+			if(m_lapped[j] || slot->m_state.load(std::memory_order_acquire) != FANOUT_SLOT_ACTIVE)
+			{
+				continue;
+			}
+
+			if(slot->m_read_pos.load(std::memory_order_acquire) + m_data_size < end)
+			{
+				m_lapped[j] = true;
+				slot->m_n_overruns.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+
+		scan_subscribers(false);
+		return;
+	}
+}
+
+void sinsp_fanout_publisher::scan_subscribers(bool check_alive)
+{
+	uint64_t min_pos = 0xffffffffffffffffULL;
+
+	m_nactive = 0;
+
+	for(uint32_t j = 0; j < FANOUT_MAX_SUBSCRIBERS; j++)
+	{
+		fanout_slot* slot = &m_hdr->m_slots[j];
+
+		if(slot->m_state.load(std::memory_order_acquire) != FANOUT_SLOT_ACTIVE)
+		{
+			m_lapped[j] = false;
+			continue;
+		}
+
+		if(check_alive && !is_process_alive(slot->m_pid))
+		{
+			slot->m_state.store(FANOUT_SLOT_FREE, std::memory_order_release);
+			m_lapped[j] = false;
+			continue;
+		}
+
+		m_nactive++;
+
+		uint64_t read_pos = slot->m_read_pos.load(std::memory_order_acquire);
+		uint64_t lag = (m_pos > read_pos)? m_pos - read_pos : 0;
+
+		slot->m_slow.store(lag > m_data_size / 2, std::memory_order_relaxed);
+
+		if(m_lapped[j])
+		{
+			if(lag > m_data_size)
+			{
+				continue;
+			}
+
+			m_lapped[j] = false;
+		}
+
+		if(read_pos < min_pos)
+		{
+			min_pos = read_pos;
+		}
+	}
+
+	if(min_pos == 0xffffffffffffffffULL)
+	{
+		m_limit = min_pos;
+	}
+	else
+	{
+		m_limit = min_pos + m_data_size;
+	}
+}
+
+void sinsp_fanout_publisher::check_resync()
+{
+	uint32_t resync = m_hdr->m_resync.load(std::memory_order_acquire);
+
+	if(resync != m_resync_gen)
+	{
+		m_resync_gen = resync;
+		m_published.clear();
+		scan_subscribers(false);
+		m_hdr->m_resync_done.store(resync, std::memory_order_release);
+	}
+}
+
+bool sinsp_fanout_publisher::is_ready()
+{
+	if(m_wait_subscribers == 0)
+	{
+		return true;
+	}
+
+	if(!m_waited)
+	{
+		scan_subscribers(true);
+
+		if(m_nactive < m_wait_subscribers)
+		{
+			usleep(FANOUT_POLL_INTERVAL_US);
+			return false;
+		}
+
+		m_waited = true;
+	}
+
+	//
+	// Keep half of the ring free for the next event and its state, so
+	// that make_room() practically never has to block
+	//
+	if(m_pos + m_data_size / 2 > m_limit)
+	{
+		scan_subscribers(false);
+
+		if(m_pos + m_data_size / 2 > m_limit)
+		{
+			scan_subscribers(true);
+			usleep(FANOUT_POLL_INTERVAL_US);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void sinsp_fanout_publisher::get_stats(OUT vector<sinsp_fanout_subscriber_stats>* stats)
+{
+	stats->clear();
+
+	for(uint32_t j = 0; j < FANOUT_MAX_SUBSCRIBERS; j++)
+	{
+		fanout_slot* slot = &m_hdr->m_slots[j];
+
+		if(slot->m_state.load(std::memory_order_acquire) != FANOUT_SLOT_ACTIVE)
+		{
+			continue;
+		}
+
+		sinsp_fanout_subscriber_stats st;
+		st.m_pid = slot->m_pid;
+		st.m_n_evts = slot->m_n_evts.load(std::memory_order_relaxed);
+		st.m_n_drops = slot->m_n_drops.load(std::memory_order_relaxed);
+		st.m_n_overruns = slot->m_n_overruns.load(std::memory_order_relaxed);
+		st.m_slow = slot->m_slow.load(std::memory_order_relaxed) != 0;
+		stats->push_back(st);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_fanout_subscriber implementation
+///////////////////////////////////////////////////////////////////////////////
+sinsp_fanout_subscriber::sinsp_fanout_subscriber(sinsp* inspector, const string& name)
+{
+	m_inspector = inspector;
+	m_slot = NULL;
+	m_read_pos = 0;
+	m_next_seq = (uint64_t)-1;
+	m_min_resync_gen = 0;
+	m_n_evts = 0;
+	m_n_drops = 0;
+	m_n_polls = 0;
+
+	attach(name);
+
+	if(m_hdr->m_state.load(std::memory_order_acquire) != FANOUT_STATE_RUNNING ||
+		!is_process_alive(m_hdr->m_publisher_pid))
+	{
+		unmap();
+		throw sinsp_exception("the publisher of '" + name + "' is not running");
+	}
+
+	for(uint32_t j = 0; j < FANOUT_MAX_SUBSCRIBERS; j++)
+	{
+		uint32_t state = FANOUT_SLOT_FREE;
+
+		if(m_hdr->m_slots[j].m_state.compare_exchange_strong(state, FANOUT_SLOT_CLAIMED))
+		{
+			m_slot = &m_hdr->m_slots[j];
+			break;
+		}
+	}
+
+	if(m_slot == NULL)
+	{
+		unmap();
+		throw sinsp_exception("'" + name + "' already has the maximum number of subscribers");
+	}
+
+	m_read_pos = m_hdr->m_commit_pos.load(std::memory_order_acquire);
+
+	m_slot->m_pid = getpid();
+	m_slot->m_read_pos.store(m_read_pos, std::memory_order_relaxed);
+	m_slot->m_n_evts.store(0, std::memory_order_relaxed);
+	m_slot->m_n_drops.store(0, std::memory_order_relaxed);
+	m_slot->m_n_overruns.store(0, std::memory_order_relaxed);
+	m_slot->m_slow.store(0, std::memory_order_relaxed);
+	m_slot->m_state.store(FANOUT_SLOT_ACTIVE, std::memory_order_release);
+
+	//
+	// Get the state of all the threads
+	//
+	m_min_resync_gen = m_hdr->m_resync.fetch_add(1, std::memory_order_acq_rel) + 1;
+}
+
+sinsp_fanout_subscriber::~sinsp_fanout_subscriber()
+{
+	if(m_slot != NULL)
+	{
+		m_slot->m_state.store(FANOUT_SLOT_FREE, std::memory_order_release);
+	}
+}
+
+int32_t sinsp_fanout_subscriber::next(OUT sinsp_evt** evt)
+{
+	sinsp* inspector = m_inspector;
+	fanout_frame frame;
+
+	//
+	// Delayed removal of the threads that exited, like in the live capture
+	//
+	if(inspector->m_tid_to_remove != -1)
+	{
+		inspector->remove_thread(inspector->m_tid_to_remove, false);
+		inspector->m_tid_to_remove = -1;
+	}
+
+	while(true)
+	{
+		int32_t res = read_frame(&frame);
+
+		if(res != SCAP_SUCCESS)
+		{
+			*evt = NULL;
+			return res;
+		}
+
+		const char* payload = &m_buf[0];
+
+		if(frame.m_type == FANOUT_RECORD_THREAD)
+		{
+			apply_thread(payload, frame.m_len);
+		}
+		else if(frame.m_type == FANOUT_RECORD_THREAD_STATS)
+		{
+			apply_thread_stats(payload, frame.m_len);
+		}
+		else if(frame.m_type == FANOUT_RECORD_EVENT)
+		{
+			if(load_event(&frame, payload, frame.m_len))
+			{
+				break;
+			}
+		}
+	}
+
+	sinsp_evt* sevt = &inspector->m_evt;
+	uint16_t etype = sevt->get_type();
+	sinsp_threadinfo* tinfo = sevt->m_tinfo;
+
+	if(tinfo != NULL && (etype == PPME_PROCEXIT_E || etype == PPME_PROCEXIT_1_E))
+	{
+		inspector->m_thread_manager->set_closed(tinfo);
+		inspector->m_tid_to_remove = sevt->get_tid();
+	}
+
+#if defined(HAS_FILTERING) && defined(HAS_CAPTURE_FILTERING)
+	sevt->m_filtered_out = false;
+
+	//
+	// Like the parser does for the live captures, hide the events of this
+	// process unless debug mode is enabled
+	//
+	if(!inspector->is_debug_enabled() &&
+		sevt->get_tid() == inspector->m_sysdig_pid &&
+		etype != PPME_SCHEDSWITCH_1_E &&
+		etype != PPME_SCHEDSWITCH_6_E &&
+		etype != PPME_DROP_E &&
+		etype != PPME_DROP_X &&
+		etype != PPME_SYSDIGEVENT_E)
+	{
+		sevt->m_filtered_out = true;
+	}
+	else if(inspector->m_filter != NULL && !inspector->m_filter->run(sevt))
+	{
+		sevt->m_filtered_out = true;
+	}
+
+	if(sevt->m_filtered_out)
+	{
+		*evt = sevt;
+		return SCAP_TIMEOUT;
+	}
+#endif
+
+	if(inspector->m_firstacceptedevent_ts == 0)
+	{
+		inspector->m_firstacceptedevent_ts = inspector->m_lastevent_ts;
+	}
+
+	if(tinfo != NULL &&
+		etype != PPME_SCHEDSWITCH_1_E &&
+		etype != PPME_SCHEDSWITCH_6_E)
+	{
+		tinfo->m_prevevent_ts = tinfo->m_lastevent_ts;
+		tinfo->m_lastevent_ts = inspector->m_lastevent_ts;
+	}
+
+	*evt = sevt;
+	return SCAP_SUCCESS;
+}
+
+int32_t sinsp_fanout_subscriber::read_frame(OUT fanout_frame* frame)
+{
+	while(true)
+	{
+		uint64_t commit_pos = m_hdr->m_commit_pos.load(std::memory_order_acquire);
+
+		if(m_read_pos == commit_pos)
+		{
+			//
+			// The publisher writes its last frames before closing, so
+			// the ring is drained if it's still empty after the check
+			//
+			if(m_hdr->m_state.load(std::memory_order_acquire) == FANOUT_STATE_CLOSED)
+			{
+				if(m_hdr->m_commit_pos.load(std::memory_order_acquire) == m_read_pos)
+				{
+					return SCAP_EOF;
+				}
+
+				continue;
+			}
+
+			//
+			// A publisher that crashed can't close the ring
+			//
+			if(++m_n_polls % 1000 == 0 && !is_process_alive(m_hdr->m_publisher_pid))
+			{
+				return SCAP_EOF;
+			}
+
+			usleep(FANOUT_POLL_INTERVAL_US);
+			return SCAP_TIMEOUT;
+		}
+
+		if(commit_pos - m_read_pos > m_data_size)
+		{
+			on_overrun();
+			continue;
+		}
+
+		//
+		// Copy the frame out of the ring, then make sure the publisher
+		// didn't write over it in the meantime
+		//
+		uint64_t off = m_read_pos & m_mask;
+		uint64_t total = 0;
+
+		memcpy(frame, m_data + off, sizeof(fanout_frame));
+
+		if(frame->m_len != FANOUT_FRAME_WRAP)
+		{
+			total = FANOUT_ALIGN(sizeof(fanout_frame) + (uint64_t)frame->m_len);
+
+			if(total <= m_data_size / 2 && off + total <= m_data_size)
+			{
+				if(m_buf.size() < frame->m_len + 1)
+				{
+					m_buf.resize(frame->m_len + 1);
+				}
+
+				memcpy(&m_buf[0], m_data + off + sizeof(fanout_frame), frame->m_len);
+			}
+			else
+			{
+				total = 0;
+			}
+		}
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		if(m_hdr->m_reserve_pos.load(std::memory_order_relaxed) - m_read_pos > m_data_size)
+		{
+			on_overrun();
+			continue;
+		}
+
+		if(frame->m_len == FANOUT_FRAME_WRAP)
+		{
+			m_read_pos += m_data_size - off;
+			continue;
+		}
+
+		if(total == 0)
+		{
+			throw sinsp_exception("corrupted event publisher ring");
+		}
+
+		m_read_pos += total;
+		m_slot->m_read_pos.store(m_read_pos, std::memory_order_release);
+		return SCAP_SUCCESS;
+	}
+}
+
+void sinsp_fanout_subscriber::on_overrun()
+{
+	//
+	// Skip to the most recent data. The lost events show up as a gap in
+	// the sequence numbers.
+	//
+	m_read_pos = m_hdr->m_commit_pos.load(std::memory_order_acquire);
+	m_slot->m_read_pos.store(m_read_pos, std::memory_order_release);
+	request_resync();
+}
+
+void sinsp_fanout_subscriber::request_resync()
+{
+	uint32_t resync = m_hdr->m_resync.load(std::memory_order_acquire);
+
+	if(m_hdr->m_resync_done.load(std::memory_order_acquire) == resync)
+	{
+		m_hdr->m_resync.compare_exchange_strong(resync, resync + 1);
+	}
+
+	m_min_resync_gen = m_hdr->m_resync.load(std::memory_order_acquire);
+}
+
+void sinsp_fanout_subscriber::apply_thread(const char* buf, uint32_t len)
+{
+	fanout_thread_record rec;
+
+	if(len < sizeof(rec))
+	{
+		ASSERT(false);
+		return;
+	}
+
+	memcpy(&rec, buf, sizeof(rec));
+
+	uint64_t slen = (uint64_t)rec.m_comm_len + rec.m_exe_len + rec.m_cwd_len +
+		rec.m_container_id_len + rec.m_args_len + rec.m_env_len + rec.m_cgroups_len;
+
+	if(sizeof(rec) + slen != len)
+	{
+		ASSERT(false);
+		return;
+	}
+
+	//
+	// Updates go through a copy too, so the thread manager can fix its
+	// indexes when the container or the parent change
+	//
+	sinsp_threadinfo* ptinfo = m_inspector->get_thread(rec.m_tid, false, true);
+	sinsp_threadinfo newti(m_inspector);
+
+	if(ptinfo != NULL)
+	{
+		newti = *ptinfo;
+	}
+
+	const char* p = buf + sizeof(rec);
+
+	newti.m_tid = rec.m_tid;
+	newti.m_pid = rec.m_pid;
+	newti.m_ptid = rec.m_ptid;
+	newti.m_vtid = rec.m_vtid;
+	newti.m_vpid = rec.m_vpid;
+	newti.m_fdlimit = rec.m_fdlimit;
+	newti.m_clone_ts = rec.m_clone_ts;
+	newti.m_uid = rec.m_uid;
+	newti.m_gid = rec.m_gid;
+	newti.m_flags = rec.m_flags;
+	newti.m_comm.assign(p, rec.m_comm_len);
+	p += rec.m_comm_len;
+	newti.m_exe.assign(p, rec.m_exe_len);
+	p += rec.m_exe_len;
+	newti.m_cwd.assign(p, rec.m_cwd_len);
+	p += rec.m_cwd_len;
+	newti.m_container_id.assign(p, rec.m_container_id_len);
+	p += rec.m_container_id_len;
+
+	//
+	// The lists are NUL terminated, and the payload buffer has room for
+	// the terminator of the last one
+	//
+	m_buf[len] = 0;
+	newti.set_args(p, rec.m_args_len);
+	p += rec.m_args_len;
+	newti.set_env(p, rec.m_env_len);
+	p += rec.m_env_len;
+	newti.set_cgroups(p, rec.m_cgroups_len);
+
+	//
+	// A new thread counts as a child of its main thread, as long as the
+	// main thread is known
+	//
+	bool count_child = (ptinfo == NULL) &&
+		(!(rec.m_flags & PPM_CL_CLONE_THREAD) || m_inspector->get_thread(rec.m_pid, false, true) != NULL);
+
+	m_inspector->m_thread_manager->add_thread(newti, !count_child);
+}
+
+void sinsp_fanout_subscriber::apply_thread_stats(const char* buf, uint32_t len)
+{
+	fanout_thread_stats_record rec;
+
+	if(len != sizeof(rec))
+	{
+		ASSERT(false);
+		return;
+	}
+
+	memcpy(&rec, buf, sizeof(rec));
+
+	sinsp_threadinfo* tinfo = m_inspector->get_thread(rec.m_tid, false, true);
+
+	if(tinfo != NULL)
+	{
+		tinfo->m_pfmajor = rec.m_pfmajor;
+		tinfo->m_pfminor = rec.m_pfminor;
+		tinfo->m_vmsize_kb = rec.m_vmsize_kb;
+		tinfo->m_vmrss_kb = rec.m_vmrss_kb;
+		tinfo->m_vmswap_kb = rec.m_vmswap_kb;
+	}
+}
+
+bool sinsp_fanout_subscriber::load_event(const fanout_frame* frame, const char* buf, uint32_t len)
+{
+	sinsp* inspector = m_inspector;
+	sinsp_evt* evt = &inspector->m_evt;
+	fanout_event_record rec;
+	fanout_fd_record fdrec;
+	const char* fdname = NULL;
+	uint32_t pos = sizeof(rec);
+
+	//
+	// Drop accounting
+	//
+	if(m_next_seq != (uint64_t)-1 && frame->m_seq > m_next_seq)
+	{
+		m_n_drops += frame->m_seq - m_next_seq;
+		m_slot->m_n_drops.store(m_n_drops, std::memory_order_relaxed);
+		request_resync();
+	}
+
+	m_next_seq = frame->m_seq + 1;
+
+	if(len < sizeof(rec))
+	{
+		ASSERT(false);
+		return false;
+	}
+
+	memcpy(&rec, buf, sizeof(rec));
+
+	//
+	// Until the publisher has seen our resync request, the events can
+	// refer to threads and fds that we don't have or that have changed.
+	// They count as lost.
+	//
+	if((int32_t)(rec.m_resync_gen - m_min_resync_gen) < 0)
+	{
+		m_n_drops++;
+		m_slot->m_n_drops.store(m_n_drops, std::memory_order_relaxed);
+		return false;
+	}
+
+	if(rec.m_flags & FANOUT_EVT_FD)
+	{
+		if(len < pos + sizeof(fdrec))
+		{
+			ASSERT(false);
+			return false;
+		}
+
+		memcpy(&fdrec, buf + pos, sizeof(fdrec));
+		pos += sizeof(fdrec);
+
+		if(len - pos < fdrec.m_name_len)
+		{
+			ASSERT(false);
+			return false;
+		}
+
+		fdname = buf + pos;
+		pos += fdrec.m_name_len;
+	}
+
+	scap_evt* pevt = (scap_evt*)(buf + pos);
+
+	if(len - pos != rec.m_evtlen || rec.m_evtlen < sizeof(scap_evt) ||
+		pevt->len != rec.m_evtlen || pevt->type >= PPM_EVENT_MAX)
+	{
+		ASSERT(false);
+		return false;
+	}
+
+	evt->m_pevt = pevt;
+	evt->init();
+	evt->m_cpuid = rec.m_cpuid;
+	evt->m_evtnum = rec.m_evtnum;
+	evt->m_errorcode = rec.m_errorcode;
+	evt->m_iosize = rec.m_iosize;
+
+	inspector->m_lastevent_ts = evt->get_ts();
+
+#ifdef HAS_FILTERING
+	if(inspector->m_firstevent_ts == 0)
+	{
+		inspector->m_firstevent_ts = inspector->m_lastevent_ts;
+	}
+#endif
+
+	sinsp_threadinfo* tinfo = NULL;
+
+	if(rec.m_flags & FANOUT_EVT_THREAD)
+	{
+		tinfo = inspector->get_thread(evt->get_tid(), false, false);
+
+		if(tinfo == NULL)
+		{
+			//
+			// We lost the thread, or never had it because we joined
+			// late
+			//
+			request_resync();
+		}
+	}
+
+	if(tinfo != NULL)
+	{
+		sinsp_fdinfo_t* fdinfo = NULL;
+
+		if(rec.m_flags & FANOUT_EVT_FD)
+		{
+			m_fdinfo.m_type = (scap_fd_type)fdrec.m_type;
+			m_fdinfo.m_openflags = fdrec.m_openflags;
+			m_fdinfo.m_flags = fdrec.m_flags;
+			m_fdinfo.m_ino = fdrec.m_ino;
+			m_fdinfo.m_sockinfo = fdrec.m_sockinfo;
+			m_fdinfo.m_name = string(fdname, fdrec.m_name_len);
+
+			if(rec.m_fdnum != -1 && tinfo->get_fd_table() != NULL)
+			{
+				fdinfo = tinfo->add_fd(rec.m_fdnum, &m_fdinfo);
+			}
+			else
+			{
+				fdinfo = &m_fdinfo;
+			}
+		}
+		else if(rec.m_flags & FANOUT_EVT_NO_FD)
+		{
+			if(tinfo->get_fd_table() != NULL)
+			{
+				tinfo->remove_fd(rec.m_fdnum);
+			}
+		}
+		else if(rec.m_flags & FANOUT_EVT_FDINFO)
+		{
+			fdinfo = tinfo->get_fd(rec.m_fdnum);
+		}
+
+		if(rec.m_flags & FANOUT_EVT_FDINFO)
+		{
+			evt->m_fdinfo = fdinfo;
+		}
+
+		tinfo->m_lastevent_fd = rec.m_lastevent_fd;
+		tinfo->m_latency = rec.m_latency;
+	}
+
+	evt->m_tinfo = tinfo;
+
+	m_n_evts++;
+	m_slot->m_n_evts.store(m_n_evts, std::memory_order_relaxed);
+	return true;
+}
+
+#endif // HAS_CAPTURE
@@ -0,0 +1,241 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// Fan-out of the parsed event stream to local subscribers.
+//
+// Every live capture copies the events from the kernel, scans /proc and
+// parses the events on its own, and the driver only accepts a few consumers.
+// A publisher inspector instead exposes the events it has already parsed
+// through a ring in POSIX shared memory, and other local processes read them
+// with sinsp::open_subscriber(). Next to the raw events, the ring carries the
+// state that the filter fields need: the thread of every event, with its main
+// thread and ancestors, sent again only when it changes, and the fd that the
+// event refers to. A subscriber rebuilds that state in its own tables, so it
+// can apply its own filter and output format without a driver or a parser.
+//
+// By default the publisher never waits for the subscribers. A subscriber that
+// falls behind by more than the ring size loses the oldest events, and gets
+// the thread state again. The publisher flags the subscribers that are more
+// than half a ring behind as slow and counts how many times it overran them,
+// while every subscriber counts the events it lost, from the gaps in the
+// event sequence numbers. See sinsp::get_fanout_stats().
+//
+// Not carried to the subscribers: the user and group tables, the container
+// metadata, the network interfaces and the machine information.
+///////////////////////////////////////////////////////////////////////////////
+
+/*!
+  \brief State of a subscriber, as seen by the publisher.
+*/
+struct sinsp_fanout_subscriber_stats
+{
+	int64_t m_pid; ///< Process ID of the subscriber.
+	uint64_t m_n_evts; ///< Number of events that the subscriber received.
+	uint64_t m_n_drops; ///< Number of events that the subscriber lost because it was too slow.
+	uint64_t m_n_overruns; ///< Number of times the publisher overwrote events that the subscriber hadn't read yet.
+	bool m_slow; ///< True if the subscriber was more than half a ring behind at the last check.
+};
+
+#if defined(HAS_CAPTURE)
+
+#include <atomic>
+
+struct fanout_ring_header;
+struct fanout_slot;
+struct fanout_frame;
+
+//
+// Mapping of the shared memory ring, common to the two ends
+//
+class sinsp_fanout_ring
+{
+public:
+	sinsp_fanout_ring();
+	~sinsp_fanout_ring();
+
+protected:
+	//
+	// The publisher creates the ring, the subscribers attach to it. Both
+	// throw a sinsp_exception on failure.
+	//
+	void create(const string& name, uint64_t data_size);
+	void attach(const string& name);
+	void unmap();
+	static string get_shm_name(const string& name);
+	static bool is_process_alive(int64_t pid);
+
+	fanout_ring_header* m_hdr;
+	char* m_data;
+	uint64_t m_data_size;
+	uint64_t m_mask;
+	uint64_t m_map_size;
+	string m_shm_name;
+	bool m_owner;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// The publishing end, driven by sinsp::next()
+///////////////////////////////////////////////////////////////////////////////
+class sinsp_fanout_publisher : public sinsp_fanout_ring
+{
+public:
+	//
+	// ring_size is rounded up to a power of two. If wait_subscribers is not
+	// 0, the publisher waits for that many subscribers before sending the
+	// first event, and then never overwrites the events that a live
+	// subscriber hasn't read. This is meant for replaying trace files.
+	//
+	sinsp_fanout_publisher(sinsp* inspector, const string& name, uint64_t ring_size, uint32_t wait_subscribers);
+	~sinsp_fanout_publisher();
+
+	//
+	// Send an event, and the thread and fd state it needs, to the
+	// subscribers. Called after the event has been parsed and filtered.
+	//
+	void publish(sinsp_evt* evt);
+
+	//
+	// When waiting for the subscribers, false if the next event can't be
+	// published yet. sinsp::next() checks it before reading the event, and
+	// returns a timeout instead of blocking, so that the caller can stop.
+	//
+	bool is_ready();
+
+	//
+	// Called when the inspector opens a new capture. The thread table
+	// starts from scratch, so its content is sent again.
+	//
+	void on_capture_start()
+	{
+		m_published.clear();
+	}
+
+	uint64_t get_num_published()
+	{
+		return m_n_published;
+	}
+
+	void get_stats(OUT vector<sinsp_fanout_subscriber_stats>* stats);
+
+private:
+	struct thread_state
+	{
+		uint64_t m_hash;
+		uint64_t m_stats_hash;
+		//
+		// Changes every time the full thread is sent. The fds remembered
+		// with an older epoch are sent again.
+		//
+		uint64_t m_epoch;
+	};
+
+	struct fd_cache_entry
+	{
+		int64_t m_tid;
+		int64_t m_fd;
+		uint64_t m_epoch;
+		uint64_t m_hash;
+	};
+
+	thread_state* publish_thread(sinsp_threadinfo* tinfo, uint32_t depth);
+	void write_thread(sinsp_threadinfo* tinfo);
+	void write_thread_stats(sinsp_threadinfo* tinfo);
+	char* reserve(uint16_t type, uint32_t len);
+	void commit();
+	void make_room(uint64_t end);
+	void scan_subscribers(bool check_alive);
+	void check_resync();
+
+	sinsp* m_inspector;
+	uint32_t m_wait_subscribers;
+	bool m_waited;
+	//
+	// Committed position, and end of the frame being written
+	//
+	uint64_t m_pos;
+	uint64_t m_end;
+	//
+	// Position up to which the ring can be written without overwriting
+	// data that an active subscriber hasn't read yet
+	//
+	uint64_t m_limit;
+	uint32_t m_nactive;
+	bool m_lapped[FANOUT_MAX_SUBSCRIBERS];
+	uint64_t m_n_published;
+	uint32_t m_n_since_check;
+	uint32_t m_resync_gen;
+	unordered_map<int64_t, thread_state> m_published;
+	vector<fd_cache_entry> m_fd_cache;
+	uint64_t m_next_epoch;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// The subscribing end, used by sinsp::next() instead of libscap and the
+// parser
+///////////////////////////////////////////////////////////////////////////////
+class sinsp_fanout_subscriber : public sinsp_fanout_ring
+{
+public:
+	sinsp_fanout_subscriber(sinsp* inspector, const string& name);
+	~sinsp_fanout_subscriber();
+
+	int32_t next(OUT sinsp_evt** evt);
+
+	uint64_t get_num_events()
+	{
+		return m_n_evts;
+	}
+
+	uint64_t get_num_drops()
+	{
+		return m_n_drops;
+	}
+
+private:
+	int32_t read_frame(OUT fanout_frame* frame);
+	void on_overrun();
+	void request_resync();
+	void apply_thread(const char* buf, uint32_t len);
+	void apply_thread_stats(const char* buf, uint32_t len);
+	bool load_event(const fanout_frame* frame, const char* buf, uint32_t len);
+
+	sinsp* m_inspector;
+	fanout_slot* m_slot;
+	uint64_t m_read_pos;
+	//
+	// Sequence number of the next event, or -1 before the first one
+	//
+	uint64_t m_next_seq;
+	//
+	// The events published before this resync generation are discarded
+	//
+	uint32_t m_min_resync_gen;
+	uint64_t m_n_evts;
+	uint64_t m_n_drops;
+	uint32_t m_n_polls;
+	vector<char> m_buf;
+	//
+	// The fd of an event that can't go in a thread's table
+	//
+	sinsp_fdinfo_t m_fdinfo;
+};
+
+#endif // HAS_CAPTURE
@@ -24,6 +24,119 @@ along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
 #include "sinsp.h"
 #include "sinsp_int.h"
 
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_fdname implementation
+///////////////////////////////////////////////////////////////////////////////
+const string sinsp_fdname::m_empty;
+
+sinsp_fdname::table_owner::table_owner()
+{
+	m_table = new table();
+	m_table->m_orphaned = false;
+}
+
+sinsp_fdname::table_owner::~table_owner()
+{
+	//
+	// Names held by objects that outlive the thread, e.g. static ones for
+	// the main thread, are still valid and free the table when they go
+	//
+	if(m_table->m_entries.empty())
+	{
+		delete m_table;
+	}
+	else
+	{
+		m_table->m_orphaned = true;
+	}
+}
+
+sinsp_fdname::table* sinsp_fdname::get_table()
+{
+	static thread_local table_owner owner;
+	return owner.m_table;
+}
+
+size_t sinsp_fdname::get_table_size()
+{
+	return get_table()->m_entries.size();
+}
+
+void sinsp_fdname::set(const char* str, size_t len)
+{
+	if(m_entry != NULL &&
+		m_entry->m_str.size() == len &&
+		memcmp(m_entry->m_str.data(), str, len) == 0)
+	{
+		return;
+	}
+
+	release();
+
+	if(len == 0)
+	{
+		return;
+	}
+
+	table* t = get_table();
+	uint64_t hash = sinsp_intern_hash(str, len);
+
+	auto range = t->m_entries.equal_range(hash);
+	for(auto it = range.first; it != range.second; ++it)
+	{
+		if(it->second->m_str.size() == len &&
+			memcmp(it->second->m_str.data(), str, len) == 0)
+		{
+			m_entry = it->second;
+			m_entry->m_refcount++;
+			return;
+		}
+	}
+
+	entry* e = new entry();
+	e->m_str.assign(str, len);
+	e->m_hash = hash;
+	e->m_refcount = 1;
+	e->m_lastslash = e->m_str.rfind('/');
+	e->m_clean = (find_if(e->m_str.begin(), e->m_str.end(), g_invalidchar()) == e->m_str.end());
+	e->m_table = t;
+
+	t->m_entries.insert(std::make_pair(hash, e));
+	m_entry = e;
+}
+
+void sinsp_fdname::release()
+{
+	if(m_entry == NULL)
+	{
+		return;
+	}
+
+	if(--m_entry->m_refcount == 0)
+	{
+		table* t = m_entry->m_table;
+
+		auto range = t->m_entries.equal_range(m_entry->m_hash);
+		for(auto it = range.first; it != range.second; ++it)
+		{
+			if(it->second == m_entry)
+			{
+				t->m_entries.erase(it);
+				break;
+			}
+		}
+
+		delete m_entry;
+
+		if(t->m_orphaned && t->m_entries.empty())
+		{
+			delete t;
+		}
+	}
+
+	m_entry = NULL;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // sinsp_fdinfo inomlementation
 ///////////////////////////////////////////////////////////////////////////////
@@ -35,9 +148,9 @@ template<> sinsp_fdinfo_t::sinsp_fdinfo()
 	m_usrstate = NULL;
 }
 
-template<> string* sinsp_fdinfo_t::tostring()
+template<> const string* sinsp_fdinfo_t::tostring()
 {
-	return &m_name;
+	return &m_name.str();
 }
 
 template<> char sinsp_fdinfo_t::get_typechar()
@@ -116,6 +229,12 @@ template<> char* sinsp_fdinfo_t::get_typestring()
 template<> string sinsp_fdinfo_t::tostring_clean()
 {
 	string m_tstr = m_name;
+
+	if(m_name.is_clean())
+	{
+		return m_tstr;
+	}
+
 	m_tstr.erase(remove_if(m_tstr.begin(), m_tstr.end(), g_invalidchar()), m_tstr.end());
 	return m_tstr;
 }
@@ -57,6 +57,173 @@ typedef union _sinsp_sockinfo
 	unix_tuple m_unixinfo; ///< The tuple if this a unix socket.
 }sinsp_sockinfo;
 
+/*!
+  \brief Interned FD name.
+  FD names (file paths, tuples...) are stored once in a refcounted table
+  and shared by all the FDs that have the same name, also across
+  processes. The position of the last slash is computed when the name is
+  interned, so splitting a path into directory and file name is free.
+
+  \note This class behaves like a read-only std::string and can be assigned
+   from strings and C strings.
+
+  \note Every thread has its own table, so that setting a name on the hot
+   path doesn't take locks. The names of an inspector are created by its
+   capture thread, and must be copied and dropped only by that thread, or
+   after it stopped using them. Names created on different threads are
+   never shared, even if they are equal.
+*/
+class SINSP_PUBLIC sinsp_fdname
+{
+public:
+	sinsp_fdname()
+	{
+		m_entry = NULL;
+	}
+
+	sinsp_fdname(const sinsp_fdname& other)
+	{
+		m_entry = other.m_entry;
+		if(m_entry != NULL)
+		{
+			m_entry->m_refcount++;
+		}
+	}
+
+	~sinsp_fdname()
+	{
+		release();
+	}
+
+	sinsp_fdname& operator=(const sinsp_fdname& other)
+	{
+		entry* e = other.m_entry;
+
+		if(e != NULL)
+		{
+			e->m_refcount++;
+		}
+
+		release();
+		m_entry = e;
+		return *this;
+	}
+
+	sinsp_fdname& operator=(const string& str)
+	{
+		set(str.c_str(), str.size());
+		return *this;
+	}
+
+	sinsp_fdname& operator=(const char* str)
+	{
+		set(str, strlen(str));
+		return *this;
+	}
+
+	inline operator const string&() const
+	{
+		return str();
+	}
+
+	inline const string& str() const
+	{
+		return (m_entry != NULL)? m_entry->m_str : m_empty;
+	}
+
+	inline const char* c_str() const
+	{
+		return str().c_str();
+	}
+
+	inline size_t size() const
+	{
+		return str().size();
+	}
+
+	inline size_t length() const
+	{
+		return str().size();
+	}
+
+	inline bool empty() const
+	{
+		return m_entry == NULL;
+	}
+
+	inline size_t find(const char* s, size_t pos = 0) const
+	{
+		return str().find(s, pos);
+	}
+
+	inline char operator[](size_t pos) const
+	{
+		return str()[pos];
+	}
+
+	/*!
+	  \brief Return true if the name doesn't contain invalid characters,
+	   i.e. it doesn't need to be sanitized before being shown.
+	*/
+	inline bool is_clean() const
+	{
+		return (m_entry != NULL)? m_entry->m_clean : true;
+	}
+
+	/*!
+	  \brief Return the position of the last slash in the name, or
+	   string::npos if there's none.
+	*/
+	inline size_t get_lastslash_pos() const
+	{
+		return (m_entry != NULL)? m_entry->m_lastslash : string::npos;
+	}
+
+	/*!
+	  \brief Return the number of distinct names currently interned by the
+	   calling thread.
+	*/
+	static size_t get_table_size();
+
+private:
+	struct table;
+
+	struct entry
+	{
+		string m_str;
+		uint64_t m_hash;
+		uint64_t m_refcount;
+		size_t m_lastslash;
+		bool m_clean;
+		table* m_table;
+	};
+
+	//
+	// The table of a thread outlives the thread if some of its names are
+	// still referenced, and is freed with the last of them
+	//
+	struct table
+	{
+		unordered_multimap<uint64_t, entry*> m_entries;
+		bool m_orphaned;
+	};
+
+	struct table_owner
+	{
+		table_owner();
+		~table_owner();
+
+		table* m_table;
+	};
+
+	void set(const char* str, size_t len);
+	void release();
+	static table* get_table();
+
+	entry* m_entry;
+	static const string m_empty;
+};
+
 class fd_callbacks_info
 {
 public:
@@ -101,7 +268,7 @@ public:
 		return *this;
 	}
 
-	string* tostring();
+	const string* tostring();
 
 	inline void copy(const sinsp_fdinfo &other, bool free_state)
 	{
@@ -292,7 +459,7 @@ public:
 	*/
 	sinsp_sockinfo m_sockinfo;
 
-	string m_name; ///< Human readable rendering of this FD. For files, this is the full file name. For sockets, this is the tuple. And so on.
+	sinsp_fdname m_name; ///< Human readable rendering of this FD. For files, this is the full file name. For sockets, this is the tuple. And so on.
 
 	inline bool has_decoder_callbacks()
 	{
@@ -376,6 +543,8 @@ private:
 	friend class thread_analyzer_info;
 	friend class sinsp_analyzer_fd_listener;
 	friend class sinsp_fdtable;
+	friend class sinsp_fanout_publisher;
+	friend class sinsp_fanout_subscriber;
 	friend class sinsp_filter_check_fd;
 	friend class sinsp_filter_check_event;
 	friend class lua_cbacks;
@@ -26,12 +26,18 @@ along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
 // code at every new release, and I will have a cleaner and easier to understand code base.
 //
 
+#include <functional>
+#include <chrono>
+
 #include "sinsp.h"
 #include "sinsp_int.h"
 
 #ifdef HAS_FILTERING
 #include "filter.h"
 #include "filterchecks.h"
+#include "multimatch.h"
+#include "netmatch.h"
+#include "strsearch.h"
 
 #ifndef _GNU_SOURCE
 //
@@ -155,6 +161,8 @@ bool flt_compare_uint64(ppm_cmp_operator op, uint64_t operand1, uint64_t operand
 		return (operand1 > operand2);
 	case CO_GE:
 		return (operand1 >= operand2);
+	case CO_IN:
+		return (operand1 == operand2);
 	default:
 		throw sinsp_exception("'contains' not supported for numeric filters");
 		return false;
@@ -181,8 +189,7 @@ bool flt_compare_int64(ppm_cmp_operator op, int64_t operand1, int64_t operand2)
 		throw sinsp_exception("'contains' not supported for numeric filters");
 		return false;
 	case CO_IN:
-		throw sinsp_exception("'in' not supported for numeric filters");
-		return false;
+		return (operand1 == operand2);
 	default:
 		throw sinsp_exception("'unknown' not supported for numeric filters");
 		return false;
@@ -200,7 +207,7 @@ bool flt_compare_string(ppm_cmp_operator op, char* operand1, char* operand2)
 	case CO_CONTAINS:
 		return (strstr(operand1, operand2) != NULL);
 	case CO_IN:
-		return (strstr(operand1, operand2) != NULL);
+		return (strcmp(operand1, operand2) == 0);
 	case CO_LT:
 		throw sinsp_exception("'<' not supported for string filters");
 	case CO_LE:
@@ -221,6 +228,7 @@ bool flt_compare_buffer(ppm_cmp_operator op, char* operand1, char* operand2, uin
 	switch(op)
 	{
 	case CO_EQ:
+	case CO_IN:
 		return op1_len == op2_len && (memcmp(operand1, operand2, op1_len) == 0);
 	case CO_NE:
 		return op1_len != op2_len || (memcmp(operand1, operand2, op1_len) != 0);
@@ -297,6 +305,283 @@ bool flt_compare(ppm_cmp_operator op, ppm_param_type type, void* operand1, void*
 	}
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// comparison kernels
+// Each kernel implements one (type, operator) case of flt_compare, with
+// exactly the same semantics.
+///////////////////////////////////////////////////////////////////////////////
+template<class T, class W, class OP>
+static bool flt_numeric_kernel(void* operand1, void* operand2, uint32_t op1_len, uint32_t op2_len)
+{
+	return OP()((W)*(T*)operand1, (W)*(T*)operand2);
+}
+
+template<class T, class W>
+static flt_cmp_kernel flt_get_numeric_kernel(ppm_cmp_operator op)
+{
+	switch(op)
+	{
+	case CO_EQ:
+	case CO_IN:
+		return flt_numeric_kernel<T, W, std::equal_to<W> >;
+	case CO_NE:
+		return flt_numeric_kernel<T, W, std::not_equal_to<W> >;
+	case CO_LT:
+		return flt_numeric_kernel<T, W, std::less<W> >;
+	case CO_LE:
+		return flt_numeric_kernel<T, W, std::less_equal<W> >;
+	case CO_GT:
+		return flt_numeric_kernel<T, W, std::greater<W> >;
+	case CO_GE:
+		return flt_numeric_kernel<T, W, std::greater_equal<W> >;
+	default:
+		//
+		// Not supported, the check will throw when it's run
+		//
+		return NULL;
+	}
+}
+
+static bool flt_string_eq_kernel(void* operand1, void* operand2, uint32_t op1_len, uint32_t op2_len)
+{
+	return strcmp((char*)operand1, (char*)operand2) == 0;
+}
+
+static bool flt_string_ne_kernel(void* operand1, void* operand2, uint32_t op1_len, uint32_t op2_len)
+{
+	return strcmp((char*)operand1, (char*)operand2) != 0;
+}
+
+static bool flt_string_contains_kernel(void* operand1, void* operand2, uint32_t op1_len, uint32_t op2_len)
+{
+	return strstr((char*)operand1, (char*)operand2) != NULL;
+}
+
+static bool flt_buffer_eq_kernel(void* operand1, void* operand2, uint32_t op1_len, uint32_t op2_len)
+{
+	return op1_len == op2_len && (memcmp(operand1, operand2, op1_len) == 0);
+}
+
+static bool flt_buffer_ne_kernel(void* operand1, void* operand2, uint32_t op1_len, uint32_t op2_len)
+{
+	return op1_len != op2_len || (memcmp(operand1, operand2, op1_len) != 0);
+}
+
+static bool flt_buffer_contains_kernel(void* operand1, void* operand2, uint32_t op1_len, uint32_t op2_len)
+{
+	return memmem(operand1, op1_len, operand2, op2_len) != NULL;
+}
+
+static bool flt_multi_match_string_kernel(void* operand1, void* operand2, uint32_t op1_len, uint32_t op2_len)
+{
+	return ((sinsp_multi_matcher*)operand2)->match_string((char*)operand1);
+}
+
+static bool flt_multi_match_buffer_kernel(void* operand1, void* operand2, uint32_t op1_len, uint32_t op2_len)
+{
+	return ((sinsp_multi_matcher*)operand2)->match_buffer((char*)operand1, op1_len);
+}
+
+static bool flt_network_kernel(void* operand1, void* operand2, uint32_t op1_len, uint32_t op2_len)
+{
+	return ((sinsp_network_set*)operand2)->match_ipv4(*(uint32_t*)operand1);
+}
+
+static bool flt_needle_string_kernel(void* operand1, void* operand2, uint32_t op1_len, uint32_t op2_len)
+{
+	return ((sinsp_substring_search*)operand2)->find_string((char*)operand1);
+}
+
+static bool flt_needle_buffer_kernel(void* operand1, void* operand2, uint32_t op1_len, uint32_t op2_len)
+{
+	return ((sinsp_substring_search*)operand2)->find((char*)operand1, op1_len);
+}
+
+static bool flt_exists_kernel(void* operand1, void* operand2, uint32_t op1_len, uint32_t op2_len)
+{
+	return true;
+}
+
+flt_cmp_kernel flt_get_compare_kernel(ppm_cmp_operator op, ppm_param_type type)
+{
+	if(op == CO_EXISTS)
+	{
+		return flt_exists_kernel;
+	}
+
+	switch(type)
+	{
+	case PT_INT8:
+		return flt_get_numeric_kernel<int8_t, int64_t>(op);
+	case PT_INT16:
+		return flt_get_numeric_kernel<int16_t, int64_t>(op);
+	case PT_INT32:
+		return flt_get_numeric_kernel<int32_t, int64_t>(op);
+	case PT_INT64:
+	case PT_FD:
+	case PT_PID:
+	case PT_ERRNO:
+		return flt_get_numeric_kernel<int64_t, int64_t>(op);
+	case PT_FLAGS8:
+	case PT_UINT8:
+	case PT_SIGTYPE:
+		return flt_get_numeric_kernel<int8_t, uint64_t>(op);
+	case PT_FLAGS16:
+	case PT_UINT16:
+	case PT_PORT:
+	case PT_SYSCALLID:
+		return flt_get_numeric_kernel<int16_t, uint64_t>(op);
+	case PT_UINT32:
+	case PT_FLAGS32:
+	case PT_BOOL:
+	case PT_IPV4ADDR:
+		return flt_get_numeric_kernel<int32_t, uint64_t>(op);
+	case PT_UINT64:
+	case PT_RELTIME:
+	case PT_ABSTIME:
+		return flt_get_numeric_kernel<uint64_t, uint64_t>(op);
+	case PT_CHARBUF:
+		switch(op)
+		{
+		case CO_EQ:
+		case CO_IN:
+			return flt_string_eq_kernel;
+		case CO_NE:
+			return flt_string_ne_kernel;
+		case CO_CONTAINS:
+			return flt_string_contains_kernel;
+		default:
+			return NULL;
+		}
+	case PT_BYTEBUF:
+		switch(op)
+		{
+		case CO_EQ:
+		case CO_IN:
+			return flt_buffer_eq_kernel;
+		case CO_NE:
+			return flt_buffer_ne_kernel;
+		case CO_CONTAINS:
+			return flt_buffer_contains_kernel;
+		default:
+			return NULL;
+		}
+	default:
+		return NULL;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_filter_value_set implementation
+///////////////////////////////////////////////////////////////////////////////
+template<class T, class W>
+static bool flt_in_numeric_kernel(void* operand1, void* operand2, uint32_t op1_len, uint32_t op2_len)
+{
+	return ((sinsp_filter_value_set*)operand2)->m_nums.count((uint64_t)(W)*(T*)operand1) != 0;
+}
+
+static bool flt_in_buffer_kernel(void* operand1, void* operand2, uint32_t op1_len, uint32_t op2_len)
+{
+	unordered_multimap<uint64_t, string>* strs = &((sinsp_filter_value_set*)operand2)->m_strs;
+
+	auto range = strs->equal_range(sinsp_intern_hash((char*)operand1, op1_len));
+	for(auto it = range.first; it != range.second; ++it)
+	{
+		if(it->second.size() == op1_len && memcmp(it->second.data(), operand1, op1_len) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool flt_in_string_kernel(void* operand1, void* operand2, uint32_t op1_len, uint32_t op2_len)
+{
+	//
+	// The length returned by the extractors is not reliable for strings
+	//
+	return flt_in_buffer_kernel(operand1, operand2, (uint32_t)strlen((char*)operand1), 0);
+}
+
+static bool flt_in_empty_kernel(void* operand1, void* operand2, uint32_t op1_len, uint32_t op2_len)
+{
+	return false;
+}
+
+sinsp_filter_value_set::sinsp_filter_value_set()
+{
+	m_kernel = flt_in_empty_kernel;
+}
+
+void sinsp_filter_value_set::add(ppm_param_type type, uint8_t* val, uint32_t len)
+{
+	//
+	// Same normalization as flt_compare(), so that a value is in the set
+	// exactly when it compares equal to one of the constants
+	//
+	switch(type)
+	{
+	case PT_INT8:
+		m_nums.insert((uint64_t)(int64_t)*(int8_t*)val);
+		m_kernel = flt_in_numeric_kernel<int8_t, int64_t>;
+		break;
+	case PT_INT16:
+		m_nums.insert((uint64_t)(int64_t)*(int16_t*)val);
+		m_kernel = flt_in_numeric_kernel<int16_t, int64_t>;
+		break;
+	case PT_INT32:
+		m_nums.insert((uint64_t)(int64_t)*(int32_t*)val);
+		m_kernel = flt_in_numeric_kernel<int32_t, int64_t>;
+		break;
+	case PT_INT64:
+	case PT_FD:
+	case PT_PID:
+	case PT_ERRNO:
+		m_nums.insert((uint64_t)*(int64_t*)val);
+		m_kernel = flt_in_numeric_kernel<int64_t, int64_t>;
+		break;
+	case PT_FLAGS8:
+	case PT_UINT8:
+	case PT_SIGTYPE:
+		m_nums.insert((uint64_t)*(int8_t*)val);
+		m_kernel = flt_in_numeric_kernel<int8_t, uint64_t>;
+		break;
+	case PT_FLAGS16:
+	case PT_UINT16:
+	case PT_PORT:
+	case PT_SYSCALLID:
+		m_nums.insert((uint64_t)*(int16_t*)val);
+		m_kernel = flt_in_numeric_kernel<int16_t, uint64_t>;
+		break;
+	case PT_UINT32:
+	case PT_FLAGS32:
+	case PT_BOOL:
+	case PT_IPV4ADDR:
+		m_nums.insert((uint64_t)*(int32_t*)val);
+		m_kernel = flt_in_numeric_kernel<int32_t, uint64_t>;
+		break;
+	case PT_UINT64:
+	case PT_RELTIME:
+	case PT_ABSTIME:
+		m_nums.insert(*(uint64_t*)val);
+		m_kernel = flt_in_numeric_kernel<uint64_t, uint64_t>;
+		break;
+	case PT_CHARBUF:
+		len = (uint32_t)strlen((char*)val);
+		m_strs.insert(std::make_pair(sinsp_intern_hash((char*)val, len), string((char*)val, len)));
+		m_kernel = flt_in_string_kernel;
+		break;
+	case PT_BYTEBUF:
+		m_strs.insert(std::make_pair(sinsp_intern_hash((char*)val, len), string((char*)val, len)));
+		m_kernel = flt_in_buffer_kernel;
+		break;
+	default:
+		ASSERT(false);
+		throw sinsp_exception("'in' not supported for this field type");
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // sinsp_filter_check implementation
 ///////////////////////////////////////////////////////////////////////////////
@@ -310,6 +595,33 @@ sinsp_filter_check::sinsp_filter_check() :
 	m_info.m_fields = NULL;
 	m_info.m_nfields = -1;
 	m_val_storage_len = 0;
+	m_patterns = NULL;
+	m_needle = NULL;
+	m_networks = NULL;
+	m_nevals = 0;
+	m_ntrue = 0;
+	m_cost_ns = 0;
+	m_cache_mode = CM_UNKNOWN;
+	m_cache_argid = 0;
+	m_cache_argname = NULL;
+}
+
+sinsp_filter_check::~sinsp_filter_check()
+{
+	if(m_patterns != NULL)
+	{
+		delete m_patterns;
+	}
+
+	if(m_needle != NULL)
+	{
+		delete m_needle;
+	}
+
+	if(m_networks != NULL)
+	{
+		delete m_networks;
+	}
 }
 
 void sinsp_filter_check::set_inspector(sinsp* inspector)
@@ -778,10 +1090,87 @@ void sinsp_filter_check::string_to_rawval(const char* str, uint32_t len, ppm_par
 	}
 }
 
+uint8_t* sinsp_filter_check::extract_through_cache(sinsp_evt *evt, OUT uint32_t* len)
+{
+	uint32_t j;
+
+	if(m_cache_mode == CM_UNKNOWN)
+	{
+		//
+		// Only strings are cached. They are the expensive fields, and their
+		// length is known without trusting *len.
+		//
+		if(m_field != NULL && m_info.m_fields != NULL &&
+			m_field->m_type == PT_CHARBUF &&
+			get_extraction_cache_key(&m_cache_argid, &m_cache_argname))
+		{
+			m_cache_mode = CM_CACHED;
+		}
+		else
+		{
+			m_cache_mode = CM_UNCACHED;
+			return extract(evt, len);
+		}
+	}
+
+	//
+	// The key is the entry of the field in the table of its class, which
+	// is shared by all the instances, and the argument
+	//
+	const void* field = &m_info.m_fields[m_field_id];
+
+	for(j = 0; j < evt->m_n_cached_fields; j++)
+	{
+		sinsp_evt::extraction_cache_entry* entry = &evt->m_extraction_cache[j];
+
+		if(entry->m_field == field && entry->m_argid == m_cache_argid &&
+			((m_cache_argname == NULL)? entry->m_argname.empty() : entry->m_argname == *m_cache_argname))
+		{
+			if(entry->m_is_null)
+			{
+				return NULL;
+			}
+
+			*len = (uint32_t)entry->m_val.size() - 1;
+			return (uint8_t*)&entry->m_val[0];
+		}
+	}
+
+	uint8_t* res = extract(evt, len);
+
+	if(evt->m_n_cached_fields == evt->m_extraction_cache.size())
+	{
+		evt->m_extraction_cache.push_back(sinsp_evt::extraction_cache_entry());
+	}
+
+	sinsp_evt::extraction_cache_entry* entry = &evt->m_extraction_cache[evt->m_n_cached_fields++];
+
+	entry->m_field = field;
+	entry->m_argid = m_cache_argid;
+
+	if(m_cache_argname == NULL)
+	{
+		entry->m_argname.clear();
+	}
+	else
+	{
+		entry->m_argname = *m_cache_argname;
+	}
+
+	entry->m_is_null = (res == NULL);
+
+	if(res != NULL)
+	{
+		entry->m_val.assign((char*)res, (char*)res + strlen((char*)res) + 1);
+	}
+
+	return res;
+}
+
 char* sinsp_filter_check::tostring(sinsp_evt* evt)
 {
 	uint32_t len;
-	uint8_t* rawval = extract(evt, &len);
+	uint8_t* rawval = extract_cached(evt, &len);
 
 	if(rawval == NULL)
 	{
@@ -798,7 +1187,7 @@ Json::Value sinsp_filter_check::tojson(sinsp_evt* evt)
 
 	if(jsonval == Json::Value::null)
 	{
-		uint8_t* rawval = extract(evt, &len);
+		uint8_t* rawval = extract_cached(evt, &len);
 		if(rawval == NULL)
 		{
 			return Json::Value::null;
@@ -843,116 +1232,932 @@ int32_t sinsp_filter_check::parse_field_name(const char* str)
 void sinsp_filter_check::parse_filter_value(const char* str, uint32_t len)
 {
 	string_to_rawval(str, len, m_field->m_type);
-}
 
-const filtercheck_field_info* sinsp_filter_check::get_field_info()
-{
-	return &m_info.m_fields[m_field_id];
+	//
+	// The constant of 'contains' never changes, so it's worth preprocessing
+	//
+	if(m_cmpop == CO_CONTAINS)
+	{
+		if(m_needle != NULL)
+		{
+			delete m_needle;
+			m_needle = NULL;
+		}
+
+		if(m_field->m_type == PT_CHARBUF)
+		{
+			m_needle = new sinsp_substring_search((char*)&m_val_storage[0], (uint32_t)strlen((char*)&m_val_storage[0]));
+		}
+		else if(m_field->m_type == PT_BYTEBUF)
+		{
+			m_needle = new sinsp_substring_search((char*)&m_val_storage[0], m_val_storage_len);
+		}
+	}
 }
 
-bool sinsp_filter_check::compare(sinsp_evt *evt)
+void sinsp_filter_check::add_list_filter_value(const char* str, uint32_t len)
 {
-	uint32_t len;
-	uint8_t* extracted_val = extract(evt, &len);
-
-	if(extracted_val == NULL)
+	//
+	// Networks are parsed here, since they aren't values of the field type
+	//
+	if(m_cmpop == CO_IN_CIDR)
 	{
-		return false;
+		if(m_networks == NULL)
+		{
+			m_networks = new sinsp_network_set();
+		}
+
+		if(!m_networks->add_network(str))
+		{
+			throw sinsp_exception("filter error: unrecognized network " + string(str));
+		}
+
+		return;
 	}
 
-	return flt_compare(m_cmpop,
-		m_info.m_fields[m_field_id].m_type,
-		extracted_val,
-		&m_val_storage[0],
-		len,
-		m_val_storage_len);
-}
+	parse_filter_value(str, len);
 
-///////////////////////////////////////////////////////////////////////////////
-// sinsp_filter_expression implementation
+	ppm_param_type type = m_info.m_fields[m_field_id].m_type;
+
+	if(m_cmpop == CO_IN)
+	{
+		m_in_values.add(type, &m_val_storage[0], m_val_storage_len);
+		return;
+	}
+
+	ASSERT(m_cmpop == CO_CONTAINS_ANY || m_cmpop == CO_STARTSWITH_ANY);
+
+	if(m_patterns == NULL)
+	{
+		m_patterns = new sinsp_multi_matcher(m_cmpop == CO_CONTAINS_ANY?
+			sinsp_multi_matcher::MM_CONTAINS : sinsp_multi_matcher::MM_PREFIX);
+	}
+
+	if(type == PT_CHARBUF)
+	{
+		m_patterns->add_pattern((char*)&m_val_storage[0], (uint32_t)strlen((char*)&m_val_storage[0]));
+	}
+	else
+	{
+		m_patterns->add_pattern((char*)&m_val_storage[0], m_val_storage_len);
+	}
+}
+
+void sinsp_filter_check::end_list_filter_values()
+{
+	if(m_patterns != NULL)
+	{
+		m_patterns->compile();
+	}
+}
+
+const filtercheck_field_info* sinsp_filter_check::get_field_info()
+{
+	return &m_info.m_fields[m_field_id];
+}
+
+bool sinsp_filter_check::compare(sinsp_evt *evt)
+{
+	uint32_t len;
+	uint8_t* extracted_val = extract_cached(evt, &len);
+
+	if(extracted_val == NULL)
+	{
+		return false;
+	}
+
+	if(m_cmpop == CO_DESCENDANTOF)
+	{
+		return compare_descendantof(*(int64_t*)extracted_val);
+	}
+
+	return compare_rawval(m_info.m_fields[m_field_id].m_type, extracted_val, len);
+}
+
+bool sinsp_filter_check::compare_rawval(ppm_param_type type, void* val, uint32_t len)
+{
+	switch(m_cmpop)
+	{
+	case CO_IN:
+		return m_in_values.contains((uint8_t*)val, len);
+	case CO_CONTAINS:
+		if(m_needle != NULL && (type == PT_CHARBUF || type == PT_BYTEBUF))
+		{
+			if(type == PT_CHARBUF)
+			{
+				return m_needle->find_string((char*)val);
+			}
+			else
+			{
+				return m_needle->find((char*)val, len);
+			}
+		}
+
+		return flt_compare(m_cmpop, type, val, &m_val_storage[0], len, m_val_storage_len);
+	case CO_CONTAINS_ANY:
+	case CO_STARTSWITH_ANY:
+		ASSERT(m_patterns != NULL);
+
+		if(type == PT_CHARBUF)
+		{
+			return m_patterns->match_string((char*)val);
+		}
+		else
+		{
+			return m_patterns->match_buffer((char*)val, len);
+		}
+	case CO_IN_CIDR:
+		ASSERT(m_networks != NULL && type == PT_IPV4ADDR);
+		return m_networks->match_ipv4(*(uint32_t*)val);
+	default:
+		return flt_compare(m_cmpop, type, val, &m_val_storage[0], len, m_val_storage_len);
+	}
+}
+
+flt_cmp_kernel sinsp_filter_check::get_compare_kernel()
+{
+	if(m_cmpop == CO_DESCENDANTOF)
+	{
+		return NULL;
+	}
+	else if(m_cmpop == CO_IN)
+	{
+		return m_in_values.get_kernel();
+	}
+	else if(m_cmpop == CO_CONTAINS_ANY || m_cmpop == CO_STARTSWITH_ANY)
+	{
+		if(m_info.m_fields[m_field_id].m_type == PT_CHARBUF)
+		{
+			return flt_multi_match_string_kernel;
+		}
+		else
+		{
+			return flt_multi_match_buffer_kernel;
+		}
+	}
+	else if(m_cmpop == CO_IN_CIDR)
+	{
+		return flt_network_kernel;
+	}
+	else if(m_cmpop == CO_CONTAINS && m_needle != NULL)
+	{
+		if(m_info.m_fields[m_field_id].m_type == PT_CHARBUF)
+		{
+			return flt_needle_string_kernel;
+		}
+		else
+		{
+			return flt_needle_buffer_kernel;
+		}
+	}
+
+	return flt_get_compare_kernel(m_cmpop, m_info.m_fields[m_field_id].m_type);
+}
+
+void sinsp_filter_check::emit(sinsp_filter_program* program)
+{
+	if(m_cmpop == CO_IN)
+	{
+		program->add_check(this, get_compare_kernel(), &m_in_values, 0);
+	}
+	else if(m_cmpop == CO_CONTAINS_ANY || m_cmpop == CO_STARTSWITH_ANY)
+	{
+		program->add_check(this, get_compare_kernel(), m_patterns, 0);
+	}
+	else if(m_cmpop == CO_IN_CIDR)
+	{
+		program->add_check(this, get_compare_kernel(), m_networks, 0);
+	}
+	else if(m_cmpop == CO_CONTAINS && m_needle != NULL)
+	{
+		program->add_check(this, get_compare_kernel(), m_needle, 0);
+	}
+	else
+	{
+		program->add_check(this, get_compare_kernel(), &m_val_storage[0], m_val_storage_len);
+	}
+}
+
+uint32_t sinsp_filter_check::add_to_set(sinsp_filter_set* set)
+{
+	return set->add_check(this);
+}
+
+void sinsp_filter_check::get_evttypes(OUT vector<bool>* can_be_true, OUT vector<bool>* can_be_false)
+{
+	can_be_true->assign(PPM_EVENT_MAX, true);
+	can_be_false->assign(PPM_EVENT_MAX, true);
+}
+
+static const char* boolop_to_string(boolop op)
+{
+	switch(op)
+	{
+	case BO_NOT:
+		return "not ";
+	case BO_OR:
+		return "or ";
+	case BO_ORNOT:
+		return "or not ";
+	case BO_AND:
+		return "and ";
+	case BO_ANDNOT:
+		return "and not ";
+	default:
+		return "";
+	}
+}
+
+static const char* cmpop_to_string(ppm_cmp_operator op)
+{
+	switch(op)
+	{
+	case CO_EQ:
+		return "=";
+	case CO_NE:
+		return "!=";
+	case CO_LT:
+		return "<";
+	case CO_LE:
+		return "<=";
+	case CO_GT:
+		return ">";
+	case CO_GE:
+		return ">=";
+	case CO_CONTAINS:
+		return "contains";
+	case CO_IN:
+		return "in";
+	case CO_EXISTS:
+		return "exists";
+	case CO_DESCENDANTOF:
+		return "descendantof";
+	case CO_CONTAINS_ANY:
+		return "contains_any";
+	case CO_STARTSWITH_ANY:
+		return "startswith_any";
+	case CO_IN_CIDR:
+		return "in_cidr";
+	default:
+		return "";
+	}
+}
+
+//
+// Print the statistics columns of a line of the stats table
+//
+static void dump_stats_columns(OUT string* out, sinsp_filter_check* chk)
+{
+	char buf[64];
+
+	if(chk->m_nevals == 0)
+	{
+		snprintf(buf, sizeof(buf), "%10d %7s %10s  ", 0, "-", "-");
+	}
+	else
+	{
+		snprintf(buf, sizeof(buf), "%10" PRIu64 " %6.2f%% %10.1f  ",
+			chk->m_nevals,
+			(double)chk->m_ntrue * 100 / chk->m_nevals,
+			(double)chk->m_cost_ns / chk->m_nevals);
+	}
+
+	out->append(buf);
+}
+
+void sinsp_filter_check::dump_stats(OUT string* out, uint32_t depth)
+{
+	dump_stats_columns(out, this);
+	out->append(depth * 2, ' ');
+	out->append(boolop_to_string(m_boolop));
+	out->append((m_field != NULL)? m_field->m_name : "<unknown>");
+	out->append(" ");
+	out->append(cmpop_to_string(m_cmpop));
+	out->append("\n");
+}
+
+bool sinsp_filter_check::compare_descendantof(int64_t pid)
+{
+	sinsp_threadinfo* tinfo = m_inspector->get_thread(pid, false, true);
+
+	if(tinfo == NULL)
+	{
+		return false;
+	}
+
+	return tinfo->is_descendant_of(*(int64_t*)&m_val_storage[0]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_filter_expression implementation
 ///////////////////////////////////////////////////////////////////////////////
 sinsp_filter_expression::sinsp_filter_expression()
 {
 	m_parent = NULL;
 }
 
-sinsp_filter_expression::~sinsp_filter_expression()
+sinsp_filter_expression::~sinsp_filter_expression()
+{
+	uint32_t j;
+
+	for(j = 0; j < m_checks.size(); j++)
+	{
+		delete m_checks[j];
+	}
+}
+
+sinsp_filter_check* sinsp_filter_expression::allocate_new()
+{
+	ASSERT(false);
+	return NULL;
+}
+
+void sinsp_filter_expression::add_check(sinsp_filter_check* chk)
+{
+	m_checks.push_back(chk);
+}
+
+void sinsp_filter_expression::parse(string expr)
+{
+}
+
+bool sinsp_filter_expression::compare(sinsp_evt *evt)
+{
+	return eval(evt, false);
+}
+
+bool sinsp_filter_expression::compare_profiled(sinsp_evt *evt)
+{
+	return eval(evt, true);
+}
+
+inline bool sinsp_filter_expression::eval_check(sinsp_filter_check* chk, sinsp_evt *evt, bool profiled)
+{
+	if(!profiled)
+	{
+		return chk->compare(evt);
+	}
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	bool res = chk->compare_profiled(evt);
+	chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+	chk->m_nevals++;
+	chk->m_ntrue += res;
+	chk->m_cost_ns += chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+
+	return res;
+}
+
+bool sinsp_filter_expression::eval(sinsp_evt *evt, bool profiled)
+{
+	uint32_t j;
+	uint32_t size = (uint32_t)m_checks.size();
+	bool res = true;
+
+	for(j = 0; j < size; j++)
+	{
+		sinsp_filter_check* chk = m_checks[j];
+		ASSERT(chk != NULL);
+
+		if(j == 0)
+		{
+			switch(chk->m_boolop)
+			{
+			case BO_NONE:
+				res = eval_check(chk, evt, profiled);
+				break;
+			case BO_NOT:
+				res = !eval_check(chk, evt, profiled);
+				break;
+			default:
+				ASSERT(false);
+				break;
+			}
+		}
+		else
+		{
+			switch(chk->m_boolop)
+			{
+			case BO_OR:
+				res = res || eval_check(chk, evt, profiled);
+				break;
+			case BO_AND:
+				res = res && eval_check(chk, evt, profiled);
+				break;
+			case BO_ORNOT:
+				res = res || !eval_check(chk, evt, profiled);
+				break;
+			case BO_ANDNOT:
+				res = res && !eval_check(chk, evt, profiled);
+				break;
+			default:
+				ASSERT(false);
+				break;
+			}
+		}
+	}
+
+	return res;
+}
+
+void sinsp_filter_expression::get_evttypes(OUT vector<bool>* can_be_true, OUT vector<bool>* can_be_false)
+{
+	uint32_t j;
+	uint32_t size = (uint32_t)m_checks.size();
+	vector<bool> chk_true;
+	vector<bool> chk_false;
+
+	//
+	// An empty expression accepts everything
+	//
+	can_be_true->assign(PPM_EVENT_MAX, true);
+	can_be_false->assign(PPM_EVENT_MAX, false);
+
+	//
+	// Same left fold as compare(), applied to the sets of event types
+	//
+	for(j = 0; j < size; j++)
+	{
+		sinsp_filter_check* chk = m_checks[j];
+
+		chk->get_evttypes(&chk_true, &chk_false);
+
+		if(chk->m_boolop & BO_NOT)
+		{
+			chk_true.swap(chk_false);
+		}
+
+		if(j == 0)
+		{
+			can_be_true->swap(chk_true);
+			can_be_false->swap(chk_false);
+			continue;
+		}
+
+		for(uint32_t k = 0; k < PPM_EVENT_MAX; k++)
+		{
+			if(chk->m_boolop & BO_AND)
+			{
+				(*can_be_true)[k] = (*can_be_true)[k] && chk_true[k];
+				(*can_be_false)[k] = (*can_be_false)[k] || chk_false[k];
+			}
+			else
+			{
+				(*can_be_true)[k] = (*can_be_true)[k] || chk_true[k];
+				(*can_be_false)[k] = (*can_be_false)[k] && chk_false[k];
+			}
+		}
+	}
+}
+
+//
+// The probability that a check decides the result of a group of checks
+// joined by op, i.e. that it's false in an 'and' group or true in an 'or'
+// group. Checks that were evaluated too few times are considered as free and
+// never deciding, so they don't move.
+//
+static void get_check_model(sinsp_filter_check* chk, uint32_t op, OUT double* cost, OUT double* pdecide)
+{
+	if(chk->m_nevals < 16)
+	{
+		*cost = 0;
+		*pdecide = 0;
+		return;
+	}
+
+	double ptrue = (double)chk->m_ntrue / chk->m_nevals;
+
+	if(chk->m_boolop & BO_NOT)
+	{
+		ptrue = 1 - ptrue;
+	}
+
+	*cost = (double)chk->m_cost_ns / chk->m_nevals;
+	*pdecide = (op == BO_AND)? 1 - ptrue : ptrue;
+}
+
+//
+// The expected cost of evaluating a group of checks in the given order
+//
+static double get_expected_cost(vector<sinsp_filter_check*>* checks, uint32_t op)
+{
+	double res = 0;
+	double preach = 1;
+
+	for(vector<sinsp_filter_check*>::iterator it = checks->begin(); it != checks->end(); ++it)
+	{
+		double cost;
+		double pdecide;
+
+		get_check_model(*it, op, &cost, &pdecide);
+		res += preach * cost;
+		preach *= (1 - pdecide);
+	}
+
+	return res;
+}
+
+static bool check_rank_less(pair<double, sinsp_filter_check*> a, pair<double, sinsp_filter_check*> b)
+{
+	return a.first < b.first;
+}
+
+bool sinsp_filter_expression::reorder_group(uint32_t start, uint32_t end, uint32_t op)
+{
+	uint32_t j;
+
+	if(end - start < 2)
+	{
+		return false;
+	}
+
+	//
+	// Sorting by cost / probability of deciding the result minimizes the
+	// expected cost of the group
+	//
+	vector<sinsp_filter_check*> cur(m_checks.begin() + start, m_checks.begin() + end);
+	vector<pair<double, sinsp_filter_check*> > ranks;
+
+	for(j = 0; j < cur.size(); j++)
+	{
+		double cost;
+		double pdecide;
+
+		get_check_model(cur[j], op, &cost, &pdecide);
+
+		if(pdecide == 0)
+		{
+			ranks.push_back(pair<double, sinsp_filter_check*>(numeric_limits<double>::infinity(), cur[j]));
+		}
+		else
+		{
+			ranks.push_back(pair<double, sinsp_filter_check*>(cost / pdecide, cur[j]));
+		}
+	}
+
+	stable_sort(ranks.begin(), ranks.end(), check_rank_less);
+
+	vector<sinsp_filter_check*> sorted;
+
+	for(j = 0; j < ranks.size(); j++)
+	{
+		sorted.push_back(ranks[j].second);
+	}
+
+	//
+	// Don't bother for small gains, which could just be noise in the
+	// measurements
+	//
+	if(sorted == cur ||
+		get_expected_cost(&sorted, op) > get_expected_cost(&cur, op) * 0.9)
+	{
+		return false;
+	}
+
+	//
+	// The negation stays with the check, the boolean operator with the
+	// position
+	//
+	for(j = start; j < end; j++)
+	{
+		sinsp_filter_check* chk = sorted[j - start];
+		uint32_t newop = (j == 0)? BO_NONE : op;
+
+		chk->m_boolop = (boolop)(newop | (chk->m_boolop & BO_NOT));
+		m_checks[j] = chk;
+	}
+
+	return true;
+}
+
+bool sinsp_filter_expression::reorder()
+{
+	uint32_t j;
+	uint32_t size = (uint32_t)m_checks.size();
+	bool res = false;
+
+	for(j = 0; j < size; j++)
+	{
+		res |= m_checks[j]->reorder();
+	}
+
+	//
+	// The checks are evaluated left to right without precedence, so
+	// 'a or b and c' means '(a or b) and c'. This means that the runs of
+	// consecutive checks joined by the same operator are commutative
+	// groups, and can be reordered freely. The first check belongs to the
+	// group of the second one.
+	//
+	uint32_t start = 0;
+
+	while(start < size)
+	{
+		uint32_t end = start + 1;
+		uint32_t op = (start == 0)?
+			((size > 1)? (m_checks[1]->m_boolop & ~BO_NOT) : BO_NONE) :
+			(m_checks[start]->m_boolop & ~BO_NOT);
+
+		while(end < size && (uint32_t)(m_checks[end]->m_boolop & ~BO_NOT) == op)
+		{
+			end++;
+		}
+
+		res |= reorder_group(start, end, op);
+		start = end;
+	}
+
+	//
+	// Age the statistics, so the order follows changes in the workload
+	//
+	for(j = 0; j < size; j++)
+	{
+		sinsp_filter_check* chk = m_checks[j];
+
+		chk->m_nevals /= 2;
+		chk->m_ntrue /= 2;
+		chk->m_cost_ns /= 2;
+	}
+
+	return res;
+}
+
+void sinsp_filter_expression::dump_stats(OUT string* out, uint32_t depth)
+{
+	uint32_t j;
+	uint32_t size = (uint32_t)m_checks.size();
+
+	//
+	// The root expression has no statistics of its own
+	//
+	if(m_parent != NULL)
+	{
+		dump_stats_columns(out, this);
+		out->append(depth * 2, ' ');
+		out->append(boolop_to_string(m_boolop));
+		out->append("(\n");
+		depth++;
+	}
+
+	for(j = 0; j < size; j++)
+	{
+		m_checks[j]->dump_stats(out, depth);
+	}
+
+	if(m_parent != NULL)
+	{
+		out->append(31, ' ');
+		out->append((depth - 1) * 2, ' ');
+		out->append(")\n");
+	}
+}
+
+uint32_t sinsp_filter_expression::add_to_set(sinsp_filter_set* set)
+{
+	vector<pair<boolop, uint32_t> > children;
+
+	for(vector<sinsp_filter_check*>::iterator it = m_checks.begin(); it != m_checks.end(); ++it)
+	{
+		children.push_back(pair<boolop, uint32_t>((*it)->m_boolop, (*it)->add_to_set(set)));
+	}
+
+	return set->add_expression(children);
+}
+
+void sinsp_filter_expression::emit(sinsp_filter_program* program)
+{
+	uint32_t j;
+	uint32_t size = (uint32_t)m_checks.size();
+
+	for(j = 0; j < size; j++)
+	{
+		sinsp_filter_check* chk = m_checks[j];
+		int64_t jump = -1;
+
+		ASSERT(chk != NULL);
+
+		//
+		// If the result so far already decides the boolean operator, the
+		// check is skipped
+		//
+		if(j != 0)
+		{
+			switch(chk->m_boolop)
+			{
+			case BO_OR:
+			case BO_ORNOT:
+				jump = program->add_jump(sinsp_filter_program::OP_JUMP_IF_TRUE);
+				break;
+			case BO_AND:
+			case BO_ANDNOT:
+				jump = program->add_jump(sinsp_filter_program::OP_JUMP_IF_FALSE);
+				break;
+			default:
+				ASSERT(false);
+				break;
+			}
+		}
+
+		chk->emit(program);
+
+		if(chk->m_boolop & BO_NOT)
+		{
+			program->add_not();
+		}
+
+		if(jump != -1)
+		{
+			program->set_target((uint32_t)jump, program->size());
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_filter_program implementation
+///////////////////////////////////////////////////////////////////////////////
+void sinsp_filter_program::add_check(sinsp_filter_check* chk, flt_cmp_kernel kernel, void* operand2, uint32_t op2_len)
 {
-	uint32_t j;
+	instruction ins;
 
-	for(j = 0; j < m_checks.size(); j++)
+	ins.m_opcode = (kernel != NULL)? OP_KERNEL : OP_COMPARE;
+	ins.m_chk = chk;
+	ins.m_kernel = kernel;
+	ins.m_operand2 = operand2;
+	ins.m_op2_len = op2_len;
+	ins.m_target = 0;
+
+	if(m_evttype != -1)
 	{
-		delete m_checks[j];
+		vector<bool> can_be_true;
+		vector<bool> can_be_false;
+
+		chk->get_evttypes(&can_be_true, &can_be_false);
+
+		if(can_be_true[m_evttype] != can_be_false[m_evttype])
+		{
+			ins.m_opcode = OP_CONST;
+			ins.m_kernel = NULL;
+			ins.m_operand2 = NULL;
+			ins.m_op2_len = can_be_true[m_evttype]? 1 : 0;
+		}
 	}
+
+	m_code.push_back(ins);
 }
 
-sinsp_filter_check* sinsp_filter_expression::allocate_new()
+uint32_t sinsp_filter_program::add_jump(opcode op)
 {
-	ASSERT(false);
-	return NULL;
+	instruction ins;
+
+	ins.m_opcode = op;
+	ins.m_chk = NULL;
+	ins.m_kernel = NULL;
+	ins.m_operand2 = NULL;
+	ins.m_op2_len = 0;
+	ins.m_target = 0;
+
+	m_code.push_back(ins);
+	return (uint32_t)m_code.size() - 1;
 }
 
-void sinsp_filter_expression::add_check(sinsp_filter_check* chk)
+void sinsp_filter_program::add_not()
 {
-	m_checks.push_back(chk);
+	instruction ins;
+
+	ins.m_opcode = OP_NOT;
+	ins.m_chk = NULL;
+	ins.m_kernel = NULL;
+	ins.m_operand2 = NULL;
+	ins.m_op2_len = 0;
+	ins.m_target = 0;
+
+	m_code.push_back(ins);
 }
 
-void sinsp_filter_expression::parse(string expr)
+void sinsp_filter_program::set_target(uint32_t jump, uint32_t target)
 {
+	ASSERT(m_code[jump].m_opcode == OP_JUMP_IF_TRUE || m_code[jump].m_opcode == OP_JUMP_IF_FALSE);
+	m_code[jump].m_target = target;
 }
 
-bool sinsp_filter_expression::compare(sinsp_evt *evt)
+void sinsp_filter_program::optimize()
 {
-	uint32_t j;
-	uint32_t size = (uint32_t)m_checks.size();
-	bool res = true;
+	uint32_t size = (uint32_t)m_code.size();
 
-	for(j = 0; j < size; j++)
+	for(uint32_t j = 0; j < size; j++)
 	{
-		sinsp_filter_check* chk = m_checks[j];
-		ASSERT(chk != NULL);
+		instruction* ins = &m_code[j];
 
-		if(j == 0)
+		if(ins->m_opcode != OP_JUMP_IF_TRUE && ins->m_opcode != OP_JUMP_IF_FALSE)
 		{
-			switch(chk->m_boolop)
+			continue;
+		}
+
+		//
+		// The register doesn't change across jumps, so when a jump lands on
+		// another jump the outcome of the second one is already known.
+		// Targets always move forward, so this terminates.
+		//
+		while(ins->m_target < size)
+		{
+			instruction* dst = &m_code[ins->m_target];
+
+			if(dst->m_opcode == ins->m_opcode)
+			{
+				ins->m_target = dst->m_target;
+			}
+			else if(dst->m_opcode == OP_JUMP_IF_TRUE || dst->m_opcode == OP_JUMP_IF_FALSE)
+			{
+				ins->m_target++;
+			}
+			else
 			{
-			case BO_NONE:
-				res = chk->compare(evt);
-				break;
-			case BO_NOT:
-				res = !chk->compare(evt);
-				break;
-			default:
-				ASSERT(false);
 				break;
 			}
 		}
-		else
+	}
+}
+
+bool sinsp_filter_program::run(sinsp_evt* evt)
+{
+	bool res = true;
+	const instruction* code = m_code.data();
+	uint32_t size = (uint32_t)m_code.size();
+	uint32_t pc = 0;
+
+	while(pc < size)
+	{
+		const instruction* ins = code + pc;
+
+		switch(ins->m_opcode)
 		{
-			switch(chk->m_boolop)
+		case OP_KERNEL:
 			{
-			case BO_OR:
-				res = res || chk->compare(evt);
-				break;
-			case BO_AND:
-				res = res && chk->compare(evt);
-				break;
-			case BO_ORNOT:
-				res = res || !chk->compare(evt);
-				break;
-			case BO_ANDNOT:
-				res = res && !chk->compare(evt);
-				break;
-			default:
-				ASSERT(false);
-				break;
+				uint32_t len;
+				uint8_t* val = ins->m_chk->extract_cached(evt, &len);
+				res = (val != NULL) && ins->m_kernel(val, ins->m_operand2, len, ins->m_op2_len);
+				pc++;
 			}
+			break;
+		case OP_COMPARE:
+			res = ins->m_chk->compare(evt);
+			pc++;
+			break;
+		case OP_NOT:
+			res = !res;
+			pc++;
+			break;
+		case OP_JUMP_IF_TRUE:
+			pc = res? ins->m_target : pc + 1;
+			break;
+		case OP_JUMP_IF_FALSE:
+			pc = res? pc + 1 : ins->m_target;
+			break;
+		case OP_CONST:
+			res = (ins->m_op2_len != 0);
+			pc++;
+			break;
 		}
 	}
 
 	return res;
 }
 
+bool sinsp_filter_program::has_constants()
+{
+	for(vector<instruction>::iterator it = m_code.begin(); it != m_code.end(); ++it)
+	{
+		if(it->m_opcode == OP_CONST)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool sinsp_filter_program::operator==(const sinsp_filter_program& other) const
+{
+	if(m_code.size() != other.m_code.size())
+	{
+		return false;
+	}
+
+	for(uint32_t j = 0; j < m_code.size(); j++)
+	{
+		const instruction* a = &m_code[j];
+		const instruction* b = &other.m_code[j];
+
+		if(a->m_opcode != b->m_opcode || a->m_chk != b->m_chk ||
+			a->m_op2_len != b->m_op2_len || a->m_target != b->m_target)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // sinsp_filter implementation
 ///////////////////////////////////////////////////////////////////////////////
@@ -967,10 +2172,21 @@ sinsp_filter::sinsp_filter(sinsp* inspector, const string& fltstr, bool ttable_o
 	m_curexpr = m_filter;
 	m_last_boolop = BO_NONE;
 	m_nest_level = 0;
+	m_nruns = 0;
+	m_nprofiled = 0;
+
+	//
+	// The expression tree is the reference for the semantics of the filter.
+	// With SYSDIG_FILTER_EVALUATOR=tree, the filter runs it for every event
+	// instead of the compiled programs, so that the two can be compared.
+	//
+	const char* evaluator = getenv("SYSDIG_FILTER_EVALUATOR");
+	m_tree_only = (evaluator != NULL && strcmp(evaluator, "tree") == 0);
 
 	try
 	{
 		compile(fltstr);
+		emit_programs();
 	}
 	catch(sinsp_exception& e)
 	{
@@ -986,12 +2202,96 @@ sinsp_filter::sinsp_filter(sinsp* inspector, const string& fltstr, bool ttable_o
 
 sinsp_filter::~sinsp_filter()
 {
+	for(vector<sinsp_filter_program*>::iterator it = m_specialized_programs.begin();
+		it != m_specialized_programs.end(); ++it)
+	{
+		delete *it;
+	}
+
 	if(m_filter)
 	{
 		delete m_filter;
 	}
 }
 
+void sinsp_filter::emit_programs()
+{
+	m_program = sinsp_filter_program();
+	m_filter->emit(&m_program);
+	m_program.optimize();
+	compile_evttype_dispatch();
+}
+
+void sinsp_filter::compile_evttype_dispatch()
+{
+	vector<bool> can_be_true;
+	vector<bool> can_be_false;
+
+	for(vector<sinsp_filter_program*>::iterator it = m_specialized_programs.begin();
+		it != m_specialized_programs.end(); ++it)
+	{
+		delete *it;
+	}
+
+	m_specialized_programs.clear();
+
+	m_filter->get_evttypes(&can_be_true, &can_be_false);
+
+	m_evttype_verdicts.assign(PPM_EVENT_MAX, EV_RUN);
+	m_evttype_programs.assign(PPM_EVENT_MAX, &m_program);
+
+	for(uint32_t j = 0; j < PPM_EVENT_MAX; j++)
+	{
+		if(!can_be_true[j])
+		{
+			m_evttype_verdicts[j] = EV_REJECT;
+			continue;
+		}
+		else if(!can_be_false[j])
+		{
+			m_evttype_verdicts[j] = EV_ACCEPT;
+			continue;
+		}
+
+		//
+		// Types that still need to run the program get a version of it
+		// where the checks that are decided by the type are constants.
+		// Types that end up with the same program share it.
+		//
+		sinsp_filter_program* program = new sinsp_filter_program();
+		program->set_evttype(j);
+		m_filter->emit(program);
+		program->optimize();
+
+		if(!program->has_constants())
+		{
+			delete program;
+			continue;
+		}
+
+		vector<sinsp_filter_program*>::iterator it;
+		for(it = m_specialized_programs.begin(); it != m_specialized_programs.end(); ++it)
+		{
+			if(**it == *program)
+			{
+				break;
+			}
+		}
+
+		if(it != m_specialized_programs.end())
+		{
+			delete program;
+			program = *it;
+		}
+		else
+		{
+			m_specialized_programs.push_back(program);
+		}
+
+		m_evttype_programs[j] = program;
+	}
+}
+
 bool sinsp_filter::isblank(char c)
 {
 	if(c == ' ' || c == '\t' || c == '\n' || c == '\r')
@@ -1264,6 +2564,21 @@ ppm_cmp_operator sinsp_filter::next_comparison_operator()
 		m_scanpos += 1;
 		return CO_GT;
 	}
+	else if(compare_no_consume("contains_any"))
+	{
+		m_scanpos += 12;
+		return CO_CONTAINS_ANY;
+	}
+	else if(compare_no_consume("startswith_any"))
+	{
+		m_scanpos += 14;
+		return CO_STARTSWITH_ANY;
+	}
+	else if(compare_no_consume("in_cidr"))
+	{
+		m_scanpos += 7;
+		return CO_IN_CIDR;
+	}
 	else if(compare_no_consume("contains"))
 	{
 		m_scanpos += 8;
@@ -1279,12 +2594,28 @@ ppm_cmp_operator sinsp_filter::next_comparison_operator()
 		m_scanpos += 6;
 		return CO_EXISTS;
 	}
+	else if(compare_no_consume("descendantof"))
+	{
+		m_scanpos += 12;
+		return CO_DESCENDANTOF;
+	}
 	else
 	{
 		throw sinsp_exception("filter error: unrecognized comparison operator after " + m_fltstr.substr(0, start));
 	}
 }
 
+//
+// Append a value to the signature of a check. Values are length prefixed, so
+// a list can't be confused with a single value that contains commas.
+//
+static void add_signature_value(sinsp_filter_check* chk, vector<char>* operand)
+{
+	uint32_t len = (uint32_t)operand->size() - 1;
+
+	chk->m_signature += " " + to_string((long long)len) + ":" + string(&(*operand)[0], len);
+}
+
 void sinsp_filter::parse_check(sinsp_filter_expression* parent_expr, boolop op)
 {
 	uint32_t startpos = m_scanpos;
@@ -1311,17 +2642,61 @@ void sinsp_filter::parse_check(sinsp_filter_expression* parent_expr, boolop op)
 	chk->m_boolop = op;
 	chk->m_cmpop = co;
 	chk->parse_field_name((char *)&operand1[0]);
+	chk->m_signature = str_operand1 + " " + cmpop_to_string(co);
 
-	//
-	// In this case we need to create '(field=value1 or field=value2 ...)'
-	//
-	if(co == CO_IN)
+	if(co == CO_DESCENDANTOF)
+	{
+		ppm_param_type type = chk->get_field_info()->m_type;
+
+		if(type != PT_INT64 && type != PT_PID)
+		{
+			throw sinsp_exception("filter error: 'descendantof' can only be applied to process id fields, not to " + str_operand1);
+		}
+	}
+
+	if(co == CO_CONTAINS_ANY || co == CO_STARTSWITH_ANY)
+	{
+		ppm_param_type type = chk->get_field_info()->m_type;
+
+		if(type != PT_CHARBUF && type != PT_BYTEBUF)
+		{
+			throw sinsp_exception("filter error: 'contains_any' and 'startswith_any' can only be applied to string and buffer fields, not to " + str_operand1);
+		}
+	}
+
+	if(co == CO_IN_CIDR)
+	{
+		if(chk->get_field_info()->m_type != PT_IPV4ADDR)
+		{
+			throw sinsp_exception("filter error: 'in_cidr' can only be applied to IP address fields, not to " + str_operand1);
+		}
+	}
+
+	if(co == CO_IN || co == CO_CONTAINS_ANY || co == CO_STARTSWITH_ANY || co == CO_IN_CIDR)
 	{
 		//
-		// Separate the 'or's from the
-		// rest of the conditions
+		// Checks that compare through a plain kernel can probe a set of
+		// values after a single extraction. For 'in', the ones with custom
+		// comparison logic are expanded into
+		// '(field=value1 or field=value2 ...)'.
 		//
-		push_expression(op);
+		bool use_set = true;
+
+		if(co == CO_IN)
+		{
+			chk->m_cmpop = CO_EQ;
+			use_set = (chk->get_compare_kernel() != NULL);
+			chk->m_cmpop = CO_IN;
+		}
+
+		if(!use_set)
+		{
+			//
+			// Separate the 'or's from the
+			// rest of the conditions
+			//
+			push_expression(op);
+		}
 
 		//
 		// Skip spaces
@@ -1333,7 +2708,7 @@ void sinsp_filter::parse_check(sinsp_filter_expression* parent_expr, boolop op)
 
 		if(m_fltstr[m_scanpos] != '(')
 		{
-			throw sinsp_exception("expected '(' after 'in' operand");
+			throw sinsp_exception("expected '(' after '" + string(cmpop_to_string(co)) + "' operand");
 		}
 
 		//
@@ -1345,31 +2720,42 @@ void sinsp_filter::parse_check(sinsp_filter_expression* parent_expr, boolop op)
 		// The first boolean operand will be BO_NONE
 		// Then we will start putting BO_ORs
 		//
-		op = BO_NONE;
+		boolop orop = BO_NONE;
 
-		//
-		// Create the 'or' sequence
-		//
 		while(true)
 		{
 			// 'in' clause aware
 			vector<char> operand2 = next_operand(false, true);
 
-			//
-			// Append every sinsp_filter_check creating the 'or' sequence
-			//
-			sinsp_filter_check* newchk = g_filterlist.new_filter_check_from_another(chk);
-			newchk->m_boolop = op;
-			newchk->m_cmpop = CO_EQ;
-			newchk->parse_filter_value((char *)&operand2[0], (uint32_t)operand2.size() - 1);
-
-			//
-			// We pushed another expression before
-			// so 'parent_expr' still referers to
-			// the old one, this is the new nested
-			// level for the 'or' sequence
-			//
-			m_curexpr->add_check(newchk);
+			if(use_set)
+			{
+				chk->add_list_filter_value((char *)&operand2[0], (uint32_t)operand2.size() - 1);
+				add_signature_value(chk, &operand2);
+			}
+			else
+			{
+				//
+				// Append every sinsp_filter_check creating the 'or' sequence.
+				// The field name is parsed again instead of cloning chk, so
+				// the argument of fields like proc.apid[2] or evt.rawarg.res
+				// is preserved.
+				//
+				sinsp_filter_check* newchk = g_filterlist.new_filter_check_from_fldname(str_operand1, m_inspector, true);
+				newchk->m_boolop = orop;
+				newchk->m_cmpop = CO_EQ;
+				newchk->parse_field_name(str_operand1.c_str());
+				newchk->parse_filter_value((char *)&operand2[0], (uint32_t)operand2.size() - 1);
+				newchk->m_signature = str_operand1 + " =";
+				add_signature_value(newchk, &operand2);
+
+				//
+				// We pushed another expression before
+				// so 'parent_expr' still referers to
+				// the old one, this is the new nested
+				// level for the 'or' sequence
+				//
+				m_curexpr->add_check(newchk);
+			}
 
 			next();
 
@@ -1383,19 +2769,28 @@ void sinsp_filter::parse_check(sinsp_filter_expression* parent_expr, boolop op)
 			}
 			else
 			{
-				throw sinsp_exception("expected either ')' or ',' after a value inside the 'in' clause");
+				throw sinsp_exception("expected either ')' or ',' after a value inside the list");
 			}
 
 			//
 			// From now on we 'or' every newchk
 			//
-			op = BO_OR;
+			orop = BO_OR;
 		}
 
-		//
-		// Come back to the rest of the filter
-		//
-		pop_expression();
+		if(use_set)
+		{
+			chk->end_list_filter_values();
+			parent_expr->add_check(chk);
+		}
+		else
+		{
+			//
+			// Come back to the rest of the filter
+			//
+			pop_expression();
+			delete chk;
+		}
 	}
 	else
 	{
@@ -1415,6 +2810,7 @@ void sinsp_filter::parse_check(sinsp_filter_expression* parent_expr, boolop op)
 		{
 			vector<char> operand2 = next_operand(false, false);
 			chk->parse_filter_value((char *)&operand2[0], (uint32_t)operand2.size() - 1);
+			add_signature_value(chk, &operand2);
 		}
 
 		parent_expr->add_check(chk);
@@ -1556,9 +2952,76 @@ void sinsp_filter::compile(const string& fltstr)
 	vector<string> components = sinsp_split(m_fltstr, ' ');
 }
 
+void sinsp_filter::get_evttypes(OUT vector<bool>* evttypes)
+{
+	vector<bool> can_be_false;
+
+	if(m_tree_only)
+	{
+		evttypes->assign(PPM_EVENT_MAX, true);
+		return;
+	}
+
+	m_filter->get_evttypes(evttypes, &can_be_false);
+}
+
 bool sinsp_filter::run(sinsp_evt *evt)
 {
-	return m_filter->compare(evt);
+	uint16_t etype = evt->get_type();
+
+	if(m_tree_only)
+	{
+		return m_filter->compare(evt);
+	}
+
+	if(etype >= PPM_EVENT_MAX)
+	{
+		return m_program.run(evt);
+	}
+
+	switch(m_evttype_verdicts[etype])
+	{
+	case EV_REJECT:
+		return false;
+	case EV_ACCEPT:
+		return true;
+	default:
+		if((++m_nruns & (FILTER_PROFILE_SAMPLING_RATIO - 1)) == 0)
+		{
+			return run_profiled(evt);
+		}
+
+		return m_evttype_programs[etype]->run(evt);
+	}
+}
+
+bool sinsp_filter::run_profiled(sinsp_evt *evt)
+{
+	bool res = m_filter->compare_profiled(evt);
+
+	if(++m_nprofiled == FILTER_REORDER_SAMPLES)
+	{
+		m_nprofiled = 0;
+
+		if(m_filter->reorder())
+		{
+			emit_programs();
+		}
+	}
+
+	return res;
+}
+
+string sinsp_filter::get_stats()
+{
+	char buf[64];
+	string res;
+
+	snprintf(buf, sizeof(buf), "%10s %7s %10s  %s\n", "evals", "true", "ns/eval", "check");
+	res = buf;
+	m_filter->dump_stats(&res, 0);
+
+	return res;
 }
 
 #endif // HAS_FILTERING
@@ -20,8 +20,16 @@ along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
 
 #ifdef HAS_FILTERING
 
+class sinsp_filter_check;
 class sinsp_filter_expression;
 
+//
+// A comparison kernel compares an extracted value with the filter constant
+// for a specific type and operator, so the filter doesn't need to switch
+// on them for every event
+//
+typedef bool (*flt_cmp_kernel)(void* operand1, void* operand2, uint32_t op1_len, uint32_t op2_len);
+
 enum boolop
 {
 	BO_NONE = 0,
@@ -32,6 +40,87 @@ enum boolop
 	BO_ANDNOT = 5,
 };
 
+///////////////////////////////////////////////////////////////////////////////
+// A filter lowered into a flat sequence of instructions.
+// The instructions operate on a single boolean register, and the boolean
+// operators become conditional jumps that skip the checks that can't
+// change the result.
+///////////////////////////////////////////////////////////////////////////////
+class sinsp_filter_program
+{
+public:
+	enum opcode
+	{
+		OP_KERNEL,			// res = extract() != NULL && kernel(extracted value, constant)
+		OP_COMPARE,			// res = chk->compare(), for checks with custom comparison logic
+		OP_NOT,				// res = !res
+		OP_JUMP_IF_TRUE,	// if(res) go to target
+		OP_JUMP_IF_FALSE,	// if(!res) go to target
+		OP_CONST,			// res = m_op2_len != 0, for checks whose result is known in advance
+	};
+
+	struct instruction
+	{
+		opcode m_opcode;
+		sinsp_filter_check* m_chk;
+		flt_cmp_kernel m_kernel;
+		void* m_operand2;
+		uint32_t m_op2_len;
+		uint32_t m_target;
+	};
+
+	sinsp_filter_program()
+	{
+		m_evttype = -1;
+	}
+
+	//
+	// Specialize the program for an event type: the checks that are always
+	// true or always false for it are emitted as constants
+	//
+	void set_evttype(int32_t evttype)
+	{
+		m_evttype = evttype;
+	}
+
+	//
+	// Emit the instructions for a single check
+	//
+	void add_check(sinsp_filter_check* chk, flt_cmp_kernel kernel, void* operand2, uint32_t op2_len);
+
+	//
+	// Emit a jump and return its index, so that the target can be set
+	// with set_target() once it's known
+	//
+	uint32_t add_jump(opcode op);
+	void add_not();
+	void set_target(uint32_t jump, uint32_t target);
+	uint32_t size()
+	{
+		return (uint32_t)m_code.size();
+	}
+
+	//
+	// Make the jumps that land on other jumps go straight to their
+	// final destination
+	//
+	void optimize();
+
+	bool run(sinsp_evt* evt);
+
+	//
+	// True if the program contains checks that have been turned into
+	// constants
+	//
+	bool has_constants();
+
+	bool operator==(const sinsp_filter_program& other) const;
+
+private:
+	vector<instruction> m_code;
+	int32_t m_evttype;
+};
+
 /** @defgroup filter Filtering events
  * Filtering infrastructure.
  *  @{
@@ -62,9 +151,36 @@ public:
 
 	  \param evt Pointer that needs to be filtered.
 	  \return true if the event is accepted by the filter, false if it's rejected.
+
+	  \note When the SYSDIG_FILTER_EVALUATOR environment variable is set to
+	   tree, the filter walks the expression tree instead of running the
+	   compiled programs, and get_evttypes() flags every event type. This is
+	   slower, and meant to check the programs against the tree.
 	*/
 	bool run(sinsp_evt *evt);
 
+	/*!
+	  \brief Computes the event types that can pass the filter.
+
+	  \param evttypes Receives PPM_EVENT_MAX flags, indexed by event type.
+	   An event type is flagged unless the filter rejects every event of
+	   that type, based only on the evt.type checks.
+	*/
+	void get_evttypes(OUT vector<bool>* evttypes);
+
+	/*!
+	  \brief Returns a table with the runtime statistics of the filter
+	   checks, for debugging.
+
+	  One event every FILTER_PROFILE_SAMPLING_RATIO is evaluated in
+	  profiling mode. For each check, the table shows how many of the
+	  profiled events evaluated it, how often it was true and its average
+	  cost. The checks are shown in their current order, which the filter
+	  adapts to the statistics. The counters are halved every time the order
+	  is reconsidered.
+	*/
+	string get_stats();
+
 private:
 	enum state
 	{
@@ -82,6 +198,9 @@ private:
 	void pop_expression();
 
 	void compile(const string& fltstr);
+	void emit_programs();
+	void compile_evttype_dispatch();
+	bool run_profiled(sinsp_evt *evt);
 
 	static bool isblank(char c);
 	static bool is_special_char(char c);
@@ -89,6 +208,7 @@ private:
 
 	sinsp* m_inspector;
 	bool m_ttable_only;
+	bool m_tree_only;
 
 	string m_fltstr;
 	int32_t m_scanpos;
@@ -99,8 +219,32 @@ private:
 	int32_t m_nest_level;
 
 	sinsp_filter_expression* m_filter;
+	sinsp_filter_program m_program;
+
+	//
+	// Per event type dispatch table. Event types that the filter always
+	// rejects or always accepts are decided by the lookup alone, the others
+	// run the program, specialized for the type when that helps.
+	//
+	enum evttype_verdict
+	{
+		EV_REJECT,
+		EV_ACCEPT,
+		EV_RUN,
+	};
+
+	vector<uint8_t> m_evttype_verdicts;
+	vector<sinsp_filter_program*> m_evttype_programs;
+	vector<sinsp_filter_program*> m_specialized_programs;
+
+	//
+	// Sampling state for the adaptive ordering of the checks
+	//
+	uint64_t m_nruns;
+	uint32_t m_nprofiled;
 
 	friend class sinsp_evt_formatter;
+	friend class sinsp_filter_set;
 };
 
 /*@}*/
@@ -26,6 +26,7 @@ along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
 #ifdef HAS_FILTERING
 #include "filter.h"
 #include "filterchecks.h"
+#include "netmatch.h"
 #include "protodecoder.h"
 
 extern sinsp_evttables g_infotables;
@@ -337,6 +338,11 @@ uint8_t* sinsp_filter_check_fd::extract(sinsp_evt *evt, OUT uint32_t* len)
 			}
 		}
 
+		if(m_fdinfo->m_name.is_clean())
+		{
+			return (uint8_t*)m_fdinfo->m_name.c_str();
+		}
+
 		m_tstr = m_fdinfo->m_name;
 		m_tstr.erase(remove_if(m_tstr.begin(), m_tstr.end(), g_invalidchar()), m_tstr.end());
 		return (uint8_t*)m_tstr.c_str();
@@ -359,6 +365,34 @@ uint8_t* sinsp_filter_check_fd::extract(sinsp_evt *evt, OUT uint32_t* len)
 				return NULL;
 			}
 
+			//
+			// Fast path: the name is clean, so we can use the slash position
+			// that was computed when it was interned
+			//
+			if(m_fdinfo->m_name.is_clean())
+			{
+				const sinsp_fdname& name = m_fdinfo->m_name;
+				size_t pos = name.get_lastslash_pos();
+
+				if(!m_fdinfo->is_file())
+				{
+					return (uint8_t*)name.c_str();
+				}
+				else if(pos == string::npos)
+				{
+					return (uint8_t*)"/";
+				}
+				else if(pos < name.size() - 1)
+				{
+					m_tstr.assign(name.c_str(), pos);
+					return (uint8_t*)m_tstr.c_str();
+				}
+				else
+				{
+					return (uint8_t*)name.c_str();
+				}
+			}
+
 			m_tstr = m_fdinfo->m_name;
 			m_tstr.erase(remove_if(m_tstr.begin(), m_tstr.end(), g_invalidchar()), m_tstr.end());
 
@@ -392,6 +426,21 @@ uint8_t* sinsp_filter_check_fd::extract(sinsp_evt *evt, OUT uint32_t* len)
 				return NULL;
 			}
 
+			if(m_fdinfo->m_name.is_clean())
+			{
+				const sinsp_fdname& name = m_fdinfo->m_name;
+				size_t pos = name.get_lastslash_pos();
+
+				if(pos == string::npos)
+				{
+					return (uint8_t*)"/";
+				}
+				else
+				{
+					return (uint8_t*)name.c_str() + ((pos < name.size() - 1)? pos + 1 : 0);
+				}
+			}
+
 			m_tstr = m_fdinfo->m_name;
 			m_tstr.erase(remove_if(m_tstr.begin(), m_tstr.end(), g_invalidchar()), m_tstr.end());
 
@@ -658,6 +707,47 @@ bool sinsp_filter_check_fd::compare_ip(sinsp_evt *evt)
 	return false;
 }
 
+bool sinsp_filter_check_fd::compare_network(sinsp_evt *evt)
+{
+	if(!extract_fd(evt))
+	{
+		return false;
+	}
+
+	if(m_fdinfo == NULL)
+	{
+		return false;
+	}
+
+	//
+	// fd.ip matches if either end of the connection is in the networks
+	//
+	bool match_client = (m_field_id == TYPE_IP || m_field_id == TYPE_CLIENTIP);
+	bool match_server = (m_field_id == TYPE_IP || m_field_id == TYPE_SERVERIP);
+
+	if(m_field_id != TYPE_IP && m_fdinfo->is_role_none() &&
+		(m_fdinfo->m_type == SCAP_FD_IPV4_SOCK || m_fdinfo->m_type == SCAP_FD_IPV6_SOCK))
+	{
+		return false;
+	}
+
+	switch(m_fdinfo->m_type)
+	{
+	case SCAP_FD_IPV4_SOCK:
+		return (match_client && m_networks->match_ipv4(m_fdinfo->m_sockinfo.m_ipv4info.m_fields.m_sip)) ||
+			(match_server && m_networks->match_ipv4(m_fdinfo->m_sockinfo.m_ipv4info.m_fields.m_dip));
+	case SCAP_FD_IPV4_SERVSOCK:
+		return match_server && m_networks->match_ipv4(m_fdinfo->m_sockinfo.m_ipv4serverinfo.m_ip);
+	case SCAP_FD_IPV6_SOCK:
+		return (match_client && m_networks->match_ipv6(m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_sip)) ||
+			(match_server && m_networks->match_ipv6(m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_dip));
+	case SCAP_FD_IPV6_SERVSOCK:
+		return match_server && m_networks->match_ipv6(m_fdinfo->m_sockinfo.m_ipv6serverinfo.m_ip);
+	default:
+		return false;
+	}
+}
+
 bool sinsp_filter_check_fd::compare_port(sinsp_evt *evt)
 {
 	if(!extract_fd(evt))
@@ -783,12 +873,31 @@ bool sinsp_filter_check_fd::extract_fd(sinsp_evt *evt)
 	return true;
 }
 
+bool sinsp_filter_check_fd::get_extraction_cache_key(OUT int32_t* argid, OUT const string** argname)
+{
+	switch(m_field_id)
+	{
+	case TYPE_FDNAME:
+	case TYPE_DIRECTORY:
+	case TYPE_FILENAME:
+		*argid = 0;
+		*argname = NULL;
+		return true;
+	default:
+		return false;
+	}
+}
+
 bool sinsp_filter_check_fd::compare(sinsp_evt *evt)
 {
 	//
 	// A couple of fields are filter only and therefore get a special treatment
 	//
-	if(m_field_id == TYPE_IP)
+	if(m_cmpop == CO_IN_CIDR)
+	{
+		return compare_network(evt);
+	}
+	else if(m_field_id == TYPE_IP)
 	{
 		return compare_ip(evt);
 	}
@@ -800,18 +909,21 @@ bool sinsp_filter_check_fd::compare(sinsp_evt *evt)
 	//
 	// Standard extract-based fields
 	//
-	uint32_t len;
-	uint8_t* extracted_val = extract(evt, &len);
+	return sinsp_filter_check::compare(evt);
+}
 
-	if(extracted_val == NULL)
+flt_cmp_kernel sinsp_filter_check_fd::get_compare_kernel()
+{
+	//
+	// 'in_cidr' also looks at IPv6 sockets, which can't be extracted as
+	// IPv4 addresses
+	//
+	if(m_field_id == TYPE_IP || m_field_id == TYPE_PORT || m_cmpop == CO_IN_CIDR)
 	{
-		return false;
+		return NULL;
 	}
 
-	return flt_compare(m_cmpop, 
-		m_info.m_fields[m_field_id].m_type, 
-		extracted_val, 
-		&m_val_storage[0]);
+	return sinsp_filter_check::get_compare_kernel();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -863,6 +975,7 @@ sinsp_filter_check_thread::sinsp_filter_check_thread()
 	m_info.m_flags = filter_check_info::FL_WORKS_ON_THREAD_TABLE;
 
 	m_u64val = 0;
+	m_argid = 0;
 }
 
 sinsp_filter_check* sinsp_filter_check_thread::allocate_new()
@@ -1058,11 +1171,11 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len)
 			m_tstr.clear();
 
 			uint32_t j;
-			uint32_t nargs = (uint32_t)tinfo->m_args.size();
+			uint32_t nargs = (uint32_t)tinfo->get_args().size();
 
 			for(j = 0; j < nargs; j++)
 			{
-				m_tstr += tinfo->m_args[j];
+				m_tstr += tinfo->get_args()[j];
 				if(j < nargs -1)
 				{
 					m_tstr += ' ';
@@ -1076,11 +1189,11 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len)
 			m_tstr.clear();
 
 			uint32_t j;
-			uint32_t nargs = (uint32_t)tinfo->m_env.size();
+			uint32_t nargs = (uint32_t)tinfo->get_env().size();
 
 			for(j = 0; j < nargs; j++)
 			{
-				m_tstr += tinfo->m_env[j];
+				m_tstr += tinfo->get_env()[j];
 				if(j < nargs -1)
 				{
 					m_tstr += ' ';
@@ -1094,11 +1207,11 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len)
 			m_tstr = tinfo->get_comm() + " ";
 
 			uint32_t j;
-			uint32_t nargs = (uint32_t)tinfo->m_args.size();
+			uint32_t nargs = (uint32_t)tinfo->get_args().size();
 
 			for(j = 0; j < nargs; j++)
 			{
-				m_tstr += tinfo->m_args[j];
+				m_tstr += tinfo->get_args()[j];
 				if(j < nargs -1)
 				{
 					m_tstr += ' ';
@@ -1204,14 +1317,16 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len)
 			//
 			// Search for a specific ancestors
 			//
-			for(int32_t j = 0; j < m_argid; j++)
+			if(m_argid > 0)
 			{
-				mt = mt->get_parent_thread();
+				const vector<sinsp_threadinfo*>& ancestors = mt->get_ancestors();
 
-				if(mt == NULL)
+				if((size_t)m_argid > ancestors.size())
 				{
 					return NULL;
 				}
+
+				mt = ancestors[m_argid - 1];
 			}
 
 			return (uint8_t*)&mt->m_pid;
@@ -1234,14 +1349,16 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len)
 				}
 			}
 
-			for(int32_t j = 0; j < m_argid; j++)
+			if(m_argid > 0)
 			{
-				mt = mt->get_parent_thread();
+				const vector<sinsp_threadinfo*>& ancestors = mt->get_ancestors();
 
-				if(mt == NULL)
+				if((size_t)m_argid > ancestors.size())
 				{
 					return NULL;
 				}
+
+				mt = ancestors[m_argid - 1];
 			}
 
 			m_tstr = mt->get_comm();
@@ -1266,13 +1383,21 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len)
 				}
 			}
 
-			for(; mt != NULL; mt = mt->get_parent_thread())
+			//
+			// Start from the oldest ancestor, the first shell we find is the
+			// login one
+			//
+			const vector<sinsp_threadinfo*>& ancestors = mt->get_ancestors();
+
+			for(size_t j = ancestors.size() + 1; j > 0; j--)
 			{
-				size_t len = mt->m_comm.size();
+				sinsp_threadinfo* at = (j == 1)? mt : ancestors[j - 2];
+				size_t len = at->m_comm.size();
 
-				if(len >= 2 && mt->m_comm[len - 2] == 's' && mt->m_comm[len - 1] == 'h')
+				if(len >= 2 && at->m_comm[len - 2] == 's' && at->m_comm[len - 1] == 'h')
 				{
-					res = &mt->m_pid;
+					res = &at->m_pid;
+					break;
 				}
 			}
 
@@ -1373,7 +1498,7 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len)
 			m_tstr.clear();
 
 			uint32_t j;
-			uint32_t nargs = (uint32_t)tinfo->m_cgroups.size();
+			uint32_t nargs = (uint32_t)tinfo->get_cgroups().size();
 
 			if(nargs == 0)
 			{
@@ -1382,9 +1507,9 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len)
 			
 			for(j = 0; j < nargs; j++)
 			{
-				m_tstr += tinfo->m_cgroups[j].first;
+				m_tstr += tinfo->get_cgroups()[j].first;
 				m_tstr += "=";
-				m_tstr += tinfo->m_cgroups[j].second;				
+				m_tstr += tinfo->get_cgroups()[j].second;				
 				if(j < nargs - 1)
 				{
 					m_tstr += ' ';
@@ -1395,7 +1520,7 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len)
 		}
 	case TYPE_CGROUP:
 		{
-			uint32_t nargs = (uint32_t)tinfo->m_cgroups.size();
+			uint32_t nargs = (uint32_t)tinfo->get_cgroups().size();
 
 			if(nargs == 0)
 			{
@@ -1404,9 +1529,9 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len)
 			
 			for(uint32_t j = 0; j < nargs; j++)
 			{
-				if(tinfo->m_cgroups[j].first == m_argname)
+				if(tinfo->get_cgroups()[j].first == m_argname)
 				{
-					m_tstr = tinfo->m_cgroups[j].second;
+					m_tstr = tinfo->get_cgroups()[j].second;
 					return (uint8_t*)m_tstr.c_str();					
 				}
 			}
@@ -1435,6 +1560,25 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len)
 	}
 }
 
+bool sinsp_filter_check_thread::get_extraction_cache_key(OUT int32_t* argid, OUT const string** argname)
+{
+	switch(m_field_id)
+	{
+	case TYPE_ARGS:
+	case TYPE_ENV:
+	case TYPE_CMDLINE:
+	case TYPE_PNAME:
+	case TYPE_ANAME:
+	case TYPE_CGROUPS:
+	case TYPE_CGROUP:
+		*argid = m_argid;
+		*argname = &m_argname;
+		return true;
+	default:
+		return false;
+	}
+}
+
 bool sinsp_filter_check_thread::compare_full_apid(sinsp_evt *evt)
 {
 	bool res;
@@ -1466,19 +1610,17 @@ bool sinsp_filter_check_thread::compare_full_apid(sinsp_evt *evt)
 	//
 	// No id specified, search in all of the ancestors
 	//
-	for(j = 0; mt != NULL; mt = mt->get_parent_thread(), j++)
+	const vector<sinsp_threadinfo*>& ancestors = mt->get_ancestors();
+
+	for(j = 0; j < ancestors.size(); j++)
 	{
-		if(j > 0)
-		{
-			res = flt_compare(m_cmpop,
-				PT_PID, 
-				&mt->m_pid, 
-				&m_val_storage[0]);
+		mt = ancestors[j];
 
-			if(res == true)
-			{
-				return true;
-			}
+		res = compare_rawval(PT_PID, &mt->m_pid, 0);
+
+		if(res == true)
+		{
+			return true;
 		}
 	}
 
@@ -1516,19 +1658,17 @@ bool sinsp_filter_check_thread::compare_full_aname(sinsp_evt *evt)
 	//
 	// No id specified, search in all of the ancestors
 	//
-	for(j = 0; mt != NULL; mt = mt->get_parent_thread(), j++)
+	const vector<sinsp_threadinfo*>& ancestors = mt->get_ancestors();
+
+	for(j = 0; j < ancestors.size(); j++)
 	{
-		if(j > 0)
-		{
-			res = flt_compare(m_cmpop,
-				PT_CHARBUF, 
-				(void*)mt->m_comm.c_str(), 
-				&m_val_storage[0]);
+		mt = ancestors[j];
 
-			if(res == true)
-			{
-				return true;
-			}
+		res = compare_rawval(PT_CHARBUF, (void*)mt->m_comm.c_str(), 0);
+
+		if(res == true)
+		{
+			return true;
 		}
 	}
 
@@ -1537,6 +1677,11 @@ bool sinsp_filter_check_thread::compare_full_aname(sinsp_evt *evt)
 
 bool sinsp_filter_check_thread::compare(sinsp_evt *evt)
 {
+	if(m_cmpop == CO_DESCENDANTOF)
+	{
+		return sinsp_filter_check::compare(evt);
+	}
+
 	if(m_field_id == TYPE_APID)
 	{
 		if(m_argid == -1)
@@ -1555,6 +1700,16 @@ bool sinsp_filter_check_thread::compare(sinsp_evt *evt)
 	return sinsp_filter_check::compare(evt);
 }
 
+flt_cmp_kernel sinsp_filter_check_thread::get_compare_kernel()
+{
+	if((m_field_id == TYPE_APID || m_field_id == TYPE_ANAME) && m_argid == -1)
+	{
+		return NULL;
+	}
+
+	return sinsp_filter_check::get_compare_kernel();
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // sinsp_filter_check_event implementation
 ///////////////////////////////////////////////////////////////////////////////
@@ -1602,11 +1757,15 @@ const filtercheck_field_info sinsp_filter_check_event_fields[] =
 sinsp_filter_check_event::sinsp_filter_check_event()
 {
 	m_first_ts = 0;
+	m_ts_sec = 0xffffffffffffffffULL;
+	m_ts_prefix_len = 0;
+	m_ts_str[0] = 0;
 	m_is_compare = false;
 	m_info.m_name = "evt";
 	m_info.m_fields = sinsp_filter_check_event_fields;
 	m_info.m_nfields = sizeof(sinsp_filter_check_event_fields) / sizeof(sinsp_filter_check_event_fields[0]);
 	m_u64val = 0;
+	m_argid = 0;
 }
 
 sinsp_filter_check* sinsp_filter_check_event::allocate_new()
@@ -1844,44 +2003,65 @@ int32_t sinsp_filter_check_event::gmt2local(time_t t)
 	return dt;
 }
 
-void sinsp_filter_check_event::ts_to_string(uint64_t ts, OUT string* res, bool date, bool ns)
+//
+// The date and time part of the string only changes once per second, so it's
+// rendered, together with the lookup of the timezone, when the event is in a
+// different second than the previous one. For the other events, only the
+// nanoseconds are written.
+//
+char* sinsp_filter_check_event::ts_to_string(uint64_t ts, bool date, bool ns)
 {
-	struct tm *tm;
-	time_t Time;
 	uint64_t sec = ts / ONE_SECOND_IN_NS;
-	uint64_t nsec = ts % ONE_SECOND_IN_NS;
-	int32_t thiszone = gmt2local(0);
-	int32_t s = (sec + thiszone) % 86400;
-	int32_t bufsize = 0;
-	char buf[256];
+	uint32_t nsec = (uint32_t)(ts % ONE_SECOND_IN_NS);
 
-	if(date) 
+	if(sec != m_ts_sec)
 	{
-		Time = (sec + thiszone) - s;
-		tm = gmtime (&Time);
-		if(!tm)
+		struct tm *tm;
+		time_t Time;
+		int32_t thiszone = gmt2local(0);
+		int32_t s = (sec + thiszone) % 86400;
+		int32_t bufsize = 0;
+
+		if(date) 
 		{
-			bufsize = sprintf(buf, "<date error> ");
+			Time = (sec + thiszone) - s;
+			tm = gmtime (&Time);
+			if(!tm)
+			{
+				bufsize = sprintf(m_ts_str, "<date error> ");
+			}
+			else
+			{
+				bufsize = sprintf(m_ts_str, "%04d-%02d-%02d ",
+					   tm->tm_year+1900, tm->tm_mon+1, tm->tm_mday);
+			}
 		}
-		else
+
+		bufsize += sprintf(m_ts_str + bufsize, "%02d:%02d:%02d",
+				s / 3600, (s % 3600) / 60, s % 60);
+
+		if(ns)
 		{
-			bufsize = sprintf(buf, "%04d-%02d-%02d ",
-				   tm->tm_year+1900, tm->tm_mon+1, tm->tm_mday);
+			m_ts_str[bufsize] = '.';
+			m_ts_str[bufsize + 10] = 0;
 		}
+
+		m_ts_prefix_len = bufsize;
+		m_ts_sec = sec;
 	}
 
 	if(ns)
 	{
-		sprintf(buf + bufsize, "%02d:%02d:%02d.%09u",
-				s / 3600, (s % 3600) / 60, s % 60, (unsigned)nsec);
-	}
-	else
-	{
-		sprintf(buf + bufsize, "%02d:%02d:%02d",
-				s / 3600, (s % 3600) / 60, s % 60);
+		char* p = m_ts_str + m_ts_prefix_len + 10;
+
+		for(uint32_t j = 0; j < 9; j++)
+		{
+			*--p = (char)('0' + nsec % 10);
+			nsec /= 10;
+		}
 	}
 
-	*res = buf;
+	return m_ts_str;
 }
 
 uint8_t* extract_argraw(sinsp_evt *evt, OUT uint32_t* len, const char *argname)
@@ -2022,7 +2202,7 @@ uint8_t *sinsp_filter_check_event::extract_abspath(sinsp_evt *evt, OUT uint32_t
 			}
 			else
 			{
-				sdir = evt->m_fdinfo->m_name + '/';
+				sdir = evt->m_fdinfo->m_name.str() + '/';
 			}
 		}
 	}
@@ -2068,19 +2248,36 @@ Json::Value sinsp_filter_check_event::extract_as_js(sinsp_evt *evt, OUT uint32_t
 	return Json::Value::null;
 }
 
+//
+// The relative times start from the first event that passed the capture
+// filter, and not from the first event that reached this check, because
+// displayed events can be filtered before being formatted
+//
+void sinsp_filter_check_event::set_first_ts(sinsp_evt *evt)
+{
+	if(m_first_ts == 0)
+	{
+		if(m_inspector != NULL && m_inspector->m_firstacceptedevent_ts != 0)
+		{
+			m_first_ts = m_inspector->m_firstacceptedevent_ts;
+		}
+		else
+		{
+			m_first_ts = evt->get_ts();
+		}
+	}
+}
+
 uint8_t* sinsp_filter_check_event::extract(sinsp_evt *evt, OUT uint32_t* len)
 {
 	switch(m_field_id)
 	{
 	case TYPE_TIME:
-		ts_to_string(evt->get_ts(), &m_strstorage, false, true);
-		return (uint8_t*)m_strstorage.c_str();
+		return (uint8_t*)ts_to_string(evt->get_ts(), false, true);
 	case TYPE_TIME_S:
-		ts_to_string(evt->get_ts(), &m_strstorage, false, false);
-		return (uint8_t*)m_strstorage.c_str();
+		return (uint8_t*)ts_to_string(evt->get_ts(), false, false);
 	case TYPE_DATETIME:
-		ts_to_string(evt->get_ts(), &m_strstorage, true, true);
-		return (uint8_t*)m_strstorage.c_str();
+		return (uint8_t*)ts_to_string(evt->get_ts(), true, true);
 	case TYPE_RAWTS:
 		return (uint8_t*)&evt->m_pevt->ts;
 	case TYPE_RAWTS_S:
@@ -2090,27 +2287,15 @@ uint8_t* sinsp_filter_check_event::extract(sinsp_evt *evt, OUT uint32_t* len)
 		m_u64val = evt->get_ts() % ONE_SECOND_IN_NS;
 		return (uint8_t*)&m_u64val;
 	case TYPE_RELTS:
-		if(m_first_ts == 0)
-		{
-			m_first_ts = evt->get_ts();
-		}
-
+		set_first_ts(evt);
 		m_u64val = evt->get_ts() - m_first_ts;
 		return (uint8_t*)&m_u64val;
 	case TYPE_RELTS_S:
-		if(m_first_ts == 0)
-		{
-			m_first_ts = evt->get_ts();
-		}
-
+		set_first_ts(evt);
 		m_u64val = (evt->get_ts() - m_first_ts) / ONE_SECOND_IN_NS;
 		return (uint8_t*)&m_u64val;
 	case TYPE_RELTS_NS:
-		if(m_first_ts == 0)
-		{
-			m_first_ts = evt->get_ts();
-		}
-
+		set_first_ts(evt);
 		m_u64val = (evt->get_ts() - m_first_ts) % ONE_SECOND_IN_NS;
 		return (uint8_t*)&m_u64val;
 	case TYPE_LATENCY:
@@ -2298,7 +2483,9 @@ uint8_t* sinsp_filter_check_event::extract(sinsp_evt *evt, OUT uint32_t* len)
 					m_strstorage += evt->get_param_name(j);
 					m_strstorage += '=';
 					m_strstorage += argstr;
-					m_strstorage += string("(") + resolved_argstr + ") ";
+					m_strstorage += '(';
+					m_strstorage += resolved_argstr;
+					m_strstorage += ") ";
 				}
 			}
 
@@ -2548,6 +2735,26 @@ uint8_t* sinsp_filter_check_event::extract(sinsp_evt *evt, OUT uint32_t* len)
 	return NULL;
 }
 
+bool sinsp_filter_check_event::get_extraction_cache_key(OUT int32_t* argid, OUT const string** argname)
+{
+	//
+	// evt.abspath is not here because it updates the fd of the event. The
+	// times are not here because they are cheaper to render than to copy.
+	//
+	switch(m_field_id)
+	{
+	case TYPE_ARGS:
+	case TYPE_ARGSTR:
+	case TYPE_INFO:
+	case TYPE_RESSTR:
+		*argid = m_argid;
+		*argname = &m_argname;
+		return true;
+	default:
+		return false;
+	}
+}
+
 bool sinsp_filter_check_event::compare(sinsp_evt *evt)
 {
 	bool res;
@@ -2599,6 +2806,96 @@ bool sinsp_filter_check_event::compare(sinsp_evt *evt)
 	return res;
 }
 
+flt_cmp_kernel sinsp_filter_check_event::get_compare_kernel()
+{
+	//
+	// These fields extract differently when compared, or compare against
+	// something else than the filter constant
+	//
+	if(m_field_id == TYPE_ARGRAW || m_field_id == TYPE_AROUND || m_field_id == TYPE_BUFFER)
+	{
+		return NULL;
+	}
+
+	return sinsp_filter_check::get_compare_kernel();
+}
+
+void sinsp_filter_check_event::get_evttypes(OUT vector<bool>* can_be_true, OUT vector<bool>* can_be_false)
+{
+	if(m_field_id != TYPE_TYPE)
+	{
+		return sinsp_filter_check::get_evttypes(can_be_true, can_be_false);
+	}
+
+	//
+	// The result is cached, since the filter asks for it once per event type
+	// when building its dispatch table
+	//
+	if(!m_evttypes_true.empty())
+	{
+		*can_be_true = m_evttypes_true;
+		*can_be_false = m_evttypes_false;
+		return;
+	}
+
+	//
+	// evt.type only depends on the event type, so the check can be evaluated
+	// on the names in the event table
+	//
+	sinsp_evttables* einfo = m_inspector->get_event_info_tables();
+	const struct ppm_event_info* etable = einfo->m_event_info;
+	const struct ppm_syscall_desc* stable = einfo->m_syscall_info_table;
+
+	can_be_true->assign(PPM_EVENT_MAX, false);
+	can_be_false->assign(PPM_EVENT_MAX, false);
+
+	try
+	{
+		for(uint32_t j = 0; j < PPM_EVENT_MAX; j++)
+		{
+			if(j == PPME_GENERIC_E || j == PPME_GENERIC_X)
+			{
+				//
+				// The type of the generic events is the name of the syscall
+				//
+				for(uint32_t k = 0; k < PPM_SC_MAX; k++)
+				{
+					if(stable[k].name == NULL)
+					{
+						continue;
+					}
+
+					if(compare_rawval(PT_CHARBUF, stable[k].name, 0))
+					{
+						(*can_be_true)[j] = true;
+					}
+					else
+					{
+						(*can_be_false)[j] = true;
+					}
+				}
+			}
+			else
+			{
+				bool res = compare_rawval(PT_CHARBUF, (void*)etable[j].name, 0);
+				(*can_be_true)[j] = res;
+				(*can_be_false)[j] = !res;
+			}
+		}
+	}
+	catch(sinsp_exception&)
+	{
+		//
+		// Operators that are not supported for strings fail when the
+		// filter runs, not here
+		//
+		sinsp_filter_check::get_evttypes(can_be_true, can_be_false);
+	}
+
+	m_evttypes_true = *can_be_true;
+	m_evttypes_false = *can_be_false;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // sinsp_filter_check_user implementation
 ///////////////////////////////////////////////////////////////////////////////
@@ -26,9 +26,65 @@ along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
 	throw sinsp_exception("filter error: value too long: " + val); \
 }
 
+class sinsp_multi_matcher;
+class sinsp_substring_search;
+class sinsp_network_set;
+class sinsp_filter_set;
+
 bool flt_compare(ppm_cmp_operator op, ppm_param_type type, void* operand1, void* operand2, uint32_t op1_len = 0, uint32_t op2_len = 0);
+flt_cmp_kernel flt_get_compare_kernel(ppm_cmp_operator op, ppm_param_type type);
 char* flt_to_string(uint8_t* rawval, filtercheck_field_info* finfo);
 
+///////////////////////////////////////////////////////////////////////////////
+// The set of constants of an 'in' check.
+// The values are stored in hash tables keyed by their normalized value, so
+// the field is extracted once and membership is a single probe, no matter
+// how many values the clause lists.
+///////////////////////////////////////////////////////////////////////////////
+class sinsp_filter_value_set
+{
+public:
+	sinsp_filter_value_set();
+
+	//
+	// Add a value in the raw format produced by parse_filter_value()
+	//
+	void add(ppm_param_type type, uint8_t* val, uint32_t len);
+
+	//
+	// Check if an extracted value is in the set
+	//
+	bool contains(uint8_t* val, uint32_t len)
+	{
+		return m_kernel(val, this, len, 0);
+	}
+
+	//
+	// The kernel that probes the set. Its second operand is the set itself.
+	//
+	flt_cmp_kernel get_kernel()
+	{
+		return m_kernel;
+	}
+
+	size_t size()
+	{
+		return m_nums.size() + m_strs.size();
+	}
+
+	//
+	// Numeric values, widened to 64 bits like flt_compare() does
+	//
+	unordered_set<uint64_t> m_nums;
+	//
+	// Strings and buffers, keyed by their hash
+	//
+	unordered_multimap<uint64_t, string> m_strs;
+
+private:
+	flt_cmp_kernel m_kernel;
+};
+
 class operand_info
 {
 public:
@@ -48,9 +104,7 @@ class sinsp_filter_check
 public:
 	sinsp_filter_check();
 	
-	virtual ~sinsp_filter_check()
-	{
-	}
+	virtual ~sinsp_filter_check();
 
 	//
 	// Allocate a new check of the same type.
@@ -79,6 +133,18 @@ public:
 	//
 	virtual void parse_filter_value(const char* str, uint32_t len);
 
+	//
+	// Parse one of the values of an 'in', 'contains_any', 'startswith_any'
+	// or 'in_cidr' clause and add it to the constants of this check
+	//
+	void add_list_filter_value(const char* str, uint32_t len);
+
+	//
+	// Called after the last value of the list, to build the structures
+	// that match the values
+	//
+	void end_list_filter_values();
+
 	//
 	// Return the info about the field that this instance contains 
 	//
@@ -89,6 +155,34 @@ public:
 	//
 	virtual uint8_t* extract(sinsp_evt *evt, OUT uint32_t* len) = 0;
 
+	//
+	// Same as extract(), but the expensive string fields go through the
+	// extraction cache of the event, so that the checks that extract the
+	// same field from the same event, like the ones of a filter, of a
+	// formatter and of a chisel, share the work
+	//
+	inline uint8_t* extract_cached(sinsp_evt *evt, OUT uint32_t* len)
+	{
+		if(m_cache_mode == CM_UNCACHED)
+		{
+			return extract(evt, len);
+		}
+
+		return extract_through_cache(evt, len);
+	}
+
+	//
+	// Return true if the field is worth sharing through the extraction
+	// cache of the event: it must be expensive to extract, and its value
+	// must only depend on the event and on the argument of the field.
+	// The argument is part of the cache key, and is returned in argid and
+	// argname. By default fields are not cached.
+	//
+	virtual bool get_extraction_cache_key(OUT int32_t* argid, OUT const string** argname)
+	{
+		return false;
+	}
+
 	//
 	// Extract the field as json from the event (by default, fall
 	// back to the regular extract functionality)
@@ -103,6 +197,54 @@ public:
 	//
 	virtual bool compare(sinsp_evt *evt);
 
+	//
+	// Return the kernel that compare() uses for this check, or NULL if the
+	// check has custom comparison logic and compare() must be called
+	//
+	virtual flt_cmp_kernel get_compare_kernel();
+
+	//
+	// Append the instructions that evaluate this check to a compiled filter
+	//
+	virtual void emit(sinsp_filter_program* program);
+
+	//
+	// Add this check to the graph of a filter set, and return its node
+	//
+	virtual uint32_t add_to_set(sinsp_filter_set* set);
+
+	//
+	// Compute the event types for which this check can be true and the ones
+	// for which it can be false. Both are vectors of PPM_EVENT_MAX flags.
+	// By default a check can be anything for any event type.
+	//
+	virtual void get_evttypes(OUT vector<bool>* can_be_true, OUT vector<bool>* can_be_false);
+
+	//
+	// Same as compare(), but also updates the runtime statistics of the
+	// checks below this one
+	//
+	virtual bool compare_profiled(sinsp_evt *evt)
+	{
+		return compare(evt);
+	}
+
+	//
+	// Reorder the checks below this one according to their runtime
+	// statistics, so that the cheap and selective ones run first, and age
+	// the statistics. Returns true if the order changed.
+	//
+	virtual bool reorder()
+	{
+		return false;
+	}
+
+	//
+	// Append a human readable description of this check and of its runtime
+	// statistics to out
+	//
+	virtual void dump_stats(OUT string* out, uint32_t depth);
+
 	//
 	// Extract the value from the event and convert it into a string
 	//
@@ -118,13 +260,46 @@ public:
 	boolop m_boolop;
 	ppm_cmp_operator m_cmpop;
 
+	//
+	// Runtime statistics, collected by the parent expression on a sample of
+	// the events: number of evaluations, how many of them were true, and
+	// their total cost in nanoseconds
+	//
+	uint64_t m_nevals;
+	uint64_t m_ntrue;
+	uint64_t m_cost_ns;
+
+	//
+	// Canonical form of the check as written in the filter, i.e. field,
+	// operator and values. Two checks with the same signature are
+	// interchangeable, which is how filter sets find the checks they can
+	// share.
+	//
+	string m_signature;
+
 protected:
 	char* rawval_to_string(uint8_t* rawval, const filtercheck_field_info* finfo, uint32_t len);
 	Json::Value rawval_to_json(uint8_t* rawval, const filtercheck_field_info* finfo, uint32_t len);
 	void string_to_rawval(const char* str, uint32_t len, ppm_param_type ptype);
+	bool compare_descendantof(int64_t pid);
+	//
+	// Compare an extracted value with the constant, or the constants, of
+	// this check, according to the operator
+	//
+	bool compare_rawval(ppm_param_type type, void* val, uint32_t len);
 
 	char m_getpropertystr_storage[1024];
 	vector<uint8_t> m_val_storage;
+	sinsp_filter_value_set m_in_values;
+	sinsp_multi_matcher* m_patterns;
+	//
+	// The preprocessed constant of 'contains' on strings and buffers
+	//
+	sinsp_substring_search* m_needle;
+	//
+	// The networks of 'in_cidr'
+	//
+	sinsp_network_set* m_networks;
 	const filtercheck_field_info* m_field;
 	filter_check_info m_info;
 	uint32_t m_field_id;
@@ -132,7 +307,22 @@ protected:
 	uint32_t m_val_storage_len;
 
 private:
+	enum cache_mode
+	{
+		CM_UNKNOWN,
+		CM_CACHED,
+		CM_UNCACHED,
+	};
+
 	void set_inspector(sinsp* inspector);
+	uint8_t* extract_through_cache(sinsp_evt *evt, OUT uint32_t* len);
+
+	//
+	// Resolved at the first extraction, when the field is known
+	//
+	cache_mode m_cache_mode;
+	int32_t m_cache_argid;
+	const string* m_cache_argname;
 
 friend class sinsp_filter_check_list;
 };
@@ -170,6 +360,12 @@ public:
 	// does nothing for sinsp_filter_expression
 	void parse(string expr);
 	bool compare(sinsp_evt *evt);
+	void emit(sinsp_filter_program* program);
+	uint32_t add_to_set(sinsp_filter_set* set);
+	void get_evttypes(OUT vector<bool>* can_be_true, OUT vector<bool>* can_be_false);
+	bool compare_profiled(sinsp_evt *evt);
+	bool reorder();
+	void dump_stats(OUT string* out, uint32_t depth);
 
 	//
 	// The following methods are part of the filter check interface but are irrelevant
@@ -200,6 +396,11 @@ public:
 
 	sinsp_filter_expression* m_parent;
 	vector<sinsp_filter_check*> m_checks;
+
+private:
+	bool eval(sinsp_evt *evt, bool profiled);
+	bool eval_check(sinsp_filter_check* chk, sinsp_evt *evt, bool profiled);
+	bool reorder_group(uint32_t start, uint32_t end, uint32_t op);
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -251,9 +452,12 @@ public:
 	sinsp_filter_check* allocate_new();
 	int32_t parse_field_name(const char* str);
 	uint8_t* extract(sinsp_evt *evt, OUT uint32_t* len);
+	bool get_extraction_cache_key(OUT int32_t* argid, OUT const string** argname);
 	bool compare_ip(sinsp_evt *evt);
+	bool compare_network(sinsp_evt *evt);
 	bool compare_port(sinsp_evt *evt);
 	bool compare(sinsp_evt *evt);
+	flt_cmp_kernel get_compare_kernel();
 
 	sinsp_threadinfo* m_tinfo;
 	sinsp_fdinfo_t* m_fdinfo;
@@ -316,7 +520,9 @@ public:
 	sinsp_filter_check* allocate_new();
 	int32_t parse_field_name(const char* str);
 	uint8_t* extract(sinsp_evt *evt, OUT uint32_t* len);
+	bool get_extraction_cache_key(OUT int32_t* argid, OUT const string** argname);
 	bool compare(sinsp_evt *evt);
+	flt_cmp_kernel get_compare_kernel();
 
 private:
 	uint64_t extract_exectime(sinsp_evt *evt);
@@ -386,8 +592,12 @@ public:
 	void parse_filter_value(const char* str, uint32_t len);
 	const filtercheck_field_info* get_field_info();
 	uint8_t* extract(sinsp_evt *evt, OUT uint32_t* len);
+	bool get_extraction_cache_key(OUT int32_t* argid, OUT const string** argname);
 	Json::Value extract_as_js(sinsp_evt *evt, OUT uint32_t* len);
 	bool compare(sinsp_evt *evt);
+	flt_cmp_kernel get_compare_kernel();
+	void get_evttypes(OUT vector<bool>* can_be_true, OUT vector<bool>* can_be_false);
+	void set_first_ts(sinsp_evt *evt);
 
 	uint64_t m_first_ts;
 	uint64_t m_u64val;
@@ -406,10 +616,19 @@ public:
 private:
 	int32_t extract_arg(string fldname, string val, OUT const struct ppm_param_info** parinfo);
 	int32_t gmt2local(time_t t);
-	void ts_to_string(uint64_t ts, OUT string* res, bool full, bool ns);
+	char* ts_to_string(uint64_t ts, bool date, bool ns);
 	uint8_t *extract_abspath(sinsp_evt *evt, OUT uint32_t *len);
 
 	bool m_is_compare;
+	//
+	// Rendering of the last timestamp, whose part up to the seconds is
+	// reused for the events in the same second
+	//
+	uint64_t m_ts_sec;
+	uint32_t m_ts_prefix_len;
+	char m_ts_str[64];
+	vector<bool> m_evttypes_true;
+	vector<bool> m_evttypes_false;
 };
 
 //
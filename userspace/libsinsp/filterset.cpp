@@ -0,0 +1,401 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+
+#ifdef HAS_FILTERING
+#include "filter.h"
+#include "filterchecks.h"
+#include "filterset.h"
+
+sinsp_filter_set::sinsp_filter_set()
+{
+	m_dirty = false;
+	m_stamp = 0;
+	m_last_evt = NULL;
+	m_last_evtnum = 0;
+	m_last_ts = 0;
+	m_last_mask = 0;
+}
+
+sinsp_filter_set::~sinsp_filter_set()
+{
+	clear_nodes();
+}
+
+int32_t sinsp_filter_set::add(sinsp_filter* filter)
+{
+	uint32_t j;
+
+	m_dirty = true;
+
+	for(j = 0; j < m_filters.size(); j++)
+	{
+		if(m_filters[j] == NULL)
+		{
+			m_filters[j] = filter;
+			return j;
+		}
+	}
+
+	if(m_filters.size() == MAX_FILTERS)
+	{
+		return -1;
+	}
+
+	m_filters.push_back(filter);
+	return (int32_t)m_filters.size() - 1;
+}
+
+void sinsp_filter_set::remove(int32_t id)
+{
+	ASSERT(id >= 0 && id < (int32_t)m_filters.size());
+
+	m_filters[id] = NULL;
+	m_dirty = true;
+}
+
+uint32_t sinsp_filter_set::add_check(sinsp_filter_check* chk)
+{
+	//
+	// Checks that don't come from the parser have no signature, and are
+	// never shared
+	//
+	string key;
+
+	if(chk->m_signature.empty())
+	{
+		key = "P" + to_string((long long)(uintptr_t)chk);
+	}
+	else
+	{
+		key = "C" + chk->m_signature;
+	}
+
+	unordered_map<string, uint32_t>::iterator it = m_node_ids.find(key);
+
+	if(it != m_node_ids.end())
+	{
+		return it->second;
+	}
+
+	node n;
+	n.m_program = new sinsp_filter_program();
+	chk->emit(n.m_program);
+
+	vector<bool> can_be_true;
+	vector<bool> can_be_false;
+
+	chk->get_evttypes(&can_be_true, &can_be_false);
+
+	for(uint32_t j = 0; j < can_be_true.size(); j++)
+	{
+		if(!can_be_true[j] || !can_be_false[j])
+		{
+			n.m_evttype_results.resize(can_be_true.size());
+
+			for(j = 0; j < can_be_true.size(); j++)
+			{
+				n.m_evttype_results[j] = (can_be_true[j] && can_be_false[j])? 2 : can_be_true[j];
+			}
+
+			break;
+		}
+	}
+
+	m_nodes.push_back(n);
+
+	uint32_t id = (uint32_t)m_nodes.size() - 1;
+	m_node_ids[key] = id;
+	return id;
+}
+
+uint32_t sinsp_filter_set::add_expression(const vector<pair<boolop, uint32_t> >& children)
+{
+	//
+	// The children are already deduplicated, so two expressions are the
+	// same if they have the same operators and the same children
+	//
+	string key = "E";
+
+	for(vector<pair<boolop, uint32_t> >::const_iterator it = children.begin(); it != children.end(); ++it)
+	{
+		key += to_string((long long)it->first) + ":" + to_string((long long)it->second) + ",";
+	}
+
+	unordered_map<string, uint32_t>::iterator it = m_node_ids.find(key);
+
+	if(it != m_node_ids.end())
+	{
+		return it->second;
+	}
+
+	node n;
+	n.m_program = NULL;
+	n.m_children = children;
+	m_nodes.push_back(n);
+
+	uint32_t id = (uint32_t)m_nodes.size() - 1;
+	m_node_ids[key] = id;
+	return id;
+}
+
+uint32_t sinsp_filter_set::get_n_nodes()
+{
+	if(m_dirty)
+	{
+		build();
+	}
+
+	return (uint32_t)m_nodes.size();
+}
+
+void sinsp_filter_set::clear_nodes()
+{
+	for(vector<node>::iterator it = m_nodes.begin(); it != m_nodes.end(); ++it)
+	{
+		if(it->m_program != NULL)
+		{
+			delete it->m_program;
+		}
+	}
+
+	m_nodes.clear();
+}
+
+void sinsp_filter_set::build()
+{
+	clear_nodes();
+	m_node_ids.clear();
+	m_roots.clear();
+
+	for(vector<sinsp_filter*>::iterator it = m_filters.begin(); it != m_filters.end(); ++it)
+	{
+		if(*it == NULL)
+		{
+			m_roots.push_back(0);
+			continue;
+		}
+
+		m_roots.push_back((*it)->m_filter->add_to_set(this));
+	}
+
+	//
+	// Filters that don't share any node with the others gain nothing from
+	// the graph, and are run on their own, through their per event type
+	// programs
+	//
+	vector<int32_t> owners(m_nodes.size(), -1);
+
+	for(uint32_t j = 0; j < m_roots.size(); j++)
+	{
+		if(m_filters[j] != NULL)
+		{
+			mark_owner(m_roots[j], j, &owners);
+		}
+	}
+
+	m_standalone.assign(m_roots.size(), false);
+
+	for(uint32_t j = 0; j < m_roots.size(); j++)
+	{
+		if(m_filters[j] != NULL)
+		{
+			m_standalone[j] = is_owned_by(m_roots[j], j, owners);
+		}
+	}
+
+	m_stamps.assign(m_nodes.size(), 0);
+	m_results.assign(m_nodes.size(), 0);
+	m_stamp = 0;
+	m_last_evt = NULL;
+	m_dirty = false;
+}
+
+void sinsp_filter_set::mark_owner(uint32_t id, int32_t owner, vector<int32_t>* owners)
+{
+	int32_t& cur = (*owners)[id];
+
+	if(cur == owner || cur == SHARED)
+	{
+		return;
+	}
+
+	cur = (cur == -1)? owner : SHARED;
+
+	for(uint32_t j = 0; j < m_nodes[id].m_children.size(); j++)
+	{
+		mark_owner(m_nodes[id].m_children[j].second, owner, owners);
+	}
+}
+
+bool sinsp_filter_set::is_owned_by(uint32_t id, int32_t owner, const vector<int32_t>& owners)
+{
+	if(owners[id] != owner)
+	{
+		return false;
+	}
+
+	for(uint32_t j = 0; j < m_nodes[id].m_children.size(); j++)
+	{
+		if(!is_owned_by(m_nodes[id].m_children[j].second, owner, owners))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool sinsp_filter_set::eval(uint32_t id, sinsp_evt* evt, uint16_t etype)
+{
+	if(m_stamps[id] == m_stamp)
+	{
+		return m_results[id] != 0;
+	}
+
+	node* n = &m_nodes[id];
+	bool res = true;
+
+	if(n->m_program != NULL)
+	{
+		if(etype < n->m_evttype_results.size() && n->m_evttype_results[etype] != 2)
+		{
+			res = (n->m_evttype_results[etype] != 0);
+		}
+		else
+		{
+			res = n->m_program->run(evt);
+		}
+	}
+	else
+	{
+		//
+		// Same logic as sinsp_filter_expression::compare()
+		//
+		uint32_t size = (uint32_t)n->m_children.size();
+
+		for(uint32_t j = 0; j < size; j++)
+		{
+			boolop op = n->m_children[j].first;
+			uint32_t child = n->m_children[j].second;
+
+			switch(op)
+			{
+			case BO_NONE:
+				res = eval(child, evt, etype);
+				break;
+			case BO_NOT:
+				res = !eval(child, evt, etype);
+				break;
+			case BO_OR:
+				res = res || eval(child, evt, etype);
+				break;
+			case BO_AND:
+				res = res && eval(child, evt, etype);
+				break;
+			case BO_ORNOT:
+				res = res || !eval(child, evt, etype);
+				break;
+			case BO_ANDNOT:
+				res = res && !eval(child, evt, etype);
+				break;
+			default:
+				ASSERT(false);
+				break;
+			}
+		}
+	}
+
+	m_stamps[id] = m_stamp;
+	m_results[id] = res;
+
+	return res;
+}
+
+uint64_t sinsp_filter_set::run(sinsp_evt* evt)
+{
+	uint64_t res = 0;
+	uint16_t etype = evt->get_type();
+
+	if(m_dirty)
+	{
+		build();
+	}
+
+	//
+	// A new stamp invalidates the results of the previous event
+	//
+	if(++m_stamp == 0)
+	{
+		m_stamps.assign(m_nodes.size(), 0);
+		m_stamp = 1;
+	}
+
+	for(uint32_t j = 0; j < m_filters.size(); j++)
+	{
+		sinsp_filter* filter = m_filters[j];
+
+		if(filter == NULL)
+		{
+			continue;
+		}
+
+		if(m_standalone[j])
+		{
+			if(filter->run(evt))
+			{
+				res |= ((uint64_t)1 << j);
+			}
+
+			continue;
+		}
+
+		//
+		// The event type dispatch of the filter decides most events without
+		// looking at the graph
+		//
+		uint8_t verdict = (etype < filter->m_evttype_verdicts.size())?
+			filter->m_evttype_verdicts[etype] : (uint8_t)sinsp_filter::EV_RUN;
+
+		if(verdict == sinsp_filter::EV_ACCEPT ||
+			(verdict == sinsp_filter::EV_RUN && eval(m_roots[j], evt, etype)))
+		{
+			res |= ((uint64_t)1 << j);
+		}
+	}
+
+	return res;
+}
+
+bool sinsp_filter_set::run(sinsp_evt* evt, int32_t id)
+{
+	if(m_dirty || evt != m_last_evt ||
+		evt->get_num() != m_last_evtnum || evt->get_ts() != m_last_ts)
+	{
+		m_last_mask = run(evt);
+		m_last_evt = evt;
+		m_last_evtnum = evt->get_num();
+		m_last_ts = evt->get_ts();
+	}
+
+	return (m_last_mask & ((uint64_t)1 << id)) != 0;
+}
+
+#endif // HAS_FILTERING
@@ -0,0 +1,134 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifdef HAS_FILTERING
+
+class sinsp_filter_check;
+
+///////////////////////////////////////////////////////////////////////////////
+// A set of filters that are evaluated together on the same events, like the
+// ones of the chisels.
+// The filters are merged into a single graph, where identical checks and
+// identical subexpressions are shared. Every node of the graph is evaluated
+// at most once per event, no matter how many filters contain it, and the
+// result is a bitmask of the filters that accept the event.
+// The set doesn't own the filters, which must stay alive while they are in
+// the set.
+///////////////////////////////////////////////////////////////////////////////
+class SINSP_PUBLIC sinsp_filter_set
+{
+public:
+	sinsp_filter_set();
+	~sinsp_filter_set();
+
+	//
+	// Add a filter. Returns its bit in the masks returned by run(), or -1
+	// if the set is full.
+	//
+	int32_t add(sinsp_filter* filter);
+
+	//
+	// Remove the filter with the given id
+	//
+	void remove(int32_t id);
+
+	//
+	// Evaluate all the filters on the event, and return the mask of the ones
+	// that accept it
+	//
+	uint64_t run(sinsp_evt* evt);
+
+	//
+	// True if the filter with the given id accepts the event. The filters
+	// are evaluated once per event, and the following calls for the same
+	// event, e.g. from the other chisels, just look at the mask.
+	//
+	bool run(sinsp_evt* evt, int32_t id);
+
+	//
+	// Called by the checks while the graph is built, see
+	// sinsp_filter_check::add_to_set()
+	//
+	uint32_t add_check(sinsp_filter_check* chk);
+	uint32_t add_expression(const vector<pair<boolop, uint32_t> >& children);
+
+	//
+	// Number of distinct checks and expressions in the graph, for debugging
+	//
+	uint32_t get_n_nodes();
+
+	static const uint32_t MAX_FILTERS = 64;
+
+private:
+	struct node
+	{
+		//
+		// For checks, the check compiled on its own, so that it's evaluated
+		// through its kernel like in a filter program. NULL for expressions.
+		//
+		sinsp_filter_program* m_program;
+		//
+		// For checks that depend on the event type, their result for every
+		// type: 0 false, 1 true, 2 depends on the event
+		//
+		vector<uint8_t> m_evttype_results;
+		vector<pair<boolop, uint32_t> > m_children;
+	};
+
+	static const int32_t SHARED = -2;
+
+	void clear_nodes();
+	void build();
+	void mark_owner(uint32_t id, int32_t owner, vector<int32_t>* owners);
+	bool is_owned_by(uint32_t id, int32_t owner, const vector<int32_t>& owners);
+	bool eval(uint32_t id, sinsp_evt* evt, uint16_t etype);
+
+	vector<sinsp_filter*> m_filters;
+	bool m_dirty;
+
+	//
+	// The graph, and the root node of each filter
+	//
+	vector<node> m_nodes;
+	unordered_map<string, uint32_t> m_node_ids;
+	vector<uint32_t> m_roots;
+	//
+	// True for the filters that don't share any node with the others
+	//
+	vector<bool> m_standalone;
+
+	//
+	// Results of the nodes for the current event. A node has a valid result
+	// if its stamp is the current one.
+	//
+	vector<uint32_t> m_stamps;
+	vector<uint8_t> m_results;
+	uint32_t m_stamp;
+
+	//
+	// The event that the last mask refers to
+	//
+	sinsp_evt* m_last_evt;
+	uint64_t m_last_evtnum;
+	uint64_t m_last_ts;
+	uint64_t m_last_mask;
+};
+
+#endif // HAS_FILTERING
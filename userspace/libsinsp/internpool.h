@@ -0,0 +1,149 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+
+//
+// The pool is purged of unreferenced entries when it reaches this size,
+// and after that every time it doubles
+//
+#define INTERN_POOL_MIN_PURGE_SIZE 1024
+
+//
+// FNV-1a, good enough for short keys and doesn't require building a string
+//
+static inline uint64_t sinsp_intern_hash(const char* buf, size_t len)
+{
+	uint64_t res = 14695981039346656037ULL;
+
+	for(size_t j = 0; j < len; j++)
+	{
+		res ^= (uint8_t)buf[j];
+		res *= 1099511628211ULL;
+	}
+
+	return res;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Refcounted pool of immutable objects built from raw buffers.
+// Interning the same buffer twice returns a handle to the same object, so
+// state that is identical across many threads (command line arguments,
+// environment, cgroups...) is allocated once and shared by copying the
+// handle.
+//
+// The pool is not thread safe: intern(), purge() and size() must all be
+// called from the same thread, normally the one that parses the events.
+// The handles are shared_ptrs to const objects, so once returned they can
+// be read, copied and released from any thread.
+///////////////////////////////////////////////////////////////////////////////
+template<class T>
+class sinsp_intern_pool
+{
+public:
+	typedef shared_ptr<const T> handle;
+	typedef void (*parser)(const char* buf, size_t len, T* res);
+
+	sinsp_intern_pool()
+	{
+		m_purge_threshold = INTERN_POOL_MIN_PURGE_SIZE;
+		m_n_hits = 0;
+		m_n_misses = 0;
+	}
+
+	//
+	// Return the shared object for the given buffer. If the buffer is not in
+	// the pool yet, the object is created by calling parse.
+	//
+	handle intern(const char* buf, size_t len, parser parse)
+	{
+		uint64_t key = sinsp_intern_hash(buf, len);
+
+		auto range = m_table.equal_range(key);
+		for(auto it = range.first; it != range.second; ++it)
+		{
+			const string& raw = it->second.m_raw;
+
+			if(raw.size() == len && memcmp(raw.data(), buf, len) == 0)
+			{
+				m_n_hits++;
+				return it->second.m_value;
+			}
+		}
+
+		m_n_misses++;
+
+		if(m_table.size() >= m_purge_threshold)
+		{
+			purge();
+		}
+
+		T* value = new T();
+		parse(buf, len, value);
+
+		entry e;
+		e.m_raw.assign(buf, len);
+		e.m_value = handle(value);
+		m_table.insert(std::make_pair(key, e));
+
+		return e.m_value;
+	}
+
+	//
+	// Remove the objects that are not referenced by anyone but the pool
+	//
+	void purge()
+	{
+		for(auto it = m_table.begin(); it != m_table.end();)
+		{
+			if(it->second.m_value.unique())
+			{
+				it = m_table.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+
+		m_purge_threshold = std::max((size_t)INTERN_POOL_MIN_PURGE_SIZE, m_table.size() * 2);
+	}
+
+	size_t size()
+	{
+		return m_table.size();
+	}
+
+	uint64_t m_n_hits;
+	uint64_t m_n_misses;
+
+private:
+	struct entry
+	{
+		string m_raw;
+		handle m_value;
+	};
+
+	unordered_multimap<uint64_t, entry> m_table;
+	size_t m_purge_threshold;
+};
@@ -0,0 +1,270 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "multimatch.h"
+
+const uint32_t sinsp_multi_matcher::DEAD_STATE;
+const uint32_t sinsp_multi_matcher::ROOT_STATE;
+const uint32_t sinsp_multi_matcher::NO_STATE;
+
+sinsp_multi_matcher::sinsp_multi_matcher(mode m)
+{
+	m_mode = m;
+	m_compiled = false;
+	m_max_table_size = MULTI_MATCHER_MAX_TABLE_SIZE;
+	m_nclasses = 0;
+}
+
+void sinsp_multi_matcher::add_pattern(const char* buf, uint32_t len)
+{
+	ASSERT(!m_compiled);
+	m_patterns.push_back(string(buf, len));
+}
+
+void sinsp_multi_matcher::compile()
+{
+	uint32_t j;
+
+	if(m_compiled)
+	{
+		return;
+	}
+
+	//
+	// Build the byte classes
+	//
+	memset(m_classes, 0, sizeof(m_classes));
+	m_nclasses = 1;
+
+	for(vector<string>::iterator it = m_patterns.begin(); it != m_patterns.end(); ++it)
+	{
+		for(j = 0; j < it->size(); j++)
+		{
+			uint8_t c = (uint8_t)(*it)[j];
+
+			if(m_classes[c] == 0)
+			{
+				m_classes[c] = (uint16_t)m_nclasses++;
+			}
+		}
+	}
+
+	//
+	// Build the trie. The dead state has no children.
+	//
+	vector<vector<edge>> children(2);
+	m_accept.assign(2, 0);
+
+	for(vector<string>::iterator it = m_patterns.begin(); it != m_patterns.end(); ++it)
+	{
+		uint32_t state = ROOT_STATE;
+
+		for(j = 0; j < it->size(); j++)
+		{
+			uint32_t cls = m_classes[(uint8_t)(*it)[j]];
+			vector<edge>& edges = children[state];
+			vector<edge>::iterator eit = edges.begin();
+
+			while(eit != edges.end() && eit->m_class < cls)
+			{
+				++eit;
+			}
+
+			if(eit != edges.end() && eit->m_class == cls)
+			{
+				state = eit->m_next;
+				continue;
+			}
+
+			edge e;
+			e.m_class = cls;
+			e.m_next = (uint32_t)m_accept.size();
+			edges.insert(eit, e);
+
+			children.push_back(vector<edge>());
+			m_accept.push_back(0);
+			state = e.m_next;
+		}
+
+		m_accept[state] = 1;
+	}
+
+	uint32_t nstates = (uint32_t)m_accept.size();
+
+	m_first_edge.resize(nstates + 1);
+	m_edges.clear();
+
+	for(j = 0; j < nstates; j++)
+	{
+		m_first_edge[j] = (uint32_t)m_edges.size();
+		m_edges.insert(m_edges.end(), children[j].begin(), children[j].end());
+	}
+
+	m_first_edge[nstates] = (uint32_t)m_edges.size();
+
+	//
+	// Order the states breadth first, so that the failure target of a state
+	// is complete before the state itself
+	//
+	vector<uint32_t> order;
+	order.reserve(nstates);
+	order.push_back(ROOT_STATE);
+
+	for(j = 0; j < order.size(); j++)
+	{
+		for(uint32_t e = m_first_edge[order[j]]; e < m_first_edge[order[j] + 1]; e++)
+		{
+			order.push_back(m_edges[e].m_next);
+		}
+	}
+
+	if(m_mode == MM_CONTAINS)
+	{
+		//
+		// The failure target of a state is the longest proper suffix of its
+		// path that is also in the trie, and a state accepts if its failure
+		// target does
+		//
+		m_fail.assign(nstates, ROOT_STATE);
+
+		for(j = 0; j < order.size(); j++)
+		{
+			uint32_t state = order[j];
+
+			for(uint32_t e = m_first_edge[state]; e < m_first_edge[state + 1]; e++)
+			{
+				uint32_t next = m_edges[e].m_next;
+
+				if(state != ROOT_STATE)
+				{
+					uint32_t f = m_fail[state];
+					uint32_t fnext;
+
+					while((fnext = get_child(f, m_edges[e].m_class)) == NO_STATE && f != ROOT_STATE)
+					{
+						f = m_fail[f];
+					}
+
+					m_fail[next] = (fnext != NO_STATE)? fnext : ROOT_STATE;
+				}
+
+				m_accept[next] |= m_accept[m_fail[next]];
+			}
+		}
+	}
+
+	//
+	// Unless it's too big, turn the trie into a dense transition table. The
+	// missing transitions of a state are the ones of its failure target in
+	// MM_CONTAINS mode, and lead to the dead state in MM_PREFIX mode.
+	//
+	m_delta.clear();
+
+	if((size_t)nstates * m_nclasses * sizeof(uint32_t) <= m_max_table_size)
+	{
+		m_delta.assign((size_t)nstates * m_nclasses, DEAD_STATE);
+
+		for(j = 0; j < order.size(); j++)
+		{
+			uint32_t state = order[j];
+			uint32_t* row = &m_delta[(size_t)state * m_nclasses];
+
+			if(m_mode == MM_CONTAINS)
+			{
+				if(state == ROOT_STATE)
+				{
+					fill(row, row + m_nclasses, ROOT_STATE);
+				}
+				else
+				{
+					copy(&m_delta[(size_t)m_fail[state] * m_nclasses],
+						&m_delta[(size_t)m_fail[state] * m_nclasses] + m_nclasses,
+						row);
+				}
+			}
+
+			for(uint32_t e = m_first_edge[state]; e < m_first_edge[state + 1]; e++)
+			{
+				row[m_edges[e].m_class] = m_edges[e].m_next;
+			}
+		}
+
+		//
+		// The trie is not needed anymore
+		//
+		vector<edge>().swap(m_edges);
+		vector<uint32_t>().swap(m_first_edge);
+		vector<uint32_t>().swap(m_fail);
+	}
+
+	m_compiled = true;
+}
+
+bool sinsp_multi_matcher::match_trie(const uint8_t* buf, const uint8_t* end)
+{
+	uint32_t state = ROOT_STATE;
+
+	if(m_accept[state])
+	{
+		return true;
+	}
+
+	for(const uint8_t* p = buf; p < end; p++)
+	{
+		uint32_t cls = m_classes[*p];
+		uint32_t next;
+
+		if(m_mode == MM_PREFIX)
+		{
+			state = get_child(state, cls);
+
+			if(state == NO_STATE)
+			{
+				return false;
+			}
+		}
+		else if(cls == 0)
+		{
+			//
+			// The byte is in no pattern, so every match starts over
+			//
+			state = ROOT_STATE;
+			continue;
+		}
+		else
+		{
+			while((next = get_child(state, cls)) == NO_STATE && state != ROOT_STATE)
+			{
+				state = m_fail[state];
+			}
+
+			state = (next != NO_STATE)? next : ROOT_STATE;
+		}
+
+		if(m_accept[state])
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
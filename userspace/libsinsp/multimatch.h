@@ -0,0 +1,218 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// Matches a buffer against a set of patterns in a single pass.
+// In MM_CONTAINS mode the patterns are compiled into an Aho-Corasick
+// automaton, and the match succeeds if any pattern appears anywhere in the
+// buffer. In MM_PREFIX mode the automaton is a plain prefix trie, and the
+// match succeeds if the buffer starts with any of the patterns.
+//
+// The automaton is a dense transition table, so that every byte costs one
+// lookup. If the table would be bigger than MULTI_MATCHER_MAX_TABLE_SIZE,
+// the trie is walked instead, following the failure links in MM_CONTAINS
+// mode, which takes memory proportional to the patterns.
+// Either way the buffer is scanned once, no matter how many patterns there
+// are.
+///////////////////////////////////////////////////////////////////////////////
+class sinsp_multi_matcher
+{
+public:
+	enum mode
+	{
+		MM_CONTAINS,
+		MM_PREFIX,
+	};
+
+	sinsp_multi_matcher(mode m);
+
+	//
+	// Add a pattern. Must be called before compile().
+	//
+	void add_pattern(const char* buf, uint32_t len);
+
+	//
+	// Build the automaton. Must be called after the last pattern is added
+	// and before the first match, i.e. when the filter is compiled.
+	//
+	void compile();
+
+	//
+	// Match a NULL terminated string
+	//
+	bool match_string(const char* str)
+	{
+		ASSERT(m_compiled);
+
+		if(m_delta.empty())
+		{
+			return match_trie((const uint8_t*)str, (const uint8_t*)str + strlen(str));
+		}
+
+		uint32_t state = ROOT_STATE;
+
+		if(m_accept[state])
+		{
+			return true;
+		}
+
+		for(const uint8_t* p = (const uint8_t*)str; *p != 0; p++)
+		{
+			state = m_delta[state * m_nclasses + m_classes[*p]];
+
+			if(m_accept[state])
+			{
+				return true;
+			}
+			else if(state == DEAD_STATE)
+			{
+				return false;
+			}
+		}
+
+		return false;
+	}
+
+	//
+	// Match a binary buffer
+	//
+	bool match_buffer(const char* buf, uint32_t len)
+	{
+		ASSERT(m_compiled);
+
+		const uint8_t* end = (const uint8_t*)buf + len;
+
+		if(m_delta.empty())
+		{
+			return match_trie((const uint8_t*)buf, end);
+		}
+
+		uint32_t state = ROOT_STATE;
+
+		if(m_accept[state])
+		{
+			return true;
+		}
+
+		for(const uint8_t* p = (const uint8_t*)buf; p < end; p++)
+		{
+			state = m_delta[state * m_nclasses + m_classes[*p]];
+
+			if(m_accept[state])
+			{
+				return true;
+			}
+			else if(state == DEAD_STATE)
+			{
+				return false;
+			}
+		}
+
+		return false;
+	}
+
+	uint32_t get_n_patterns()
+	{
+		return (uint32_t)m_patterns.size();
+	}
+
+	//
+	// True if the automaton is a dense transition table
+	//
+	bool is_dense()
+	{
+		return !m_delta.empty();
+	}
+
+private:
+	//
+	// The dead state is only reachable in MM_PREFIX mode, when the buffer
+	// diverges from every pattern
+	//
+	static const uint32_t DEAD_STATE = 0;
+	static const uint32_t ROOT_STATE = 1;
+	static const uint32_t NO_STATE = 0xffffffff;
+
+	struct edge
+	{
+		uint32_t m_class;
+		uint32_t m_next;
+	};
+
+	//
+	// Return the child of a trie state for the given class, or NO_STATE
+	//
+	inline uint32_t get_child(uint32_t state, uint32_t cls)
+	{
+		const edge* first = m_edges.data() + m_first_edge[state];
+		const edge* end = m_edges.data() + m_first_edge[state + 1];
+		const edge* last = end;
+
+		while(first < last)
+		{
+			const edge* mid = first + (last - first) / 2;
+
+			if(mid->m_class < cls)
+			{
+				first = mid + 1;
+			}
+			else
+			{
+				last = mid;
+			}
+		}
+
+		return (first < end && first->m_class == cls)? first->m_next : NO_STATE;
+	}
+
+	bool match_trie(const uint8_t* buf, const uint8_t* end);
+
+	mode m_mode;
+	bool m_compiled;
+	vector<string> m_patterns;
+	size_t m_max_table_size;
+
+	//
+	// The bytes that appear in the patterns are mapped to classes starting
+	// from 1. Everything else is class 0. This keeps the transition table
+	// small, since patterns usually use few distinct characters.
+	//
+	uint16_t m_classes[256];
+	uint32_t m_nclasses;
+
+	//
+	// Dense transition table, m_nclasses entries per state. Empty if the
+	// trie is walked instead.
+	//
+	vector<uint32_t> m_delta;
+	//
+	// The trie, used when the table would be too big: the children of a
+	// state are m_edges[m_first_edge[state]] to
+	// m_edges[m_first_edge[state + 1]], sorted by class
+	//
+	vector<edge> m_edges;
+	vector<uint32_t> m_first_edge;
+	vector<uint32_t> m_fail;
+	//
+	// True for the states that complete a pattern, directly or through
+	// their failure link
+	//
+	vector<uint8_t> m_accept;
+};
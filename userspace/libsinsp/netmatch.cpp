@@ -0,0 +1,272 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "netmatch.h"
+
+sinsp_network_set::sinsp_network_set()
+{
+	m_compiled = false;
+	m_n_networks = 0;
+}
+
+bool sinsp_network_set::add_network(const char* str)
+{
+	ASSERT(!m_compiled);
+
+	string addr = str;
+	uint32_t prefixlen = 0xffffffff;
+	size_t slash = addr.find('/');
+
+	if(slash != string::npos)
+	{
+		string len = addr.substr(slash + 1);
+
+		if(len.empty() || len.size() > 3 || len.find_first_not_of("0123456789") != string::npos)
+		{
+			return false;
+		}
+
+		prefixlen = (uint32_t)atoi(len.c_str());
+		addr = addr.substr(0, slash);
+	}
+
+	uint8_t buf[16];
+
+	if(inet_pton(AF_INET, addr.c_str(), buf) == 1)
+	{
+		if(prefixlen == 0xffffffff)
+		{
+			prefixlen = 32;
+		}
+		else if(prefixlen > 32)
+		{
+			return false;
+		}
+
+		uint32_t first = ntohl(*(uint32_t*)buf);
+		uint32_t hostmask = (prefixlen == 0)? 0xffffffff : (((uint32_t)1 << (32 - prefixlen)) - 1);
+
+		m_ipv4_ranges.push_back(make_pair(first & ~hostmask, first | hostmask));
+	}
+	else if(inet_pton(AF_INET6, addr.c_str(), buf) == 1)
+	{
+		if(prefixlen == 0xffffffff)
+		{
+			prefixlen = 128;
+		}
+		else if(prefixlen > 128)
+		{
+			return false;
+		}
+
+		ipv6_addr first;
+		first.m_hi = 0;
+		first.m_lo = 0;
+
+		for(uint32_t j = 0; j < 8; j++)
+		{
+			first.m_hi = (first.m_hi << 8) | buf[j];
+			first.m_lo = (first.m_lo << 8) | buf[j + 8];
+		}
+
+		ipv6_addr hostmask;
+
+		if(prefixlen >= 64)
+		{
+			hostmask.m_hi = 0;
+			hostmask.m_lo = (prefixlen == 128)? 0 : ((uint64_t)0xffffffffffffffffULL >> (prefixlen - 64));
+		}
+		else
+		{
+			hostmask.m_hi = (prefixlen == 0)? 0xffffffffffffffffULL : ((uint64_t)0xffffffffffffffffULL >> prefixlen);
+			hostmask.m_lo = 0xffffffffffffffffULL;
+		}
+
+		ipv6_addr last;
+		first.m_hi &= ~hostmask.m_hi;
+		first.m_lo &= ~hostmask.m_lo;
+		last.m_hi = first.m_hi | hostmask.m_hi;
+		last.m_lo = first.m_lo | hostmask.m_lo;
+
+		m_ipv6_ranges.push_back(make_pair(first, last));
+
+		//
+		// IPv4-mapped addresses are looked up in the IPv4 table, so the part
+		// of the network that overlaps ::ffff:0.0.0.0/96 goes there too
+		//
+		ipv6_addr mapped_first;
+		ipv6_addr mapped_last;
+		mapped_first.m_hi = 0;
+		mapped_first.m_lo = 0x0000ffff00000000ULL;
+		mapped_last.m_hi = 0;
+		mapped_last.m_lo = 0x0000ffffffffffffULL;
+
+		if(first <= mapped_last && mapped_first <= last)
+		{
+			ipv6_addr v4first = (mapped_first < first)? first : mapped_first;
+			ipv6_addr v4last = (last < mapped_last)? last : mapped_last;
+
+			m_ipv4_ranges.push_back(make_pair((uint32_t)v4first.m_lo, (uint32_t)v4last.m_lo));
+		}
+	}
+	else
+	{
+		return false;
+	}
+
+	m_n_networks++;
+	return true;
+}
+
+void sinsp_network_set::compile()
+{
+	uint32_t j;
+
+	//
+	// Sort the ranges by their first address, and merge the ones that
+	// overlap or touch
+	//
+	sort(m_ipv4_ranges.begin(), m_ipv4_ranges.end());
+
+	vector<pair<uint32_t, uint32_t> > ipv4_merged;
+
+	for(j = 0; j < m_ipv4_ranges.size(); j++)
+	{
+		if(!ipv4_merged.empty() &&
+			(ipv4_merged.back().second == 0xffffffff || m_ipv4_ranges[j].first <= ipv4_merged.back().second + 1))
+		{
+			ipv4_merged.back().second = max(ipv4_merged.back().second, m_ipv4_ranges[j].second);
+		}
+		else
+		{
+			ipv4_merged.push_back(m_ipv4_ranges[j]);
+		}
+	}
+
+	m_ipv4_ranges.swap(ipv4_merged);
+
+	if(m_ipv4_ranges.size() > IPV4_INDEX_MIN_RANGES)
+	{
+		uint32_t nslices = 1 << IPV4_INDEX_BITS;
+		uint32_t k = 0;
+
+		m_ipv4_index.resize(nslices + 1);
+
+		for(j = 0; j < nslices; j++)
+		{
+			while(k < m_ipv4_ranges.size() &&
+				(m_ipv4_ranges[k].first >> (32 - IPV4_INDEX_BITS)) < j)
+			{
+				k++;
+			}
+
+			m_ipv4_index[j] = k;
+		}
+
+		m_ipv4_index[nslices] = (uint32_t)m_ipv4_ranges.size();
+	}
+
+	sort(m_ipv6_ranges.begin(), m_ipv6_ranges.end());
+
+	vector<pair<ipv6_addr, ipv6_addr> > ipv6_merged;
+
+	for(j = 0; j < m_ipv6_ranges.size(); j++)
+	{
+		if(!ipv6_merged.empty())
+		{
+			ipv6_addr next = ipv6_merged.back().second;
+
+			next.m_lo++;
+
+			if(next.m_lo == 0)
+			{
+				next.m_hi++;
+			}
+
+			bool is_max = (next.m_hi == 0 && next.m_lo == 0);
+
+			if(is_max || m_ipv6_ranges[j].first <= next)
+			{
+				if(ipv6_merged.back().second < m_ipv6_ranges[j].second)
+				{
+					ipv6_merged.back().second = m_ipv6_ranges[j].second;
+				}
+
+				continue;
+			}
+		}
+
+		ipv6_merged.push_back(m_ipv6_ranges[j]);
+	}
+
+	m_ipv6_ranges.swap(ipv6_merged);
+
+	m_compiled = true;
+}
+
+bool sinsp_network_set::match_ipv6(const uint32_t* addr)
+{
+	if(!m_compiled)
+	{
+		compile();
+	}
+
+	const uint8_t* buf = (const uint8_t*)addr;
+
+	//
+	// IPv4-mapped address
+	//
+	if(addr[0] == 0 && addr[1] == 0 && buf[8] == 0 && buf[9] == 0 &&
+		buf[10] == 0xff && buf[11] == 0xff)
+	{
+		return match_ipv4(addr[3]);
+	}
+
+	ipv6_addr key;
+	key.m_hi = 0;
+	key.m_lo = 0;
+
+	for(uint32_t j = 0; j < 8; j++)
+	{
+		key.m_hi = (key.m_hi << 8) | buf[j];
+		key.m_lo = (key.m_lo << 8) | buf[j + 8];
+	}
+
+	uint32_t lo = 0;
+	uint32_t hi = (uint32_t)m_ipv6_ranges.size();
+
+	while(lo < hi)
+	{
+		uint32_t mid = (lo + hi) / 2;
+
+		if(m_ipv6_ranges[mid].first <= key)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+
+	return lo > 0 && key <= m_ipv6_ranges[lo - 1].second;
+}
@@ -0,0 +1,138 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// A set of IPv4 and IPv6 networks, like 10.0.0.0/8 or fe80::/10.
+// The networks are compiled into sorted tables of disjoint address ranges,
+// one per address family, where overlapping and adjacent networks are
+// merged. Looking up an address is a binary search. For IPv4, the search
+// starts from the slice of the table selected by the top bits of the
+// address, so it takes a few steps no matter how many networks there are.
+// IPv4-mapped IPv6 addresses (::ffff:a.b.c.d) are looked up in the IPv4
+// table, and the IPv6 networks that contain mapped addresses are added to
+// both tables.
+///////////////////////////////////////////////////////////////////////////////
+class sinsp_network_set
+{
+public:
+	sinsp_network_set();
+
+	//
+	// Add a network in CIDR notation. An address without prefix length is a
+	// network with a single address. Returns false if the string can't be
+	// parsed. Must be called before the first match.
+	//
+	bool add_network(const char* str);
+
+	//
+	// Match an IPv4 address, in network byte order
+	//
+	bool match_ipv4(uint32_t addr)
+	{
+		if(!m_compiled)
+		{
+			compile();
+		}
+
+		uint32_t haddr = ntohl(addr);
+
+		//
+		// Find the last range that starts at or before the address. The
+		// ranges before the slice all start before the address, the ones
+		// after it all start after the address.
+		//
+		uint32_t lo = 0;
+		uint32_t hi = (uint32_t)m_ipv4_ranges.size();
+
+		if(!m_ipv4_index.empty())
+		{
+			lo = m_ipv4_index[haddr >> (32 - IPV4_INDEX_BITS)];
+			hi = m_ipv4_index[(haddr >> (32 - IPV4_INDEX_BITS)) + 1];
+		}
+
+		while(lo < hi)
+		{
+			uint32_t mid = (lo + hi) / 2;
+
+			if(m_ipv4_ranges[mid].first <= haddr)
+			{
+				lo = mid + 1;
+			}
+			else
+			{
+				hi = mid;
+			}
+		}
+
+		return lo > 0 && haddr <= m_ipv4_ranges[lo - 1].second;
+	}
+
+	//
+	// Match an IPv6 address, in network byte order
+	//
+	bool match_ipv6(const uint32_t* addr);
+
+	uint32_t get_n_networks()
+	{
+		return m_n_networks;
+	}
+
+private:
+	struct ipv6_addr
+	{
+		uint64_t m_hi;
+		uint64_t m_lo;
+
+		bool operator<(const ipv6_addr& other) const
+		{
+			return m_hi < other.m_hi || (m_hi == other.m_hi && m_lo < other.m_lo);
+		}
+
+		bool operator<=(const ipv6_addr& other) const
+		{
+			return !(other < *this);
+		}
+	};
+
+	//
+	// The IPv4 index has an entry for every value of the top IPV4_INDEX_BITS
+	// bits of the address. It's only built for tables with more than
+	// IPV4_INDEX_MIN_RANGES ranges.
+	//
+	static const uint32_t IPV4_INDEX_BITS = 12;
+	static const uint32_t IPV4_INDEX_MIN_RANGES = 16;
+
+	void compile();
+
+	bool m_compiled;
+	uint32_t m_n_networks;
+
+	//
+	// First and last address of every range, in host byte order. Sorted
+	// and disjoint once compiled.
+	//
+	vector<pair<uint32_t, uint32_t> > m_ipv4_ranges;
+	vector<pair<ipv6_addr, ipv6_addr> > m_ipv6_ranges;
+	//
+	// Number of IPv4 ranges that start before every slice of the address
+	// space, plus the total number of ranges at the end
+	//
+	vector<uint32_t> m_ipv4_index;
+};
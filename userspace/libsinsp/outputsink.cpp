@@ -0,0 +1,233 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <errno.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <poll.h>
+#else
+#include <io.h>
+#endif
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "outputsink.h"
+
+sinsp_output_sink::sinsp_output_sink(int fd, uint32_t bufsize, uint32_t flush_interval_ms, bool use_writer_thread)
+{
+	m_fd = fd;
+	m_bufsize = bufsize;
+	m_flush_interval = std::chrono::milliseconds(flush_interval_ms);
+	m_len = 0;
+	m_nbytes = 0;
+	m_use_writer_thread = use_writer_thread && (bufsize != 0);
+	m_writing = false;
+	m_stop = false;
+
+	m_pending_len = 0;
+
+	//
+	// Leave some room for the line that crosses the size limit
+	//
+	m_buf.resize(bufsize + OUTPUT_SINK_LINE_SIZE);
+
+	if(m_use_writer_thread)
+	{
+		m_pending.resize(bufsize + OUTPUT_SINK_LINE_SIZE);
+		m_writer = std::thread(&sinsp_output_sink::run, this);
+	}
+}
+
+sinsp_output_sink::~sinsp_output_sink()
+{
+	try
+	{
+		flush();
+	}
+	catch(...)
+	{
+	}
+
+	if(m_use_writer_thread)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+
+		m_cond.notify_all();
+		m_writer.join();
+	}
+}
+
+void sinsp_output_sink::flush()
+{
+	submit();
+
+	if(m_use_writer_thread)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		m_cond.wait(lock, [this]{ return !m_writing; });
+
+		if(!m_error.empty())
+		{
+			string error = m_error;
+			m_error.clear();
+			throw sinsp_exception(error);
+		}
+	}
+}
+
+void sinsp_output_sink::submit()
+{
+	if(m_len == 0)
+	{
+		return;
+	}
+
+	m_nbytes += m_len;
+
+	if(!m_use_writer_thread)
+	{
+		//
+		// After an error the data is dropped anyway, so that the
+		// destructor doesn't try to write it again
+		//
+		try
+		{
+			write_fd(&m_buf[0], m_len);
+		}
+		catch(...)
+		{
+			m_len = 0;
+			throw;
+		}
+
+		m_len = 0;
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		//
+		// Wait for the writer to finish the previous buffer
+		//
+		m_cond.wait(lock, [this]{ return !m_writing; });
+
+		if(!m_error.empty())
+		{
+			string error = m_error;
+			m_error.clear();
+			m_len = 0;
+			throw sinsp_exception(error);
+		}
+
+		m_pending.swap(m_buf);
+		m_pending_len = m_len;
+		m_writing = true;
+	}
+
+	m_cond.notify_all();
+	m_len = 0;
+}
+
+void sinsp_output_sink::write_fd(const char* data, uint64_t len)
+{
+	while(len > 0)
+	{
+#ifndef _WIN32
+		ssize_t res = ::write(m_fd, data, len);
+#else
+		int res = _write(m_fd, data, (unsigned int)len);
+#endif
+
+		if(res < 0)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+#ifndef _WIN32
+			else if(errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				//
+				// Non blocking output: wait until the reader makes room
+				// instead of spinning on write()
+				//
+				struct pollfd pfd;
+				pfd.fd = m_fd;
+				pfd.events = POLLOUT;
+				pfd.revents = 0;
+
+				if(poll(&pfd, 1, -1) < 0 && errno != EINTR)
+				{
+					throw sinsp_exception(string("error writing the output: ") + strerror(errno));
+				}
+
+				continue;
+			}
+#endif
+
+			throw sinsp_exception(string("error writing the output: ") + strerror(errno));
+		}
+
+		data += res;
+		len -= res;
+	}
+}
+
+void sinsp_output_sink::run()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while(true)
+	{
+		m_cond.wait(lock, [this]{ return m_writing || m_stop; });
+
+		if(!m_writing)
+		{
+			return;
+		}
+
+		//
+		// The caller doesn't touch m_pending until m_writing is cleared, so
+		// it can be written without holding the lock
+		//
+		lock.unlock();
+
+		string error;
+
+		try
+		{
+			write_fd(&m_pending[0], m_pending_len);
+		}
+		catch(sinsp_exception& e)
+		{
+			error = e.what();
+		}
+
+		lock.lock();
+
+		m_pending_len = 0;
+		m_error = error;
+		m_writing = false;
+		m_cond.notify_all();
+	}
+}
@@ -0,0 +1,150 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+///////////////////////////////////////////////////////////////////////////////
+// Buffered writer for the event output.
+// Data is accumulated in a large user space buffer and written to the file
+// descriptor when the buffer is full, when its oldest data has been waiting
+// for longer than the flush interval, and when the sink is flushed or
+// destroyed. This way printing events costs a write() every megabyte instead
+// of one per event.
+// Optionally, the writes are done by a dedicated thread. The caller fills a
+// buffer while the thread writes the previous one, and only waits if the
+// thread is still busy when the next buffer is full.
+///////////////////////////////////////////////////////////////////////////////
+class SINSP_PUBLIC sinsp_output_sink
+{
+public:
+	//
+	// A buffer size of 0 makes the sink unbuffered: every write() goes
+	// straight to the file descriptor.
+	//
+	sinsp_output_sink(int fd,
+		uint32_t bufsize = OUTPUT_SINK_BUFFER_SIZE,
+		uint32_t flush_interval_ms = OUTPUT_SINK_FLUSH_INTERVAL_MS,
+		bool use_writer_thread = false);
+	~sinsp_output_sink();
+
+	void write(const char* data, uint32_t len)
+	{
+		memcpy(reserve(len), data, len);
+		commit(len);
+	}
+
+	void write(const string& str)
+	{
+		write(str.c_str(), (uint32_t)str.size());
+	}
+
+	//
+	// Return a pointer to at least len bytes of free space at the end of
+	// the buffer, so that the data can be rendered in place. The data
+	// becomes part of the output when commit() is called.
+	//
+	char* reserve(uint32_t len)
+	{
+		if(m_len + len > m_buf.size())
+		{
+			m_buf.resize(m_len + len);
+		}
+
+		return &m_buf[m_len];
+	}
+
+	void commit(uint32_t len)
+	{
+		if(m_len == 0)
+		{
+			m_first_write_time = std::chrono::steady_clock::now();
+		}
+
+		m_len += len;
+
+		if(m_len >= m_bufsize)
+		{
+			submit();
+		}
+	}
+
+	//
+	// Write the buffered data if it has been waiting for longer than the
+	// flush interval. Meant to be called periodically, also when there
+	// are no events to print, to bound the output latency.
+	//
+	void flush_if_stale()
+	{
+		if(m_len != 0 &&
+			std::chrono::steady_clock::now() - m_first_write_time >= m_flush_interval)
+		{
+			submit();
+		}
+	}
+
+	//
+	// Write all the buffered data, and wait until it has been written
+	//
+	void flush();
+
+	uint64_t get_bytes_written()
+	{
+		return m_nbytes;
+	}
+
+private:
+	//
+	// Hand the current buffer to the writer thread, or write it directly
+	//
+	void submit();
+	void write_fd(const char* data, uint64_t len);
+	void run();
+
+	int m_fd;
+	uint32_t m_bufsize;
+	std::chrono::steady_clock::duration m_flush_interval;
+	std::chrono::steady_clock::time_point m_first_write_time;
+	//
+	// The buffer is allocated once, and m_len bytes of it are used
+	//
+	vector<char> m_buf;
+	uint32_t m_len;
+	uint64_t m_nbytes;
+
+	//
+	// Writer thread state. m_pending is the buffer being written by the
+	// thread, and is protected by m_mutex.
+	//
+	bool m_use_writer_thread;
+	std::thread m_writer;
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	vector<char> m_pending;
+	uint32_t m_pending_len;
+	bool m_writing;
+	bool m_stop;
+	//
+	// Last write error, reported to the caller on the next submit
+	//
+	string m_error;
+};
@@ -116,6 +116,11 @@ void sinsp_parser::process_event(sinsp_evt *evt)
 		}
 		else
 		{
+			//
+			// run() starts with a lookup on the event type, so the types that
+			// the filter can't accept are dropped here without extracting any
+			// field
+			//
 			if(m_inspector->m_filter->run(evt) == false)
 			{
 				if(evt->m_tinfo != NULL)
@@ -133,6 +138,12 @@ void sinsp_parser::process_event(sinsp_evt *evt)
 	}
 
 	evt->m_filtered_out = false;
+
+	//
+	// The fields that the filter extracted so far describe the state before
+	// the parsing of this event, and can't be shared with the later users
+	//
+	evt->clear_extraction_cache();
 #endif
 
 	//
@@ -1172,7 +1183,7 @@ void sinsp_parser::parse_clone_exit(sinsp_evt *evt)
 		case PPME_SYSCALL_CLONE_20_X:
 			parinfo = evt->get_param(14);
 			tinfo.set_cgroups(parinfo->m_val, parinfo->m_len);
-			m_inspector->m_container_manager.resolve_container_from_cgroups(tinfo.m_cgroups, m_inspector->m_islive, &tinfo.m_container_id);
+			m_inspector->m_container_manager.resolve_container_from_cgroups(tinfo.get_cgroups(), m_inspector->m_islive, &tinfo.m_container_id);
 			break;
 	}
 
@@ -1342,7 +1353,8 @@ void sinsp_parser::parse_execve_exit(sinsp_evt *evt)
 		evt->m_tinfo->set_cgroups(parinfo->m_val, parinfo->m_len);
 		if(evt->m_tinfo->m_container_id.empty())
 		{
-			m_inspector->m_container_manager.resolve_container_from_cgroups(evt->m_tinfo->m_cgroups, m_inspector->m_islive, &evt->m_tinfo->m_container_id);
+			m_inspector->m_container_manager.resolve_container_from_cgroups(evt->m_tinfo->get_cgroups(), m_inspector->m_islive, &evt->m_tinfo->m_container_id);
+			m_inspector->m_thread_manager->on_container_id_set(evt->m_tinfo);
 		}
 		break;
 	default:
@@ -1417,7 +1429,7 @@ void sinsp_parser::parse_openat_dir(sinsp_evt *evt, char* name, int64_t dirfd, O
 			}
 			else
 			{
-				tdirstr = evt->m_fdinfo->m_name + '/';
+				tdirstr = evt->m_fdinfo->m_name.str() + '/';
 				*sdir = tdirstr;
 			}
 		}
@@ -2192,7 +2204,7 @@ void sinsp_parser::parse_thread_exit(sinsp_evt *evt)
 	//
 	if(evt->m_tinfo)
 	{
-		evt->m_tinfo->m_flags |= PPM_CL_CLOSED;
+		m_inspector->m_thread_manager->set_closed(evt->m_tinfo);
 		m_inspector->m_tid_to_remove = evt->get_tid();
 	}
 }
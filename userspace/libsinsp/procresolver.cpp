@@ -0,0 +1,310 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "procresolver.h"
+
+#if defined(HAS_CAPTURE)
+
+sinsp_proc_resolver::sinsp_proc_resolver(sinsp* inspector, scap_t* h)
+{
+	m_inspector = inspector;
+	m_h = h;
+	m_stop = false;
+	m_results_ready = false;
+	m_cur_result.m_tid = -1;
+	m_cur_result.m_proc = NULL;
+	m_lasterr[0] = 0;
+
+	m_worker = std::thread(&sinsp_proc_resolver::run, this);
+}
+
+sinsp_proc_resolver::~sinsp_proc_resolver()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+
+	m_cond.notify_one();
+	m_worker.join();
+
+	for(vector<result_info>::iterator it = m_results.begin(); it != m_results.end(); ++it)
+	{
+		if(it->m_proc != NULL)
+		{
+			scap_proc_free(m_h, it->m_proc);
+		}
+	}
+}
+
+bool sinsp_proc_resolver::request(int64_t tid, bool scan_sockets)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if(m_requests.size() >= MAX_PENDING_PROC_LOOKUPS)
+		{
+			return false;
+		}
+
+		request_info req;
+		req.m_tid = tid;
+		req.m_scan_sockets = scan_sockets;
+		m_requests.push_back(req);
+	}
+
+	m_cond.notify_one();
+	return true;
+}
+
+void sinsp_proc_resolver::on_new_fd(scap_fdinfo* fdinfo)
+{
+	m_cur_result.m_fds.push_back(*fdinfo);
+}
+
+void sinsp_proc_resolver::run()
+{
+	while(true)
+	{
+		request_info req;
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			while(m_requests.empty() && !m_stop)
+			{
+				m_cond.wait(lock);
+			}
+
+			if(m_stop)
+			{
+				return;
+			}
+
+			req = m_requests.front();
+			m_requests.pop_front();
+		}
+
+		//
+		// In live mode libscap reports the fds of the process through the
+		// proc callback, which lands in on_new_fd()
+		//
+		m_cur_result.m_tid = req.m_tid;
+		m_cur_result.m_fds.clear();
+		m_cur_result.m_proc = scap_proc_get_r(m_h, req.m_tid, req.m_scan_sockets, m_lasterr);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_results.push_back(m_cur_result);
+			m_results_ready = true;
+		}
+
+		m_cur_result.m_proc = NULL;
+	}
+}
+
+void sinsp_proc_resolver::merge_results()
+{
+	if(!m_results_ready)
+	{
+		return;
+	}
+
+	vector<result_info> results;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		results.swap(m_results);
+		m_results_ready = false;
+	}
+
+	for(vector<result_info>::iterator it = results.begin(); it != results.end(); ++it)
+	{
+		merge_result(&*it);
+
+		if(it->m_proc != NULL)
+		{
+			scap_proc_free(m_h, it->m_proc);
+		}
+	}
+}
+
+void sinsp_proc_resolver::merge_result(result_info* res)
+{
+	sinsp_threadinfo* tinfo = m_inspector->get_thread(res->m_tid, false, true);
+	unordered_set<int64_t> closed_fds;
+
+	unordered_map<int64_t, unordered_set<int64_t>>::iterator cit = m_closed_fds.find(res->m_tid);
+	if(cit != m_closed_fds.end())
+	{
+		closed_fds.swap(cit->second);
+		m_closed_fds.erase(cit);
+	}
+
+	//
+	// The thread went away, or we got a real entry for it (e.g. from its
+	// clone()), while the lookup was in flight
+	//
+	if(tinfo == NULL || !tinfo->m_proc_lookup_pending)
+	{
+		return;
+	}
+
+	tinfo->m_proc_lookup_pending = false;
+
+	//
+	// If the process is not in /proc anymore, keep the placeholder, exactly
+	// like the synchronous lookup does
+	//
+	if(res->m_proc == NULL)
+	{
+		return;
+	}
+
+	//
+	// The events parsed while the lookup was pending (an execve(), a chdir(),
+	// a setuid()...) are more recent than the /proc snapshot, so the
+	// snapshot only fills the fields that are still at the defaults of the
+	// placeholder. The entry is updated in place, so pointers to it and its
+	// per-event state stay valid.
+	//
+	sinsp_threadinfo snap(m_inspector);
+	snap.init(res->m_proc);
+	sinsp_thread_manager* manager = m_inspector->m_thread_manager;
+
+	if(tinfo->m_comm == "<NA>")
+	{
+		tinfo->m_comm = snap.m_comm;
+	}
+
+	if(tinfo->m_exe == "<NA>")
+	{
+		tinfo->m_exe = snap.m_exe;
+	}
+
+	if(!tinfo->m_args)
+	{
+		tinfo->m_args = snap.m_args;
+	}
+
+	if(!tinfo->m_env)
+	{
+		tinfo->m_env = snap.m_env;
+	}
+
+	if(tinfo->m_cwd.empty())
+	{
+		tinfo->m_cwd = snap.m_cwd;
+	}
+
+	if(tinfo->m_uid == 0xffffffff)
+	{
+		tinfo->m_uid = snap.m_uid;
+	}
+
+	if(tinfo->m_gid == 0xffffffff)
+	{
+		tinfo->m_gid = snap.m_gid;
+	}
+
+	if(tinfo->m_fdlimit == -1)
+	{
+		tinfo->m_fdlimit = snap.m_fdlimit;
+	}
+
+	if(tinfo->m_vtid == -1)
+	{
+		tinfo->m_vtid = snap.m_vtid;
+	}
+
+	if(tinfo->m_vpid == -1)
+	{
+		tinfo->m_vpid = snap.m_vpid;
+	}
+
+	if(tinfo->m_vmsize_kb == 0)
+	{
+		tinfo->m_vmsize_kb = snap.m_vmsize_kb;
+		tinfo->m_vmrss_kb = snap.m_vmrss_kb;
+		tinfo->m_vmswap_kb = snap.m_vmswap_kb;
+	}
+
+	if(tinfo->m_pfmajor == 0 && tinfo->m_pfminor == 0)
+	{
+		tinfo->m_pfmajor = snap.m_pfmajor;
+		tinfo->m_pfminor = snap.m_pfminor;
+	}
+
+	if(!tinfo->m_cgroups)
+	{
+		tinfo->m_cgroups = snap.m_cgroups;
+
+		if(tinfo->m_container_id.empty() && !snap.m_container_id.empty())
+		{
+			tinfo->m_container_id = snap.m_container_id;
+			manager->on_container_id_set(tinfo);
+		}
+	}
+
+	//
+	// A change of parent or of process moves the thread in the process tree
+	//
+	bool tree_changed = false;
+
+	if(tinfo->m_ptid == -1 && snap.m_ptid != -1)
+	{
+		tinfo->m_ptid = snap.m_ptid;
+		tree_changed = true;
+	}
+
+	tinfo->m_flags |= PPM_CL_ACTIVE;
+
+	if(tinfo->m_pid == tinfo->m_tid && snap.m_pid != tinfo->m_tid)
+	{
+		tinfo->m_pid = snap.m_pid;
+		tinfo->m_flags |= snap.m_flags;
+		tinfo->m_main_thread = NULL;
+		manager->increment_mainthread_childcount(tinfo);
+		tree_changed = true;
+	}
+
+	if(tree_changed)
+	{
+		manager->invalidate_ancestors();
+	}
+
+	tinfo->compute_program_hash();
+
+	//
+	// The fds that the placeholder collected from the events are more up to
+	// date than the ones coming from /proc, and the ones it closed must not
+	// come back
+	//
+	for(vector<scap_fdinfo>::iterator it = res->m_fds.begin(); it != res->m_fds.end(); ++it)
+	{
+		if(tinfo->m_fdtable.m_table.find(it->fd) == tinfo->m_fdtable.m_table.end() &&
+			closed_fds.find(it->fd) == closed_fds.end())
+		{
+			tinfo->add_fd(&*it);
+		}
+	}
+}
+
+#endif // HAS_CAPTURE
@@ -0,0 +1,128 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#if defined(HAS_CAPTURE)
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#ifndef VISIBILITY_PRIVATE
+#define VISIBILITY_PRIVATE private:
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// Background resolver for the threads that are missing from the table.
+// Scanning /proc for a process, including its fds and sockets, can take
+// milliseconds. Instead of stalling the capture, get_thread() adds a
+// placeholder entry and queues the scan here. The worker thread runs
+// scap_proc_get(), and the capture thread merges the results into the
+// table at the beginning of the next event.
+///////////////////////////////////////////////////////////////////////////////
+class sinsp_proc_resolver
+{
+public:
+	sinsp_proc_resolver(sinsp* inspector, scap_t* h);
+	~sinsp_proc_resolver();
+
+	//
+	// Queue the lookup of the given thread. Returns false if the lookup
+	// can't be queued, because the queue is full.
+	//
+	bool request(int64_t tid, bool scan_sockets);
+
+	//
+	// Merge the completed lookups into the thread table. Must be called on
+	// the capture thread.
+	//
+	void merge_results();
+
+	//
+	// True when called on the worker thread. Used by sinsp to route the fds
+	// that libscap reports through the proc callback.
+	//
+	bool is_worker_thread()
+	{
+		return std::this_thread::get_id() == m_worker.get_id();
+	}
+
+	//
+	// Store an fd of the process that the worker is currently scanning
+	//
+	void on_new_fd(scap_fdinfo* fdinfo);
+
+	//
+	// Remember that a pending thread closed an fd, so that the fd is not
+	// added back from a /proc snapshot taken before the close. Must be
+	// called on the capture thread.
+	//
+	void on_fd_removed(int64_t tid, int64_t fd)
+	{
+		m_closed_fds[tid].insert(fd);
+	}
+
+VISIBILITY_PRIVATE
+	struct request_info
+	{
+		int64_t m_tid;
+		bool m_scan_sockets;
+	};
+
+	struct result_info
+	{
+		int64_t m_tid;
+		scap_threadinfo* m_proc;
+		vector<scap_fdinfo> m_fds;
+	};
+
+	void run();
+	void merge_result(result_info* res);
+
+	sinsp* m_inspector;
+	scap_t* m_h;
+	//
+	// Owned by the worker, so that the lookups don't write the handle's error
+	//
+	char m_lasterr[SCAP_LASTERR_SIZE];
+	std::thread m_worker;
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	bool m_stop;
+	deque<request_info> m_requests;
+	vector<result_info> m_results;
+	std::atomic<bool> m_results_ready;
+
+	//
+	// Only touched by the worker thread
+	//
+	result_info m_cur_result;
+
+	//
+	// The fds closed by every pending thread. Only touched by the capture
+	// thread.
+	//
+	unordered_map<int64_t, unordered_set<int64_t>> m_closed_fds;
+};
+
+#endif // HAS_CAPTURE
@@ -0,0 +1,239 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define VISIBILITY_PRIVATE
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "parsers.h"
+#include "procresolver.h"
+#include "../../driver/ppm_events_public.h"
+
+#include <gtest.h>
+
+#define TEST_TID 1234
+
+//
+// Build an event with the given parameters, laid out like the driver does
+//
+static vector<uint8_t> make_event(uint16_t type, int64_t tid, const vector<string>& params)
+{
+	uint32_t len = sizeof(struct ppm_evt_hdr) + params.size() * sizeof(uint16_t);
+	for(uint32_t j = 0; j < params.size(); j++)
+	{
+		len += params[j].size();
+	}
+
+	vector<uint8_t> res(len);
+	struct ppm_evt_hdr* hdr = (struct ppm_evt_hdr*)&res[0];
+	hdr->ts = 1;
+	hdr->tid = tid;
+	hdr->len = len;
+	hdr->type = type;
+
+	uint16_t* lens = (uint16_t*)(hdr + 1);
+	char* valptr = (char*)(lens + params.size());
+	for(uint32_t j = 0; j < params.size(); j++)
+	{
+		lens[j] = (uint16_t)params[j].size();
+		memcpy(valptr, params[j].data(), params[j].size());
+		valptr += params[j].size();
+	}
+
+	return res;
+}
+
+static string make_param(int64_t val)
+{
+	return string((char*)&val, sizeof(val));
+}
+
+static string make_param(uint32_t val)
+{
+	return string((char*)&val, sizeof(val));
+}
+
+static string make_param(const char* str)
+{
+	return string(str, strlen(str) + 1);
+}
+
+//
+// Add a placeholder for TEST_TID, like get_thread() does when the lookup
+// goes to the resolver
+//
+static sinsp_threadinfo* add_placeholder(sinsp* inspector)
+{
+	sinsp_threadinfo newti(inspector);
+	newti.m_tid = TEST_TID;
+	newti.m_pid = TEST_TID;
+	newti.m_ptid = -1;
+	newti.m_comm = "<NA>";
+	newti.m_exe = "<NA>";
+	newti.m_uid = 0xffffffff;
+	newti.m_gid = 0xffffffff;
+	newti.m_proc_lookup_pending = true;
+	inspector->m_thread_manager->add_thread(newti, false);
+
+	return inspector->get_thread(TEST_TID, false, true);
+}
+
+static void add_file_fd(vector<scap_fdinfo>* fds, int64_t fd, const char* name)
+{
+	scap_fdinfo fdi;
+	memset(&fdi, 0, sizeof(fdi));
+	fdi.fd = fd;
+	fdi.type = SCAP_FD_FILE;
+	strcpy(fdi.info.fname, name);
+	fds->push_back(fdi);
+}
+
+//
+// The /proc snapshot of TEST_TID, with the fds 3, 4 and 5
+//
+static void make_result(sinsp_proc_resolver::result_info* res)
+{
+	scap_threadinfo* proc = (scap_threadinfo*)calloc(1, sizeof(scap_threadinfo));
+	proc->tid = TEST_TID;
+	proc->pid = TEST_TID;
+	proc->ptid = 1;
+	strcpy(proc->comm, "bash");
+	strcpy(proc->exe, "bash");
+	memcpy(proc->args, "-l", 3);
+	proc->args_len = 3;
+	strcpy(proc->cwd, "/home/user/");
+	proc->fdlimit = 1024;
+	proc->uid = 1000;
+	proc->gid = 1000;
+	proc->vtid = TEST_TID;
+	proc->vpid = TEST_TID;
+
+	res->m_tid = TEST_TID;
+	res->m_proc = proc;
+	add_file_fd(&res->m_fds, 3, "/etc/passwd");
+	add_file_fd(&res->m_fds, 4, "/etc/hosts");
+	add_file_fd(&res->m_fds, 5, "/etc/group");
+}
+
+TEST(procresolver,merge_fills_placeholder)
+{
+	sinsp inspector;
+	sinsp_proc_resolver resolver(&inspector, NULL);
+	sinsp_proc_resolver::result_info res;
+
+	sinsp_threadinfo* tinfo = add_placeholder(&inspector);
+	ASSERT_TRUE(tinfo != NULL);
+
+	make_result(&res);
+	resolver.merge_result(&res);
+	free(res.m_proc);
+
+	EXPECT_FALSE(tinfo->m_proc_lookup_pending);
+	EXPECT_EQ(tinfo, inspector.get_thread(TEST_TID, false, true));
+	EXPECT_EQ("bash", tinfo->m_comm);
+	EXPECT_EQ("bash", tinfo->m_exe);
+	ASSERT_EQ(1, tinfo->get_args().size());
+	EXPECT_EQ("-l", tinfo->get_args()[0]);
+	EXPECT_EQ("/home/user/", tinfo->get_cwd());
+	EXPECT_EQ(1, tinfo->m_ptid);
+	EXPECT_EQ(1000, tinfo->m_uid);
+	EXPECT_EQ(1024, tinfo->m_fdlimit);
+	EXPECT_EQ(3, tinfo->m_fdtable.size());
+}
+
+TEST(procresolver,merge_keeps_execve_and_closes)
+{
+	sinsp inspector;
+	sinsp_proc_resolver resolver(&inspector, NULL);
+	sinsp_proc_resolver::result_info res;
+	sinsp_fdinfo_t fdinfo;
+
+	inspector.m_proc_resolver = &resolver;
+
+	sinsp_threadinfo* tinfo = add_placeholder(&inspector);
+	ASSERT_TRUE(tinfo != NULL);
+
+	//
+	// While the lookup is pending, the thread closes fd 4, opens a new fd 5
+	// and runs an execve()
+	//
+	tinfo->remove_fd(4);
+
+	fdinfo.m_type = SCAP_FD_FILE;
+	fdinfo.m_name = "/tmp/new";
+	tinfo->add_fd(5, &fdinfo);
+
+	vector<string> params;
+	params.push_back(make_param((int64_t)0));
+	params.push_back(make_param("/bin/ls"));
+	params.push_back(string("-a\0/tmp\0", 8));
+	params.push_back(make_param((int64_t)TEST_TID));
+	params.push_back(make_param((int64_t)TEST_TID));
+	params.push_back(make_param((int64_t)1));
+	params.push_back(make_param("/tmp"));
+	params.push_back(make_param((int64_t)4096));
+	params.push_back(make_param((int64_t)0));
+	params.push_back(make_param((int64_t)0));
+	params.push_back(make_param((uint32_t)0));
+	params.push_back(make_param((uint32_t)0));
+	params.push_back(make_param((uint32_t)0));
+	params.push_back(make_param("ls"));
+	params.push_back(string());
+	params.push_back(string());
+
+	vector<uint8_t> evdata = make_event(PPME_SYSCALL_EXECVE_16_X, TEST_TID, params);
+	sinsp_evt evt(&inspector);
+	evt.init(&evdata[0], 0);
+	inspector.m_parser->process_event(&evt);
+
+	make_result(&res);
+	resolver.merge_result(&res);
+	free(res.m_proc);
+
+	//
+	// The state set by the execve() wins over the snapshot
+	//
+	EXPECT_FALSE(tinfo->m_proc_lookup_pending);
+	EXPECT_EQ("ls", tinfo->m_comm);
+	EXPECT_EQ("/bin/ls", tinfo->m_exe);
+	ASSERT_EQ(2, tinfo->get_args().size());
+	EXPECT_EQ("-a", tinfo->get_args()[0]);
+	EXPECT_EQ("/tmp", tinfo->get_args()[1]);
+	EXPECT_EQ("/tmp/", tinfo->get_cwd());
+	EXPECT_EQ(4096, tinfo->m_fdlimit);
+
+	//
+	// The fields the execve() doesn't carry come from the snapshot
+	//
+	EXPECT_EQ(1, tinfo->m_ptid);
+	EXPECT_EQ(1000, tinfo->m_uid);
+	EXPECT_EQ(1000, tinfo->m_gid);
+
+	//
+	// fd 3 comes from the snapshot, fd 4 stays closed and fd 5 is the one
+	// opened after the snapshot
+	//
+	ASSERT_TRUE(tinfo->get_fd(3) != NULL);
+	EXPECT_EQ("/etc/passwd", tinfo->get_fd(3)->m_name.str());
+	EXPECT_TRUE(tinfo->get_fd(4) == NULL);
+	ASSERT_TRUE(tinfo->get_fd(5) != NULL);
+	EXPECT_EQ("/tmp/new", tinfo->get_fd(5)->m_name.str());
+	EXPECT_TRUE(resolver.m_closed_fds.empty());
+
+	inspector.m_proc_resolver = NULL;
+}
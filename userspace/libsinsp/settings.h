@@ -70,6 +70,97 @@ along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
 //
 #define DEFAULT_INACTIVE_THREAD_SCAN_TIME_S 1200
 
+//
+// Max number of thread table entries that are checked for expiration every
+// time an event is processed. Expiration is incremental, so this bounds the
+// time that the cleanup can steal from a single call to sinsp::next().
+//
+#define MAX_THREAD_EXPIRY_CHECKS_PER_EVENT 8
+
+//
+// The list of exited threads waiting for the next flush is purged of the
+// ones already removed when it reaches this size, and after that every
+// time it doubles
+//
+#define MIN_CLOSED_TIDS_COMPACT_SIZE 1024
+
+//
+// Max number of /proc lookups that can be waiting for the background
+// resolver when asynchronous lookups are enabled
+//
+#define MAX_PENDING_PROC_LOOKUPS 256
+
+//
+// Max number of ancestors that are cached for a thread. Ancestor chains are
+// normally short, this only protects from loops caused by pid reuse.
+//
+#define MAX_ANCESTOR_CHAIN_LEN 512
+
+//
+// Max size in bytes of the transition table that matches the values of
+// contains_any and startswith_any. Bigger sets of values are matched by
+// walking their trie, which is slower but takes memory proportional to the
+// values.
+//
+#define MULTI_MATCHER_MAX_TABLE_SIZE (4 * 1024 * 1024)
+
+//
+// Filters evaluate one event out of FILTER_PROFILE_SAMPLING_RATIO in profiling
+// mode, to measure the cost and the selectivity of their checks. After
+// FILTER_REORDER_SAMPLES profiled events the checks are reordered.
+// The ratio must be a power of 2.
+//
+#define FILTER_PROFILE_SAMPLING_RATIO 256
+#define FILTER_REORDER_SAMPLES 4096
+
+//
+// Size of the buffers of sinsp_output_sink, and max time that data can wait
+// in a buffer before being written
+//
+#define OUTPUT_SINK_BUFFER_SIZE (1024 * 1024)
+#define OUTPUT_SINK_FLUSH_INTERVAL_MS 100
+
+//
+// Space reserved in the output sink for rendering an event. Longer events
+// are rendered in two steps.
+//
+#define OUTPUT_SINK_LINE_SIZE 4096
+
+//
+// Default size of the shared memory ring that a publisher uses to send the
+// parsed events to the local subscribers, and maximum number of subscribers
+// of a publisher
+//
+#define FANOUT_RING_SIZE (32 * 1024 * 1024)
+#define FANOUT_MAX_SUBSCRIBERS 16
+
+//
+// How often, in published events, the publisher checks for slow and dead
+// subscribers
+//
+#define FANOUT_CHECK_INTERVAL 4096
+
+//
+// How long a subscriber sleeps when the ring is empty, before returning a
+// timeout
+//
+#define FANOUT_POLL_INTERVAL_US 1000
+
+//
+// Number of entries in the table that the publisher uses to remember which
+// fds the subscribers already know
+//
+#define FANOUT_FD_CACHE_SIZE 8192
+
+//
+// Range and default of the precision of the HyperLogLog distinct counters.
+// A sketch with precision p takes 2^p bytes, and its standard error is
+// 1.04 / sqrt(2^p).
+//
+#define HLL_MIN_PRECISION 4
+#define HLL_MAX_PRECISION 18
+#define HLL_DEFAULT_PRECISION 14
+
 //
 // How often the thread table is sacnned for inactive threads
 //
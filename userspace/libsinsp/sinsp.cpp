@@ -33,6 +33,7 @@ along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
 #include "filterchecks.h"
 #include "cyclewriter.h"
 #include "protodecoder.h"
+#include "procresolver.h"
 #ifdef HAS_ANALYZER
 #include "analyzer_int.h"
 #include "analyzer.h"
@@ -83,6 +84,11 @@ sinsp::sinsp() :
 	m_n_proc_lookups_duration_ns = 0;
 	m_max_n_proc_lookups = 0;
 	m_max_n_proc_socket_lookups = 0;
+	m_async_proc_lookups = false;
+	m_proc_resolver = NULL;
+	m_fanout_publisher = NULL;
+	m_fanout_subscriber = NULL;
+	m_n_incomplete_thread_evts = 0;
 	m_snaplen = DEFAULT_SNAPLEN;
 	m_buffer_format = sinsp_evt::PF_NORMAL;
 	m_isdebug_enabled = false;
@@ -105,6 +111,7 @@ sinsp::sinsp() :
 sinsp::~sinsp()
 {
 	close();
+	stop_publishing();
 
 	if(m_fds_to_remove)
 	{
@@ -176,6 +183,7 @@ void sinsp::init()
 
 	m_tid_to_remove = -1;
 	m_lastevent_ts = 0;
+	m_firstacceptedevent_ts = 0;
 #ifdef HAS_FILTERING
 	m_firstevent_ts = 0;
 #endif
@@ -227,6 +235,19 @@ void sinsp::init()
 		{
 			ASSERT(false);
 		}
+
+		if(m_async_proc_lookups)
+		{
+			m_proc_resolver = new sinsp_proc_resolver(this, m_h);
+		}
+	}
+
+	//
+	// The thread table has been rebuilt, and the subscribers need it
+	//
+	if(m_fanout_publisher != NULL)
+	{
+		m_fanout_publisher->on_capture_start();
 	}
 #endif
 }
@@ -322,8 +343,61 @@ void sinsp::open(string filename)
 	init();
 }
 
+void sinsp::open_subscriber(const string& name)
+{
+#if defined(HAS_CAPTURE)
+	g_logger.log("subscribing to the events of " + name);
+
+	m_islive = true;
+
+	//
+	// Reset the thread manager
+	//
+	m_thread_manager->clear();
+
+	m_fanout_subscriber = new sinsp_fanout_subscriber(this, name);
+
+	//
+	// The part of init() that doesn't need libscap. The threads and the
+	// fds come from the publisher.
+	//
+	m_machine_info = NULL;
+	m_num_cpus = (uint32_t)sysconf(_SC_NPROCESSORS_ONLN);
+	m_cycle_writer = new cycle_writer();
+	m_tid_to_remove = -1;
+	m_lastevent_ts = 0;
+	m_firstacceptedevent_ts = 0;
+#ifdef HAS_FILTERING
+	m_firstevent_ts = 0;
+#endif
+	m_fds_to_remove->clear();
+	m_network_interfaces = new sinsp_network_interfaces;
+	m_sysdig_pid = getpid();
+#else
+	throw sinsp_exception("subscribing to published events is not supported on this platform");
+#endif
+}
+
 void sinsp::close()
 {
+#if defined(HAS_CAPTURE)
+	if(m_fanout_subscriber != NULL)
+	{
+		delete m_fanout_subscriber;
+		m_fanout_subscriber = NULL;
+	}
+
+	//
+	// The resolver uses the scap handle from its worker thread, so it must
+	// go away first
+	//
+	if(m_proc_resolver != NULL)
+	{
+		delete m_proc_resolver;
+		m_proc_resolver = NULL;
+	}
+#endif
+
 	if(m_h)
 	{
 		scap_close(m_h);
@@ -403,6 +477,22 @@ void sinsp::on_new_entry_from_proc(void* context,
 {
 	ASSERT(tinfo != NULL);
 
+#if defined(HAS_CAPTURE)
+	//
+	// The fds of a process scanned by the background resolver are reported
+	// on its worker thread, and must not touch the thread table
+	//
+	if(m_proc_resolver != NULL && m_proc_resolver->is_worker_thread())
+	{
+		if(fdinfo != NULL)
+		{
+			m_proc_resolver->on_new_fd(fdinfo);
+		}
+
+		return;
+	}
+#endif
+
 	//
 	// Retrieve machine information if we don't have it yet
 	//
@@ -519,8 +609,36 @@ void sinsp::import_ipv4_interface(const sinsp_ipv4_ifinfo& ifinfo)
 
 bool should_drop(sinsp_evt *evt, bool* stopped, bool* switched);
 
+#ifdef GATHER_INTERNAL_STATS
+//
+// Measures the time spent in sinsp::next(), whatever the exit path
+//
+class sinsp_next_latency_probe
+{
+public:
+	sinsp_next_latency_probe(sinsp_stats* stats)
+	{
+		m_stats = stats;
+		m_start_ns = sinsp_utils::get_current_time_ns();
+	}
+
+	~sinsp_next_latency_probe()
+	{
+		m_stats->add_next_latency(sinsp_utils::get_current_time_ns() - m_start_ns);
+	}
+
+private:
+	sinsp_stats* m_stats;
+	uint64_t m_start_ns;
+};
+#endif
+
 int32_t sinsp::next(OUT sinsp_evt **evt)
 {
+#ifdef GATHER_INTERNAL_STATS
+	sinsp_next_latency_probe latency_probe(&m_stats);
+#endif
+
 	//
 	// Reset previous event's decoders if required
 	//
@@ -535,6 +653,22 @@ int32_t sinsp::next(OUT sinsp_evt **evt)
 		m_decoders_reset_list.clear();
 	}
 
+#if defined(HAS_CAPTURE)
+	//
+	// Subscribers get the events, already parsed, from the publisher
+	//
+	if(m_fanout_subscriber != NULL)
+	{
+		return m_fanout_subscriber->next(evt);
+	}
+
+	if(m_fanout_publisher != NULL && !m_fanout_publisher->is_ready())
+	{
+		*evt = NULL;
+		return SCAP_TIMEOUT;
+	}
+#endif
+
 	//
 	// Get the event from libscap
 	//
@@ -578,6 +712,18 @@ int32_t sinsp::next(OUT sinsp_evt **evt)
 	//
 	m_evt.m_evtnum = scap_event_get_num(m_h);
 	m_lastevent_ts = m_evt.get_ts();
+
+#if defined(HAS_CAPTURE)
+	//
+	// Bring in the threads that the background resolver found since the
+	// previous event
+	//
+	if(m_proc_resolver != NULL)
+	{
+		m_proc_resolver->merge_results();
+	}
+#endif
+
 #ifdef HAS_FILTERING
 	if(m_firstevent_ts == 0)
 	{
@@ -604,7 +750,7 @@ int32_t sinsp::next(OUT sinsp_evt **evt)
 	//
 	if(m_islive)
 	{
-		m_thread_manager->remove_inactive_threads();
+		m_thread_manager->remove_inactive_threads(MAX_THREAD_EXPIRY_CHECKS_PER_EVENT);
 		m_container_manager.remove_inactive_containers();
 	}
 #endif // HAS_ANALYZER
@@ -662,6 +808,11 @@ int32_t sinsp::next(OUT sinsp_evt **evt)
 	m_parser->process_event(&m_evt);
 #endif
 
+	if(m_evt.m_tinfo != NULL && m_evt.m_tinfo->m_proc_lookup_pending)
+	{
+		m_n_incomplete_thread_evts++;
+	}
+
 	//
 	// If needed, dump the event to file
 	//
@@ -731,6 +882,21 @@ int32_t sinsp::next(OUT sinsp_evt **evt)
 	}
 #endif
 
+	if(m_firstacceptedevent_ts == 0)
+	{
+		m_firstacceptedevent_ts = m_lastevent_ts;
+	}
+
+#if defined(HAS_CAPTURE)
+	//
+	// Hand the event to the local subscribers
+	//
+	if(m_fanout_publisher != NULL)
+	{
+		m_fanout_publisher->publish(&m_evt);
+	}
+#endif
+
 	//
 	// Run the analysis engine
 	//
@@ -779,6 +945,13 @@ int32_t sinsp::next(OUT sinsp_evt **evt)
 
 uint64_t sinsp::get_num_events()
 {
+#if defined(HAS_CAPTURE)
+	if(m_fanout_subscriber != NULL)
+	{
+		return m_fanout_subscriber->get_num_events();
+	}
+#endif
+
 	return scap_event_get_num(m_h);
 }
 
@@ -794,7 +967,7 @@ sinsp_threadinfo* sinsp::find_thread(int64_t tid, bool lookup_only)
 #ifdef GATHER_INTERNAL_STATS
 		m_thread_manager->m_cached_lookups->increment();
 #endif
-		m_thread_manager->m_last_tinfo->m_lastaccess_ts = m_lastevent_ts;
+		m_thread_manager->touch(m_thread_manager->m_last_tinfo, m_lastevent_ts);
 		return m_thread_manager->m_last_tinfo;
 	}
 
@@ -812,7 +985,7 @@ sinsp_threadinfo* sinsp::find_thread(int64_t tid, bool lookup_only)
 		{
 			m_thread_manager->m_last_tid = tid;
 			m_thread_manager->m_last_tinfo = &(it->second);
-			m_thread_manager->m_last_tinfo->m_lastaccess_ts = m_lastevent_ts;
+			m_thread_manager->touch(m_thread_manager->m_last_tinfo, m_lastevent_ts);
 		}
 		return &(it->second);
 	}
@@ -834,7 +1007,7 @@ sinsp_threadinfo* sinsp::get_thread(int64_t tid, bool query_os_if_not_found, boo
 {
 	sinsp_threadinfo* sinsp_proc = find_thread(tid, lookup_only);
 
-	if(sinsp_proc == NULL && query_os_if_not_found)
+	if(sinsp_proc == NULL && query_os_if_not_found && m_h != NULL)
 	{
 		scap_threadinfo* scap_proc = NULL;
 		sinsp_threadinfo newti(this);
@@ -866,13 +1039,26 @@ sinsp_threadinfo* sinsp::get_thread(int64_t tid, bool query_os_if_not_found, boo
 					scan_sockets = true;
 				}
 
+#if defined(HAS_CAPTURE)
+				if(m_proc_resolver != NULL)
+				{
+					//
+					// Let the background resolver do the scan. If the queue is
+					// full, we just add the placeholder without a lookup.
+					//
+					newti.m_proc_lookup_pending = m_proc_resolver->request(tid, scan_sockets);
+				}
+				else
+#endif
+				{
 #ifdef HAS_ANALYZER
-				uint64_t ts = sinsp_utils::get_current_time_ns();
+					uint64_t ts = sinsp_utils::get_current_time_ns();
 #endif
-				scap_proc = scap_proc_get(m_h, tid, scan_sockets);
+					scap_proc = scap_proc_get(m_h, tid, scan_sockets);
 #ifdef HAS_ANALYZER
-				m_n_proc_lookups_duration_ns += sinsp_utils::get_current_time_ns() - ts;
+					m_n_proc_lookups_duration_ns += sinsp_utils::get_current_time_ns() - ts;
 #endif
+				}
 			}
 		}
 
@@ -936,6 +1122,11 @@ void sinsp::remove_thread(int64_t tid, bool force)
 	m_thread_manager->remove_thread(tid, force);
 }
 
+void sinsp::set_async_proc_lookups(bool enable)
+{
+	m_async_proc_lookups = enable;
+}
+
 void sinsp::set_snaplen(uint32_t snaplen)
 {
 	//
@@ -1021,6 +1212,99 @@ const string sinsp::get_filter()
 	return m_filterstring;
 }
 
+string sinsp::get_filter_stats()
+{
+	if(m_filter == NULL)
+	{
+		return "";
+	}
+
+	return m_filter->get_stats();
+}
+
+bool sinsp::apply_filter_eventmask()
+{
+	if(!m_islive || m_h == NULL || m_filter == NULL)
+	{
+		return false;
+	}
+
+	vector<bool> evttypes;
+	const struct ppm_event_info* etable = g_infotables.m_event_info;
+	uint32_t j;
+
+	m_filter->get_evttypes(&evttypes);
+
+	//
+	// The state engine needs the state-changing events whether they pass the
+	// filter or not. The driver always needs the drop events, and uses the
+	// sysdig events to notify dropping mode changes.
+	//
+	for(j = 0; j < PPM_EVENT_MAX; j++)
+	{
+		if(etable[j].flags & EF_MODIFIES_STATE)
+		{
+			evttypes[j] = true;
+		}
+	}
+
+	evttypes[PPME_DROP_E] = true;
+	evttypes[PPME_DROP_X] = true;
+	evttypes[PPME_SYSDIGEVENT_E] = true;
+	evttypes[PPME_SYSDIGEVENT_X] = true;
+
+	//
+	// The parser pairs exit events with their enter events, so keep both
+	// directions
+	//
+	for(j = 0; j + 1 < PPM_EVENT_MAX; j += 2)
+	{
+		if(evttypes[j] || evttypes[j + 1])
+		{
+			evttypes[j] = true;
+			evttypes[j + 1] = true;
+		}
+	}
+
+	if(std::find(evttypes.begin(), evttypes.end(), false) == evttypes.end())
+	{
+		//
+		// Nothing to discard
+		//
+		return false;
+	}
+
+	if(scap_clear_eventmask(m_h) != SCAP_SUCCESS)
+	{
+		throw sinsp_exception(scap_getlasterr(m_h));
+	}
+
+	for(j = 0; j < PPM_EVENT_MAX; j++)
+	{
+		if(evttypes[j])
+		{
+			if(scap_set_eventmask(m_h, j) != SCAP_SUCCESS)
+			{
+				string err = scap_getlasterr(m_h);
+
+				//
+				// Don't leave the driver with a partial mask: go back to
+				// capturing everything, so that the filter still works in
+				// userspace
+				//
+				for(j = 0; j < PPM_EVENT_MAX; j++)
+				{
+					scap_set_eventmask(m_h, j);
+				}
+
+				throw sinsp_exception(err);
+			}
+		}
+	}
+
+	return true;
+}
+
 #endif
 
 const scap_machine_info* sinsp::get_machine_info()
@@ -1061,12 +1345,55 @@ uint32_t sinsp::reserve_thread_memory(uint32_t size)
 
 void sinsp::get_capture_stats(scap_stats* stats)
 {
+#if defined(HAS_CAPTURE)
+	if(m_fanout_subscriber != NULL)
+	{
+		memset(stats, 0, sizeof(scap_stats));
+		stats->n_drops = m_fanout_subscriber->get_num_drops();
+		stats->n_evts = m_fanout_subscriber->get_num_events() + stats->n_drops;
+		return;
+	}
+#endif
+
 	if(scap_get_stats(m_h, stats) != SCAP_SUCCESS)
 	{
 		throw sinsp_exception(scap_getlasterr(m_h));
 	}
 }
 
+void sinsp::start_publishing(const string& name, uint64_t ring_size, uint32_t wait_subscribers)
+{
+#if defined(HAS_CAPTURE)
+	stop_publishing();
+	m_fanout_publisher = new sinsp_fanout_publisher(this, name, ring_size, wait_subscribers);
+#else
+	throw sinsp_exception("publishing the events is not supported on this platform");
+#endif
+}
+
+void sinsp::stop_publishing()
+{
+#if defined(HAS_CAPTURE)
+	if(m_fanout_publisher != NULL)
+	{
+		delete m_fanout_publisher;
+		m_fanout_publisher = NULL;
+	}
+#endif
+}
+
+void sinsp::get_fanout_stats(OUT vector<sinsp_fanout_subscriber_stats>* stats)
+{
+	stats->clear();
+
+#if defined(HAS_CAPTURE)
+	if(m_fanout_publisher != NULL)
+	{
+		m_fanout_publisher->get_stats(stats);
+	}
+#endif
+}
+
 #ifdef GATHER_INTERNAL_STATS
 sinsp_stats sinsp::get_stats()
 {
@@ -1231,77 +1558,119 @@ double sinsp::get_read_progress()
 
 bool sinsp::remove_inactive_threads()
 {
-	return m_thread_manager->remove_inactive_threads();
+	//
+	// This is called periodically rather than for every event, so check all
+	// the expired threads
+	//
+	return m_thread_manager->remove_inactive_threads(0);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // Note: this is defined here so we can inline it in sinso::next
 ///////////////////////////////////////////////////////////////////////////////
-bool sinsp_thread_manager::remove_inactive_threads()
+bool sinsp_thread_manager::remove_inactive_threads(uint32_t max_checks)
 {
 	bool res = false;
+	uint64_t now = m_inspector->m_lastevent_ts;
+
+	//
+	// Threads are kept sorted by last access time, so the expired ones are
+	// at the head of the list. Check at most max_checks of them: the ones
+	// that turn out to be still alive are moved to the tail and will be
+	// checked again after another m_thread_timeout_ns.
+	//
+	for(uint32_t j = 0; max_checks == 0 || j < max_checks; j++)
+	{
+		sinsp_threadinfo* tinfo = m_lru_head;
+
+		if(tinfo == NULL || 
+			tinfo->m_lastaccess_ts + m_inspector->m_thread_timeout_ns >= now)
+		{
+			break;
+		}
+
+		//
+		// Threads imported from /proc before the first event have never been
+		// accessed, so start counting their timeout from now
+		//
+		if(tinfo->m_lastaccess_ts == 0)
+		{
+			touch(tinfo, now);
+			continue;
+		}
+
+		bool closed = (tinfo->m_flags & PPM_CL_CLOSED) != 0;
+
+		if(closed || 
+			!scap_is_thread_alive(m_inspector->m_h, tinfo->m_pid, tinfo->m_tid, tinfo->m_comm.c_str()))
+		{
+			if(closed || tinfo->m_nchilds == 0)
+			{
+				res = true;
+				remove_thread(tinfo->m_tid, closed);
+				continue;
+			}
+
+			//
+			// Dead, but stuck because of reference counting. It will be freed
+			// after the next rebalance of the dependency tree.
+			//
+			m_child_dependencies_dirty = true;
+		}
+
+		touch(tinfo, now);
+	}
 
 	if(m_last_flush_time_ns == 0)
 	{
 		//
-		// Set the first table scan for 30 seconds in, so that we can spot bugs in the logic without having
+		// Set the first flush for 30 seconds in, so that we can spot bugs in the logic without having
 		// to wait for tens of minutes
 		//
 		if(m_inspector->m_inactive_thread_scan_time_ns > 30 * ONE_SECOND_IN_NS)
 		{
-			m_last_flush_time_ns = 
-				(m_inspector->m_lastevent_ts - m_inspector->m_inactive_thread_scan_time_ns + 30 * ONE_SECOND_IN_NS);
+			m_last_flush_time_ns = now - m_inspector->m_inactive_thread_scan_time_ns + 30 * ONE_SECOND_IN_NS;
 		}
 		else
 		{
-			m_last_flush_time_ns = 
-				(m_inspector->m_lastevent_ts - m_inspector->m_inactive_thread_scan_time_ns);			
+			m_last_flush_time_ns = now - m_inspector->m_inactive_thread_scan_time_ns;
 		}
 	}
 
-	if(m_inspector->m_lastevent_ts > 
-		m_last_flush_time_ns + m_inspector->m_inactive_thread_scan_time_ns)
+	if(now > m_last_flush_time_ns + m_inspector->m_inactive_thread_scan_time_ns)
 	{
-		res = true;
-
-		m_last_flush_time_ns = m_inspector->m_lastevent_ts;
-
-		g_logger.format(sinsp_logger::SEV_INFO, "Flushing thread table");
+		m_last_flush_time_ns = now;
 
 		//
-		// Go through the table and remove dead entries.
+		// Remove the threads that exited and are still in the table, like the
+		// main threads that had children when they exited
 		//
-		for(threadinfo_map_iterator_t it = m_threadtable.begin(); it != m_threadtable.end();)
+		for(uint32_t j = 0; j < m_closed_tids.size(); j++)
 		{
-			bool closed = (it->second.m_flags & PPM_CL_CLOSED) != 0;
+			threadinfo_map_iterator_t it = m_threadtable.find(m_closed_tids[j]);
 
-			if(closed || 
-				((m_inspector->m_lastevent_ts > it->second.m_lastaccess_ts + m_inspector->m_thread_timeout_ns) &&
-					!scap_is_thread_alive(m_inspector->m_h, it->second.m_pid, it->first, it->second.m_comm.c_str()))
-					)
-			{
-				//
-				// Reset the cache
-				//
-				m_last_tid = 0;
-				m_last_tinfo = NULL;
-
-#ifdef GATHER_INTERNAL_STATS
-				m_removed_threads->increment();
-#endif
-				remove_thread(it++, closed);
-			}
-			else
+			if(it != m_threadtable.end() && (it->second.m_flags & PPM_CL_CLOSED))
 			{
-				++it;
+				res = true;
+				remove_thread(it, true);
+				m_child_dependencies_dirty = true;
 			}
 		}
 
+		m_closed_tids.clear();
+		m_closed_tids_compact_size = MIN_CLOSED_TIDS_COMPACT_SIZE;
+
 		//
 		// Rebalance the thread table dependency tree, so we free up threads that
 		// exited but that are stuck because of reference counting.
 		//
-		recreate_child_dependencies();
+		if(m_child_dependencies_dirty)
+		{
+			g_logger.format(sinsp_logger::SEV_INFO, "Rebalancing thread table");
+
+			m_child_dependencies_dirty = false;
+			recreate_child_dependencies();
+		}
 	}
 
 	return res;
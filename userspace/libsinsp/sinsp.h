@@ -59,8 +59,10 @@ along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
 #include <unordered_map>
 #include <map>
 #include <queue>
+#include <deque>
 #include <vector>
 #include <set>
+#include <unordered_set>
 
 using namespace std;
 
@@ -69,6 +71,7 @@ using namespace std;
 #include "logger.h"
 #include "event.h"
 #include "filter.h"
+#include "filterset.h"
 #include "dumper.h"
 #include "stats.h"
 #include "ifinfo.h"
@@ -94,10 +97,16 @@ typedef enum sinsp_pd_callback_type
 }sinsp_pd_callback_type;
 
 #include "tuples.h"
+#include "internpool.h"
 #include "fdinfo.h"
 #include "threadinfo.h"
 #include "ifinfo.h"
 #include "eventformatter.h"
+#include "outputsink.h"
+#include "binaryrecords.h"
+#include "sketches.h"
+#include "aggregator.h"
+#include "fanout.h"
 
 class sinsp_partial_transaction;
 class sinsp_parser;
@@ -105,6 +114,9 @@ class sinsp_analyzer;
 class sinsp_filter;
 class cycle_writer;
 class sinsp_protodecoder;
+class sinsp_proc_resolver;
+class sinsp_fanout_publisher;
+class sinsp_fanout_subscriber;
 
 vector<string> sinsp_split(const string &s, char delim);
 
@@ -208,6 +220,19 @@ public:
 	*/
 	void open(string filename);
 
+	/*!
+	  \brief Read the events that another local inspector publishes with
+	   \ref start_publishing(), instead of capturing them. The thread and fd
+	   state comes with the events, so filters and output formats work like
+	   in a live capture, without loading the driver or scanning /proc.
+
+	  \param name the name that the publisher was started with.
+
+	  @throws a sinsp_exception containing the error string is thrown in case
+	   of failure, for example if nobody is publishing with the given name.
+	*/
+	void open_subscriber(const string& name);
+
 	/*!
 	  \brief Ends a capture and release all resources.
 	*/
@@ -310,6 +335,41 @@ public:
 	   string if no filter has been set yet.
 	*/
 	const string get_filter();
+
+	/*!
+	  \brief Return the runtime statistics of the checks of the capture
+	   filter, as a printable table. See \ref sinsp_filter::get_stats().
+
+	  \return the statistics table, or an empty string if no filter has been
+	   set.
+	*/
+	string get_filter_stats();
+
+	/*!
+	  \brief Return the filter set that the chisels running on this
+	   inspector share, so that their filters are evaluated together.
+	*/
+	sinsp_filter_set* get_chisel_filters()
+	{
+		return &m_chisel_filters;
+	}
+
+	/*!
+	  \brief Programs the driver so that it only captures the event types
+	   that can pass the capture filter, plus the ones that the state engine
+	   needs to keep track of processes and fds.
+
+	  \return true if the driver event mask was changed, false if the filter
+	   can accept any event type or this is not a live capture.
+
+	  \note Call this after \ref open() and \ref set_filter(). The mask is
+	   reset when the capture is reopened.
+
+	  @throws a sinsp_exception containing the error string is thrown in case
+	   the driver can't be programmed. The driver is then set back to
+	   capture every event type.
+	*/
+	bool apply_filter_eventmask();
 #endif
 
 	/*!
@@ -441,10 +501,45 @@ public:
 	  \brief Fill the given structure with statistics about the currently
 	   open capture.
 
-	  \note this call won't work on file captures.
+	  \note this call won't work on file captures. For the inspectors opened
+	   with \ref open_subscriber(), n_evts and n_drops count the published
+	   events and the ones that were lost.
 	*/
 	void get_capture_stats(scap_stats* stats);
 
+	/*!
+	  \brief Publish the events of this inspector to the local processes
+	   that call \ref open_subscriber(). Events are published after they
+	   have been parsed and filtered, so the filter of this inspector limits
+	   what the subscribers get.
+
+	  \param name the name that the subscribers use to find the publisher.
+	  \param ring_size the size of the shared memory ring, in bytes.
+	  \param wait_subscribers if not 0, wait for that many subscribers before
+	   publishing the first event, and never overwrite the events that they
+	   haven't read yet. Meant for publishing trace files.
+
+	  @throws a sinsp_exception containing the error string is thrown in case
+	   of failure.
+	*/
+	void start_publishing(const string& name, uint64_t ring_size = FANOUT_RING_SIZE, uint32_t wait_subscribers = 0);
+
+	/*!
+	  \brief Stop publishing. The subscribers see the end of the capture
+	   after reading the events that have already been published.
+
+	  \note Publishing continues across \ref close() and \ref open(), so
+	   multiple trace files can be published as a single stream. It stops
+	   when the inspector is destroyed.
+	*/
+	void stop_publishing();
+
+	/*!
+	  \brief Fill the given vector with the state of the subscribers of this
+	   inspector.
+	*/
+	void get_fanout_stats(OUT vector<sinsp_fanout_subscriber_stats>* stats);
+
 
 #ifdef GATHER_INTERNAL_STATS
 	sinsp_stats get_stats();
@@ -530,6 +625,30 @@ public:
 	*/
 	void set_max_evt_output_len(uint32_t len);
 
+	/*!
+	  \brief Enable or disable the asynchronous lookup of the threads that
+	   are missing from the thread table.
+
+	  \param enable if true, the /proc scan for a missing thread runs on a
+	   background thread. The event that triggered it is processed with
+	   placeholder thread information, and the real information is merged
+	   into the table when the scan completes.
+
+	  \note This must be called before opening the capture, and only affects
+	   live captures.
+	*/
+	void set_async_proc_lookups(bool enable);
+
+	/*!
+	  \brief Return the number of events that were processed while the
+	   /proc lookup for their thread was still in progress, and therefore
+	   carry incomplete thread information.
+	*/
+	uint64_t get_n_incomplete_thread_evts()
+	{
+		return m_n_incomplete_thread_evts;
+	}
+
 	/*!
 	  \brief Returns true if the debug mode is enabled.
 	*/
@@ -642,6 +761,9 @@ private:
 	int64_t m_tid_of_fd_to_remove;
 	vector<int64_t>* m_fds_to_remove;
 	uint64_t m_lastevent_ts;
+	// the timestamp of the first event that passed the capture filter, which
+	// the relative times start from
+	uint64_t m_firstacceptedevent_ts;
 	// the parsing engine
 	sinsp_parser* m_parser;
 	// the statistics analysis engine
@@ -666,6 +788,7 @@ private:
 	uint64_t m_firstevent_ts;
 	sinsp_filter* m_filter;
 	string m_filterstring;
+	sinsp_filter_set m_chisel_filters;
 #endif
 
 	//
@@ -678,6 +801,11 @@ private:
 	uint64_t m_n_proc_lookups_duration_ns;
 	uint32_t m_max_n_proc_lookups;
 	uint32_t m_max_n_proc_socket_lookups;
+	bool m_async_proc_lookups;
+	sinsp_proc_resolver* m_proc_resolver;
+	sinsp_fanout_publisher* m_fanout_publisher;
+	sinsp_fanout_subscriber* m_fanout_subscriber;
+	uint64_t m_n_incomplete_thread_evts;
 #ifdef HAS_ANALYZER
 	vector<uint64_t> m_tid_collisions;
 #endif
@@ -754,7 +882,11 @@ private:
 	friend class sinsp_protodecoder;
 	friend class lua_cbacks;
 	friend class sinsp_filter_check_container;
+	friend class sinsp_filter_check_event;
 	friend class sinsp_worker;
+	friend class sinsp_proc_resolver;
+	friend class sinsp_fanout_publisher;
+	friend class sinsp_fanout_subscriber;
 
 	template<class TKey,class THash,class TCompare> friend class sinsp_connection_manager;
 };
@@ -0,0 +1,344 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <math.h>
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "sketches.h"
+
+//
+// Sorts the counters by decreasing count
+//
+struct counter_comparer
+{
+	bool operator() (const sinsp_space_saving::counter* first, const sinsp_space_saving::counter* second) const
+	{
+		return first->m_count > second->m_count;
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_space_saving implementation
+///////////////////////////////////////////////////////////////////////////////
+sinsp_space_saving::sinsp_space_saving(uint32_t capacity)
+{
+	if(capacity == 0)
+	{
+		throw sinsp_exception("the capacity of a top keys table can't be 0");
+	}
+
+	m_capacity = capacity;
+	m_total = 0;
+	m_counters.reserve(capacity);
+	m_heap.reserve(capacity);
+	m_index.reserve(capacity);
+}
+
+void sinsp_space_saving::add(const string& key, double weight)
+{
+	if(!(weight > 0))
+	{
+		return;
+	}
+
+	m_total += weight;
+
+	unordered_map<string, uint32_t>::iterator it = m_index.find(key);
+
+	if(it != m_index.end())
+	{
+		counter& c = m_counters[it->second];
+		c.m_count += weight;
+		sift_down(c.m_heap_pos);
+		return;
+	}
+
+	if(m_counters.size() < m_capacity)
+	{
+		uint32_t idx = (uint32_t)m_counters.size();
+
+		m_counters.push_back(counter());
+		counter& c = m_counters.back();
+		c.m_key = key;
+		c.m_count = weight;
+		c.m_error = 0;
+		c.m_heap_pos = (uint32_t)m_heap.size();
+
+		m_heap.push_back(idx);
+		m_index[key] = idx;
+		sift_up(c.m_heap_pos);
+		return;
+	}
+
+	//
+	// The table is full: the key replaces the one with the smallest count,
+	// whose count becomes the error of the new key
+	//
+	uint32_t idx = m_heap[0];
+	counter& c = m_counters[idx];
+
+	m_index.erase(c.m_key);
+	c.m_key = key;
+	c.m_error = c.m_count;
+	c.m_count += weight;
+	m_index[key] = idx;
+	sift_down(0);
+}
+
+void sinsp_space_saving::heap_swap(uint32_t a, uint32_t b)
+{
+	uint32_t tmp = m_heap[a];
+	m_heap[a] = m_heap[b];
+	m_heap[b] = tmp;
+
+	m_counters[m_heap[a]].m_heap_pos = a;
+	m_counters[m_heap[b]].m_heap_pos = b;
+}
+
+void sinsp_space_saving::sift_up(uint32_t pos)
+{
+	while(pos > 0)
+	{
+		uint32_t parent = (pos - 1) / 2;
+
+		if(m_counters[m_heap[parent]].m_count <= m_counters[m_heap[pos]].m_count)
+		{
+			break;
+		}
+
+		heap_swap(pos, parent);
+		pos = parent;
+	}
+}
+
+void sinsp_space_saving::sift_down(uint32_t pos)
+{
+	uint32_t size = (uint32_t)m_heap.size();
+
+	while(true)
+	{
+		uint32_t smallest = pos;
+		uint32_t left = pos * 2 + 1;
+		uint32_t right = left + 1;
+
+		if(left < size && m_counters[m_heap[left]].m_count < m_counters[m_heap[smallest]].m_count)
+		{
+			smallest = left;
+		}
+
+		if(right < size && m_counters[m_heap[right]].m_count < m_counters[m_heap[smallest]].m_count)
+		{
+			smallest = right;
+		}
+
+		if(smallest == pos)
+		{
+			break;
+		}
+
+		heap_swap(pos, smallest);
+		pos = smallest;
+	}
+}
+
+void sinsp_space_saving::get_top(uint32_t n, OUT vector<const counter*>* res)
+{
+	res->clear();
+	res->reserve(m_counters.size());
+
+	for(uint32_t j = 0; j < m_counters.size(); j++)
+	{
+		res->push_back(&m_counters[j]);
+	}
+
+	counter_comparer cmp;
+
+	if(n != 0 && n < res->size())
+	{
+		partial_sort(res->begin(), res->begin() + n, res->end(), cmp);
+		res->resize(n);
+	}
+	else
+	{
+		sort(res->begin(), res->end(), cmp);
+	}
+}
+
+void sinsp_space_saving::clear()
+{
+	m_counters.clear();
+	m_heap.clear();
+	m_index.clear();
+	m_total = 0;
+}
+
+uint64_t sinsp_space_saving::get_memory_size()
+{
+	//
+	// The counters and the heap are allocated upfront. Every key is stored
+	// twice, in its counter and in the index, and the index has a node and a
+	// bucket per key.
+	//
+	uint64_t res = (uint64_t)m_capacity * (sizeof(counter) + sizeof(uint32_t));
+
+	for(uint32_t j = 0; j < m_counters.size(); j++)
+	{
+		res += 2 * m_counters[j].m_key.capacity() +
+			sizeof(unordered_map<string, uint32_t>::value_type) + 2 * sizeof(void*);
+	}
+
+	return res;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_hyperloglog implementation
+///////////////////////////////////////////////////////////////////////////////
+sinsp_hyperloglog::sinsp_hyperloglog(uint32_t precision)
+{
+	if(precision < HLL_MIN_PRECISION || precision > HLL_MAX_PRECISION)
+	{
+		throw sinsp_exception("the precision of a distinct counter must be between " +
+			to_string((long long)HLL_MIN_PRECISION) + " and " +
+			to_string((long long)HLL_MAX_PRECISION));
+	}
+
+	m_precision = precision;
+	m_registers.resize(1 << precision);
+}
+
+uint64_t sinsp_hyperloglog::hash(const char* data, uint32_t len)
+{
+	//
+	// FNV-1a, followed by the MurmurHash3 finalizer to spread the bits, since
+	// the estimate uses the leading bits of the hash
+	//
+	uint64_t h = 0xcbf29ce484222325ULL;
+
+	for(uint32_t j = 0; j < len; j++)
+	{
+		h ^= (uint8_t)data[j];
+		h *= 0x100000001b3ULL;
+	}
+
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+
+	return h;
+}
+
+void sinsp_hyperloglog::add_hash(uint64_t h)
+{
+	//
+	// The first p bits select the register, which keeps the max position of
+	// the first 1 bit in the rest of the hash. The guard bit bounds the
+	// position when the rest is all zeros.
+	//
+	uint32_t idx = (uint32_t)(h >> (64 - m_precision));
+	uint64_t w = (h << m_precision) | (1ULL << (m_precision - 1));
+	uint8_t rank = 1;
+
+	while((w & 0x8000000000000000ULL) == 0)
+	{
+		w <<= 1;
+		rank++;
+	}
+
+	if(rank > m_registers[idx])
+	{
+		m_registers[idx] = rank;
+	}
+}
+
+double sinsp_hyperloglog::estimate()
+{
+	double m = (double)m_registers.size();
+	double alpha;
+
+	switch(m_registers.size())
+	{
+	case 16:
+		alpha = 0.673;
+		break;
+	case 32:
+		alpha = 0.697;
+		break;
+	case 64:
+		alpha = 0.709;
+		break;
+	default:
+		alpha = 0.7213 / (1 + 1.079 / m);
+		break;
+	}
+
+	double sum = 0;
+	uint32_t nzeros = 0;
+
+	for(uint32_t j = 0; j < m_registers.size(); j++)
+	{
+		sum += ldexp(1.0, -(int)m_registers[j]);
+
+		if(m_registers[j] == 0)
+		{
+			nzeros++;
+		}
+	}
+
+	double res = alpha * m * m / sum;
+
+	//
+	// For the small cardinalities, the number of empty registers gives a
+	// better estimate
+	//
+	if(res <= 2.5 * m && nzeros != 0)
+	{
+		res = m * log(m / nzeros);
+	}
+
+	return res;
+}
+
+void sinsp_hyperloglog::merge(const sinsp_hyperloglog& other)
+{
+	if(other.m_precision != m_precision)
+	{
+		throw sinsp_exception("can't merge distinct counters with different precisions");
+	}
+
+	for(uint32_t j = 0; j < m_registers.size(); j++)
+	{
+		if(other.m_registers[j] > m_registers[j])
+		{
+			m_registers[j] = other.m_registers[j];
+		}
+	}
+}
+
+void sinsp_hyperloglog::clear()
+{
+	memset(&m_registers[0], 0, m_registers.size());
+}
+
+double sinsp_hyperloglog::get_std_error()
+{
+	return 1.04 / sqrt((double)m_registers.size());
+}
@@ -0,0 +1,210 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+/** @defgroup sketches Approximate counting with bounded memory
+ *  @{
+ */
+
+/*!
+  \brief Finds the keys with the largest total weight in a stream, keeping at
+   most a fixed number of keys.
+
+  This is the Space-Saving algorithm (Metwally, Agrawal, El Abbadi, 2005),
+  with weights. Every key that is already tracked gets its weight added to its
+  counter. When the table is full, a new key takes the place of the counter
+  with the smallest count, and inherits that count as its error.
+
+  Guarantees, with N the total weight added and k the capacity:
+  - the estimated count of a key is never lower than its real weight, and
+    never higher than the real weight plus the error of its counter;
+  - the error of a counter is at most N / k;
+  - every key with a real weight larger than N / k is in the table.
+  As long as there are no more than k different keys, the counts are exact.
+
+  The table holds k counters, each with a copy of its key, plus an index of
+  the keys: the memory doesn't grow after the first k keys.
+*/
+class SINSP_PUBLIC sinsp_space_saving
+{
+public:
+	class counter
+	{
+	public:
+		string m_key;
+		double m_count; ///< Estimated weight of the key, never lower than the real one.
+		double m_error; ///< Max amount by which m_count can exceed the real weight.
+
+	private:
+		uint32_t m_heap_pos;
+
+		friend class sinsp_space_saving;
+	};
+
+	/*!
+	  \param capacity The number of keys that can be tracked. Must not be 0.
+	*/
+	sinsp_space_saving(uint32_t capacity);
+
+	/*!
+	  \brief Add weight to a key. Weights that are not positive are ignored.
+	*/
+	void add(const string& key, double weight);
+
+	/*!
+	  \brief Get the keys with the largest counts, sorted by count.
+
+	  \param n The number of keys to return, or 0 to return all of them.
+	  \param res Filled with pointers to the counters, which stay valid
+	   until the next call to add() or clear().
+	*/
+	void get_top(uint32_t n, OUT vector<const counter*>* res);
+
+	/*!
+	  \brief Forget all the keys.
+	*/
+	void clear();
+
+	uint32_t get_capacity()
+	{
+		return m_capacity;
+	}
+
+	/*!
+	  \brief Get the number of keys in the table.
+	*/
+	uint32_t size()
+	{
+		return (uint32_t)m_counters.size();
+	}
+
+	/*!
+	  \brief Get the total weight added since the last clear().
+	*/
+	double get_total_weight()
+	{
+		return m_total;
+	}
+
+	/*!
+	  \brief Get the bound on the error of the counts, N / k.
+	*/
+	double get_max_error()
+	{
+		return (m_counters.size() < m_capacity)? 0 : m_total / m_capacity;
+	}
+
+	/*!
+	  \brief Get the approximate number of bytes used by the table.
+	*/
+	uint64_t get_memory_size();
+
+private:
+	void sift_up(uint32_t pos);
+	void sift_down(uint32_t pos);
+	void heap_swap(uint32_t a, uint32_t b);
+
+	uint32_t m_capacity;
+	double m_total;
+	vector<counter> m_counters;
+	//
+	// Min-heap of the counter indexes, ordered by count
+	//
+	vector<uint32_t> m_heap;
+	unordered_map<string, uint32_t> m_index;
+};
+
+/*!
+  \brief Estimates the number of distinct keys in a stream, using a fixed
+   amount of memory.
+
+  This is HyperLogLog (Flajolet, Fusy, Gandouet, Meunier, 2007), with the
+  linear counting correction for the small cardinalities. With precision p,
+  the sketch uses 2^p one byte registers, and the standard error of the
+  estimate is 1.04 / sqrt(2^p): for example 0.81% with the default precision
+  of 14, which takes 16KB. The estimate is within one standard error of the
+  real count about 65% of the times, and within three standard errors more
+  than 99% of the times.
+*/
+class SINSP_PUBLIC sinsp_hyperloglog
+{
+public:
+	/*!
+	  \param precision The log2 of the number of registers, between
+	   HLL_MIN_PRECISION and HLL_MAX_PRECISION.
+
+	  \note Throws a sinsp_exception if the precision is out of range.
+	*/
+	sinsp_hyperloglog(uint32_t precision = HLL_DEFAULT_PRECISION);
+
+	/*!
+	  \brief Add a key.
+	*/
+	void add(const char* data, uint32_t len)
+	{
+		add_hash(hash(data, len));
+	}
+
+	/*!
+	  \brief Add a key, given its 64 bit hash.
+	*/
+	void add_hash(uint64_t h);
+
+	/*!
+	  \brief Get the estimated number of distinct keys added.
+	*/
+	double estimate();
+
+	/*!
+	  \brief Add the keys of another sketch with the same precision to this
+	   one.
+	*/
+	void merge(const sinsp_hyperloglog& other);
+
+	/*!
+	  \brief Forget all the keys.
+	*/
+	void clear();
+
+	uint32_t get_precision()
+	{
+		return m_precision;
+	}
+
+	/*!
+	  \brief Get the relative standard error of the estimate.
+	*/
+	double get_std_error();
+
+	uint64_t get_memory_size()
+	{
+		return m_registers.size();
+	}
+
+	/*!
+	  \brief The 64 bit hash that add() uses.
+	*/
+	static uint64_t hash(const char* data, uint32_t len);
+
+private:
+	uint32_t m_precision;
+	vector<uint8_t> m_registers;
+};
+
+/*@}*/
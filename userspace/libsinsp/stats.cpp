@@ -40,6 +40,11 @@ void sinsp_stats::clear()
 	m_n_store_drops = 0;
 	m_n_retrieved_evts = 0;
 	m_n_retrieve_drops = 0;
+	m_n_interned_blobs = 0;
+	m_n_intern_hits = 0;
+	m_n_intern_misses = 0;
+	m_n_interned_fdnames = 0;
+	memset(m_next_latency_hist, 0, sizeof(m_next_latency_hist));
 	m_metrics_registry.clear_all_metrics();
 }
 
@@ -63,6 +68,20 @@ void sinsp_stats::emit(FILE* f)
 	fprintf(f, "store drops: %" PRIu64 "\n", m_n_store_drops);
 	fprintf(f, "retrieved evts: %" PRIu64 "\n", m_n_retrieved_evts);
 	fprintf(f, "retrieve drops: %" PRIu64 "\n", m_n_retrieve_drops);
+	fprintf(f, "interned thread blobs: %" PRIu64 "(%" PRIu64 " hits %" PRIu64 " misses)\n", 
+		m_n_interned_blobs,
+		m_n_intern_hits,
+		m_n_intern_misses);
+	fprintf(f, "interned fd names: %" PRIu64 "\n", m_n_interned_fdnames);
+
+	fprintf(f, "next() latency:\n");
+	for(uint32_t j = 0; j < SINSP_LATENCY_HISTOGRAM_BUCKETS; j++)
+	{
+		if(m_next_latency_hist[j] != 0)
+		{
+			fprintf(f, "  >= %" PRIu64 "ns: %" PRIu64 "\n", ((uint64_t)1) << j, m_next_latency_hist[j]);
+		}
+	}
 
 	for(internal_metrics::registry::metric_map_iterator_t it = m_metrics_registry.get_metrics().begin(); it != m_metrics_registry.get_metrics().end(); it++)
 	{
@@ -22,6 +22,12 @@ along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
 
 #ifdef GATHER_INTERNAL_STATS
 
+//
+// Number of log2 buckets in the latency histograms. The last bucket
+// collects everything above 2^(n-1) ns.
+//
+#define SINSP_LATENCY_HISTOGRAM_BUCKETS 32
+
 //
 // Processing stats class.
 // Keeps a bunch of counters with key library performance metrics.
@@ -38,6 +44,22 @@ public:
 
 	void process(internal_metrics::counter& metric);
 
+	//
+	// Account a call to sinsp::next() that took the given time
+	//
+	void add_next_latency(uint64_t ns)
+	{
+		uint32_t bucket = 0;
+
+		while(ns > 1 && bucket < SINSP_LATENCY_HISTOGRAM_BUCKETS - 1)
+		{
+			ns >>= 1;
+			bucket++;
+		}
+
+		m_next_latency_hist[bucket]++;
+	}
+
 	uint64_t m_n_seen_evts;
 	uint64_t m_n_drops;
 	uint64_t m_n_preemptions;
@@ -52,6 +74,11 @@ public:
 	uint64_t m_n_store_drops;
 	uint64_t m_n_retrieved_evts;
 	uint64_t m_n_retrieve_drops;
+	uint64_t m_n_interned_blobs;
+	uint64_t m_n_intern_hits;
+	uint64_t m_n_intern_misses;
+	uint64_t m_n_interned_fdnames;
+	uint64_t m_next_latency_hist[SINSP_LATENCY_HISTOGRAM_BUCKETS]; ///< Bucket j counts the calls to next() that took [2^j, 2^(j+1)) ns
 
 private:
 	internal_metrics::registry m_metrics_registry;
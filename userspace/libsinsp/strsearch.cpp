@@ -0,0 +1,185 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "strsearch.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+sinsp_substring_search::sinsp_substring_search(const char* needle, uint32_t len)
+{
+	uint32_t j;
+
+	m_needle.assign(needle, len);
+	m_needle_len = len;
+
+	for(j = 0; j < 256; j++)
+	{
+		m_shift[j] = len;
+	}
+
+	for(j = 0; j + 1 < len; j++)
+	{
+		m_shift[(uint8_t)needle[j]] = len - 1 - j;
+	}
+
+	if(len == 0)
+	{
+		m_find = find_empty;
+		m_impl_name = "empty";
+	}
+	else if(len == 1)
+	{
+		m_find = find_byte;
+		m_impl_name = "memchr";
+	}
+	else
+	{
+#if defined(__GNUC__) && defined(__x86_64__)
+		__builtin_cpu_init();
+
+		if(__builtin_cpu_supports("avx2"))
+		{
+			m_find = find_avx2;
+			m_impl_name = "avx2";
+		}
+		else
+		{
+			//
+			// SSE2 is part of the x86_64 baseline
+			//
+			m_find = find_sse2;
+			m_impl_name = "sse2";
+		}
+#else
+		m_find = find_horspool;
+		m_impl_name = "horspool";
+#endif
+	}
+}
+
+bool sinsp_substring_search::find_empty(sinsp_substring_search* s, const uint8_t* buf, uint32_t len)
+{
+	return true;
+}
+
+bool sinsp_substring_search::find_byte(sinsp_substring_search* s, const uint8_t* buf, uint32_t len)
+{
+	return memchr(buf, s->m_needle[0], len) != NULL;
+}
+
+bool sinsp_substring_search::find_horspool(sinsp_substring_search* s, const uint8_t* buf, uint32_t len)
+{
+	return s->horspool(buf, 0, len);
+}
+
+bool sinsp_substring_search::horspool(const uint8_t* buf, uint32_t start, uint32_t len)
+{
+	const uint8_t* needle = (const uint8_t*)m_needle.data();
+	uint32_t n = m_needle_len;
+	uint8_t last = needle[n - 1];
+	uint32_t j = start;
+
+	while(j + n <= len)
+	{
+		uint8_t c = buf[j + n - 1];
+
+		if(c == last && memcmp(buf + j, needle, n - 1) == 0)
+		{
+			return true;
+		}
+
+		j += m_shift[c];
+	}
+
+	return false;
+}
+
+#if defined(__GNUC__) && defined(__x86_64__)
+//
+// The vectorized versions compare a block of candidate positions with the
+// first and the last byte of the needle at once, and run memcmp only on the
+// positions where both match. Loads never go past the end of the buffer:
+// the positions that don't fill a whole block are left to Horspool.
+//
+bool sinsp_substring_search::find_sse2(sinsp_substring_search* s, const uint8_t* buf, uint32_t len)
+{
+	const char* needle = s->m_needle.data();
+	uint32_t n = s->m_needle_len;
+	const __m128i first = _mm_set1_epi8(needle[0]);
+	const __m128i last = _mm_set1_epi8(needle[n - 1]);
+	uint32_t j;
+
+	for(j = 0; j + n - 1 + 16 <= len; j += 16)
+	{
+		__m128i bfirst = _mm_loadu_si128((const __m128i*)(buf + j));
+		__m128i blast = _mm_loadu_si128((const __m128i*)(buf + j + n - 1));
+		uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, bfirst),
+			_mm_cmpeq_epi8(last, blast)));
+
+		while(mask != 0)
+		{
+			uint32_t pos = j + __builtin_ctz(mask);
+
+			if(memcmp(buf + pos + 1, needle + 1, n - 2) == 0)
+			{
+				return true;
+			}
+
+			mask &= mask - 1;
+		}
+	}
+
+	return s->horspool(buf, j, len);
+}
+
+__attribute__((target("avx2")))
+bool sinsp_substring_search::find_avx2(sinsp_substring_search* s, const uint8_t* buf, uint32_t len)
+{
+	const char* needle = s->m_needle.data();
+	uint32_t n = s->m_needle_len;
+	const __m256i first = _mm256_set1_epi8(needle[0]);
+	const __m256i last = _mm256_set1_epi8(needle[n - 1]);
+	uint32_t j;
+
+	for(j = 0; j + n - 1 + 32 <= len; j += 32)
+	{
+		__m256i bfirst = _mm256_loadu_si256((const __m256i*)(buf + j));
+		__m256i blast = _mm256_loadu_si256((const __m256i*)(buf + j + n - 1));
+		uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, bfirst),
+			_mm256_cmpeq_epi8(last, blast)));
+
+		while(mask != 0)
+		{
+			uint32_t pos = j + __builtin_ctz(mask);
+
+			if(memcmp(buf + pos + 1, needle + 1, n - 2) == 0)
+			{
+				return true;
+			}
+
+			mask &= mask - 1;
+		}
+	}
+
+	return s->horspool(buf, j, len);
+}
+#endif
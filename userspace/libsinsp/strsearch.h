@@ -0,0 +1,88 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// Substring search for a needle that is known in advance, like the constant
+// of a 'contains' filter.
+// The needle is preprocessed once, and the search routine is picked at
+// construction time based on the CPU: AVX2 or SSE2 filtering on the first
+// and last byte of the needle when available, Horspool otherwise.
+///////////////////////////////////////////////////////////////////////////////
+class sinsp_substring_search
+{
+public:
+	sinsp_substring_search(const char* needle, uint32_t len);
+
+	//
+	// True if the needle appears in the given buffer
+	//
+	bool find(const char* buf, uint32_t len)
+	{
+		if(len < m_needle_len)
+		{
+			return false;
+		}
+
+		return m_find(this, (const uint8_t*)buf, len);
+	}
+
+	//
+	// True if the needle appears in the given NULL terminated string
+	//
+	bool find_string(const char* str)
+	{
+		return find(str, (uint32_t)strlen(str));
+	}
+
+	//
+	// The name of the selected implementation, for debugging
+	//
+	const char* get_impl_name()
+	{
+		return m_impl_name;
+	}
+
+private:
+	typedef bool (*find_fn)(sinsp_substring_search* s, const uint8_t* buf, uint32_t len);
+
+	static bool find_empty(sinsp_substring_search* s, const uint8_t* buf, uint32_t len);
+	static bool find_byte(sinsp_substring_search* s, const uint8_t* buf, uint32_t len);
+	static bool find_horspool(sinsp_substring_search* s, const uint8_t* buf, uint32_t len);
+#if defined(__GNUC__) && defined(__x86_64__)
+	static bool find_sse2(sinsp_substring_search* s, const uint8_t* buf, uint32_t len);
+	static bool find_avx2(sinsp_substring_search* s, const uint8_t* buf, uint32_t len);
+#endif
+
+	//
+	// Horspool on the part of the buffer starting at start, used by the
+	// vectorized versions for the tail
+	//
+	bool horspool(const uint8_t* buf, uint32_t start, uint32_t len);
+
+	string m_needle;
+	uint32_t m_needle_len;
+	find_fn m_find;
+	const char* m_impl_name;
+
+	//
+	// Horspool bad character shifts
+	//
+	uint32_t m_shift[256];
+};
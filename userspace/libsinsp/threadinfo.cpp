@@ -24,6 +24,7 @@ along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
 #include "sinsp.h"
 #include "sinsp_int.h"
 #include "protodecoder.h"
+#include "procresolver.h"
 
 static void copy_ipv6_address(uint32_t* dest, uint32_t* src)
 {
@@ -36,6 +37,9 @@ static void copy_ipv6_address(uint32_t* dest, uint32_t* src)
 ///////////////////////////////////////////////////////////////////////////////
 // sinsp_threadinfo implementation
 ///////////////////////////////////////////////////////////////////////////////
+const vector<string> sinsp_threadinfo::m_empty_strvec;
+const vector<pair<string, string>> sinsp_threadinfo::m_empty_cgroups;
+
 sinsp_threadinfo::sinsp_threadinfo() :
 	m_fdtable(NULL)
 {
@@ -78,6 +82,12 @@ void sinsp_threadinfo::init()
 #endif
 	m_ainfo = NULL;
 	m_program_hash = 0;
+	m_lru_prev = NULL;
+	m_lru_next = NULL;
+	m_proc_lookup_pending = false;
+	m_ancestors_gen = 0;
+	m_missing_ancestor = -1;
+	m_is_ancestor = false;
 }
 
 sinsp_threadinfo::~sinsp_threadinfo()
@@ -135,16 +145,22 @@ void sinsp_threadinfo::fix_sockets_coming_from_proc()
 
 void sinsp_threadinfo::compute_program_hash()
 {
-	string phs = m_exe;
+	//
+	// Combine the hashes of the components instead of concatenating them,
+	// so we don't need to copy the (potentially long) argument list
+	//
+	std::hash<std::string> hasher;
+	size_t res = hasher(m_exe);
+	const vector<string>& args = get_args();
 
-	for(auto arg = m_args.begin(); arg != m_args.end(); ++arg)
+	for(auto arg = args.begin(); arg != args.end(); ++arg)
 	{
-		phs += *arg;
+		res ^= hasher(*arg) + 0x9e3779b9 + (res << 6) + (res >> 2);
 	}
 
-	phs += m_container_id;
+	res ^= hasher(m_container_id) + 0x9e3779b9 + (res << 6) + (res >> 2);
 
-	m_program_hash = std::hash<std::string>()(phs);
+	m_program_hash = res;
 }
 
 void sinsp_threadinfo::add_fd(scap_fdinfo *fdi)
@@ -307,7 +323,7 @@ void sinsp_threadinfo::init(const scap_threadinfo* pi)
 	ASSERT(m_inspector);
 	if(m_inspector)
 	{
-		m_inspector->m_container_manager.resolve_container_from_cgroups(m_cgroups, m_inspector->m_islive, &m_container_id);
+		m_inspector->m_container_manager.resolve_container_from_cgroups(get_cgroups(), m_inspector->m_islive, &m_container_id);
 	}
 	
 	HASH_ITER(hh, pi->fdlist, fdi, tfdi)
@@ -326,38 +342,22 @@ string sinsp_threadinfo::get_exe()
 	return m_exe;
 }
 
-void sinsp_threadinfo::set_args(const char* args, size_t len)
-{
-	m_args.clear();
-
-	size_t offset = 0;
-	while(offset < len)
-	{
-		m_args.push_back(args + offset);
-		offset += m_args.back().length() + 1;
-	}
-}
-
-void sinsp_threadinfo::set_env(const char* env, size_t len)
+void sinsp_threadinfo::parse_strvec(const char* buf, size_t len, vector<string>* res)
 {
-	m_env.clear();
-
 	size_t offset = 0;
 	while(offset < len)
 	{
-		m_env.push_back(env + offset);
-		offset += m_env.back().length() + 1;
+		res->push_back(buf + offset);
+		offset += res->back().length() + 1;
 	}
 }
 
-void sinsp_threadinfo::set_cgroups(const char* cgroups, size_t len)
+void sinsp_threadinfo::parse_cgroups(const char* buf, size_t len, vector<pair<string, string>>* res)
 {
-	m_cgroups.clear();
-
 	size_t offset = 0;
 	while(offset < len)
 	{
-		const char* str = cgroups + offset;
+		const char* str = buf + offset;
 		const char* sep = strchr(str, '=');
 		if(sep == NULL)
 		{
@@ -384,11 +384,53 @@ void sinsp_threadinfo::set_cgroups(const char* cgroups, size_t len)
 			subsys = "memory";
 		}
 
-		m_cgroups.push_back(std::make_pair(subsys, cgroup));
+		res->push_back(std::make_pair(subsys, cgroup));
 		offset += subsys_length + 1 + cgroup.length() + 1;
 	}
 }
 
+void sinsp_threadinfo::set_args(const char* args, size_t len)
+{
+	if(m_inspector != NULL)
+	{
+		m_args = m_inspector->m_thread_manager->m_strvec_pool.intern(args, len, parse_strvec);
+	}
+	else
+	{
+		vector<string>* res = new vector<string>();
+		parse_strvec(args, len, res);
+		m_args = sinsp_strvec_pool::handle(res);
+	}
+}
+
+void sinsp_threadinfo::set_env(const char* env, size_t len)
+{
+	if(m_inspector != NULL)
+	{
+		m_env = m_inspector->m_thread_manager->m_strvec_pool.intern(env, len, parse_strvec);
+	}
+	else
+	{
+		vector<string>* res = new vector<string>();
+		parse_strvec(env, len, res);
+		m_env = sinsp_strvec_pool::handle(res);
+	}
+}
+
+void sinsp_threadinfo::set_cgroups(const char* cgroups, size_t len)
+{
+	if(m_inspector != NULL)
+	{
+		m_cgroups = m_inspector->m_thread_manager->m_cgroups_pool.intern(cgroups, len, parse_cgroups);
+	}
+	else
+	{
+		vector<pair<string, string>>* res = new vector<pair<string, string>>();
+		parse_cgroups(cgroups, len, res);
+		m_cgroups = sinsp_cgroups_pool::handle(res);
+	}
+}
+
 bool sinsp_threadinfo::is_main_thread()
 {
 	return m_tid == m_pid;
@@ -436,6 +478,74 @@ sinsp_threadinfo* sinsp_threadinfo::get_parent_thread()
 	return m_inspector->get_thread(m_ptid, false, true);
 }
 
+const vector<sinsp_threadinfo*>& sinsp_threadinfo::get_ancestors()
+{
+	sinsp_thread_manager* thread_manager = m_inspector->m_thread_manager;
+
+	if(m_ancestors_gen == thread_manager->m_tree_gen)
+	{
+		return m_ancestors;
+	}
+
+	m_ancestors.clear();
+	m_missing_ancestor = -1;
+
+	sinsp_threadinfo* cur = this;
+
+	while(m_ancestors.size() < MAX_ANCESTOR_CHAIN_LEN)
+	{
+		sinsp_threadinfo* ptinfo = cur->get_parent_thread();
+
+		if(ptinfo == NULL)
+		{
+			//
+			// If the parent shows up later, the chain must be rebuilt
+			//
+			thread_manager->m_missing_ancestors.insert(cur->m_ptid);
+			m_missing_ancestor = cur->m_ptid;
+			break;
+		}
+
+		if(ptinfo == this)
+		{
+			break;
+		}
+
+		ptinfo->m_is_ancestor = true;
+		m_ancestors.push_back(ptinfo);
+		cur = ptinfo;
+	}
+
+	m_ancestors_gen = thread_manager->m_tree_gen;
+	return m_ancestors;
+}
+
+bool sinsp_threadinfo::is_descendant_of(int64_t pid)
+{
+	sinsp_threadinfo* mt = get_main_thread();
+
+	if(mt == NULL)
+	{
+		return false;
+	}
+
+	const vector<sinsp_threadinfo*>& ancestors = mt->get_ancestors();
+
+	for(vector<sinsp_threadinfo*>::const_iterator it = ancestors.begin(); it != ancestors.end(); ++it)
+	{
+		if((*it)->m_pid == pid)
+		{
+			return true;
+		}
+	}
+
+	//
+	// The parent at which the chain stops is not in the table, but we know
+	// its id, e.g. for the children of init when pid 1 was never seen
+	//
+	return mt->m_missing_ancestor != -1 && mt->m_missing_ancestor == pid;
+}
+
 sinsp_fdtable* sinsp_threadinfo::get_fd_table()
 {
 	sinsp_threadinfo* root;
@@ -472,6 +582,16 @@ sinsp_fdinfo_t* sinsp_threadinfo::add_fd(int64_t fd, sinsp_fdinfo_t *fdinfo)
 void sinsp_threadinfo::remove_fd(int64_t fd)
 {
 	get_fd_table()->erase(fd);
+
+#if defined(HAS_CAPTURE)
+	//
+	// A /proc snapshot that is still in flight can predate the close
+	//
+	if(m_proc_lookup_pending && m_inspector->m_proc_resolver != NULL)
+	{
+		m_inspector->m_proc_resolver->on_fd_removed(m_tid, fd);
+	}
+#endif
 }
 
 sinsp_fdinfo_t* sinsp_threadinfo::get_fd(int64_t fd)
@@ -703,6 +823,14 @@ void sinsp_thread_manager::clear()
 	m_last_tinfo = NULL;
 	m_last_flush_time_ns = 0;
 	m_n_drops = 0;
+	m_lru_head = NULL;
+	m_lru_tail = NULL;
+	m_child_dependencies_dirty = false;
+	m_closed_tids.clear();
+	m_closed_tids_compact_size = MIN_CLOSED_TIDS_COMPACT_SIZE;
+	m_container_refs.clear();
+	m_tree_gen = 1;
+	m_missing_ancestors.clear();
 
 #ifdef GATHER_INTERNAL_STATS
 	m_failed_lookups = &m_inspector->m_stats.get_metrics_registry().register_counter(internal_metrics::metric_name("thread_failed_lookups","Failed thread lookups"));
@@ -761,8 +889,38 @@ void sinsp_thread_manager::add_thread(sinsp_threadinfo& threadinfo, bool from_sc
 
 	threadinfo.compute_program_hash();
 
+	//
+	// If we are overwriting an entry, take it out of the expiration list
+	// and drop its container reference first
+	//
+	threadinfo_map_iterator_t it = m_threadtable.find(threadinfo.m_tid);
+	if(it != m_threadtable.end())
+	{
+		lru_remove(&it->second);
+		container_unref(it->second.m_container_id);
+
+		if(it->second.m_is_ancestor)
+		{
+			invalidate_ancestors();
+		}
+	}
+
+	if(!m_missing_ancestors.empty() && 
+		m_missing_ancestors.find(threadinfo.m_tid) != m_missing_ancestors.end())
+	{
+		invalidate_ancestors();
+	}
+
 	sinsp_threadinfo& newentry = (m_threadtable[threadinfo.m_tid] = threadinfo);
 
+	newentry.m_ancestors.clear();
+	newentry.m_ancestors_gen = 0;
+	newentry.m_is_ancestor = false;
+
+	newentry.m_lastaccess_ts = m_inspector->m_lastevent_ts;
+	lru_push(&newentry);
+	container_ref(newentry.m_container_id);
+
 	newentry.allocate_private_state();
 
 	if(m_listener)
@@ -771,6 +929,27 @@ void sinsp_thread_manager::add_thread(sinsp_threadinfo& threadinfo, bool from_sc
 	}
 }
 
+//
+// Drop the closed threads that are not in the table anymore
+//
+void sinsp_thread_manager::compact_closed_tids()
+{
+	size_t n = 0;
+
+	for(size_t j = 0; j < m_closed_tids.size(); j++)
+	{
+		threadinfo_map_iterator_t it = m_threadtable.find(m_closed_tids[j]);
+
+		if(it != m_threadtable.end() && (it->second.m_flags & PPM_CL_CLOSED))
+		{
+			m_closed_tids[n++] = m_closed_tids[j];
+		}
+	}
+
+	m_closed_tids.resize(n);
+	m_closed_tids_compact_size = std::max((size_t)MIN_CLOSED_TIDS_COMPACT_SIZE, n * 2);
+}
+
 void sinsp_thread_manager::remove_thread(int64_t tid, bool force)
 {
 	remove_thread(m_threadtable.find(tid), force);
@@ -859,6 +1038,14 @@ void sinsp_thread_manager::remove_thread(threadinfo_map_iterator_t it, bool forc
 		m_removed_threads->increment();
 #endif
 
+		lru_remove(&it->second);
+		container_unref(it->second.m_container_id);
+
+		if(it->second.m_is_ancestor)
+		{
+			invalidate_ancestors();
+		}
+
 		m_threadtable.erase(it);
 
 		//
@@ -874,6 +1061,45 @@ void sinsp_thread_manager::remove_thread(threadinfo_map_iterator_t it, bool forc
 	}
 }
 
+void sinsp_thread_manager::invalidate_ancestors()
+{
+	m_tree_gen++;
+	m_missing_ancestors.clear();
+}
+
+void sinsp_thread_manager::container_ref(const string& container_id)
+{
+	if(!container_id.empty())
+	{
+		m_container_refs[container_id]++;
+	}
+}
+
+void sinsp_thread_manager::container_unref(const string& container_id)
+{
+	if(container_id.empty())
+	{
+		return;
+	}
+
+	unordered_map<string, uint32_t>::iterator it = m_container_refs.find(container_id);
+	if(it == m_container_refs.end())
+	{
+		ASSERT(false);
+		return;
+	}
+
+	if(--it->second == 0)
+	{
+		m_container_refs.erase(it);
+	}
+}
+
+void sinsp_thread_manager::on_container_id_set(sinsp_threadinfo* tinfo)
+{
+	container_ref(tinfo->m_container_id);
+}
+
 void sinsp_thread_manager::fix_sockets_coming_from_proc()
 {
 	threadinfo_map_iterator_t it;
@@ -945,5 +1171,10 @@ void sinsp_thread_manager::update_statistics()
 	{
 		m_inspector->m_stats.m_n_fds += it->second.get_fd_table()->size();
 	}
+
+	m_inspector->m_stats.m_n_interned_blobs = m_strvec_pool.size() + m_cgroups_pool.size();
+	m_inspector->m_stats.m_n_intern_hits = m_strvec_pool.m_n_hits + m_cgroups_pool.m_n_hits;
+	m_inspector->m_stats.m_n_intern_misses = m_strvec_pool.m_n_misses + m_cgroups_pool.m_n_misses;
+	m_inspector->m_stats.m_n_interned_fdnames = sinsp_fdname::get_table_size();
 #endif
 }
@@ -26,6 +26,12 @@ class sinsp_delays_info;
 class sinsp_threadtable_listener;
 class thread_analyzer_info;
 
+//
+// Shared, immutable thread state. See sinsp_intern_pool.
+//
+typedef sinsp_intern_pool<vector<string>> sinsp_strvec_pool;
+typedef sinsp_intern_pool<vector<pair<string, string>>> sinsp_cgroups_pool;
+
 typedef struct erase_fd_params
 {
 	bool m_remove_from_table;
@@ -73,6 +79,33 @@ public:
 	*/
 	string get_cwd();
 
+	/*!
+	  \brief Return the command line arguments of this thread (e.g. "-d1").
+
+	  \note The vector is shared with the other threads running the same
+	   command line, so it can't be modified.
+	*/
+	inline const vector<string>& get_args()
+	{
+		return (m_args)? *m_args : m_empty_strvec;
+	}
+
+	/*!
+	  \brief Return the environment variables of this thread.
+	*/
+	inline const vector<string>& get_env()
+	{
+		return (m_env)? *m_env : m_empty_strvec;
+	}
+
+	/*!
+	  \brief Return the subsystem-cgroup pairs of this thread.
+	*/
+	inline const vector<pair<string, string>>& get_cgroups()
+	{
+		return (m_cgroups)? *m_cgroups : m_empty_cgroups;
+	}
+
 	/*!
 	  \brief Return true if this is a process' main thread.
 	*/
@@ -88,6 +121,21 @@ public:
 	*/
 	sinsp_threadinfo* get_parent_thread();
 
+	/*!
+	  \brief Get the chain of ancestors of this thread: the parent first,
+	   then the grandparent, and so on.
+
+	  \note The chain is cached and rebuilt only when the process tree
+	   changes, so this is cheap to call on every event.
+	*/
+	const vector<sinsp_threadinfo*>& get_ancestors();
+
+	/*!
+	  \brief Return true if one of the ancestors of this thread's process
+	   has the given pid.
+	*/
+	bool is_descendant_of(int64_t pid);
+
 	/*!
 	  \brief Retrive information about one of this thread/process FDs.
 
@@ -133,9 +181,6 @@ public:
 	int64_t m_ptid; ///< The id of the process that started this thread.
 	string m_comm; ///< Command name (e.g. "top")
 	string m_exe; ///< argv[0] (e.g. "sshd: user@pts/4")
-	vector<string> m_args; ///< Command line arguments (e.g. "-d1")
-	vector<string> m_env; ///< Environment variables
-	vector<pair<string, string>> m_cgroups; ///< subsystem-cgroup pairs
 	string m_container_id; ///< heuristic-based container id
 	uint32_t m_flags; ///< The thread flags. See the PPM_CL_* declarations in ppm_events_public.h.
 	int64_t m_fdlimit;  ///< The maximum number of FDs this thread can open
@@ -207,6 +252,19 @@ VISIBILITY_PRIVATE
 	// the queue of recent fd operations
 	//  std::deque<sinsp_fdop> m_last_fdop;
 
+	static void parse_strvec(const char* buf, size_t len, vector<string>* res);
+	static void parse_cgroups(const char* buf, size_t len, vector<pair<string, string>>* res);
+
+	//
+	// Interned state. Use get_args(), get_env() and get_cgroups() to read it.
+	// Copying a threadinfo copies the handles, not the strings.
+	//
+	sinsp_strvec_pool::handle m_args;
+	sinsp_strvec_pool::handle m_env;
+	sinsp_cgroups_pool::handle m_cgroups;
+	static const vector<string> m_empty_strvec;
+	static const vector<pair<string, string>> m_empty_cgroups;
+
 	//
 	// Parameters that can't be accessed directly because they could be in the
 	// parent thread info
@@ -222,6 +280,31 @@ VISIBILITY_PRIVATE
 	sinsp_evt::category m_lastevent_category;
 	size_t m_program_hash;
 
+	//
+	// Links in the thread manager's expiration list, which keeps the
+	// threads sorted by m_lastaccess_ts
+	//
+	sinsp_threadinfo* m_lru_prev;
+	sinsp_threadinfo* m_lru_next;
+
+	//
+	// True for the placeholders waiting for an asynchronous /proc lookup
+	//
+	bool m_proc_lookup_pending;
+
+	//
+	// Cached ancestor chain, valid as long as m_ancestors_gen matches the
+	// thread manager's process tree generation
+	//
+	vector<sinsp_threadinfo*> m_ancestors;
+	uint64_t m_ancestors_gen;
+	//
+	// The id of the parent at which the cached chain stops because it's
+	// not in the table, or -1 if the chain is complete
+	//
+	int64_t m_missing_ancestor;
+	bool m_is_ancestor; ///< true if this thread is in some cached ancestor chain
+
 	friend class sinsp;
 	friend class sinsp_parser;
 	friend class sinsp_analyzer;
@@ -231,6 +314,9 @@ VISIBILITY_PRIVATE
 	friend class sinsp_transaction_table;
 	friend class thread_analyzer_info;
 	friend class lua_cbacks;
+	friend class sinsp_proc_resolver;
+	friend class sinsp_fanout_publisher;
+	friend class sinsp_fanout_subscriber;
 };
 
 /*@}*/
@@ -277,9 +363,28 @@ public:
 	void set_listener(sinsp_threadtable_listener* listener);
 	void add_thread(sinsp_threadinfo& threadinfo, bool from_scap_proctable);
 	void remove_thread(int64_t tid, bool force);
-	// Returns true if the table is actually scanned
+	// Checks at most max_checks of the expired threads, or all of them if
+	// max_checks is 0. Returns true if a thread was removed.
 	// NOTE: this is implemented in sinsp.cpp so we can inline it from there
-	inline bool remove_inactive_threads();
+	inline bool remove_inactive_threads(uint32_t max_checks);
+
+	//
+	// Mark a thread as exited. If it can't be removed right away, it's
+	// removed at the next periodic flush of the table, whether it expired
+	// or not.
+	//
+	inline void set_closed(sinsp_threadinfo* tinfo)
+	{
+		tinfo->m_flags |= PPM_CL_CLOSED;
+
+		if(m_closed_tids.size() >= m_closed_tids_compact_size)
+		{
+			compact_closed_tids();
+		}
+
+		m_closed_tids.push_back(tinfo->m_tid);
+	}
+
 	void fix_sockets_coming_from_proc();
 	void reset_child_dependencies();
 	void create_child_dependencies();
@@ -297,6 +402,21 @@ public:
 		return &m_threadtable;
 	}
 
+	/*!
+	  \brief Return true if at least one thread in the table belongs to the
+	   given container.
+	*/
+	bool is_container_in_use(const string& container_id)
+	{
+		return m_container_refs.find(container_id) != m_container_refs.end();
+	}
+
+	//
+	// Must be called after the container id of a thread that is already in
+	// the table is set
+	//
+	void on_container_id_set(sinsp_threadinfo* tinfo);
+
 	set<uint16_t> m_server_ports;
 
 private:
@@ -304,16 +424,112 @@ private:
 	void increment_mainthread_childcount(sinsp_threadinfo* threadinfo);
 	inline void clear_thread_pointers(threadinfo_map_iterator_t it);
 
+	//
+	// Expiration list management
+	//
+	inline void lru_push(sinsp_threadinfo* tinfo)
+	{
+		tinfo->m_lru_prev = m_lru_tail;
+		tinfo->m_lru_next = NULL;
+
+		if(m_lru_tail != NULL)
+		{
+			m_lru_tail->m_lru_next = tinfo;
+		}
+		else
+		{
+			m_lru_head = tinfo;
+		}
+
+		m_lru_tail = tinfo;
+	}
+
+	inline void lru_remove(sinsp_threadinfo* tinfo)
+	{
+		if(tinfo->m_lru_prev != NULL)
+		{
+			tinfo->m_lru_prev->m_lru_next = tinfo->m_lru_next;
+		}
+		else
+		{
+			m_lru_head = tinfo->m_lru_next;
+		}
+
+		if(tinfo->m_lru_next != NULL)
+		{
+			tinfo->m_lru_next->m_lru_prev = tinfo->m_lru_prev;
+		}
+		else
+		{
+			m_lru_tail = tinfo->m_lru_prev;
+		}
+	}
+
+	//
+	// Mark the thread as accessed at time ts, moving it to the end of the
+	// expiration list
+	//
+	inline void touch(sinsp_threadinfo* tinfo, uint64_t ts)
+	{
+		tinfo->m_lastaccess_ts = ts;
+
+		if(tinfo != m_lru_tail)
+		{
+			lru_remove(tinfo);
+			lru_push(tinfo);
+		}
+	}
+
+	void compact_closed_tids();
+	void container_ref(const string& container_id);
+	void invalidate_ancestors();
+	void container_unref(const string& container_id);
+
 	sinsp* m_inspector;
 	threadinfo_map_t m_threadtable;
 	int64_t m_last_tid;
 	sinsp_threadinfo* m_last_tinfo;
 	uint64_t m_last_flush_time_ns;
 	uint32_t m_n_drops;
+
+	//
+	// Threads sorted by last access time, least recently used first.
+	// Expiration looks at the head of the list only, so it costs a bounded
+	// amount of work per event instead of a periodic full table scan.
+	//
+	sinsp_threadinfo* m_lru_head;
+	sinsp_threadinfo* m_lru_tail;
+	bool m_child_dependencies_dirty;
+	//
+	// Threads that exited, to be removed at the next flush. Most of them are
+	// removed right away, so the list is compacted when it reaches
+	// m_closed_tids_compact_size.
+	//
+	vector<int64_t> m_closed_tids;
+	size_t m_closed_tids_compact_size;
+
+	//
+	// Number of threads in the table for every container id
+	//
+	unordered_map<string, uint32_t> m_container_refs;
+
+	//
+	// Generation of the process tree. Bumped every time a thread that is
+	// cached as someone's ancestor goes away or is replaced, and when a
+	// missing ancestor shows up, so that the ancestor chains are rebuilt.
+	//
+	uint64_t m_tree_gen;
+	unordered_set<int64_t> m_missing_ancestors;
 	uint32_t m_n_proc_lookups;
 
 	sinsp_threadtable_listener* m_listener;
 
+	//
+	// Pools of the state that threads running the same program share
+	//
+	sinsp_strvec_pool m_strvec_pool;
+	sinsp_cgroups_pool m_cgroups_pool;
+
 	INTERNAL_COUNTER(m_failed_lookups);
 	INTERNAL_COUNTER(m_cached_lookups);
 	INTERNAL_COUNTER(m_non_cached_lookups);
@@ -324,4 +540,5 @@ private:
 	friend class sinsp_analyzer;
 	friend class sinsp;
 	friend class sinsp_threadinfo;
+	friend class sinsp_proc_resolver;
 };
@@ -0,0 +1,97 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define VISIBILITY_PRIVATE
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "../../driver/ppm_events_public.h"
+
+#include <gtest.h>
+
+static sinsp_threadinfo* add_thread(sinsp* inspector, int64_t tid, int64_t pid, int64_t ptid)
+{
+	sinsp_threadinfo newti(inspector);
+	newti.m_tid = tid;
+	newti.m_pid = pid;
+	newti.m_ptid = ptid;
+	if(tid != pid)
+	{
+		newti.m_flags |= PPM_CL_CLONE_THREAD | PPM_CL_CLONE_FILES;
+	}
+
+	inspector->m_thread_manager->add_thread(newti, false);
+	return inspector->get_thread(tid, false, true);
+}
+
+TEST(threadinfo_ancestors,complete_chain)
+{
+	sinsp inspector;
+
+	add_thread(&inspector, 1, 1, 0);
+	add_thread(&inspector, 100, 100, 1);
+	add_thread(&inspector, 200, 200, 100);
+	sinsp_threadinfo* tinfo = add_thread(&inspector, 201, 200, 100);
+
+	ASSERT_TRUE(tinfo != NULL);
+	ASSERT_EQ(2, tinfo->get_main_thread()->get_ancestors().size());
+	EXPECT_TRUE(tinfo->is_descendant_of(100));
+	EXPECT_TRUE(tinfo->is_descendant_of(1));
+	EXPECT_TRUE(tinfo->is_descendant_of(0));
+	EXPECT_FALSE(tinfo->is_descendant_of(200));
+	EXPECT_FALSE(tinfo->is_descendant_of(50));
+}
+
+TEST(threadinfo_ancestors,missing_parent)
+{
+	sinsp inspector;
+
+	//
+	// pid 1 is not in the table, but the chain still knows it's the parent
+	// of 100
+	//
+	sinsp_threadinfo* parent = add_thread(&inspector, 100, 100, 1);
+	sinsp_threadinfo* tinfo = add_thread(&inspector, 200, 200, 100);
+
+	ASSERT_TRUE(tinfo != NULL);
+	EXPECT_TRUE(parent->is_descendant_of(1));
+	EXPECT_TRUE(tinfo->is_descendant_of(100));
+	EXPECT_TRUE(tinfo->is_descendant_of(1));
+	EXPECT_FALSE(tinfo->is_descendant_of(0));
+	EXPECT_FALSE(tinfo->is_descendant_of(-1));
+
+	//
+	// Once pid 1 shows up, the chain goes on to its own parent
+	//
+	add_thread(&inspector, 1, 1, 0);
+	EXPECT_EQ(2, tinfo->get_ancestors().size());
+	EXPECT_TRUE(tinfo->is_descendant_of(1));
+	EXPECT_TRUE(tinfo->is_descendant_of(0));
+}
+
+TEST(threadinfo_ancestors,no_parent)
+{
+	sinsp inspector;
+
+	sinsp_threadinfo* tinfo = add_thread(&inspector, 100, 100, -1);
+
+	ASSERT_TRUE(tinfo != NULL);
+	EXPECT_EQ(0, tinfo->get_ancestors().size());
+	EXPECT_FALSE(tinfo->is_descendant_of(-1));
+	EXPECT_FALSE(tinfo->is_descendant_of(1));
+}
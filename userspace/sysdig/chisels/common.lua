@@ -157,16 +157,59 @@ json = require ("dkjson")
 
 function print_sorted_table(stable, ts_s, ts_ns, timedelta, viz_info)
 	local sorted_grtable = pairs_top_by_val(stable, viz_info.top_number, function(t,a,b) return t[b] < t[a] end)
+	local rows = {}
+
+	for k,v in sorted_grtable do
+		local row = split(k, "\001\001")
+		row[#row + 1] = v
+		rows[#rows + 1] = row
+	end
+
+	print_table_rows(rows, ts_s, ts_ns, timedelta, viz_info)
+end
+
+--[[
+Render a value of a top table, according to viz_info.value_units.
+]]--
+function format_table_value(v, timedelta, viz_info)
+	if viz_info.value_units == "none" then
+		return tostring(v)
+	elseif viz_info.value_units == "bytes" then
+		return format_bytes(v)
+	elseif viz_info.value_units == "time" then
+		return format_time_interval(v)
+	elseif viz_info.value_units == "timepct" then
+		if timedelta ~= 0 then
+			return string.format("%.2f%%", v / timedelta * 100)
+		else
+			return "0.00%"
+		end
+	end
+end
+
+--[[
+Render a list of rows, already sorted, in top format. Every row is an array
+with the values of the keys, followed by the value. This is what
+chisel.aggregator_top() returns, together with the errors and max_error
+arguments: when max_error is not 0, the values with an error are estimates,
+which are marked with a ~ and can exceed the real values by up to max_error.
+]]--
+function print_table_rows(rows, ts_s, ts_ns, timedelta, viz_info, errors, max_error)
+	local approx = (max_error ~= nil and max_error > 0)
 
 	if viz_info.output_format == "json" then
 		local jdata = {}
-		local j = 1
 		
-		for k,v in sorted_grtable do
-			local vals = split(k, "\001\001")
-			vals[#vals + 1] = v
+		for j, row in ipairs(rows) do
+			local nkeys = #row - 1
+			local vals = {}
+
+			for i = 1, nkeys do
+				vals[i] = tostring(row[i])
+			end
+			vals[nkeys + 1] = row[nkeys + 1]
+
 			jdata[j] = vals
-			j = j + 1
 		end
 			
 		local jinfo = {}
@@ -177,6 +220,11 @@ function print_sorted_table(stable, ts_s, ts_ns, timedelta, viz_info)
 		jinfo[3] = {name = viz_info.value_fld, desc = viz_info.value_desc, is_key = false}
 
 		local res = {ts = sysdig.make_ts(ts_s, ts_ns), data = jdata, info = jinfo}
+
+		if approx then
+			res.errors = errors
+			res.max_error = max_error
+		end
 			
 		local str = json.encode(res, { indent = true })
 		print(str)
@@ -188,37 +236,36 @@ function print_sorted_table(stable, ts_s, ts_ns, timedelta, viz_info)
 		for i, fldname in ipairs(viz_info.key_desc) do
 			header = header .. extend_string(fldname, EXTEND_STRING_SIZE)
 		end
+
+		if approx then
+			print("Values marked with ~ are estimates, and can exceed the real values by up to " ..
+				format_table_value(max_error, timedelta, viz_info))
+		end
 		
 		print(header)
 		print("--------------------------------------------------------------------------------")
 
-		for k,v in sorted_grtable do
+		for j, row in ipairs(rows) do
 			local keystr = ""
-			
-			local singlekeys = split(k, "\001\001")
+			local nkeys = #row - 1
+			local valstr = format_table_value(row[nkeys + 1], timedelta, viz_info)
+
+			for i = 1, nkeys do
+				local singlekey = tostring(row[i])
 
-			for i, singlekey in ipairs(singlekeys) do
-				if i < #singlekeys then
+				if i < nkeys then
 					keystr = keystr .. extend_string(string.sub(singlekey, 0, 10), EXTEND_STRING_SIZE)
 				else
 					keystr = keystr .. singlekey
 				end
 			end
 
-			if viz_info.value_units == "none" then
-				print(extend_string(tostring(v), EXTEND_STRING_SIZE) .. keystr)
-			elseif viz_info.value_units == "bytes" then
-				print(extend_string(format_bytes(v), EXTEND_STRING_SIZE) .. keystr)
-			elseif viz_info.value_units == "time" then
-				print(extend_string(format_time_interval(v), EXTEND_STRING_SIZE) .. keystr)
-			elseif viz_info.value_units == "timepct" then
-				if timedelta ~= 0 then
-					pctstr = string.format("%.2f%%", v / timedelta * 100)
-				else
-					pctstr = "0.00%"
-				end
+			if approx and errors[j] > 0 then
+				valstr = "~" .. valstr
+			end
 
-				print(extend_string(pctstr, EXTEND_STRING_SIZE) .. keystr)	
+			if valstr ~= nil then
+				print(extend_string(valstr, EXTEND_STRING_SIZE) .. keystr)
 			end
 		end
 	end
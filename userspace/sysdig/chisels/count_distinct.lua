@@ -0,0 +1,94 @@
+--[[
+Copyright (C) 2013-2014 Draios inc.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+--]]
+
+-- Chisel description
+description = "Estimates the number of distinct values of a set of filter fields, for example the number of different files or remote IPs, using a fixed amount of memory. With precision p the chisel uses 2^p bytes, and the standard error of the estimate is 1.04 / sqrt(2^p). Combine this script with a filter to restrict what it counts. In live captures the count is printed and reset every second."
+short_description = "Count the distinct values of fields"
+category = "Misc"
+
+-- Chisel argument list
+args =
+{
+	{
+		name = "fields",
+		description = "comma-separated list of the filter fields whose combinations are counted, e.g. fd.name or fd.sip,fd.sport",
+		argtype = "string"
+	},
+	{
+		name = "precision",
+		description = "log2 of the memory used by the counter, between 4 and 18. The default, 14, takes 16KB and has a standard error of 0.81%.",
+		argtype = "int",
+		optional = true
+	},
+}
+
+require "common"
+
+fields = ""
+precision = 14
+counter = nil
+islive = false
+
+-- Argument notification callback
+function on_set_arg(name, val)
+	if name == "fields" then
+		fields = val
+		return true
+	elseif name == "precision" then
+		precision = parse_numeric_input(val, name)
+		return true
+	end
+
+	return false
+end
+
+-- Initialization callback
+function on_init()
+	counter = chisel.distinct_counter(split(fields, ","), precision)
+	return true
+end
+
+-- Final chisel initialization
+function on_capture_start()
+	islive = sysdig.is_live()
+
+	if islive then
+		chisel.set_interval_s(1)
+	end
+
+	return true
+end
+
+function print_count()
+	local count, err = chisel.distinct_count(counter)
+	print(string.format("%.0f distinct values of %s (standard error %.2f%%)", count, fields, err * 100))
+end
+
+-- Periodic timeout callback
+function on_interval(ts_s, ts_ns, delta)
+	print_count()
+	chisel.distinct_clear(counter)
+	return true
+end
+
+-- Called by the engine at the end of the capture
+function on_capture_end(ts_s, ts_ns, delta)
+	if not islive then
+		print_count()
+	end
+
+	return true
+end
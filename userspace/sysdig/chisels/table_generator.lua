@@ -58,15 +58,21 @@ args =
 		description = "how to render the values in the result. Can be 'bytes', 'time', 'timepct', or 'none'.",
 		argtype = "string"
 	},
+	{
+		name = "max_groups",
+		description = "maximum number of keys that are tracked. Above this, the values are estimated with bounded memory, and the estimates are marked in the output. 0, the default, tracks every key.",
+		argtype = "int",
+		optional = true
+	},
 }
 
 require "common"
 terminal = require "ansiterminal"
 
-grtable = {}
+aggregator = nil
 filter = ""
 islive = false
-fkeys = {}
+max_groups = 0
 
 vizinfo =
 {
@@ -102,6 +108,9 @@ function on_set_arg(name, val)
 	elseif name == "value_units" then
 		vizinfo.value_units = val
 		return true
+	elseif name == "max_groups" then
+		max_groups = parse_numeric_input(val, name)
+		return true
 	end
 
 	return false
@@ -114,16 +123,17 @@ function on_init()
 		return false
 	end
 
-	-- Request the fields we need
-	for i, name in ipairs(vizinfo.key_fld) do
-		fkeys[i] = chisel.request_field(name)
-	end
-
-	fvalue = chisel.request_field(vizinfo.value_fld)
+	-- The grouping is done natively: the events go through the aggregator
+	-- without calling into Lua. If max_groups is set, past max_groups keys
+	-- the aggregator keeps the heaviest ones, so that the memory doesn't
+	-- grow with the number of keys.
+	aggregator = chisel.aggregator(vizinfo.key_fld, vizinfo.value_fld, "sum", max_groups)
 
-	-- set the filter
+	-- set the filter. Only the positive values are counted.
 	if filter ~= "" then
-		chisel.set_filter(filter)
+		chisel.set_filter("(" .. filter .. ") and " .. vizinfo.value_fld .. " > 0")
+	else
+		chisel.set_filter(vizinfo.value_fld .. " > 0")
 	end
 	
 	return true
@@ -145,39 +155,6 @@ function on_capture_start()
 	return true
 end
 
--- Event parsing callback
-function on_event()
-	local key = nil
-	local kv = nil
-	
-	for i, fld in ipairs(fkeys) do
-		kv = evt.field(fld)
-		if kv == nil then
-			return
-		end
-
-		if key == nil then
-			key = kv
-		else
-			key = key .. "\001\001" .. evt.field(fld)
-		end
-	end
-	
-	value = evt.field(fvalue)
-
-	if value ~= nil and value > 0 then
-		entryval = grtable[key]
-
-		if entryval == nil then
-			grtable[key] = value
-		else
-			grtable[key] = grtable[key] + value
-		end
-	end
-
-	return true
-end
-
 -- Periodic timeout callback
 function on_interval(ts_s, ts_ns, delta)	
 	if vizinfo.output_format ~= "json" then
@@ -185,10 +162,11 @@ function on_interval(ts_s, ts_ns, delta)
 		terminal.moveto(0, 0)
 	end
 	
-	print_sorted_table(grtable, ts_s, 0, delta, vizinfo)
+	local rows, errors, max_error = chisel.aggregator_top(aggregator, vizinfo.top_number)
+	print_table_rows(rows, ts_s, 0, delta, vizinfo, errors, max_error)
 
 	-- Clear the table
-	grtable = {}
+	chisel.aggregator_clear(aggregator)
 	
 	return true
 end
@@ -202,7 +180,8 @@ function on_capture_end(ts_s, ts_ns, delta)
 		return true
 	end
 	
-	print_sorted_table(grtable, ts_s, 0, delta, vizinfo)
+	local rows, errors, max_error = chisel.aggregator_top(aggregator, vizinfo.top_number)
+	print_table_rows(rows, ts_s, 0, delta, vizinfo, errors, max_error)
 	
 	return true
 end
@@ -88,9 +88,19 @@ static void usage()
 " -A, --print-ascii  Only print the text portion of data buffers, and echo\n"
 "                    end-of-lines. This is useful to only display human-readable\n"
 "                    data.\n"
+" --async-proc-lookups\n"
+"                    Look up the processes that are missing from the thread table\n"
+"                    on a separate thread, so that reading /proc doesn't stall\n"
+"                    the capture. The first events of such a process show\n"
+"                    incomplete process information. Only affects live captures.\n"
 " -b, --print-base64 Print data buffers in base64. This is useful for encoding\n"
 "                    binary data that needs to be used over media designed to\n"
 "                    handle textual data (i.e., terminal or json).\n"
+" --binary           Write the events as binary records instead of text. Every\n"
+"                    record is length prefixed and contains a typed value for\n"
+"                    each field of the -p format. The output starts with a\n"
+"                    header that lists the fields and their types. See\n"
+"                    binaryrecords.h in libsinsp for the layout and a reader.\n"
 #ifdef HAS_CHISELS
 " -c <chiselname> <chiselargs>, --chisel  <chiselname> <chiselargs>\n"
 "                    run the specified chisel. If the chisel require arguments,\n"
@@ -159,11 +169,23 @@ static void usage()
 "                    field.\n"
 " -n <num>, --numevents=<num>\n"
 "                    Stop capturing after <num> events\n"
+" --output-thread    Write the printed events from a separate thread, so that\n"
+"                    processing doesn't wait for slow output devices.\n"
 " -P, --progress     Print progress on stderr while processing trace files\n"
 " -p <output_format>, --print=<output_format>\n"
 "                    Specify the format to be used when printing the events.\n"
 "                    With -pc or -pcontainer will use a container-friendly format.\n"
 "                    See the examples section below for more info.\n"
+" --publish=<name>   Make the captured events available to other local sysdig\n"
+"                    instances, which read them with --subscribe=<name>. The\n"
+"                    subscribers see the events that pass the filter, and apply\n"
+"                    their own filter and output format. By default, events are\n"
+"                    lost by the subscribers that fall behind, instead of slowing\n"
+"                    down the capture.\n"
+" --publish-wait=<num>\n"
+"                    With --publish, wait for <num> subscribers before starting,\n"
+"                    and never drop the events they haven't read yet. Useful to\n"
+"                    publish trace files.\n"
 " -q, --quiet        Don't print events on the screen\n"
 "                    Useful when dumping to disk.\n"
 " -r <readfile>, --read=<readfile>\n"
@@ -174,12 +196,20 @@ static void usage()
 "                    Capture the first <len> bytes of each I/O buffer.\n"
 "                    By default, the first 80 bytes are captured. Use this\n"
 "                    option with caution, it can generate huge trace files.\n"
+" --subscribe=<name>\n"
+"                    Read the events published by a sysdig instance started with\n"
+"                    --publish=<name>, instead of capturing them. This doesn't\n"
+"                    need the driver. User, group and container information is\n"
+"                    not available to the subscribers.\n"
 " -t <timetype>, --timetype=<timetype>\n"
 "                    Change the way event time is displayed. Accepted values are\n"
 "                    h for human-readable string, a for absolute timestamp from\n"
 "                    epoch, r for relative time from the beginning of the\n"
 "                    capture, d for delta between event enter and exit, and\n"
 "                    D for delta from the previous event.\n"
+" --unbuffered       Write every event as soon as it's printed. By default the\n"
+"                    output is buffered, and written when the buffer is full or\n"
+"                    at least every 100ms.\n"
 " -v, --verbose      Verbose output.\n"
 "                    This flag will cause the full content of text and binary\n"
 "                    buffers to be printed on screen, instead of being truncated\n"
@@ -444,16 +474,33 @@ static void chisels_do_timeout(sinsp_evt* ev)
 #endif
 }
 
-void handle_end_of_file(bool print_progress, sinsp_evt_formatter* formatter = NULL)
+void handle_end_of_file(bool print_progress, sinsp_evt_formatter* formatter = NULL, sinsp_output_sink* sink = NULL)
 {
 	string line;
 
 	// Notify the formatter that we are at the
 	// end of the capture in case it needs to
 	// write any terminating characters
-	if(formatter != NULL && formatter->on_capture_end(&line))
+	if(formatter != NULL && sink != NULL && formatter->on_capture_end(&line))
 	{
-		cout << line << endl;
+		sink->write(line);
+		sink->write("\n", 1);
+	}
+
+	//
+	// Make sure that the events are out before anything that the chisels
+	// print
+	//
+	if(sink != NULL)
+	{
+		try
+		{
+			sink->flush();
+		}
+		catch(sinsp_exception& e)
+		{
+			cerr << e.what() << endl;
+		}
 	}
 
 	//
@@ -485,10 +532,12 @@ captureinfo do_inspect(sinsp* inspector,
 					   uint64_t cnt,
 					   bool quiet,
 					   bool json,
+					   bool binary,
 					   bool print_progress,
 					   sinsp_filter* display_filter,
 					   vector<summary_table_entry>* summary_table,
-					   sinsp_evt_formatter* formatter)
+					   sinsp_evt_formatter* formatter,
+					   sinsp_output_sink* sink)
 {
 	captureinfo retval;
 	int32_t res;
@@ -496,7 +545,6 @@ captureinfo do_inspect(sinsp* inspector,
 	uint64_t ts;
 	uint64_t deltats = 0;
 	uint64_t firstts = 0;
-	string line;
 	double last_printed_progress_pct = 0;
 
 	//
@@ -510,10 +558,16 @@ captureinfo do_inspect(sinsp* inspector,
 			// End of capture, either because the user stopped it, or because
 			// we reached the event count specified with -n.
 			//
-			handle_end_of_file(print_progress, formatter);
+			handle_end_of_file(print_progress, formatter, sink);
 			break;
 		}
 
+		//
+		// Don't let printed events wait in the output buffer when they
+		// come in slowly
+		//
+		sink->flush_if_stale();
+
 		res = inspector->next(&ev);
 
 		if(res == SCAP_TIMEOUT)
@@ -531,7 +585,7 @@ captureinfo do_inspect(sinsp* inspector,
 		}
 		else if(res == SCAP_EOF)
 		{
-			handle_end_of_file(print_progress, formatter);
+			handle_end_of_file(print_progress, formatter, sink);
 			break;
 		}
 		else if(res != SCAP_SUCCESS)
@@ -540,7 +594,7 @@ captureinfo do_inspect(sinsp* inspector,
 			// Event read error.
 			// Notify the chisels that we're exiting, and then die with an error.
 			//
-			handle_end_of_file(print_progress, formatter);
+			handle_end_of_file(print_progress, formatter, sink);
 			cerr << "res = " << res << endl;
 			throw sinsp_exception(inspector->getlasterr().c_str());
 		}
@@ -626,28 +680,53 @@ captureinfo do_inspect(sinsp* inspector,
 				continue;
 			}
 
-			if(formatter->tostring(ev, &line))
+			//
+			// Filter the event before formatting it, so that the events that
+			// are not displayed are not formatted either
+			//
+			if(display_filter)
+			{
+				if(!display_filter->run(ev))
+				{
+					continue;
+				}
+			}
+
+			//
+			// Render the line in place in the output buffer, leaving room for
+			// the newline. A line that doesn't fit in the reserved space is
+			// fetched again from the formatter after making room for it.
+			//
+			char* buf = sink->reserve(OUTPUT_SINK_LINE_SIZE);
+			uint32_t len;
+
+			if(binary)
 			{
-				//
-				// Output the line
-				//
-				if(display_filter)
+				if(formatter->tobinary(ev, buf, OUTPUT_SINK_LINE_SIZE, &len))
 				{
-					if(!display_filter->run(ev))
+					if(len > OUTPUT_SINK_LINE_SIZE)
 					{
-						continue;
+						buf = sink->reserve(len);
+						formatter->tobinary(ev, buf, len, &len);
 					}
-				}
 
-				cout << line;
-				if(!json)
+					sink->commit(len);
+				}
+			}
+			else if(formatter->tostring(ev, buf, OUTPUT_SINK_LINE_SIZE - 1, &len))
+			{
+				if(len > OUTPUT_SINK_LINE_SIZE - 1)
 				{
-					cout << endl;
+					buf = sink->reserve(len + 1);
+					formatter->tostring(ev, buf, len, &len);
 				}
-				else
+
+				if(!json)
 				{
-					cout << flush;
+					buf[len++] = '\n';
 				}
+
+				sink->commit(len);
 			}
 		}
 	}
@@ -683,6 +762,13 @@ sysdig_init_res sysdig_init(int argc, char **argv)
 	int32_t n_filterargs = 0;
 	int cflag = 0;
 	bool jflag = false;
+	bool unbuffered = false;
+	bool output_thread = false;
+	bool binary = false;
+	bool binary_header_written = false;
+	string publish_name;
+	uint32_t publish_wait = 0;
+	string subscribe_name;
 	string cname;
 	vector<summary_table_entry>* summary_table = NULL;
 	string timefmt = "%evt.time";
@@ -696,7 +782,9 @@ sysdig_init_res sysdig_init(int argc, char **argv)
 	static struct option long_options[] =
 	{
 		{"print-ascii", no_argument, 0, 'A' },
+		{"async-proc-lookups", no_argument, 0, 0 },
 		{"print-base64", no_argument, 0, 'b' },
+		{"binary", no_argument, 0, 0 },
 #ifdef HAS_CHISELS
 		{"chisel", required_argument, 0, 'c' },
 		{"list-chisels", no_argument, &cflag, 1 },
@@ -719,13 +807,18 @@ sysdig_init_res sysdig_init(int argc, char **argv)
 		{"list", no_argument, 0, 'l' },
 		{"list-events", no_argument, 0, 'L' },
 		{"numevents", required_argument, 0, 'n' },
+		{"output-thread", no_argument, 0, 0 },
 		{"progress", required_argument, 0, 'P' },
 		{"print", required_argument, 0, 'p' },
+		{"publish", required_argument, 0, 0 },
+		{"publish-wait", required_argument, 0, 0 },
 		{"quiet", no_argument, 0, 'q' },
 		{"readfile", required_argument, 0, 'r' },
 		{"snaplen", required_argument, 0, 's' },
+		{"subscribe", required_argument, 0, 0 },
 		{"summary", no_argument, 0, 'S' },
 		{"timetype", required_argument, 0, 't' },
+		{"unbuffered", no_argument, 0, 0 },
 		{"verbose", no_argument, 0, 'v' },
 		{"version", no_argument, 0, 0 },
 		{"writefile", required_argument, 0, 'w' },
@@ -1068,6 +1161,52 @@ sysdig_init_res sysdig_init(int argc, char **argv)
 				delete inspector;
 				return sysdig_init_res(EXIT_SUCCESS);
 			}
+
+			if(op == 0)
+			{
+				if(string(long_options[long_index].name) == "unbuffered")
+				{
+					unbuffered = true;
+				}
+				else if(string(long_options[long_index].name) == "async-proc-lookups")
+				{
+					inspector->set_async_proc_lookups(true);
+				}
+				else if(string(long_options[long_index].name) == "output-thread")
+				{
+					output_thread = true;
+				}
+				else if(string(long_options[long_index].name) == "binary")
+				{
+					binary = true;
+				}
+				else if(string(long_options[long_index].name) == "publish")
+				{
+					publish_name = optarg;
+				}
+				else if(string(long_options[long_index].name) == "publish-wait")
+				{
+					publish_wait = atoi(optarg);
+				}
+				else if(string(long_options[long_index].name) == "subscribe")
+				{
+					subscribe_name = optarg;
+				}
+			}
+		}
+
+		if(jflag && binary)
+		{
+			fprintf(stderr, "-j and --binary cannot be used together\n");
+			delete inspector;
+			return sysdig_init_res(EXIT_FAILURE);
+		}
+
+		if(subscribe_name != "" && (infiles.size() != 0 || publish_name != ""))
+		{
+			fprintf(stderr, "--subscribe cannot be used with -r or --publish\n");
+			delete inspector;
+			return sysdig_init_res(EXIT_FAILURE);
 		}
 
 		//
@@ -1182,6 +1321,14 @@ sysdig_init_res sysdig_init(int argc, char **argv)
 			inspector->set_max_evt_output_len(80);
 		}
 
+		//
+		// Publishing spans all the trace files
+		//
+		if(publish_name != "")
+		{
+			inspector->start_publishing(publish_name, FANOUT_RING_SIZE, publish_wait);
+		}
+
 		for(uint32_t j = 0; j < infiles.size() || infiles.size() == 0; j++)
 		{
 #ifdef HAS_FILTERING
@@ -1205,6 +1352,17 @@ sysdig_init_res sysdig_init(int argc, char **argv)
 				//
 				inspector->open(infiles[j]);
 			}
+			else if(subscribe_name != "")
+			{
+				if(j > 0)
+				{
+					break;
+				}
+
+				initialize_chisels();
+
+				inspector->open_subscriber(subscribe_name);
+			}
 			else
 			{
 				if(j > 0)
@@ -1263,6 +1421,25 @@ sysdig_init_res sysdig_init(int argc, char **argv)
 				inspector->set_snaplen(snaplen);
 			}
 
+#ifdef HAS_FILTERING
+			//
+			// Don't make the driver capture the events that the filter is
+			// going to discard. If the driver doesn't support event masks, just
+			// filter in userspace.
+			//
+			if(filter.size() && !is_filter_display && infiles.size() == 0)
+			{
+				try
+				{
+					inspector->apply_filter_eventmask();
+				}
+				catch(sinsp_exception& e)
+				{
+					cerr << "Unable to set the driver event mask, filtering in userspace: " << e.what() << endl;
+				}
+			}
+#endif
+
 			duration = ((double)clock()) / CLOCKS_PER_SEC;
 
 			if(outfile != "")
@@ -1276,14 +1453,41 @@ sysdig_init_res sysdig_init(int argc, char **argv)
 			//
 			chisels_on_capture_start();
 
+			//
+			// From here on the events go through the sink, which writes
+			// straight to the file descriptor. Make sure that what has been
+			// printed so far comes first.
+			//
+			cout << flush;
+			fflush(stdout);
+
+			sinsp_output_sink sink(1,
+				unbuffered? 0 : OUTPUT_SINK_BUFFER_SIZE,
+				OUTPUT_SINK_FLUSH_INTERVAL_MS,
+				output_thread);
+
+			//
+			// The binary output has a single header, also when reading
+			// multiple files
+			//
+			if(binary && !quiet && !binary_header_written)
+			{
+				string header;
+				formatter.get_binary_header(&header);
+				sink.write(header);
+				binary_header_written = true;
+			}
+
 			cinfo = do_inspect(inspector,
 				cnt,
 				quiet,
 				jflag,
+				binary,
 				print_progress,
 				display_filter,
 				summary_table,
-				&formatter);
+				&formatter,
+				&sink);
 
 			duration = ((double)clock()) / CLOCKS_PER_SEC - duration;
 
@@ -1300,6 +1504,37 @@ sysdig_init_res sysdig_init(int argc, char **argv)
 					duration,
 					cinfo.m_nevts,
 					(double)cinfo.m_nevts / duration);
+
+				fprintf(stderr, "Events with incomplete process info: %" PRIu64 "\n",
+					inspector->get_n_incomplete_thread_evts());
+
+				if(publish_name != "")
+				{
+					vector<sinsp_fanout_subscriber_stats> fstats;
+					inspector->get_fanout_stats(&fstats);
+
+					for(uint32_t k = 0; k < fstats.size(); k++)
+					{
+						fprintf(stderr, "Subscriber %" PRId64 ": Events:%" PRIu64 " Drops:%" PRIu64 " Overruns:%" PRIu64 "%s\n",
+							fstats[k].m_pid,
+							fstats[k].m_n_evts,
+							fstats[k].m_n_drops,
+							fstats[k].m_n_overruns,
+							fstats[k].m_slow? " (slow)" : "");
+					}
+				}
+
+#ifdef HAS_FILTERING
+				if(inspector->get_filter() != "")
+				{
+					fprintf(stderr, "Filter statistics:\n%s", inspector->get_filter_stats().c_str());
+				}
+
+				if(display_filter)
+				{
+					fprintf(stderr, "Display filter statistics:\n%s", display_filter->get_stats().c_str());
+				}
+#endif
 			}
 
 			//